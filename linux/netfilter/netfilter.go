@@ -264,6 +264,39 @@ func nftBlockCgroup(ctx *nftCtx, cgroup uint32) {
   })
 }
 
+func nftBlockMark(ctx *nftCtx, mark uint32) {
+  mozvpn_conn.AddRule(&nftables.Rule{
+    Table: ctx.table_inet,
+    Chain: ctx.mangle,
+    Exprs: []expr.Any{
+      // Match packets from the sockets carrying the mark
+      &expr.Meta{
+        Key:        expr.MetaKeyMARK,
+        Register:   1,
+      },
+      &expr.Cmp{
+        Op:         expr.CmpOpEq,
+        Register:   1,
+        Data:       binaryutil.NativeEndian.PutUint32(mark),
+      },
+      // Do not match packets sent to localhost interfaces
+      &expr.Meta{
+        Key:      expr.MetaKeyOIFTYPE,
+        Register: 1,
+      },
+      &expr.Cmp{
+        Op:       expr.CmpOpNeq,
+        Register: 1,
+        Data:     binaryutil.NativeEndian.PutUint16(linux.ARPHRD_LOOPBACK),
+      },
+      // Drop the packets
+      &expr.Verdict{
+        Kind:       expr.VerdictDrop,
+      },
+    },
+  })
+}
+
 //export NetfilterCreateTables
 func NetfilterCreateTables() int32 {
   logger := log.New(&CLogger{level: 0}, "", 0)
@@ -429,4 +462,14 @@ func NetfilterBlockCgroup(cgroup uint32) int32 {
   return nftCommit(logger)
 }
 
+//export NetfilterBlockMark
+func NetfilterBlockMark(mark uint32) int32 {
+  logger := log.New(&CLogger{level: 0}, "", 0)
+
+  nftBlockMark(&mozvpn_ctx, mark)
+
+  logger.Println("Blocking traffic marked with", mark)
+  return nftCommit(logger)
+}
+
 func main() {}
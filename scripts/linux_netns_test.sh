@@ -0,0 +1,37 @@
+#!/bin/bash
+
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+. $(dirname $0)/commons.sh
+
+print N "This script runs the unit tests in a private network namespace, with"
+print N "the routing and the split tunnel tests enabled"
+print N ""
+
+if ! [ -d "src" ] || ! [ -d "tests" ]; then
+  die "This script must be executed at the root of the repository."
+fi
+
+if [ "$(id -u)" != "0" ]; then
+  die "This script must be executed as root."
+fi
+
+TESTS=${1:-./tests/unit/tests}
+[ -x "$TESTS" ] || die "Unable to find the unit tests: $TESTS"
+
+# The nftables tables, the ip rules and the routes of the tests stay in the
+# namespace. The mount of the cgroup hierarchy stays in the mount namespace.
+unshare --net --mount -- bash -s "$TESTS" <<'SCRIPT' || die "Failed to run tests"
+set -e
+ip link set lo up
+
+CGROUP2=$(mktemp -d)
+mount -t cgroup2 none "$CGROUP2"
+trap 'rmdir "$CGROUP2/mozvpn.test" 2>/dev/null; umount "$CGROUP2"; rmdir "$CGROUP2"' EXIT
+
+MVPN_TEST_NETNS=1 MVPN_TEST_CGROUP2="$CGROUP2" "$1"
+SCRIPT
+
+print G "All tests passed"
@@ -4,7 +4,10 @@
 
 #include "adjustfiltering.h"
 
+#include <QVarLengthArray>
+
 #include <algorithm>
+#include <cstring>
 
 namespace {
 AdjustFiltering* s_instance = nullptr;
@@ -20,6 +23,7 @@ AdjustFiltering* AdjustFiltering::instance() {
 
 void AdjustFiltering::allowField(const QString& field) {
   allowList.insert(field);
+  m_compiled = false;
 
   if (denyList.contains(field)) {
     denyList.remove(field);
@@ -32,6 +36,7 @@ void AdjustFiltering::allowField(const QString& field) {
 
 void AdjustFiltering::denyField(const QString& field, const QString& param) {
   denyList.insert(field, param);
+  m_compiled = false;
 
   if (allowList.contains(field)) {
     allowList.remove(field);
@@ -45,6 +50,7 @@ void AdjustFiltering::denyField(const QString& field, const QString& param) {
 void AdjustFiltering::mirrorField(const QString& field,
                                   const MirrorParam& param) {
   mirrorList.insert(field, param);
+  m_compiled = false;
 
   if (allowList.contains(field)) {
     allowList.remove(field);
@@ -57,44 +63,161 @@ void AdjustFiltering::mirrorField(const QString& field,
 
 QUrlQuery AdjustFiltering::filterParameters(QUrlQuery& parameters,
                                             QStringList& unknownParameters) {
-  QUrlQuery newParameters;
+  QByteArray query = parameters.query(QUrl::FullyEncoded).toLatin1();
+  return QUrlQuery(
+      QString::fromLatin1(filterQuery(query, unknownParameters)));
+}
+
+void AdjustFiltering::compile() {
+  m_rules.clear();
+  m_rules.reserve(allowList.size() + denyList.size() + mirrorList.size());
+
+  // The order matters for the duplicates: allow wins over deny, and deny
+  // over mirror.
+  for (const QString& name : allowList) {
+    m_rules.append(Rule{name.toUtf8(), RuleAllow, QByteArray(), -1});
+  }
+
+  for (auto i = denyList.constBegin(); i != denyList.constEnd(); ++i) {
+    m_rules.append(Rule{i.key().toUtf8(), RuleDeny,
+                        QUrl::toPercentEncoding(i.value()), -1});
+  }
 
-  for (const QPair<QString, QString>& parameter : parameters.queryItems()) {
-    if (allowList.contains(parameter.first)) {
-      newParameters.addQueryItem(parameter.first, parameter.second);
+  for (auto i = mirrorList.constBegin(); i != mirrorList.constEnd(); ++i) {
+    m_rules.append(Rule{i.key().toUtf8(), RuleMirror,
+                        QUrl::toPercentEncoding(i.value().m_defaultValue),
+                        -1});
+  }
+
+  std::stable_sort(m_rules.begin(), m_rules.end(),
+                   [](const Rule& a, const Rule& b) {
+                     return a.m_name < b.m_name;
+                   });
+  m_rules.erase(std::unique(m_rules.begin(), m_rules.end(),
+                            [](const Rule& a, const Rule& b) {
+                              return a.m_name == b.m_name;
+                            }),
+                m_rules.end());
+
+  // Only the allowed parameters can be mirrored.
+  for (Rule& rule : m_rules) {
+    if (rule.m_type != RuleMirror) {
       continue;
     }
 
-    if (denyList.contains(parameter.first)) {
-      newParameters.addQueryItem(parameter.first,
-                                 denyList.value(parameter.first));
-      continue;
+    const MirrorParam mirrorParam =
+        mirrorList.value(QString::fromUtf8(rule.m_name));
+    int source = findRule(mirrorParam.m_mirrorParamName.toUtf8());
+    if (source >= 0 && m_rules.at(source).m_type == RuleAllow) {
+      rule.m_source = source;
     }
+  }
 
-    if (mirrorList.contains(parameter.first)) {
-      const MirrorParam& mirrorParam = mirrorList.value(parameter.first);
-      bool found = false;
-
-      if (allowList.contains(mirrorParam.m_mirrorParamName)) {
-        for (const QPair<QString, QString>& otherParameter :
-             parameters.queryItems()) {
-          if (mirrorParam.m_mirrorParamName == otherParameter.first) {
-            newParameters.addQueryItem(parameter.first, otherParameter.second);
-            found = true;
-            break;
-          }
+  m_compiled = true;
+}
+
+int AdjustFiltering::findRule(const QByteArray& name) const {
+  auto i = std::lower_bound(
+      m_rules.constBegin(), m_rules.constEnd(), name,
+      [](const Rule& rule, const QByteArray& name) {
+        return rule.m_name < name;
+      });
+  if (i == m_rules.constEnd() || i->m_name != name) {
+    return -1;
+  }
+  return static_cast<int>(i - m_rules.constBegin());
+}
+
+QByteArray AdjustFiltering::filterQuery(const QByteArray& query,
+                                        QStringList& unknownParameters) {
+  if (!m_compiled) {
+    compile();
+  }
+
+  struct Item {
+    int m_start;
+    int m_nameEnd;
+    int m_valueStart;
+    int m_end;
+    int m_rule;
+  };
+
+  // The known parameters, in order, and the first occurrence of each of them
+  // for the mirrors.
+  QVarLengthArray<Item, 64> items;
+  QVarLengthArray<int, 128> firstItem(m_rules.size());
+  std::fill(firstItem.begin(), firstItem.end(), -1);
+
+  const char* data = query.constData();
+  const int length = query.length();
+
+  int start = 0;
+  while (start < length) {
+    const char* amp = static_cast<const char*>(
+        memchr(data + start, '&', length - start));
+    int end = amp ? static_cast<int>(amp - data) : length;
+
+    if (end > start) {
+      const char* eq =
+          static_cast<const char*>(memchr(data + start, '=', end - start));
+      int nameEnd = eq ? static_cast<int>(eq - data) : end;
+
+      QByteArray name =
+          QByteArray::fromRawData(data + start, nameEnd - start);
+      bool encoded = name.contains('%');
+      int rule = findRule(encoded ? QUrl::fromPercentEncoding(name).toUtf8()
+                                  : name);
+
+      if (rule < 0) {
+        unknownParameters.append(encoded ? QUrl::fromPercentEncoding(name)
+                                         : QString::fromUtf8(name));
+      } else {
+        if (firstItem[rule] < 0) {
+          firstItem[rule] = items.size();
         }
+        items.append(Item{start, nameEnd, eq ? nameEnd + 1 : end, end, rule});
       }
+    }
 
-      if (!found) {
-        newParameters.addQueryItem(parameter.first, mirrorParam.m_defaultValue);
-      }
+    start = end + 1;
+  }
 
-      continue;
+  QByteArray result;
+  result.reserve(length);
+
+  for (const Item& item : items) {
+    const Rule& rule = m_rules.at(item.m_rule);
+
+    if (!result.isEmpty()) {
+      result.append('&');
     }
+    result.append(data + item.m_start, item.m_nameEnd - item.m_start);
+
+    switch (rule.m_type) {
+      case RuleAllow:
+        // The value, with its '=', as it is.
+        result.append(data + item.m_nameEnd, item.m_end - item.m_nameEnd);
+        break;
+
+      case RuleDeny:
+        result.append('=').append(rule.m_value);
+        break;
+
+      case RuleMirror: {
+        result.append('=');
+        int source = rule.m_source >= 0 ? firstItem[rule.m_source] : -1;
+        if (source < 0) {
+          result.append(rule.m_value);
+          break;
+        }
 
-    unknownParameters.append(parameter.first);
+        const Item& sourceItem = items.at(source);
+        result.append(data + sourceItem.m_valueStart,
+                      sourceItem.m_end - sourceItem.m_valueStart);
+        break;
+      }
+    }
   }
 
-  return newParameters;
+  return result;
 }
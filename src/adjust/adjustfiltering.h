@@ -7,10 +7,12 @@
 
 #include "constants.h"
 
+#include <QByteArray>
 #include <QUrl>
 #include <QUrlQuery>
 #include <QSet>
 #include <QMap>
+#include <QVector>
 
 class AdjustFiltering final {
  public:
@@ -110,9 +112,41 @@ class AdjustFiltering final {
   QUrlQuery filterParameters(QUrlQuery& parameters,
                              QStringList& unknownParameters);
 
+  // Same as filterParameters(), on a percent-encoded query string
+  // ("a=b&c=d") as received. The values which are kept are copied as they
+  // are, without being decoded.
+  QByteArray filterQuery(const QByteArray& query,
+                         QStringList& unknownParameters);
+
   void allowField(const QString& field);
   void denyField(const QString& field, const QString& param);
   void mirrorField(const QString& field, const MirrorParam& param);
+
+ private:
+  enum RuleType {
+    RuleAllow,
+    RuleDeny,
+    RuleMirror,
+  };
+
+  // The three lists merged in a single table, sorted by name.
+  struct Rule {
+    QByteArray m_name;
+    RuleType m_type;
+    // The replacement for RuleDeny, the default value for RuleMirror.
+    // Percent-encoded.
+    QByteArray m_value;
+    // RuleMirror only: the rule of the mirrored parameter, if it's allowed.
+    int m_source;
+  };
+
+  void compile();
+  int findRule(const QByteArray& name) const;
+
+  // Rebuilt by the first filtering after a change made through allowField(),
+  // denyField() or mirrorField().
+  QVector<Rule> m_rules;
+  bool m_compiled = false;
 };
 
 #endif  // ADJUSTFILTERING_H
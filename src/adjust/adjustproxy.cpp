@@ -4,6 +4,7 @@
 
 #include "adjustproxy.h"
 #include "adjustproxyconnection.h"
+#include "adjustupstreampool.h"
 #include "leakdetector.h"
 #include "logger.h"
 
@@ -17,6 +18,8 @@ Logger logger(LOG_ADJUST, "AdjustProxy");
 AdjustProxy::AdjustProxy(QObject* parent) : QTcpServer(parent) {
   MVPN_COUNT_CTOR(AdjustProxy);
   logger.debug() << "Creating the AdjustProxy server";
+
+  m_upstreamPool = new AdjustUpstreamPool(this);
 }
 
 AdjustProxy::~AdjustProxy() { MVPN_COUNT_DTOR(AdjustProxy); }
@@ -41,6 +44,7 @@ void AdjustProxy::newConnectionReceived() {
   QTcpSocket* child = nextPendingConnection();
   Q_ASSERT(child);
 
-  AdjustProxyConnection* connection = new AdjustProxyConnection(this, child);
+  AdjustProxyConnection* connection =
+      new AdjustProxyConnection(this, child, m_upstreamPool);
   connect(child, &QTcpSocket::disconnected, connection, &QObject::deleteLater);
 }
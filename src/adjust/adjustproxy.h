@@ -7,6 +7,8 @@
 
 #include <QTcpServer>
 
+class AdjustUpstreamPool;
+
 class AdjustProxy final : public QTcpServer {
   Q_OBJECT
   Q_DISABLE_COPY_MOVE(AdjustProxy)
@@ -19,6 +21,9 @@ class AdjustProxy final : public QTcpServer {
 
  private:
   void newConnectionReceived();
+
+ private:
+  AdjustUpstreamPool* m_upstreamPool = nullptr;
 };
 
 #endif  // ADJUSTPROXY_H
@@ -8,33 +8,52 @@
 #include "adjustproxyconnection.h"
 #include "adjustfiltering.h"
 #include "adjusttasksubmission.h"
+#include "adjustupstreampool.h"
 #include "constants.h"
 #include "leakdetector.h"
 #include "logger.h"
 #include "mozillavpn.h"
 #include "qmlengineholder.h"
-#include "taskscheduler.h"
 
+#include <QTcpSocket>
 #include <QUrl>
 #include <QUrlQuery>
 
 const QString HTTP_RESPONSE(
-    "HTTP/1.1 %1\nContent-Type: application/json\n\n%2\n");
+    "HTTP/1.1 %1\r\nContent-Type: application/json\r\nContent-Length: "
+    "%2\r\nConnection: %3\r\n\r\n");
+
+// Requests forwarded and not answered yet, per connection. The following
+// ones wait in the package handler.
+constexpr int ADJUST_PROXY_MAX_PIPELINED_REQUESTS = 16;
+
+constexpr int ADJUST_PROXY_IDLE_TIMEOUT_MSEC = 30000;
 
 namespace {
 Logger logger(LOG_ADJUST, "AdjustProxyConnection");
 }  // namespace
 
 AdjustProxyConnection::AdjustProxyConnection(QObject* parent,
-                                             QTcpSocket* connection)
-    : QObject(parent), m_connection(connection) {
+                                             QTcpSocket* connection,
+                                             AdjustUpstreamPool* upstreamPool)
+    : QObject(parent),
+      m_connection(connection),
+      m_upstreamPool(upstreamPool) {
   MVPN_COUNT_CTOR(AdjustProxyConnection);
 
   logger.debug() << "New connection received";
 
   Q_ASSERT(m_connection);
+  Q_ASSERT(m_upstreamPool);
   connect(m_connection, &QTcpSocket::readyRead, this,
           &AdjustProxyConnection::readData);
+
+  m_idleTimer.setSingleShot(true);
+  connect(&m_idleTimer, &QTimer::timeout, this, [this]() {
+    logger.debug() << "Idle connection closed";
+    m_connection->close();
+  });
+  m_idleTimer.start(ADJUST_PROXY_IDLE_TIMEOUT_MSEC);
 }
 
 AdjustProxyConnection::~AdjustProxyConnection() {
@@ -45,17 +64,31 @@ AdjustProxyConnection::~AdjustProxyConnection() {
 void AdjustProxyConnection::readData() {
   logger.debug() << "New data read";
   Q_ASSERT(m_connection);
-  QByteArray input = m_connection->readAll();
 
-  m_packageHandler.processData(input);
+  m_packageHandler.processData(m_connection->readAll());
+  processRequests();
+}
 
-  if (m_packageHandler.isInvalidRequest()) {
-    m_connection->close();
-    return;
+void AdjustProxyConnection::processRequests() {
+  while (m_closeAfter < 0 && m_packageHandler.isProcessingDone() &&
+         m_nextRequest - m_nextResponse < ADJUST_PROXY_MAX_PIPELINED_REQUESTS) {
+    bool keepAlive = m_packageHandler.keepAlive();
+    forwardRequest();
+
+    if (!keepAlive) {
+      m_closeAfter = m_nextRequest - 1;
+      return;
+    }
+
+    m_packageHandler.nextRequest();
   }
 
-  if (m_packageHandler.isProcessingDone()) {
-    forwardRequest();
+  if (m_closeAfter < 0 && m_packageHandler.isInvalidRequest()) {
+    // The responses to the previous requests are written first.
+    m_closeAfter = m_nextRequest - 1;
+    if (m_closeAfter < m_nextResponse) {
+      m_connection->close();
+    }
   }
 }
 
@@ -88,13 +121,46 @@ void AdjustProxyConnection::forwardRequest() {
       new AdjustTaskSubmission(method, path, headers, queryParameters,
                                bodyParameters, unknownParameters);
 
-  connect(
-      task, &AdjustTaskSubmission::operationCompleted, this,
-      [this](const QByteArray& data, int statusCode) {
-        m_connection->write(
-            HTTP_RESPONSE.arg(QByteArray::number(statusCode), data).toUtf8());
-        m_connection->close();
-      });
+  qint64 sequence = m_nextRequest++;
+  connect(task, &AdjustTaskSubmission::operationCompleted, this,
+          [this, sequence](const QByteArray& data, int statusCode) {
+            responseReceived(sequence, data, statusCode);
+          });
+
+  m_idleTimer.stop();
+  m_upstreamPool->submit(task);
+}
+
+void AdjustProxyConnection::responseReceived(qint64 sequence,
+                                             const QByteArray& data,
+                                             int statusCode) {
+  m_responses.insert(sequence, qMakePair(statusCode, data));
+  writeResponses();
+}
 
-  TaskScheduler::scheduleTask(task);
+void AdjustProxyConnection::writeResponses() {
+  while (m_responses.contains(m_nextResponse)) {
+    QPair<int, QByteArray> response = m_responses.take(m_nextResponse);
+    bool close = m_nextResponse == m_closeAfter;
+    ++m_nextResponse;
+
+    m_connection->write(HTTP_RESPONSE
+                            .arg(QString::number(response.first),
+                                 QString::number(response.second.length()),
+                                 QString(close ? "close" : "keep-alive"))
+                            .toUtf8());
+    m_connection->write(response.second);
+
+    if (close) {
+      m_connection->close();
+      return;
+    }
+  }
+
+  // Pipelined requests may be waiting for a free slot.
+  processRequests();
+
+  if (m_nextResponse == m_nextRequest) {
+    m_idleTimer.start(ADJUST_PROXY_IDLE_TIMEOUT_MSEC);
+  }
 }
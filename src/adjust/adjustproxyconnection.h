@@ -7,25 +7,53 @@
 
 #include "adjustproxypackagehandler.h"
 
+#include <QHash>
 #include <QObject>
+#include <QPair>
+#include <QTimer>
 
+class AdjustUpstreamPool;
 class QTcpSocket;
 
+// A connection of the Adjust SDK. It stays open between requests (HTTP/1.1
+// keep-alive), and pipelined requests are forwarded concurrently: the
+// responses are written back in the order of the requests.
 class AdjustProxyConnection final : public QObject {
   Q_OBJECT
   Q_DISABLE_COPY_MOVE(AdjustProxyConnection)
 
  public:
-  AdjustProxyConnection(QObject* parent, QTcpSocket* connection);
+  AdjustProxyConnection(QObject* parent, QTcpSocket* connection,
+                        AdjustUpstreamPool* upstreamPool);
   ~AdjustProxyConnection();
 
  private:
   void readData();
+  void processRequests();
   void forwardRequest();
+  void responseReceived(qint64 sequence, const QByteArray& data,
+                        int statusCode);
+  void writeResponses();
 
  private:
   QTcpSocket* m_connection = nullptr;
+  AdjustUpstreamPool* m_upstreamPool = nullptr;
   AdjustProxyPackageHandler m_packageHandler;
+
+  // Sequence numbers of the next request to forward and of the next response
+  // to write.
+  qint64 m_nextRequest = 0;
+  qint64 m_nextResponse = 0;
+
+  // Status codes and bodies of the responses received before the ones of
+  // the previous requests.
+  QHash<qint64, QPair<int, QByteArray>> m_responses;
+
+  // The sequence number of the last response before closing the connection,
+  // or -1.
+  qint64 m_closeAfter = -1;
+
+  QTimer m_idleTimer;
 };
 
 #endif  // ADJUSTPROXYCONNECTION_H
@@ -10,7 +10,10 @@
 #include "qmlengineholder.h"
 
 #include <QUrl>
-#include <QUrlQuery>
+
+// Requests are small: anything bigger is not from the Adjust SDK.
+constexpr int ADJUST_PROXY_MAX_LINE_LENGTH = 16384;
+constexpr uint32_t ADJUST_PROXY_MAX_BODY_LENGTH = 1024 * 1024;
 
 namespace {
 Logger logger(LOG_ADJUST, "AdjustProxyPackageHandler");
@@ -56,22 +59,62 @@ void AdjustProxyPackageHandler::processData(const QByteArray& input) {
   }
 }
 
-bool AdjustProxyPackageHandler::processFirstLine() {
-  logger.debug() << "Processing first line";
-
-  if (m_buffer.isEmpty()) {
-    return false;
+void AdjustProxyPackageHandler::nextRequest() {
+  Q_ASSERT(m_state == ProcessingState::ProcessingDone);
+
+  // The buffer is compacted once per request, not once per line.
+  m_buffer.remove(0, m_cursor);
+  m_scan = qMax(0, m_scan - m_cursor);
+  m_cursor = 0;
+
+  m_state = ProcessingState::NotStarted;
+  m_contentLength = 0;
+  m_keepAlive = true;
+  m_method.clear();
+  m_route.clear();
+  m_path.clear();
+  m_headers.clear();
+  m_queryParameters.clear();
+  m_bodyParameters.clear();
+  m_unknownParameters.clear();
+
+  if (m_cursor < m_buffer.length()) {
+    processData(QByteArray());
   }
+}
 
-  int pos = m_buffer.indexOf("\n");
+bool AdjustProxyPackageHandler::readLine(QByteArray& line) {
+  int pos = m_buffer.indexOf('\n', qMax(m_scan, m_cursor));
   if (pos == -1) {
+    m_scan = m_buffer.length();
+
+    if (m_scan - m_cursor > ADJUST_PROXY_MAX_LINE_LENGTH) {
+      logger.error() << "Line too long; connection should be closed";
+      m_state = ProcessingState::InvalidRequest;
+    }
     return false;
   }
 
-  QByteArray line = m_buffer.left(pos);
-  m_buffer.remove(0, pos + 1);
+  line = QByteArray::fromRawData(m_buffer.constData() + m_cursor,
+                                 pos - m_cursor);
+  m_cursor = pos + 1;
+  m_scan = m_cursor;
+  return true;
+}
+
+bool AdjustProxyPackageHandler::processFirstLine() {
+  logger.debug() << "Processing first line";
+
+  QByteArray line;
+  do {
+    if (!readLine(line)) {
+      return false;
+    }
+    // Empty lines before a request are ignored (RFC 7230, 3.5): some
+    // clients send a line break after the body.
+  } while (line.trimmed().isEmpty());
 
-  QList<QByteArray> parts = line.split(' ');
+  QList<QByteArray> parts = line.trimmed().split(' ');
   if (parts.length() < 2) {
     logger.error() << "Invalid HTTP request; connection should be closed";
     m_state = ProcessingState::InvalidRequest;
@@ -82,6 +125,9 @@ bool AdjustProxyPackageHandler::processFirstLine() {
   m_route = parts[1].trimmed();
   m_path = m_route.path();
 
+  // Persistent connections are the default since HTTP/1.1.
+  m_keepAlive = parts.length() < 3 || parts[2] != "HTTP/1.0";
+
   m_state = ProcessingState::FirstLineDone;
   logger.debug() << m_method << ", " << m_path;
   return true;
@@ -90,25 +136,18 @@ bool AdjustProxyPackageHandler::processFirstLine() {
 bool AdjustProxyPackageHandler::processHeaders() {
   logger.debug() << "Processing headers";
 
-  if (m_buffer.isEmpty()) {
-    return false;
-  }
-
   while (true) {
-    int pos = m_buffer.indexOf("\n");
-    if (pos == -1) {
+    QByteArray line;
+    if (!readLine(line)) {
       return false;
     }
 
-    QByteArray line = m_buffer.left(pos);
-    m_buffer.remove(0, pos + 1);
-
     QByteArray header = line.trimmed();
     if (header.isEmpty()) {
       break;
     }
 
-    pos = header.indexOf(":");
+    int pos = header.indexOf(":");
     if (pos == -1) {
       continue;
     }
@@ -125,11 +164,23 @@ bool AdjustProxyPackageHandler::processHeaders() {
       continue;
     }
 
+    // Hop-by-hop header: it is about this connection, not about the request.
+    if (QString::compare(headerPair.first, "connection",
+                         Qt::CaseInsensitive) == 0) {
+      if (headerPair.second.contains("close", Qt::CaseInsensitive)) {
+        m_keepAlive = false;
+      } else if (headerPair.second.contains("keep-alive",
+                                            Qt::CaseInsensitive)) {
+        m_keepAlive = true;
+      }
+      continue;
+    }
+
     if (QString::compare(headerPair.first, "content-length",
                          Qt::CaseInsensitive) == 0) {
       bool ok;
       m_contentLength = headerPair.second.toUInt(&ok, 10);
-      if (!ok) {
+      if (!ok || m_contentLength > ADJUST_PROXY_MAX_BODY_LENGTH) {
         logger.error() << "Content Length could not be parsed; connection "
                           "should be closed";
         m_state = ProcessingState::InvalidRequest;
@@ -148,21 +199,16 @@ bool AdjustProxyPackageHandler::processHeaders() {
 bool AdjustProxyPackageHandler::processParameters() {
   logger.debug() << "Processing parameters";
 
-  uint32_t bodyLength = m_buffer.trimmed().length();
-
-  if (bodyLength > m_contentLength) {
-    logger.error() << "Buffer longer than the declared Contend-Length; "
-                      "connection should be closed";
-    m_state = ProcessingState::InvalidRequest;
+  // What follows the body belongs to the next request.
+  if (static_cast<uint32_t>(m_buffer.length() - m_cursor) < m_contentLength) {
     return false;
   }
 
-  if (bodyLength < m_contentLength) {
-    return false;
-  }
-  m_bodyParameters = QUrlQuery(m_buffer.trimmed());
+  // A copy: the buffer is compacted before the request is forwarded.
+  m_bodyParameters = m_buffer.mid(m_cursor, m_contentLength).trimmed();
+  m_cursor += m_contentLength;
 
-  m_queryParameters = QUrlQuery(m_route);
+  m_queryParameters = m_route.query(QUrl::FullyEncoded).toLatin1();
 
   m_state = ProcessingState::ParametersDone;
   return true;
@@ -171,9 +217,9 @@ bool AdjustProxyPackageHandler::processParameters() {
 void AdjustProxyPackageHandler::filterParameters() {
   logger.debug() << "Filtering parameters";
 
-  m_queryParameters = AdjustFiltering::instance()->filterParameters(
+  m_queryParameters = AdjustFiltering::instance()->filterQuery(
       m_queryParameters, m_unknownParameters);
-  m_bodyParameters = AdjustFiltering::instance()->filterParameters(
+  m_bodyParameters = AdjustFiltering::instance()->filterQuery(
       m_bodyParameters, m_unknownParameters);
 
   m_state = ProcessingState::ProcessingDone;
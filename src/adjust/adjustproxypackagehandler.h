@@ -6,9 +6,13 @@
 #define ADJUSTPROXYPACKAGEHANDLER_H
 
 #include <QByteArray>
+#include <QStringList>
 #include <QUrl>
-#include <QUrlQuery>
 
+// Incremental parser of the HTTP requests of a connection. The data is
+// appended to a single buffer, and a cursor keeps track of what has been
+// parsed: nothing is copied or scanned twice. Pipelined requests wait in the
+// buffer until nextRequest() is called.
 class AdjustProxyPackageHandler final {
   Q_DISABLE_COPY_MOVE(AdjustProxyPackageHandler)
 
@@ -26,17 +30,25 @@ class AdjustProxyPackageHandler final {
   ~AdjustProxyPackageHandler();
 
   void processData(const QByteArray& input);
+
+  // Forgets the processed request and parses the next one, if it has been
+  // pipelined behind it.
+  void nextRequest();
+
+  // Whether the client wants the connection to stay open after this request.
+  bool keepAlive() const { return m_keepAlive; }
   ProcessingState getProcessingState() { return m_state; }
   bool isProcessingDone() { return m_state == ProcessingState::ProcessingDone; }
   bool isInvalidRequest() { return m_state == ProcessingState::InvalidRequest; }
 
   const QString& getMethod() const { return m_method; }
   const QString& getPath() const { return m_path; }
+  // Percent-encoded, as sent by the client.
   const QString getQueryParameters() const {
-    return m_queryParameters.toString();
+    return QString::fromUtf8(m_queryParameters);
   }
   const QString getBodyParameters() const {
-    return m_bodyParameters.toString();
+    return QString::fromUtf8(m_bodyParameters);
   }
   const QStringList& getUnknownParameters() const {
     return m_unknownParameters;
@@ -44,6 +56,10 @@ class AdjustProxyPackageHandler final {
   const QList<QPair<QString, QString>>& getHeaders() const { return m_headers; }
 
  private:
+  // Returns the next complete line, without the line break. The line points
+  // into m_buffer: it is only valid until the next append.
+  bool readLine(QByteArray& line);
+
   bool processFirstLine();
   bool processHeaders();
   bool processParameters();
@@ -52,13 +68,18 @@ class AdjustProxyPackageHandler final {
  public:
   ProcessingState m_state = ProcessingState::NotStarted;
   QByteArray m_buffer;
+  // The beginning of what has not been parsed yet.
+  int m_cursor = 0;
+  // Where the search for the next line break resumes.
+  int m_scan = 0;
   uint32_t m_contentLength = 0;
+  bool m_keepAlive = true;
   QString m_method;
   QUrl m_route;
   QString m_path;
   QList<QPair<QString, QString>> m_headers;
-  QUrlQuery m_queryParameters;
-  QUrlQuery m_bodyParameters;
+  QByteArray m_queryParameters;
+  QByteArray m_bodyParameters;
   QStringList m_unknownParameters;
 };
 
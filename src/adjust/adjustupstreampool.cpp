@@ -0,0 +1,53 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "adjustupstreampool.h"
+#include "adjusttasksubmission.h"
+#include "leakdetector.h"
+#include "logger.h"
+
+// The network manager keeps up to 6 connections alive per host: more
+// concurrent requests would just wait for one of them.
+constexpr int ADJUST_UPSTREAM_MAX_CONCURRENT_REQUESTS = 6;
+
+namespace {
+Logger logger(LOG_ADJUST, "AdjustUpstreamPool");
+}  // namespace
+
+AdjustUpstreamPool::AdjustUpstreamPool(QObject* parent) : QObject(parent) {
+  MVPN_COUNT_CTOR(AdjustUpstreamPool);
+}
+
+AdjustUpstreamPool::~AdjustUpstreamPool() {
+  MVPN_COUNT_DTOR(AdjustUpstreamPool);
+}
+
+void AdjustUpstreamPool::submit(AdjustTaskSubmission* submission) {
+  Q_ASSERT(submission);
+
+  submission->setParent(this);
+  m_pending.append(submission);
+
+  maybeRunNext();
+}
+
+void AdjustUpstreamPool::maybeRunNext() {
+  while (m_running < ADJUST_UPSTREAM_MAX_CONCURRENT_REQUESTS &&
+         !m_pending.isEmpty()) {
+    AdjustTaskSubmission* submission = m_pending.takeFirst();
+    ++m_running;
+
+    logger.debug() << "Forwarding a request - running:" << m_running
+                   << "pending:" << m_pending.length();
+
+    connect(submission, &Task::completed, this, [this, submission]() {
+      Q_ASSERT(m_running > 0);
+      --m_running;
+      submission->deleteLater();
+      maybeRunNext();
+    });
+
+    submission->run();
+  }
+}
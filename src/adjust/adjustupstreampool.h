@@ -0,0 +1,36 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef ADJUSTUPSTREAMPOOL_H
+#define ADJUSTUPSTREAMPOOL_H
+
+#include <QList>
+#include <QObject>
+
+class AdjustTaskSubmission;
+
+// Forwards the requests of the Adjust proxy to the guardian, a few at a time,
+// in the order they are submitted. It doesn't go through the TaskScheduler:
+// the SDK events neither wait for the other tasks nor block them.
+class AdjustUpstreamPool final : public QObject {
+  Q_OBJECT
+  Q_DISABLE_COPY_MOVE(AdjustUpstreamPool)
+
+ public:
+  explicit AdjustUpstreamPool(QObject* parent);
+  ~AdjustUpstreamPool();
+
+  // The pool takes the ownership of the submission and deletes it when it
+  // completes.
+  void submit(AdjustTaskSubmission* submission);
+
+ private:
+  void maybeRunNext();
+
+ private:
+  QList<AdjustTaskSubmission*> m_pending;
+  int m_running = 0;
+};
+
+#endif  // ADJUSTUPSTREAMPOOL_H
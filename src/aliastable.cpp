@@ -0,0 +1,84 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "aliastable.h"
+
+#include <QRandomGenerator>
+
+void AliasTable::build(const QVector<double>& weights) {
+  int count = weights.size();
+  m_probability.resize(count);
+  m_alias.resize(count);
+
+  if (count == 0) {
+    return;
+  }
+
+  double sum = 0;
+  for (double weight : weights) {
+    sum += qMax(0.0, weight);
+  }
+
+  // Scale the weights so that their average is 1.
+  QVector<double> scaled(count);
+  for (int i = 0; i < count; ++i) {
+    scaled[i] = sum > 0 ? qMax(0.0, weights[i]) * count / sum : 1.0;
+  }
+
+  QVector<int> small;
+  QVector<int> large;
+  small.reserve(count);
+  large.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    if (scaled[i] < 1.0) {
+      small.append(i);
+    } else {
+      large.append(i);
+    }
+  }
+
+  while (!small.isEmpty() && !large.isEmpty()) {
+    int less = small.takeLast();
+    int more = large.takeLast();
+
+    m_probability[less] = scaled[less];
+    m_alias[less] = more;
+
+    scaled[more] = (scaled[more] + scaled[less]) - 1.0;
+    if (scaled[more] < 1.0) {
+      small.append(more);
+    } else {
+      large.append(more);
+    }
+  }
+
+  // What remains has a probability of 1, modulo rounding errors.
+  for (int i : large) {
+    m_probability[i] = 1.0;
+    m_alias[i] = i;
+  }
+  for (int i : small) {
+    m_probability[i] = 1.0;
+    m_alias[i] = i;
+  }
+}
+
+void AliasTable::clear() {
+  m_probability.clear();
+  m_alias.clear();
+}
+
+int AliasTable::pick(QRandomGenerator* generator) const {
+  Q_ASSERT(generator);
+
+  if (m_probability.isEmpty()) {
+    return -1;
+  }
+
+  int column = generator->bounded(m_probability.size());
+  if (generator->generateDouble() < m_probability[column]) {
+    return column;
+  }
+  return m_alias[column];
+}
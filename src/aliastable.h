@@ -0,0 +1,33 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef ALIASTABLE_H
+#define ALIASTABLE_H
+
+#include <QVector>
+
+class QRandomGenerator;
+
+// Weighted random sampling with Vose's alias method: the table is built in
+// O(n) and each pick is O(1).
+class AliasTable final {
+ public:
+  // Negative weights count as 0. If all the weights are 0, every entry has the
+  // same probability to be picked.
+  void build(const QVector<double>& weights);
+
+  void clear();
+
+  bool isEmpty() const { return m_probability.isEmpty(); }
+  int size() const { return m_probability.size(); }
+
+  // Returns the index of the picked entry, or -1 if the table is empty.
+  int pick(QRandomGenerator* generator) const;
+
+ private:
+  QVector<double> m_probability;
+  QVector<int> m_alias;
+};
+
+#endif  // ALIASTABLE_H
@@ -6,9 +6,16 @@
 #include "captiveportalrequesttask.h"
 #include "leakdetector.h"
 #include "logger.h"
+#include "mozillavpn.h"
+#include "networkwatcher.h"
 #include "taskscheduler.h"
 
-constexpr uint32_t CAPTIVE_PORTAL_MONITOR_MSEC = 10000;
+constexpr uint32_t CAPTIVE_PORTAL_MONITOR_MIN_MSEC = 2000;
+constexpr uint32_t CAPTIVE_PORTAL_MONITOR_MAX_MSEC = 60000;
+
+// While the portal is there, the user is probably logging in: the VPN must
+// come back soon after.
+constexpr uint32_t CAPTIVE_PORTAL_MONITOR_PORTAL_MAX_MSEC = 10000;
 
 namespace {
 Logger logger(LOG_NETWORKING, "CaptivePortalMonitor");
@@ -17,6 +24,7 @@ Logger logger(LOG_NETWORKING, "CaptivePortalMonitor");
 CaptivePortalMonitor::CaptivePortalMonitor(QObject* parent) : QObject(parent) {
   MVPN_COUNT_CTOR(CaptivePortalMonitor);
 
+  m_timer.setSingleShot(true);
   connect(&m_timer, &QTimer::timeout, this, &CaptivePortalMonitor::check);
 }
 
@@ -26,31 +34,110 @@ CaptivePortalMonitor::~CaptivePortalMonitor() {
 
 void CaptivePortalMonitor::start() {
   logger.debug() << "Captive portal monitor start";
-  m_timer.start(CAPTIVE_PORTAL_MONITOR_MSEC);
+
+  if (!m_active) {
+    m_active = true;
+    connect(MozillaVPN::instance()->networkWatcher(),
+            &NetworkWatcher::networkChange, this,
+            &CaptivePortalMonitor::networkChanged);
+  }
+
+  m_interval = CAPTIVE_PORTAL_MONITOR_MIN_MSEC;
+  m_lastResult = -1;
+  m_clearConnections = true;
+
+  // A check in progress schedules the next one.
+  if (!m_checking) {
+    m_timer.start(m_interval);
+  }
 }
 
 void CaptivePortalMonitor::stop() {
   logger.debug() << "Captive portal monitor stop";
+
+  if (m_active) {
+    m_active = false;
+    disconnect(MozillaVPN::instance()->networkWatcher(),
+               &NetworkWatcher::networkChange, this,
+               &CaptivePortalMonitor::networkChanged);
+  }
+
   m_timer.stop();
 }
 
+void CaptivePortalMonitor::networkChanged() {
+  Q_ASSERT(m_active);
+  logger.debug() << "Network changed, checking soon";
+
+  m_interval = CAPTIVE_PORTAL_MONITOR_MIN_MSEC;
+  m_lastResult = -1;
+  m_clearConnections = true;
+
+  if (!m_checking) {
+    m_timer.start(m_interval);
+  }
+}
+
 void CaptivePortalMonitor::check() {
   logger.debug() << "Checking the internet connectivity";
 
-  CaptivePortalRequestTask* task = new CaptivePortalRequestTask(false);
+  Q_ASSERT(!m_checking);
+  m_checking = true;
+
+  CaptivePortalRequestTask* task =
+      new CaptivePortalRequestTask(false, m_clearConnections);
+  m_clearConnections = false;
+
   connect(task, &CaptivePortalRequestTask::operationCompleted, this,
           [this](CaptivePortalRequest::CaptivePortalResult result) {
             logger.debug() << "Captive portal detection:" << result;
+            m_checking = false;
 
-            if (result != CaptivePortalRequest::CaptivePortalResult::NoPortal ||
-                !m_timer.isActive()) {
+            if (!m_active) {
               return;
             }
 
-            // It seems that the captive-portal is gone. We can reactivate the
-            // VPN.
-            emit online();
+            if (result == CaptivePortalRequest::CaptivePortalResult::NoPortal) {
+              // It seems that the captive-portal is gone. We can reactivate
+              // the VPN.
+              emit online();
+
+              // The monitor is usually stopped by now.
+              if (!m_active) {
+                return;
+              }
+            }
+
+            scheduleCheck(result);
           });
 
+  // The task can be deleted without completing, on logout for instance.
+  connect(task, &QObject::destroyed, this, [this]() {
+    if (m_checking) {
+      m_checking = false;
+      if (m_active) {
+        m_timer.start(m_interval);
+      }
+    }
+  });
+
   TaskScheduler::scheduleTask(task);
 }
+
+void CaptivePortalMonitor::scheduleCheck(
+    CaptivePortalRequest::CaptivePortalResult result) {
+  uint32_t maxInterval = result == CaptivePortalRequest::PortalDetected
+                             ? CAPTIVE_PORTAL_MONITOR_PORTAL_MAX_MSEC
+                             : CAPTIVE_PORTAL_MONITOR_MAX_MSEC;
+
+  if (result == m_lastResult) {
+    m_interval = qMin(m_interval * 2, maxInterval);
+  } else {
+    m_interval = CAPTIVE_PORTAL_MONITOR_MIN_MSEC;
+  }
+
+  m_lastResult = result;
+
+  logger.debug() << "Next check in" << m_interval << "msec";
+  m_timer.start(m_interval);
+}
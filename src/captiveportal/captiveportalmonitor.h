@@ -5,9 +5,19 @@
 #ifndef CAPTIVEPORTALMONITOR_H
 #define CAPTIVEPORTALMONITOR_H
 
+#include "captiveportalrequest.h"
+
 #include <QObject>
 #include <QTimer>
 
+#ifdef UNIT_TEST
+class TestCaptivePortal;
+#endif
+
+// Checks the internet connectivity until the captive portal is gone. The
+// interval doubles while the result doesn't change, and goes back to the
+// minimum when it does, or when the network changes. It backs off to a minute
+// while the checks fail, but stays short while the portal is there.
 class CaptivePortalMonitor final : public QObject {
   Q_OBJECT
 
@@ -23,9 +33,24 @@ class CaptivePortalMonitor final : public QObject {
 
  private:
   void check();
+  void networkChanged();
+  void scheduleCheck(CaptivePortalRequest::CaptivePortalResult result);
 
  private:
   QTimer m_timer;
+
+  bool m_active = false;
+  bool m_checking = false;
+
+  // Connections kept alive are reused, unless the network has changed.
+  bool m_clearConnections = true;
+
+  uint32_t m_interval = 0;
+  int m_lastResult = -1;
+
+#ifdef UNIT_TEST
+  friend class TestCaptivePortal;
+#endif
 };
 
 #endif  // CAPTIVEPORTALMONITOR_H
@@ -11,12 +11,20 @@
 #include "task.h"
 #include "timersingleshot.h"
 
+// Delay before starting the next attempt, if the previous one has neither
+// answered nor failed yet (the "Connection Attempt Delay" of RFC 8305).
+constexpr int CAPTIVE_PORTAL_ATTEMPT_DELAY_MSEC = 250;
+
 namespace {
 Logger logger(LOG_CAPTIVEPORTAL, "CaptivePortalRequest");
 }
 
 CaptivePortalRequest::CaptivePortalRequest(Task* parent) : QObject(parent) {
   MVPN_COUNT_CTOR(CaptivePortalRequest);
+
+  m_attemptTimer.setSingleShot(true);
+  connect(&m_attemptTimer, &QTimer::timeout, this,
+          &CaptivePortalRequest::startNextAttempt);
 }
 
 CaptivePortalRequest::~CaptivePortalRequest() {
@@ -34,21 +42,34 @@ void CaptivePortalRequest::run() {
     emit completed(NoPortal);
     return;
   }
-  m_running = 0;
-  m_success = 0;
 
-  // We do not care which request succeeds.
-  // Let's make 1 request for any available IP addresses. The first one will
-  // delete all the others.
+  // Happy eyeballs: the attempts alternate the address families, IPv6 first,
+  // and are staggered. The first decisive answer wins and cancels the others.
+  m_pending.clear();
+  for (int i = 0; i < qMax(ipv4Addresses.length(), ipv6Addresses.length());
+       ++i) {
+    if (i < ipv6Addresses.length()) {
+      m_pending.append(
+          QUrl(QString(CAPTIVEPORTAL_URL_IPV6).arg(ipv6Addresses.at(i))));
+    }
+    if (i < ipv4Addresses.length()) {
+      m_pending.append(
+          QUrl(QString(CAPTIVEPORTAL_URL_IPV4).arg(ipv4Addresses.at(i))));
+    }
+  }
+
+  startNextAttempt();
+}
 
-  for (const QString& address : ipv4Addresses) {
-    QUrl url(QString(CAPTIVEPORTAL_URL_IPV4).arg(address));
-    createRequest(url);
+void CaptivePortalRequest::startNextAttempt() {
+  if (m_completed || m_pending.isEmpty()) {
+    return;
   }
 
-  for (const QString& address : ipv6Addresses) {
-    QUrl url(QString(CAPTIVEPORTAL_URL_IPV6).arg(address));
-    createRequest(url);
+  createRequest(m_pending.takeFirst());
+
+  if (!m_pending.isEmpty()) {
+    m_attemptTimer.start(CAPTIVE_PORTAL_ATTEMPT_DELAY_MSEC);
   }
 }
 
@@ -63,13 +84,14 @@ void CaptivePortalRequest::createRequest(const QUrl& url) {
             // In Case the Captive Portal request Redirects, we 100% have one.
             logger.info() << "Portal Detected -> Redirect to "
                           << url.toString();
+            onResult(request, PortalDetected);
             request->abort();
-            onResult(PortalDetected);
           });
   connect(request, &NetworkRequest::requestFailed, this,
-          [this](QNetworkReply::NetworkError error, const QByteArray&) {
+          [this, request](QNetworkReply::NetworkError error,
+                          const QByteArray&) {
             logger.warning() << "Captive portal request failed:" << error;
-            onResult(Failure);
+            onResult(request, Failure);
           });
 
   connect(
@@ -80,41 +102,66 @@ void CaptivePortalRequest::createRequest(const QUrl& url) {
         if (request->statusCode() != 200) {
           logger.debug() << "Captive portal detected. Expected 200, received:"
                          << request->statusCode();
-          onResult(PortalDetected);
+          onResult(request, PortalDetected);
           return;
         }
 
         if (QString(data).trimmed() == CAPTIVEPORTAL_REQUEST_CONTENT) {
           logger.debug() << "No captive portal!";
-          onResult(NoPortal);
+          onResult(request, NoPortal);
           return;
         }
 
         logger.debug() << "Captive portal detected. Content does not match.";
-        onResult(PortalDetected);
+        onResult(request, PortalDetected);
       });
 
-  m_running++;
+  m_running.append(request);
 }
 
-void CaptivePortalRequest::onResult(CaptivePortalResult portalDetected) {
-  Q_ASSERT(m_running > 0);
-  m_running--;
-  if (portalDetected == NoPortal) {
-    m_success++;
+void CaptivePortalRequest::onResult(NetworkRequest* request,
+                                    CaptivePortalResult portalDetected) {
+  if (m_completed) {
+    return;
   }
 
-  // If any request detects a portal, we can terminate immediately.
-  if (portalDetected == PortalDetected) {
-    deleteLater();
-    emit completed(portalDetected);
+  m_running.removeAll(request);
+
+  // Any answer from the detection server, or a portal in the way, is
+  // decisive.
+  if (portalDetected != Failure) {
+    complete(portalDetected);
     return;
   }
 
-  // Otherwise, we are complete after all the workers have terminated.
-  if (m_running == 0) {
-    deleteLater();
-    emit completed((m_success > 0) ? NoPortal : Failure);
+  // A failed attempt doesn't wait for the attempt delay to start the next.
+  if (!m_pending.isEmpty()) {
+    m_attemptTimer.stop();
+    startNextAttempt();
     return;
   }
+
+  // Otherwise, we fail after all the attempts have terminated.
+  if (m_running.isEmpty()) {
+    complete(Failure);
+  }
+}
+
+void CaptivePortalRequest::complete(CaptivePortalResult portalDetected) {
+  Q_ASSERT(!m_completed);
+  m_completed = true;
+  m_attemptTimer.stop();
+  m_pending.clear();
+
+  // The attempts still running are the losers.
+  for (const QPointer<NetworkRequest>& request : m_running) {
+    if (request) {
+      request->disconnect(this);
+      request->abort();
+    }
+  }
+  m_running.clear();
+
+  deleteLater();
+  emit completed(portalDetected);
 }
@@ -5,9 +5,13 @@
 #ifndef CAPTIVEPORTALREQUEST_H
 #define CAPTIVEPORTALREQUEST_H
 
+#include <QList>
 #include <QObject>
+#include <QPointer>
+#include <QTimer>
 #include <QUrl>
 
+class NetworkRequest;
 class Task;
 
 class CaptivePortalRequest final : public QObject {
@@ -28,12 +32,17 @@ class CaptivePortalRequest final : public QObject {
 
  private:
   void createRequest(const QUrl& url);
-  void nextStep();
-  void onResult(CaptivePortalResult portalDetected);
+  void startNextAttempt();
+  void onResult(NetworkRequest* request, CaptivePortalResult portalDetected);
+  void complete(CaptivePortalResult portalDetected);
 
  private:
-  int m_running = 0;
-  int m_success = 0;
+  // Attempts not started yet, in order.
+  QList<QUrl> m_pending;
+  QList<QPointer<NetworkRequest>> m_running;
+
+  QTimer m_attemptTimer;
+  bool m_completed = false;
 };
 
 #endif  // CAPTIVEPORTALREQUEST_H
@@ -17,8 +17,11 @@ namespace {
 Logger logger(LOG_CAPTIVEPORTAL, "CaptivePortalRequestTask");
 }
 
-CaptivePortalRequestTask::CaptivePortalRequestTask(bool retryOnFailure)
-    : Task("CaptivePortalRequestTask"), m_retryOnFailure(retryOnFailure) {
+CaptivePortalRequestTask::CaptivePortalRequestTask(bool retryOnFailure,
+                                                   bool clearConnections)
+    : Task("CaptivePortalRequestTask"),
+      m_retryOnFailure(retryOnFailure),
+      m_clearConnections(clearConnections) {
   MVPN_COUNT_CTOR(CaptivePortalRequestTask);
 }
 
@@ -37,7 +40,10 @@ void CaptivePortalRequestTask::run() {
 }
 
 void CaptivePortalRequestTask::createRequest() {
-  NetworkManager::instance()->clearCache();
+  if (m_clearConnections) {
+    NetworkManager::instance()->clearCache();
+  }
+
   CaptivePortalRequest* request = new CaptivePortalRequest(this);
   connect(request, &CaptivePortalRequest::completed, this,
           [this](CaptivePortalRequest::CaptivePortalResult detected) {
@@ -15,7 +15,11 @@ class CaptivePortalRequestTask final : public Task {
   Q_DISABLE_COPY_MOVE(CaptivePortalRequestTask)
 
  public:
-  CaptivePortalRequestTask(bool retryOnFailure = true);
+  // Unless `clearConnections` is false, the connections kept alive by the
+  // network manager are dropped before each detection: they may have been
+  // opened on a different network, or before a VPN state change.
+  CaptivePortalRequestTask(bool retryOnFailure = true,
+                           bool clearConnections = true);
   ~CaptivePortalRequestTask();
 
   void run() override;
@@ -29,6 +33,7 @@ class CaptivePortalRequestTask final : public Task {
 
  private:
   const bool m_retryOnFailure = true;
+  const bool m_clearConnections = true;
   bool m_completed = false;
 };
 
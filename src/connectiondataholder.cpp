@@ -17,14 +17,26 @@
 #include <QSplineSeries>
 #include <QValueAxis>
 
+// The status is sampled once per second (checkStatusTimerMsec), but only while
+// the chart is visible. The history is sampled once per minute during the whole
+// session, from the byte counters: it keeps the average of each minute, and of
+// 60 minutes per hour.
+constexpr int HISTORY_SAMPLE_MSEC = 60000;
+constexpr int HISTORY_PERIOD = 60;
+constexpr int HISTORY_MINUTES = 180;
+constexpr int HISTORY_HOURS = 168;
+
 namespace {
 Logger logger(LOG_NETWORKING, "ConnectionDataHolder");
 }
 
 ConnectionDataHolder::ConnectionDataHolder()
-    //% "Loading"
-    //: This refers to the current IP address, i.e. "IP: Loading".
-    : m_ipv4Address(qtTrId("vpn.connectionInfo.loading")),
+    : m_seconds(Constants::chartsMaxPoints()),
+      m_minutes(HISTORY_MINUTES),
+      m_hours(HISTORY_HOURS),
+      //% "Loading"
+      //: This refers to the current IP address, i.e. "IP: Loading".
+      m_ipv4Address(qtTrId("vpn.connectionInfo.loading")),
       m_ipv6Address(qtTrId("vpn.connectionInfo.loading")) {
   MVPN_COUNT_CTOR(ConnectionDataHolder);
 
@@ -41,6 +53,10 @@ ConnectionDataHolder::ConnectionDataHolder()
           }
         });
   });
+
+  m_historyClock.start();
+  connect(&m_historyTimer, &QTimer::timeout, this,
+          &ConnectionDataHolder::sampleHistory);
 }
 
 ConnectionDataHolder::~ConnectionDataHolder() {
@@ -51,20 +67,16 @@ void ConnectionDataHolder::enable() {
   m_ipAddressTimer.start(Constants::ipAddressTimerMsec());
 }
 
-void ConnectionDataHolder::disable() { m_ipAddressTimer.stop(); }
+void ConnectionDataHolder::disable() {
+  m_ipAddressTimer.stop();
+  m_historyTimer.stop();
+}
 
 void ConnectionDataHolder::add(uint64_t txBytes, uint64_t rxBytes) {
   logger.debug() << "New connection data:" << txBytes << rxBytes;
 
   Q_ASSERT(!!m_txSeries == !!m_rxSeries);
 
-  if (!m_txSeries) {
-    return;
-  }
-
-  Q_ASSERT(m_txSeries->count() == Constants::chartsMaxPoints());
-  Q_ASSERT(m_rxSeries->count() == Constants::chartsMaxPoints());
-
   // This is the first time we receive data. We need at least 2 calls in order
   // to count the delta.
   if (m_initialized == false) {
@@ -82,27 +94,146 @@ void ConnectionDataHolder::add(uint64_t txBytes, uint64_t rxBytes) {
   m_txBytes = tmpTxBytes;
   m_rxBytes = tmpRxBytes;
 
-  m_maxBytes = std::max(m_maxBytes, std::max(txBytes, rxBytes));
-  m_data.append(QPair<uint64_t, uint64_t>(txBytes, rxBytes));
+  m_seconds.append(txBytes, rxBytes);
 
-  while (m_data.length() > Constants::chartsMaxPoints()) {
-    m_data.removeAt(0);
+  if (m_txSeries) {
+    appendToSeries();
   }
 
-  int i = 0;
-  for (; i < Constants::chartsMaxPoints() - m_data.length(); ++i) {
-    m_txSeries->replace(i, i, 0);
-    m_rxSeries->replace(i, i, 0);
+  emit bytesChanged();
+}
+
+void ConnectionDataHolder::sampleHistory() {
+  MozillaVPN::instance()->controller()->getStatus(
+      [this](const QString& serverIpv4Gateway,
+             const QString& deviceIpv4Address, uint64_t txBytes,
+             uint64_t rxBytes) {
+        Q_UNUSED(deviceIpv4Address);
+        if (!serverIpv4Gateway.isEmpty()) {
+          addHistory(txBytes, rxBytes, m_historyClock.elapsed());
+        }
+      });
+}
+
+void ConnectionDataHolder::addHistory(quint64 txBytes, quint64 rxBytes,
+                                      qint64 now) {
+  // The counters restart from 0 with a new tunnel.
+  if (m_historyTime < 0 || txBytes < m_historyTxBytes ||
+      rxBytes < m_historyRxBytes) {
+    m_historyTxBytes = txBytes;
+    m_historyRxBytes = rxBytes;
+    m_historyTime = now;
+    return;
   }
 
-  for (int j = 0; j < m_data.length(); ++j) {
-    m_txSeries->replace(i, i, m_data.at(j).first);
-    m_rxSeries->replace(i, i, m_data.at(j).second);
-    ++i;
+  qint64 elapsed = now - m_historyTime;
+  if (elapsed <= 0) {
+    return;
+  }
+
+  quint64 tx = (txBytes - m_historyTxBytes) * 1000 / elapsed;
+  quint64 rx = (rxBytes - m_historyRxBytes) * 1000 / elapsed;
+  m_historyTxBytes = txBytes;
+  m_historyRxBytes = rxBytes;
+  m_historyTime = now;
+
+  m_minutes.append(tx, rx);
+  if (downsample(m_hourAccumulator, tx, rx)) {
+    m_hours.append(tx, rx);
+  }
+
+  emit historyChanged();
+}
+
+// static
+bool ConnectionDataHolder::downsample(Accumulator& accumulator,
+                                      quint64& txBytes, quint64& rxBytes) {
+  accumulator.m_txBytes += txBytes;
+  accumulator.m_rxBytes += rxBytes;
+  if (++accumulator.m_count < HISTORY_PERIOD) {
+    return false;
+  }
+
+  txBytes = accumulator.m_txBytes / accumulator.m_count;
+  rxBytes = accumulator.m_rxBytes / accumulator.m_count;
+  accumulator = Accumulator();
+  return true;
+}
+
+const ThroughputSeries& ConnectionDataHolder::history(
+    Resolution resolution) const {
+  switch (resolution) {
+    case Minutes:
+      return m_minutes;
+    case Hours:
+      return m_hours;
+    case Seconds:
+      break;
+  }
+  return m_seconds;
+}
+
+QVariantList ConnectionDataHolder::historyPoints(Resolution resolution) const {
+  const ThroughputSeries& series = history(resolution);
+
+  QVariantList list;
+  list.reserve(series.count());
+  for (int i = 0; i < series.count(); ++i) {
+    const ThroughputSeries::Sample& sample = series.at(i);
+    QVariantMap point;
+    point.insert("txBytes", sample.m_txBytes);
+    point.insert("rxBytes", sample.m_rxBytes);
+    list.append(point);
+  }
+  return list;
+}
+
+void ConnectionDataHolder::fillSeries() {
+  Q_ASSERT(m_txSeries && m_rxSeries);
+
+  // The X coordinate of a point is the index of its sample: the chart scrolls
+  // by moving the X axis, and the older points don't need to be updated.
+  const int maxPoints = Constants::chartsMaxPoints();
+  const int missing = maxPoints - m_seconds.count();
+  const qint64 first = static_cast<qint64>(m_seconds.appended()) - maxPoints;
+
+  QVector<QPointF> txPoints;
+  QVector<QPointF> rxPoints;
+  txPoints.reserve(maxPoints);
+  rxPoints.reserve(maxPoints);
+
+  for (int i = 0; i < maxPoints; ++i) {
+    qreal x = first + i;
+    if (i < missing) {
+      txPoints.append(QPointF(x, 0));
+      rxPoints.append(QPointF(x, 0));
+      continue;
+    }
+
+    const ThroughputSeries::Sample& sample = m_seconds.at(i - missing);
+    txPoints.append(QPointF(x, sample.m_txBytes));
+    rxPoints.append(QPointF(x, sample.m_rxBytes));
   }
 
+  m_txSeries->replace(txPoints);
+  m_rxSeries->replace(rxPoints);
+
+  computeAxes();
+}
+
+void ConnectionDataHolder::appendToSeries() {
+  Q_ASSERT(m_txSeries->count() == Constants::chartsMaxPoints());
+  Q_ASSERT(m_rxSeries->count() == Constants::chartsMaxPoints());
+
+  qreal x = m_seconds.appended() - 1;
+  const ThroughputSeries::Sample& sample = m_seconds.last();
+
+  m_txSeries->remove(0);
+  m_txSeries->append(x, sample.m_txBytes);
+  m_rxSeries->remove(0);
+  m_rxSeries->append(x, sample.m_rxBytes);
+
   computeAxes();
-  emit bytesChanged();
 }
 
 void ConnectionDataHolder::activate(const QVariant& a_txSeries,
@@ -150,25 +281,61 @@ void ConnectionDataHolder::activate(const QVariant& a_txSeries,
             &ConnectionDataHolder::deactivate);
   }
 
-  // Let's be sure we have all the x/y points.
-  while (m_txSeries->count() < Constants::chartsMaxPoints()) {
-    m_txSeries->append(m_txSeries->count(), 0);
-    m_rxSeries->append(m_rxSeries->count(), 0);
-  }
+  // The chart shows what has been recorded so far.
+  fillSeries();
 
-  m_checkStatusTimer.start(Constants::checkStatusTimerMsec());
+  startStatusUpdates();
 }
 
 void ConnectionDataHolder::deactivate() {
   logger.info() << "Deactivated";
 
-  reset();
   m_axisX = nullptr;
   m_axisY = nullptr;
   m_txSeries = nullptr;
   m_rxSeries = nullptr;
 
+  // The history doesn't need the chart: it's sampled every minute.
+  stopStatusUpdates();
+}
+
+void ConnectionDataHolder::startStatusUpdates() {
+  Controller* controller = MozillaVPN::instance()->controller();
+  connect(controller, &Controller::statusSubscribed, this,
+          &ConnectionDataHolder::statusSubscribed, Qt::UniqueConnection);
+
+  statusSubscribed(
+      controller->subscribeStatus(Constants::checkStatusTimerMsec()));
+}
+
+void ConnectionDataHolder::statusSubscribed(bool subscribed) {
+  Controller* controller = MozillaVPN::instance()->controller();
+
+  // The backend pushes the status: no need to poll it.
+  if (subscribed) {
+    m_checkStatusTimer.stop();
+    connect(controller, &Controller::statusSampled, this,
+            &ConnectionDataHolder::add, Qt::UniqueConnection);
+    return;
+  }
+
+  disconnect(controller, &Controller::statusSampled, this,
+             &ConnectionDataHolder::add);
+  m_checkStatusTimer.start(Constants::checkStatusTimerMsec());
+}
+
+void ConnectionDataHolder::stopStatusUpdates() {
+  Controller* controller = MozillaVPN::instance()->controller();
+  controller->unsubscribeStatus();
+  disconnect(controller, &Controller::statusSubscribed, this,
+             &ConnectionDataHolder::statusSubscribed);
+  disconnect(controller, &Controller::statusSampled, this,
+             &ConnectionDataHolder::add);
+
   m_checkStatusTimer.stop();
+
+  // The bytes counted while the chart is hidden are not a throughput.
+  m_initialized = false;
 }
 
 void ConnectionDataHolder::computeAxes() {
@@ -176,7 +343,9 @@ void ConnectionDataHolder::computeAxes() {
     return;
   }
 
-  m_axisY->setRange(-1000, m_maxBytes * 1.5);
+  qreal last = m_seconds.appended();
+  m_axisX->setRange(last - Constants::chartsMaxPoints(), last - 1);
+  m_axisY->setRange(-1000, m_seconds.maximum() * 1.5);
 }
 
 void ConnectionDataHolder::reset() {
@@ -185,22 +354,17 @@ void ConnectionDataHolder::reset() {
   m_initialized = false;
   m_txBytes = 0;
   m_rxBytes = 0;
-  m_maxBytes = 0;
-  m_data.clear();
+  m_seconds.reset();
+  m_minutes.reset();
+  m_hours.reset();
+  m_hourAccumulator = Accumulator();
+  m_historyTime = -1;
 
   emit bytesChanged();
+  emit historyChanged();
 
   if (m_txSeries) {
-    // In theory, m_txSeries and m_rxSeries should contain
-    // Constants::CHARTS_MAX_POINTS elements, but during the shutdown, strange
-    // things happen.
-    for (int i = 0; i < m_txSeries->count(); ++i) {
-      m_txSeries->replace(i, i, 0);
-    }
-
-    for (int i = 0; i < m_rxSeries->count(); ++i) {
-      m_rxSeries->replace(i, i, 0);
-    }
+    fillSeries();
   }
 
   updateIpAddress();
@@ -272,12 +436,12 @@ quint64 ConnectionDataHolder::txBytes() const { return bytes(0); }
 quint64 ConnectionDataHolder::rxBytes() const { return bytes(1); }
 
 quint64 ConnectionDataHolder::bytes(bool index) const {
-  if (m_data.isEmpty()) {
+  if (m_seconds.count() == 0) {
     return 0;
   }
 
-  const QPair<uint64_t, uint64_t>& pair = m_data.last();
-  return !index ? pair.first : pair.second;
+  const ThroughputSeries::Sample& sample = m_seconds.last();
+  return !index ? sample.m_txBytes : sample.m_rxBytes;
 }
 
 void ConnectionDataHolder::stateChanged() {
@@ -294,7 +458,17 @@ void ConnectionDataHolder::stateChanged() {
 
   reset();
 
-  if (m_txSeries && vpn->controller()->state() == Controller::StateOn) {
-    m_checkStatusTimer.start();
+  if (vpn->controller()->state() != Controller::StateOn) {
+    m_historyTimer.stop();
+    return;
+  }
+
+  // reset() has dropped the baseline of the counters: this sample is the new
+  // one.
+  sampleHistory();
+  m_historyTimer.start(HISTORY_SAMPLE_MSEC);
+
+  if (m_txSeries) {
+    startStatusUpdates();
   }
 }
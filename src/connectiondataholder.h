@@ -5,11 +5,13 @@
 #ifndef CONNECTIONDATAHOLDER_H
 #define CONNECTIONDATAHOLDER_H
 
+#include "throughputseries.h"
+
+#include <QElapsedTimer>
 #include <QObject>
-#include <QPair>
 #include <QString>
 #include <QTimer>
-#include <QVector>
+#include <QVariant>
 
 #if QT_VERSION >= 0x060000
 class QSplineSeries;
@@ -37,6 +39,13 @@ class ConnectionDataHolder final : public QObject {
   Q_PROPERTY(quint64 rxBytes READ rxBytes NOTIFY bytesChanged)
 
  public:
+  enum Resolution {
+    Seconds,
+    Minutes,
+    Hours,
+  };
+  Q_ENUM(Resolution)
+
   ConnectionDataHolder();
   ~ConnectionDataHolder();
 
@@ -54,9 +63,40 @@ class ConnectionDataHolder final : public QObject {
   quint64 txBytes() const;
   quint64 rxBytes() const;
 
+  // The throughput of the session, in bytes per second. The seconds are the
+  // points of the chart, recorded while it's visible; the minutes and the
+  // hours are averages over the whole session.
+  const ThroughputSeries& history(Resolution resolution) const;
+
+  // The same history for QML, oldest first: a list of objects with the
+  // txBytes and rxBytes per second of each point.
+  Q_INVOKABLE QVariantList historyPoints(Resolution resolution) const;
+
  private:
+  struct Accumulator {
+    quint64 m_txBytes = 0;
+    quint64 m_rxBytes = 0;
+    int m_count = 0;
+  };
+
   void add(uint64_t txBytes, uint64_t rxBytes);
 
+  void sampleHistory();
+  // Adds the average throughput since the previous history sample, from the
+  // cumulative counters of the tunnel. `now` is a monotonic time, in msecs.
+  void addHistory(quint64 txBytes, quint64 rxBytes, qint64 now);
+
+  // Adds a sample to `accumulator`. When a period is complete, returns true
+  // with the averages in txBytes and rxBytes.
+  static bool downsample(Accumulator& accumulator, quint64& txBytes,
+                         quint64& rxBytes);
+
+  void startStatusUpdates();
+  void stopStatusUpdates();
+  void statusSubscribed(bool subscribed);
+
+  void fillSeries();
+  void appendToSeries();
   void computeAxes();
   void updateIpAddress();
 
@@ -75,6 +115,7 @@ class ConnectionDataHolder final : public QObject {
   void ipv4AddressChanged();
   void ipv6AddressChanged();
   void bytesChanged();
+  void historyChanged();
 
  private:
   QSplineSeries* m_txSeries = nullptr;
@@ -82,12 +123,22 @@ class ConnectionDataHolder final : public QObject {
   QValueAxis* m_axisX = nullptr;
   QValueAxis* m_axisY = nullptr;
 
-  QVector<QPair<uint64_t, uint64_t>> m_data;
+  ThroughputSeries m_seconds;
+  ThroughputSeries m_minutes;
+  ThroughputSeries m_hours;
+  Accumulator m_hourAccumulator;
+
+  QTimer m_historyTimer;
+  QElapsedTimer m_historyClock;
+
+  // The counters at the last history sample, and its time. -1 if none.
+  quint64 m_historyTxBytes = 0;
+  quint64 m_historyRxBytes = 0;
+  qint64 m_historyTime = -1;
 
   bool m_initialized = false;
   uint64_t m_txBytes = 0;
   uint64_t m_rxBytes = 0;
-  uint64_t m_maxBytes = 0;
 
   bool m_updatingIpAddress = false;
 
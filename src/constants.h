@@ -25,6 +25,9 @@ constexpr uint32_t UNSECURED_NETWORK_ALERT_MSEC = 4000;
 // Number of recent connections to retain.
 constexpr int RECENT_CONNECTIONS_MAX_COUNT = 5;
 
+// Number of tasks the TaskScheduler runs at the same time.
+constexpr int TASK_SCHEDULER_MAX_CONCURRENT_TASKS = 4;
+
 #if defined(UNIT_TEST)
 #  define CONSTEXPR(type, functionName, releaseValue, debugValue, \
                     testingValue)                                 \
@@ -66,6 +69,9 @@ CONSTEXPR(uint32_t, gleanTimeoutMsec, 1200000, 4000, 0)
 // for this check)
 CONSTEXPR(uint32_t, surveyTimerMsec, 300000, 4000, 0)
 
+// How often the latency of every server is measured when the VPN is off.
+CONSTEXPR(uint32_t, serverLatencyRefreshMsec, 1800000, 60000, 0)
+
 #undef CONSTEXPR
 
 #define PRODBETAEXPR(type, functionName, prod, beta) \
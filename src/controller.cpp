@@ -16,6 +16,7 @@
 #include "rfc/rfc4291.h"
 
 #include "ipaddress.h"
+#include "ipprefixset.h"
 #include "leakdetector.h"
 #include "logger.h"
 #include "models/server.h"
@@ -125,6 +126,14 @@ void Controller::initialize() {
           &Controller::implInitialized);
   connect(m_impl.get(), &ControllerImpl::statusUpdated, this,
           &Controller::statusUpdated);
+  connect(m_impl.get(), &ControllerImpl::statusSampled, this,
+          [this](uint64_t txBytes, uint64_t rxBytes) {
+            if (m_state == StateOn || m_state == StateConfirming) {
+              emit statusSampled(txBytes, rxBytes);
+            }
+          });
+  connect(m_impl.get(), &ControllerImpl::statusSubscribed, this,
+          &Controller::statusSubscribed);
   connect(this, &Controller::stateChanged, this,
           &Controller::maybeEnableDisconnectInConfirming);
 
@@ -133,6 +142,10 @@ void Controller::initialize() {
 
   const Device* device = vpn->deviceModel()->currentDevice(vpn->keys());
   m_impl->initialize(device, vpn->keys());
+
+  if (m_statusSubscriptionMsec) {
+    m_impl->subscribeStatus(m_statusSubscriptionMsec);
+  }
 }
 
 void Controller::implInitialized(bool status, bool a_connected,
@@ -192,7 +205,11 @@ void Controller::activateInternal() {
   MozillaVPN* vpn = MozillaVPN::instance();
   Q_ASSERT(vpn);
 
-  Server exitServer = Server::weightChooser(vpn->exitServers());
+  ServerData* serverData = vpn->currentServer();
+  ServerSelector* selector = vpn->serverSelector();
+
+  Server exitServer = selector->pick(serverData->exitCountryCode(),
+                                     serverData->exitCityName());
   if (!exitServer.initialized()) {
     logger.error() << "Empty exit server list in state" << m_state;
     backendFailure();
@@ -214,7 +231,8 @@ void Controller::activateInternal() {
   // node as the first element, and the entry node as the final entry.
   QList<Server> serverList = {exitServer};
   if (FeatureMultiHop::instance()->isSupported() && vpn->multihop()) {
-    Server entryServer = Server::weightChooser(vpn->entryServers());
+    Server entryServer = selector->pick(serverData->entryCountryCode(),
+                                        serverData->entryCityName());
     if (!entryServer.initialized()) {
       logger.error() << "Empty entry server list in state" << m_state;
       backendFailure();
@@ -246,26 +264,26 @@ bool Controller::silentSwitchServers() {
   MozillaVPN* vpn = MozillaVPN::instance();
   Q_ASSERT(vpn);
 
-  QList<Server> servers = vpn->exitServers();
-  Q_ASSERT(!servers.isEmpty());
+  ServerData* serverData = vpn->currentServer();
+  ServerSelector* selector = vpn->serverSelector();
 
-  if (servers.length() <= 1) {
+  int serverCount = selector->serverCount(serverData->exitCountryCode(),
+                                          serverData->exitCityName());
+  Q_ASSERT(serverCount > 0);
+
+  if (serverCount <= 1) {
     logger.warning()
         << "Cannot silent switch servers because there is only one available";
     return false;
   }
 
-  QList<Server>::iterator iterator = servers.begin();
-
-  while (iterator != servers.end()) {
-    if (iterator->publicKey() == vpn->serverPublicKey()) {
-      servers.erase(iterator);
-      break;
-    }
-    ++iterator;
-  }
-
-  Server server = Server::weightChooser(servers);
+  // The current server is not working: let's choose another one, favoring
+  // the fastest and most reliable servers. The instability can come from the
+  // network of the user too: only a failed connection check records a
+  // failure, in connectionFailed().
+  Server server =
+      selector->pick(serverData->exitCountryCode(),
+                     serverData->exitCityName(), vpn->serverPublicKey());
   Q_ASSERT(server.initialized());
 
 #ifndef MVPN_WASM
@@ -286,7 +304,8 @@ bool Controller::silentSwitchServers() {
 
   QList<Server> serverList = {server};
   if (FeatureMultiHop::instance()->isSupported() && vpn->multihop()) {
-    Server hop = Server::weightChooser(vpn->entryServers());
+    Server hop = selector->pick(serverData->entryCountryCode(),
+                                serverData->entryCityName());
     Q_ASSERT(hop.initialized());
     serverList.append(hop);
   }
@@ -364,6 +383,9 @@ void Controller::connectionConfirmed() {
   m_connectionRetry = 0;
   emit connectionRetryChanged();
 
+  MozillaVPN::instance()->serverSelector()->recordSuccess(
+      MozillaVPN::instance()->serverPublicKey());
+
   if (m_state == StateOn) {
     emit silentSwitchDone();
     return;
@@ -391,6 +413,9 @@ void Controller::connectionFailed() {
     return;
   }
 
+  MozillaVPN::instance()->serverSelector()->recordFailure(
+      MozillaVPN::instance()->serverPublicKey());
+
   if (m_state == StateOn) {
     emit silentSwitchDone();
   }
@@ -680,6 +705,22 @@ void Controller::statusUpdated(const QString& serverIpv4Gateway,
   }
 }
 
+bool Controller::subscribeStatus(int intervalMsec) {
+  logger.debug() << "Subscribe status";
+
+  m_statusSubscriptionMsec = intervalMsec;
+  return m_impl && m_impl->subscribeStatus(intervalMsec);
+}
+
+void Controller::unsubscribeStatus() {
+  logger.debug() << "Unsubscribe status";
+
+  m_statusSubscriptionMsec = 0;
+  if (m_impl) {
+    m_impl->unsubscribeStatus();
+  }
+}
+
 QList<IPAddress> Controller::getAllowedIPAddressRanges(
     const QList<Server>& serverList) {
   logger.debug() << "Computing the allowed IP addresses";
@@ -725,10 +766,12 @@ QList<IPAddress> Controller::getAllowedIPAddressRanges(
       IPAddress(QHostAddress(MULLVAD_PROXY_RANGE), MULLVAD_PROXY_RANGE_LENGTH));
 
   // Allow access to everything not covered by an excluded address.
-  QList<IPAddress> allowedIPv4 = {IPAddress("0.0.0.0/0")};
-  list.append(IPAddress::excludeAddresses(allowedIPv4, excludeIPv4s));
-  QList<IPAddress> allowedIPv6 = {IPAddress("::/0")};
-  list.append(IPAddress::excludeAddresses(allowedIPv6, excludeIPv6s));
+  IPPrefixSet allowed;
+  allowed.add(IPAddress("0.0.0.0/0"));
+  allowed.add(IPAddress("::/0"));
+  allowed.remove(excludeIPv4s);
+  allowed.remove(excludeIPv6s);
+  list.append(allowed.prefixes());
 #endif
 
   return list;
@@ -81,6 +81,12 @@ class Controller final : public QObject {
                          const QString& deviceIpv4Address, uint64_t txBytes,
                          uint64_t rxBytes)>&& callback);
 
+  // Asks the backend to push the counters of the tunnel with the
+  // statusSampled signal. Returns false if the backend doesn't support it, or
+  // not yet: getStatus() must be polled until statusSubscribed(true).
+  bool subscribeStatus(int intervalMsec);
+  void unsubscribeStatus();
+
   int connectionRetry() const { return m_connectionRetry; }
 
   bool enableDisconnectInConfirming() const {
@@ -121,6 +127,8 @@ class Controller final : public QObject {
   void connectionRetryChanged();
   void enableDisconnectInConfirmingChanged();
   void silentSwitchDone();
+  void statusSampled(uint64_t txBytes, uint64_t rxBytes);
+  void statusSubscribed(bool subscribed);
 
  private:
   void setState(State state);
@@ -189,6 +197,9 @@ class Controller final : public QObject {
                            const QString& deviceIpv4Address, uint64_t txBytes,
                            uint64_t rxBytes)>>
       m_getStatusCallbacks;
+
+  // 0 if there is no status subscription.
+  int m_statusSubscriptionMsec = 0;
 };
 
 #endif  // CONTROLLER_H
@@ -62,6 +62,17 @@ class ControllerImpl : public QObject {
   // active.
   virtual void checkStatus() = 0;
 
+  // If the backend is able to push the status of the VPN tunnel, this method
+  // starts the "statusSampled" signals, every `intervalMsec`, and returns
+  // true. Otherwise, checkStatus() must be polled. A backend that learns the
+  // result later returns false and emits "statusSubscribed" when it knows.
+  virtual bool subscribeStatus(int intervalMsec) {
+    Q_UNUSED(intervalMsec);
+    return false;
+  }
+
+  virtual void unsubscribeStatus() {}
+
   // This method is used to retrieve the logs from the backend service. Use
   // the callback to report logs when available.
   virtual void getBackendLogs(
@@ -91,6 +102,14 @@ class ControllerImpl : public QObject {
   void statusUpdated(const QString& serverIpv4Gateway,
                      const QString& deviceIpv4Address, uint64_t txBytes,
                      uint64_t rxBytes);
+
+  // This signal is emitted after subscribeStatus(), while the VPN tunnel is
+  // active. "txBytes" and "rxBytes" are the counters of the tunnel.
+  void statusSampled(uint64_t txBytes, uint64_t rxBytes);
+
+  // This signal is emitted when the status starts, or stops, being pushed
+  // after subscribeStatus() returned.
+  void statusSubscribed(bool subscribed);
 };
 
 #endif  // CONTROLLERIMPL_H
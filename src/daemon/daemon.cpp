@@ -8,6 +8,7 @@
 #include "loghandler.h"
 
 #include <QCoreApplication>
+#include <QHash>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -15,7 +16,12 @@
 #include <QTimer>
 
 constexpr const char* JSON_ALLOWEDIPADDRESSRANGES = "allowedIPAddressRanges";
-constexpr int HANDSHAKE_POLL_MSEC = 250;
+// The handshake is checked quickly after the activation, when it usually
+// completes, then less and less often. A network event from the backend, which
+// can unblock a stalled handshake, brings the next check forward.
+constexpr int HANDSHAKE_MIN_MSEC = 50;
+constexpr int HANDSHAKE_MAX_MSEC = 1000;
+constexpr int STATUS_MIN_INTERVAL_MSEC = 100;
 
 namespace {
 
@@ -35,6 +41,8 @@ Daemon::Daemon(QObject* parent) : QObject(parent) {
 
   m_handshakeTimer.setSingleShot(true);
   connect(&m_handshakeTimer, &QTimer::timeout, this, &Daemon::checkHandshake);
+
+  connect(&m_statusTimer, &QTimer::timeout, this, &Daemon::sampleStatus);
 }
 
 Daemon::~Daemon() {
@@ -73,8 +81,12 @@ bool Daemon::activate(const InterfaceConfig& config) {
       if (!switchServer(config)) {
         return false;
       }
+      // The new server may be reached through a different path.
+      if (supportIPUtils() && !iputils()->setMTUAndUp(config)) {
+        return false;
+      }
       m_connections[config.m_hopindex] = ConnectionState(config);
-      m_handshakeTimer.start(HANDSHAKE_POLL_MSEC);
+      startHandshakeWatcher();
       return true;
     }
 
@@ -139,18 +151,17 @@ bool Daemon::activate(const InterfaceConfig& config) {
   }
 
   // set routing
-  for (const IPAddress& ip : config.m_allowedIPAddressRanges) {
-    if (!wgutils()->updateRoutePrefix(ip, config.m_hopindex)) {
-      logger.debug() << "Routing configuration failed for" << ip.toString();
-      return false;
-    }
+  if (!wgutils()->updateRoutePrefixes(config.m_allowedIPAddressRanges,
+                                      config.m_hopindex, true)) {
+    logger.debug() << "Routing configuration failed";
+    return false;
   }
 
   bool status = run(Up, config);
   logger.debug() << "Connection status:" << status;
   if (status) {
     m_connections[config.m_hopindex] = ConnectionState(config);
-    m_handshakeTimer.start(HANDSHAKE_POLL_MSEC);
+    startHandshakeWatcher();
   }
 
   return status;
@@ -326,9 +337,8 @@ bool Daemon::deactivate(bool emitSignals) {
   for (const ConnectionState& state : m_connections.values()) {
     const InterfaceConfig& config = state.m_config;
     logger.debug() << "Deleting routes for hop" << config.m_hopindex;
-    for (const IPAddress& ip : config.m_allowedIPAddressRanges) {
-      wgutils()->deleteRoutePrefix(ip, config.m_hopindex);
-    }
+    wgutils()->deleteRoutePrefixes(config.m_allowedIPAddressRanges,
+                                   config.m_hopindex);
     wgutils()->deletePeer(config);
   }
 
@@ -344,6 +354,7 @@ bool Daemon::deactivate(bool emitSignals) {
   }
 
   m_connections.clear();
+  m_handshakeTimer.stop();
   return true;
 }
 
@@ -394,16 +405,15 @@ bool Daemon::switchServer(const InterfaceConfig& config) {
     m_excludedAddrSet[address] = 1;
   }
 
-  // Activate the new peer and its routes.
+  // Activate the new peer and its routes. The tunnel stays up with the routes
+  // which could be set: removing them again would only make things worse.
   if (!wgutils()->updatePeer(config)) {
     logger.error() << "Server switch failed to update the wireguard interface";
     return false;
   }
-  for (const IPAddress& ip : config.m_allowedIPAddressRanges) {
-    if (!wgutils()->updateRoutePrefix(ip, config.m_hopindex)) {
-      logger.error() << "Server switch failed to update the routing table";
-      break;
-    }
+  if (!wgutils()->updateRoutePrefixes(config.m_allowedIPAddressRanges,
+                                      config.m_hopindex, false)) {
+    logger.error() << "Server switch failed to update the routing table";
   }
 
   // Remove routing entries for the old peer.
@@ -417,11 +427,13 @@ bool Daemon::switchServer(const InterfaceConfig& config) {
     wgutils()->deleteExclusionRoute(address);
     m_excludedAddrSet.remove(address);
   }
+  QList<IPAddress> staleRoutes;
   for (const IPAddress& ip : lastConfig.m_allowedIPAddressRanges) {
     if (!config.m_allowedIPAddressRanges.contains(ip)) {
-      wgutils()->deleteRoutePrefix(ip, config.m_hopindex);
+      staleRoutes.append(ip);
     }
   }
+  wgutils()->deleteRoutePrefixes(staleRoutes, config.m_hopindex);
 
   // Remove the old peer if it is no longer necessary.
   if (config.m_serverPublicKey != lastConfig.m_serverPublicKey) {
@@ -435,43 +447,137 @@ bool Daemon::switchServer(const InterfaceConfig& config) {
 }
 
 QJsonObject Daemon::getStatus() {
-  Q_ASSERT(wgutils() != nullptr);
   QJsonObject json;
   logger.debug() << "Status request";
 
-  if (!m_connections.contains(0) || !wgutils()->interfaceExists()) {
+  WireguardUtils::PeerStatus status;
+  if (!connectionStatus(status)) {
     json.insert("connected", QJsonValue(false));
     return json;
   }
 
   const ConnectionState& connection = m_connections.value(0);
-  QList<WireguardUtils::PeerStatus> peers = wgutils()->getPeerStatus();
-  for (WireguardUtils::PeerStatus status : peers) {
-    if (status.m_pubkey != connection.m_config.m_serverPublicKey) {
-      continue;
-    }
-    json.insert("connected", QJsonValue(true));
-    json.insert("serverIpv4Gateway",
-                QJsonValue(connection.m_config.m_serverIpv4Gateway));
-    json.insert("deviceIpv4Address",
-                QJsonValue(connection.m_config.m_deviceIpv4Address));
-    json.insert("date", connection.m_date.toString());
-    json.insert("txBytes", QJsonValue(status.m_txBytes));
-    json.insert("rxBytes", QJsonValue(status.m_rxBytes));
-    return json;
+  json.insert("connected", QJsonValue(true));
+  json.insert("serverIpv4Gateway",
+              QJsonValue(connection.m_config.m_serverIpv4Gateway));
+  json.insert("deviceIpv4Address",
+              QJsonValue(connection.m_config.m_deviceIpv4Address));
+  json.insert("date", connection.m_date.toString());
+  json.insert("txBytes", QJsonValue(status.m_txBytes));
+  json.insert("rxBytes", QJsonValue(status.m_rxBytes));
+
+  // Only known when the backend samples the peers.
+  if (status.m_txRate >= 0 && status.m_rxRate >= 0) {
+    json.insert("txRate", QJsonValue(status.m_txRate));
+    json.insert("rxRate", QJsonValue(status.m_rxRate));
+  }
+  if (status.m_handshakeAge >= 0) {
+    json.insert("handshakeAge", QJsonValue(status.m_handshakeAge));
   }
-
-  json.insert("connected", QJsonValue(false));
   return json;
 }
 
+bool Daemon::connectionStatus(WireguardUtils::PeerStatus& status) {
+  Q_ASSERT(wgutils() != nullptr);
+
+  if (!m_connections.contains(0) || !wgutils()->interfaceExists()) {
+    return false;
+  }
+
+  const ConnectionState& connection = m_connections.value(0);
+  return wgutils()->findPeerStatus(connection.m_config.m_serverPublicKey,
+                                   status);
+}
+
+void Daemon::subscribeStatus(const QString& subscriber, int intervalMsec) {
+  logger.debug() << "Status subscription:" << subscriber << intervalMsec;
+
+  m_statusSubscribers.insert(subscriber,
+                             qMax(intervalMsec, STATUS_MIN_INTERVAL_MSEC));
+  updateStatusTimer();
+}
+
+void Daemon::unsubscribeStatus(const QString& subscriber) {
+  if (m_statusSubscribers.remove(subscriber)) {
+    logger.debug() << "Status unsubscription:" << subscriber;
+    updateStatusTimer();
+  }
+}
+
+void Daemon::updateStatusTimer() {
+  if (m_statusSubscribers.isEmpty()) {
+    m_statusTimer.stop();
+    return;
+  }
+
+  int interval = m_statusSubscribers.begin().value();
+  for (int value : m_statusSubscribers) {
+    interval = qMin(interval, value);
+  }
+
+  if (!m_statusTimer.isActive() || m_statusTimer.interval() != interval) {
+    m_statusTimer.start(interval);
+  }
+}
+
+void Daemon::sampleStatus() {
+  WireguardUtils::PeerStatus status;
+  if (!connectionStatus(status)) {
+    emit statusSampled(false, 0, 0, 0);
+    return;
+  }
+
+  emit statusSampled(true, status.m_txBytes, status.m_rxBytes,
+                     status.m_handshake);
+}
+
+void Daemon::startHandshakeWatcher() {
+  connect(wgutils(), &WireguardUtils::networkEvent, this,
+          &Daemon::handshakeWakeUp, Qt::UniqueConnection);
+
+  m_handshakeInterval = HANDSHAKE_MIN_MSEC;
+  m_handshakeTimer.start(m_handshakeInterval);
+}
+
+void Daemon::handshakeWakeUp() {
+  // No pending handshakes.
+  if (!m_handshakeTimer.isActive()) {
+    return;
+  }
+
+  // The activation itself causes bursts of events: never check more often
+  // than HANDSHAKE_MIN_MSEC.
+  qint64 delay = 0;
+  if (m_handshakeCheck.isValid()) {
+    delay = qMax(Q_INT64_C(0), HANDSHAKE_MIN_MSEC - m_handshakeCheck.elapsed());
+  }
+
+  m_handshakeInterval = HANDSHAKE_MIN_MSEC;
+  if (m_handshakeTimer.remainingTime() > delay) {
+    m_handshakeTimer.start(static_cast<int>(delay));
+  }
+}
+
 void Daemon::checkHandshake() {
   Q_ASSERT(wgutils() != nullptr);
 
   logger.debug() << "Checking for handshake...";
+  m_handshakeCheck.start();
+
+  QStringList pending;
+  for (const ConnectionState& connection : m_connections) {
+    if (!connection.m_date.isValid()) {
+      pending.append(connection.m_config.m_serverPublicKey);
+    }
+  }
+
+  // A single dump for all the hops.
+  QHash<QString, WireguardUtils::PeerStatus> peers;
+  if (!pending.isEmpty()) {
+    peers = wgutils()->findPeerStatuses(pending);
+  }
 
   int pendingHandshakes = 0;
-  QList<WireguardUtils::PeerStatus> peers = wgutils()->getPeerStatus();
   for (ConnectionState& connection : m_connections) {
     const InterfaceConfig& config = connection.m_config;
     if (connection.m_date.isValid()) {
@@ -481,14 +587,10 @@ void Daemon::checkHandshake() {
                    << WireguardUtils::printableKey(config.m_serverPublicKey);
 
     // Check if the handshake has completed.
-    for (const WireguardUtils::PeerStatus& status : peers) {
-      if (config.m_serverPublicKey != status.m_pubkey) {
-        continue;
-      }
-      if (status.m_handshake != 0) {
-        connection.m_date.setMSecsSinceEpoch(status.m_handshake);
-        emit connected(status.m_pubkey);
-      }
+    auto peer = peers.constFind(config.m_serverPublicKey);
+    if (peer != peers.constEnd() && peer->m_handshake != 0) {
+      connection.m_date.setMSecsSinceEpoch(peer->m_handshake);
+      emit connected(peer->m_pubkey);
     }
 
     if (!connection.m_date.isValid()) {
@@ -496,8 +598,10 @@ void Daemon::checkHandshake() {
     }
   }
 
-  // Check again if there were connections that haven't completed a handshake.
+  // Check again, later, if there were connections that haven't completed a
+  // handshake.
   if (pendingHandshakes > 0) {
-    m_handshakeTimer.start(HANDSHAKE_POLL_MSEC);
+    m_handshakeInterval = qMin(m_handshakeInterval * 2, HANDSHAKE_MAX_MSEC);
+    m_handshakeTimer.start(m_handshakeInterval);
   }
 }
@@ -11,6 +11,7 @@
 #include "wireguardutils.h"
 
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QTimer>
 
 class Daemon : public QObject {
@@ -33,6 +34,12 @@ class Daemon : public QObject {
   virtual bool deactivate(bool emitSignals = true);
   virtual QJsonObject getStatus();
 
+  // Starts pushing the status of the connection to `subscriber` with the
+  // statusSampled signal. All the subscribers share one sampling loop, running
+  // at the shortest interval requested.
+  void subscribeStatus(const QString& subscriber, int intervalMsec);
+  void unsubscribeStatus(const QString& subscriber);
+
   // Callback before any Activating measure is done
   virtual void prepareActivation(const InterfaceConfig& config){
       Q_UNUSED(config)};
@@ -44,6 +51,8 @@ class Daemon : public QObject {
   void connected(const QString& pubkey);
   void disconnected();
   void backendFailure();
+  void statusSampled(bool connected, qint64 txBytes, qint64 rxBytes,
+                     qint64 handshake);
 
  protected:
   virtual bool run(Op op, const InterfaceConfig& config) {
@@ -62,8 +71,16 @@ class Daemon : public QObject {
   static bool parseStringList(const QJsonObject& obj, const QString& name,
                               QStringList& list);
 
+  void startHandshakeWatcher();
+  void handshakeWakeUp();
   void checkHandshake();
 
+  // Status of the peer of the main connection, if active.
+  bool connectionStatus(WireguardUtils::PeerStatus& status);
+
+  void updateStatusTimer();
+  void sampleStatus();
+
   class ConnectionState {
    public:
     ConnectionState(){};
@@ -74,6 +91,11 @@ class Daemon : public QObject {
   QMap<int, ConnectionState> m_connections;
   QHash<QHostAddress, int> m_excludedAddrSet;
   QTimer m_handshakeTimer;
+  QElapsedTimer m_handshakeCheck;
+  int m_handshakeInterval = 0;
+
+  QHash<QString, int> m_statusSubscribers;
+  QTimer m_statusTimer;
 };
 
 #endif  // DAEMON_H
@@ -4,6 +4,7 @@
 
 #include "daemonlocalserverconnection.h"
 #include "daemon.h"
+#include "daemonstatusframe.h"
 #include "leakdetector.h"
 #include "logger.h"
 
@@ -28,6 +29,8 @@ DaemonLocalServerConnection::DaemonLocalServerConnection(QObject* parent,
 
   connect(m_socket, &QLocalSocket::readyRead, this,
           &DaemonLocalServerConnection::readData);
+  connect(m_socket, &QLocalSocket::disconnected, this,
+          &DaemonLocalServerConnection::unsubscribeStatus);
 
   Daemon* daemon = Daemon::instance();
   connect(daemon, &Daemon::connected, this,
@@ -119,6 +122,23 @@ void DaemonLocalServerConnection::parseCommand(const QByteArray& data) {
     return;
   }
 
+  if (type == "subscribeStatus") {
+    int interval = obj.value("interval").toInt();
+
+    // The current status first, then the frames.
+    QJsonObject obj = Daemon::instance()->getStatus();
+    obj.insert("type", "status");
+    write(obj);
+
+    subscribeStatus(interval);
+    return;
+  }
+
+  if (type == "unsubscribeStatus") {
+    unsubscribeStatus();
+    return;
+  }
+
   if (type == "logs") {
     QJsonObject obj;
     obj.insert("type", "logs");
@@ -155,6 +175,52 @@ void DaemonLocalServerConnection::backendFailure() {
   write(obj);
 }
 
+void DaemonLocalServerConnection::statusSampled(bool connected,
+                                                qint64 txBytes, qint64 rxBytes,
+                                                qint64 handshake) {
+  // The sampling loop runs at the shortest interval of all the subscribers.
+  // Leave some room for the timer jitter.
+  if (m_lastStatusFrame.isValid() &&
+      m_lastStatusFrame.elapsed() < m_statusIntervalMsec * 9 / 10) {
+    return;
+  }
+  m_lastStatusFrame.start();
+
+  DaemonStatusFrame frame;
+  frame.m_connected = connected;
+  frame.m_txBytes = txBytes;
+  frame.m_rxBytes = rxBytes;
+  frame.m_handshake = handshake;
+  m_socket->write(frame.encode());
+}
+
+void DaemonLocalServerConnection::subscribeStatus(int intervalMsec) {
+  Daemon* daemon = Daemon::instance();
+
+  if (m_statusSubscriber.isEmpty()) {
+    m_statusSubscriber = QString("socket-%1").arg(
+        reinterpret_cast<quintptr>(this), 0, 16);
+    connect(daemon, &Daemon::statusSampled, this,
+            &DaemonLocalServerConnection::statusSampled);
+  }
+
+  m_statusIntervalMsec = intervalMsec;
+  m_lastStatusFrame.invalidate();
+  daemon->subscribeStatus(m_statusSubscriber, intervalMsec);
+}
+
+void DaemonLocalServerConnection::unsubscribeStatus() {
+  if (m_statusSubscriber.isEmpty()) {
+    return;
+  }
+
+  Daemon* daemon = Daemon::instance();
+  disconnect(daemon, &Daemon::statusSampled, this,
+             &DaemonLocalServerConnection::statusSampled);
+  daemon->unsubscribeStatus(m_statusSubscriber);
+  m_statusSubscriber.clear();
+}
+
 void DaemonLocalServerConnection::write(const QJsonObject& obj) {
   m_socket->write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
   m_socket->write("\n");
@@ -5,6 +5,7 @@
 #ifndef DAEMONLOCALSERVERCONNECTION_H
 #define DAEMONLOCALSERVERCONNECTION_H
 
+#include <QElapsedTimer>
 #include <QObject>
 
 class QLocalSocket;
@@ -24,6 +25,11 @@ class DaemonLocalServerConnection final : public QObject {
   void connected(const QString& pubkey);
   void disconnected();
   void backendFailure();
+  void statusSampled(bool connected, qint64 txBytes, qint64 rxBytes,
+                     qint64 handshake);
+
+  void subscribeStatus(int intervalMsec);
+  void unsubscribeStatus();
 
   void write(const QJsonObject& obj);
 
@@ -31,6 +37,11 @@ class DaemonLocalServerConnection final : public QObject {
   QLocalSocket* m_socket = nullptr;
 
   QByteArray m_buffer;
+
+  // Empty if the connection is not subscribed to the status.
+  QString m_statusSubscriber;
+  int m_statusIntervalMsec = 0;
+  QElapsedTimer m_lastStatusFrame;
 };
 
 #endif  // DAEMONLOCALSERVERCONNECTION_H
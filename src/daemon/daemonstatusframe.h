@@ -0,0 +1,58 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef DAEMONSTATUSFRAME_H
+#define DAEMONSTATUSFRAME_H
+
+#include <QByteArray>
+#include <QtEndian>
+
+// Fixed-size binary frame pushed by the daemon to the clients subscribed to
+// the status, on the same socket as the JSON messages. A JSON message never
+// starts with a NUL byte, so the frames can be told apart from the lines
+// before looking for a line break:
+//
+//   0   marker (0x00)
+//   1   flags (bit 0: connected)
+//   2   tx bytes (int64, little endian)
+//   10  rx bytes (int64, little endian)
+//   18  last handshake, msecs since epoch (int64, little endian)
+class DaemonStatusFrame final {
+ public:
+  static constexpr char MARKER = '\0';
+  static constexpr int SIZE = 26;
+
+  bool m_connected = false;
+  qint64 m_txBytes = 0;
+  qint64 m_rxBytes = 0;
+  qint64 m_handshake = 0;
+
+  QByteArray encode() const {
+    QByteArray frame(SIZE, MARKER);
+    uchar* data = reinterpret_cast<uchar*>(frame.data());
+    data[1] = m_connected ? FLAG_CONNECTED : 0;
+    qToLittleEndian<qint64>(m_txBytes, data + 2);
+    qToLittleEndian<qint64>(m_rxBytes, data + 10);
+    qToLittleEndian<qint64>(m_handshake, data + 18);
+    return frame;
+  }
+
+  // `data` must point to at least SIZE bytes.
+  bool decode(const char* data) {
+    const uchar* frame = reinterpret_cast<const uchar*>(data);
+    if (frame[0] != MARKER) {
+      return false;
+    }
+    m_connected = (frame[1] & FLAG_CONNECTED) != 0;
+    m_txBytes = qFromLittleEndian<qint64>(frame + 2);
+    m_rxBytes = qFromLittleEndian<qint64>(frame + 10);
+    m_handshake = qFromLittleEndian<qint64>(frame + 18);
+    return true;
+  }
+
+ private:
+  static constexpr uchar FLAG_CONNECTED = 0x01;
+};
+
+#endif  // DAEMONSTATUSFRAME_H
@@ -7,6 +7,7 @@
 
 #include "interfaceconfig.h"
 
+#include <QHash>
 #include <QHostAddress>
 #include <QObject>
 #include <QStringList>
@@ -27,6 +28,12 @@ class WireguardUtils : public QObject {
     qint64 m_handshake = 0;
     qint64 m_rxBytes = 0;
     qint64 m_txBytes = 0;
+
+    // Bytes per second and msecs since the last handshake, when the backend
+    // samples the peers; -1 if unknown.
+    qint64 m_rxRate = -1;
+    qint64 m_txRate = -1;
+    qint64 m_handshakeAge = -1;
   };
 
   explicit WireguardUtils(QObject* parent) : QObject(parent){};
@@ -41,9 +48,55 @@ class WireguardUtils : public QObject {
   virtual bool deletePeer(const InterfaceConfig& config) = 0;
   virtual QList<PeerStatus> getPeerStatus() = 0;
 
+  // Status of a single peer. Returns false if the peer doesn't exist.
+  virtual bool findPeerStatus(const QString& pubkey, PeerStatus& status) {
+    for (const PeerStatus& peer : getPeerStatus()) {
+      if (peer.m_pubkey == pubkey) {
+        status = peer;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Status of several peers, by public key, from a single dump. The peers
+  // which don't exist are left out.
+  virtual QHash<QString, PeerStatus> findPeerStatuses(
+      const QStringList& pubkeys) {
+    QHash<QString, PeerStatus> result;
+    for (const PeerStatus& peer : getPeerStatus()) {
+      if (pubkeys.contains(peer.m_pubkey)) {
+        result.insert(peer.m_pubkey, peer);
+      }
+    }
+    return result;
+  }
+
   virtual bool updateRoutePrefix(const IPAddress& prefix, int hopindex) = 0;
   virtual bool deleteRoutePrefix(const IPAddress& prefix, int hopindex) = 0;
 
+  // Batch versions of the above. Backends able to send several routing
+  // changes at once should override these. With `rollback`, the routes added
+  // by a failed update are removed again, if the backend is able to.
+  virtual bool updateRoutePrefixes(const QList<IPAddress>& prefixes,
+                                   int hopindex, bool rollback) {
+    Q_UNUSED(rollback);
+    for (const IPAddress& prefix : prefixes) {
+      if (!updateRoutePrefix(prefix, hopindex)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  virtual bool deleteRoutePrefixes(const QList<IPAddress>& prefixes,
+                                   int hopindex) {
+    bool result = true;
+    for (const IPAddress& prefix : prefixes) {
+      result &= deleteRoutePrefix(prefix, hopindex);
+    }
+    return result;
+  }
+
   virtual bool addExclusionRoute(const QHostAddress& address) = 0;
   virtual bool deleteExclusionRoute(const QHostAddress& address) = 0;
 
@@ -55,6 +108,12 @@ class WireguardUtils : public QObject {
       return pubkey.left(6) + "..." + pubkey.right(6);
     }
   }
+
+ signals:
+  // The links or the routes of the system have changed: the path to the
+  // server may have too, and a pending handshake may complete soon. Only
+  // emitted by the backends able to monitor them.
+  void networkEvent();
 };
 
 #endif  // WIREGUARDUTILS_H
@@ -40,8 +40,10 @@ class FeatureSplitTunnel final : public Feature {
     }
     initDone = true;
 
-    /* Control groups v1 must be mounted for traffic classification */
-    if (LinuxDependencies::findCgroupPath("net_cls").isNull()) {
+    /* Control groups must be mounted for traffic classification: either the
+     * net_cls controller of v1, or the unified v2 hierarchy. */
+    if (LinuxDependencies::findCgroupPath("net_cls").isNull() &&
+        LinuxDependencies::findCgroup2Path().isNull()) {
       return false;
     }
 
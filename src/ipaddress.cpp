@@ -3,6 +3,7 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include "ipaddress.h"
+#include "ipprefixset.h"
 #include "leakdetector.h"
 #include "logger.h"
 
@@ -241,50 +242,17 @@ QList<IPAddress> IPAddress::subnets() const {
 // static
 QList<IPAddress> IPAddress::excludeAddresses(
     const QList<IPAddress>& sourceList, const QList<IPAddress>& excludeList) {
-  QList<IPAddress> results = sourceList;
-
-  for (const IPAddress& exclude : excludeList) {
-    QList<IPAddress> newResults;
-
-    for (const IPAddress& ip : results) {
-      if (ip.overlaps(exclude)) {
-        QList<IPAddress> range = ip.excludeAddresses(exclude);
-        newResults.append(range);
-      } else {
-        newResults.append(ip);
-      }
-    }
-
-    results = newResults;
-  }
-
-  return results;
+  IPPrefixSet set;
+  set.add(sourceList);
+  set.remove(excludeList);
+  return set.prefixes();
 }
 
 QList<IPAddress> IPAddress::excludeAddresses(const IPAddress& ip) const {
-  QList<IPAddress> sn = subnets();
-  Q_ASSERT(sn.length() >= 2);
-
-  QList<IPAddress> result;
-  while (sn[0] != ip && sn[1] != ip) {
-    if (ip.subnetOf(sn[0])) {
-      result.append(sn[1]);
-      sn = sn[0].subnets();
-    } else if (ip.subnetOf(sn[1])) {
-      result.append(sn[0]);
-      sn = sn[1].subnets();
-    } else {
-      Q_ASSERT(false);
-    }
-  }
-
-  if (sn[0] == ip) {
-    result.append(sn[1]);
-  } else if (sn[1] == ip) {
-    result.append(sn[0]);
-  } else {
-    Q_ASSERT(false);
-  }
+  Q_ASSERT(ip.subnetOf(*this));
 
-  return result;
+  IPPrefixSet set;
+  set.add(*this);
+  set.remove(ip);
+  return set.prefixes();
 }
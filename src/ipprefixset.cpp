@@ -0,0 +1,312 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "ipprefixset.h"
+
+#include <QVarLengthArray>
+
+// The deepest walk is an IPv6 host address: the root plus 128 levels.
+constexpr int MAX_DEPTH = 129;
+
+namespace {
+
+int familyWidth(int family) { return family == 0 ? 32 : 128; }
+
+}  // namespace
+
+IPPrefixSet::IPPrefixSet() { clear(); }
+
+void IPPrefixSet::clear() {
+  m_nodes.clear();
+  m_freeNodes.clear();
+  m_roots[FamilyIPv4] = allocNode();
+  m_roots[FamilyIPv6] = allocNode();
+}
+
+bool IPPrefixSet::isEmpty() const {
+  for (int root : m_roots) {
+    const Node& node = m_nodes.at(root);
+    if (node.full || node.child[0] >= 0 || node.child[1] >= 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void IPPrefixSet::add(const IPAddress& prefix) {
+  Prefix p;
+  if (toPrefix(prefix.address(), prefix.prefixLength(), p)) {
+    addPrefix(p);
+  }
+}
+
+void IPPrefixSet::add(const QList<IPAddress>& prefixes) {
+  for (const IPAddress& prefix : prefixes) {
+    add(prefix);
+  }
+}
+
+void IPPrefixSet::remove(const IPAddress& prefix) {
+  Prefix p;
+  if (toPrefix(prefix.address(), prefix.prefixLength(), p)) {
+    removePrefix(p);
+  }
+}
+
+void IPPrefixSet::remove(const QList<IPAddress>& prefixes) {
+  for (const IPAddress& prefix : prefixes) {
+    remove(prefix);
+  }
+}
+
+void IPPrefixSet::unite(const IPPrefixSet& other) {
+  for (const Prefix& prefix : other.fullPrefixes()) {
+    addPrefix(prefix);
+  }
+}
+
+void IPPrefixSet::subtract(const IPPrefixSet& other) {
+  for (const Prefix& prefix : other.fullPrefixes()) {
+    removePrefix(prefix);
+  }
+}
+
+bool IPPrefixSet::contains(const QHostAddress& address) const {
+  Prefix p;
+  if (!toPrefix(address, 128, p)) {
+    return false;
+  }
+  return containsPrefix(p);
+}
+
+bool IPPrefixSet::contains(const IPAddress& prefix) const {
+  Prefix p;
+  if (!toPrefix(prefix.address(), prefix.prefixLength(), p)) {
+    return false;
+  }
+  return containsPrefix(p);
+}
+
+QList<IPAddress> IPPrefixSet::prefixes() const {
+  QList<IPAddress> list;
+  for (const Prefix& prefix : fullPrefixes()) {
+    list.append(toIPAddress(prefix));
+  }
+  return list;
+}
+
+// static
+bool IPPrefixSet::toPrefix(const QHostAddress& address, int length,
+                           Prefix& prefix) {
+  prefix.key = Key();
+
+  if (address.protocol() == QAbstractSocket::IPv4Protocol) {
+    prefix.family = FamilyIPv4;
+    prefix.key.hi = static_cast<quint64>(address.toIPv4Address()) << 32;
+  } else if (address.protocol() == QAbstractSocket::IPv6Protocol) {
+    prefix.family = FamilyIPv6;
+    Q_IPV6ADDR raw = address.toIPv6Address();
+    for (int i = 0; i < 8; ++i) {
+      prefix.key.hi = (prefix.key.hi << 8) | raw[i];
+      prefix.key.lo = (prefix.key.lo << 8) | raw[i + 8];
+    }
+  } else {
+    return false;
+  }
+
+  prefix.length = qBound(0, length, familyWidth(prefix.family));
+  return true;
+}
+
+// static
+IPAddress IPPrefixSet::toIPAddress(const Prefix& prefix) {
+  if (prefix.family == FamilyIPv4) {
+    return IPAddress(QHostAddress(static_cast<quint32>(prefix.key.hi >> 32)),
+                     prefix.length);
+  }
+
+  Q_IPV6ADDR raw;
+  for (int i = 0; i < 8; ++i) {
+    raw[i] = static_cast<quint8>(prefix.key.hi >> (56 - i * 8));
+    raw[i + 8] = static_cast<quint8>(prefix.key.lo >> (56 - i * 8));
+  }
+  return IPAddress(QHostAddress(raw), prefix.length);
+}
+
+void IPPrefixSet::addPrefix(const Prefix& prefix) {
+  QVarLengthArray<int, MAX_DEPTH> path;
+
+  int node = m_roots[prefix.family];
+  for (int depth = 0;; ++depth) {
+    if (m_nodes.at(node).full) {
+      // Already covered by a shorter prefix.
+      return;
+    }
+
+    path.append(node);
+
+    if (depth == prefix.length) {
+      freeChildren(node);
+      m_nodes[node].full = true;
+      break;
+    }
+
+    int bit = prefix.key.bit(depth);
+    int child = m_nodes.at(node).child[bit];
+    if (child < 0) {
+      child = allocNode();
+      m_nodes[node].child[bit] = child;
+    }
+    node = child;
+  }
+
+  // Two full siblings are the same as a full parent.
+  for (int i = path.size() - 2; i >= 0; --i) {
+    Node& parent = m_nodes[path[i]];
+    if (parent.child[0] < 0 || parent.child[1] < 0 ||
+        !m_nodes.at(parent.child[0]).full ||
+        !m_nodes.at(parent.child[1]).full) {
+      break;
+    }
+
+    freeChildren(path[i]);
+    m_nodes[path[i]].full = true;
+  }
+}
+
+void IPPrefixSet::removePrefix(const Prefix& prefix) {
+  QVarLengthArray<int, MAX_DEPTH> path;
+
+  int node = m_roots[prefix.family];
+  for (int depth = 0;; ++depth) {
+    path.append(node);
+
+    if (depth == prefix.length) {
+      freeChildren(node);
+      m_nodes[node].full = false;
+      break;
+    }
+
+    if (m_nodes.at(node).full) {
+      // Split the block: the removal happens in one of the two halves.
+      int child0 = allocNode();
+      int child1 = allocNode();
+      m_nodes[child0].full = true;
+      m_nodes[child1].full = true;
+
+      Node& split = m_nodes[node];
+      split.full = false;
+      split.child[0] = child0;
+      split.child[1] = child1;
+    }
+
+    int child = m_nodes.at(node).child[prefix.key.bit(depth)];
+    if (child < 0) {
+      // Nothing to remove.
+      return;
+    }
+    node = child;
+  }
+
+  // Drop the nodes which are now empty. The roots always stay.
+  for (int i = path.size() - 1; i > 0; --i) {
+    const Node& current = m_nodes.at(path[i]);
+    if (current.full || current.child[0] >= 0 || current.child[1] >= 0) {
+      break;
+    }
+
+    m_nodes[path[i - 1]].child[prefix.key.bit(i - 1)] = -1;
+    m_freeNodes.append(path[i]);
+  }
+}
+
+bool IPPrefixSet::containsPrefix(const Prefix& prefix) const {
+  int node = m_roots[prefix.family];
+  for (int depth = 0;; ++depth) {
+    const Node& current = m_nodes.at(node);
+    if (current.full) {
+      return true;
+    }
+
+    if (depth == prefix.length) {
+      return false;
+    }
+
+    node = current.child[prefix.key.bit(depth)];
+    if (node < 0) {
+      return false;
+    }
+  }
+}
+
+QVector<IPPrefixSet::Prefix> IPPrefixSet::fullPrefixes() const {
+  QVector<Prefix> list;
+
+  struct Entry {
+    int node;
+    Prefix prefix;
+  };
+  QVector<Entry> stack;
+
+  for (int family : {FamilyIPv4, FamilyIPv6}) {
+    stack.append({m_roots[family], {static_cast<Family>(family), Key(), 0}});
+
+    while (!stack.isEmpty()) {
+      Entry entry = stack.takeLast();
+      const Node& node = m_nodes.at(entry.node);
+
+      if (node.full) {
+        list.append(entry.prefix);
+        continue;
+      }
+
+      // Push the "1" branch first to visit the addresses in order.
+      for (int bit = 1; bit >= 0; --bit) {
+        if (node.child[bit] < 0) {
+          continue;
+        }
+
+        Entry child{node.child[bit], entry.prefix};
+        if (bit) {
+          child.prefix.key.setBit(entry.prefix.length);
+        }
+        child.prefix.length++;
+        stack.append(child);
+      }
+    }
+  }
+
+  return list;
+}
+
+int IPPrefixSet::allocNode() {
+  if (!m_freeNodes.isEmpty()) {
+    int node = m_freeNodes.takeLast();
+    m_nodes[node] = Node();
+    return node;
+  }
+
+  m_nodes.append(Node());
+  return m_nodes.size() - 1;
+}
+
+void IPPrefixSet::freeChildren(int node) {
+  QVarLengthArray<int, MAX_DEPTH * 2> stack;
+  for (int& child : m_nodes[node].child) {
+    if (child >= 0) {
+      stack.append(child);
+      child = -1;
+    }
+  }
+
+  while (!stack.isEmpty()) {
+    int current = stack.takeLast();
+    for (int child : m_nodes.at(current).child) {
+      if (child >= 0) {
+        stack.append(child);
+      }
+    }
+    m_freeNodes.append(current);
+  }
+}
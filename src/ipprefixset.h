@@ -0,0 +1,102 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef IPPREFIXSET_H
+#define IPPREFIXSET_H
+
+#include "ipaddress.h"
+
+#include <QList>
+#include <QVector>
+
+// Set of IPv4 and IPv6 addresses, stored as a binary trie of prefixes (one
+// per address family). A node is either "full", when its whole prefix is in
+// the set, or it has up to two children for the next bit.
+//
+// Adding or removing a prefix walks at most 32 (IPv4) or 128 (IPv6) nodes on
+// raw integers. Full siblings are merged when a prefix is added, so prefixes()
+// always returns the minimal list of CIDR blocks covering the set.
+class IPPrefixSet final {
+ public:
+  IPPrefixSet();
+
+  void clear();
+
+  bool isEmpty() const;
+
+  void add(const IPAddress& prefix);
+  void add(const QList<IPAddress>& prefixes);
+
+  void remove(const IPAddress& prefix);
+  void remove(const QList<IPAddress>& prefixes);
+
+  void unite(const IPPrefixSet& other);
+  void subtract(const IPPrefixSet& other);
+
+  bool contains(const QHostAddress& address) const;
+
+  // True if the whole prefix is in the set.
+  bool contains(const IPAddress& prefix) const;
+
+  // The minimal cover of the set: IPv4 blocks first, then IPv6, each sorted by
+  // address.
+  QList<IPAddress> prefixes() const;
+
+ private:
+  enum Family {
+    FamilyIPv4 = 0,
+    FamilyIPv6 = 1,
+  };
+
+  // Addresses are left-aligned in 128 bits: an IPv4 address only uses the 32
+  // most significant bits of `hi`.
+  struct Key {
+    quint64 hi = 0;
+    quint64 lo = 0;
+
+    int bit(int index) const {
+      return static_cast<int>(index < 64 ? (hi >> (63 - index)) & 1
+                                         : (lo >> (127 - index)) & 1);
+    }
+
+    void setBit(int index) {
+      if (index < 64) {
+        hi |= Q_UINT64_C(1) << (63 - index);
+      } else {
+        lo |= Q_UINT64_C(1) << (127 - index);
+      }
+    }
+  };
+
+  struct Prefix {
+    Family family;
+    Key key;
+    int length;
+  };
+
+  struct Node {
+    int child[2] = {-1, -1};
+    bool full = false;
+  };
+
+  static bool toPrefix(const QHostAddress& address, int length,
+                       Prefix& prefix);
+  static IPAddress toIPAddress(const Prefix& prefix);
+
+  void addPrefix(const Prefix& prefix);
+  void removePrefix(const Prefix& prefix);
+  bool containsPrefix(const Prefix& prefix) const;
+
+  QVector<Prefix> fullPrefixes() const;
+
+  int allocNode();
+  void freeChildren(int node);
+
+ private:
+  QVector<Node> m_nodes;
+  QVector<int> m_freeNodes;
+  int m_roots[2];
+};
+
+#endif  // IPPREFIXSET_H
@@ -0,0 +1,257 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "jsonstreamparser.h"
+#include "leakdetector.h"
+#include "logger.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonParseError>
+
+namespace {
+Logger logger(LOG_MAIN, "JsonStreamParser");
+
+bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+}  // namespace
+
+JsonStreamParser::JsonStreamParser(const QString& arrayName,
+                                   RecordCallback&& callback)
+    : m_arrayName(arrayName), m_callback(std::move(callback)) {
+  MVPN_COUNT_CTOR(JsonStreamParser);
+}
+
+JsonStreamParser::~JsonStreamParser() { MVPN_COUNT_DTOR(JsonStreamParser); }
+
+bool JsonStreamParser::feed(const QByteArray& chunk) {
+  if (m_state == StateError) {
+    return false;
+  }
+
+  m_buffer.append(chunk);
+
+  while (m_pos < m_buffer.length()) {
+    char c = m_buffer.at(m_pos);
+
+    switch (m_state) {
+      case StateRoot:
+        if (!isSpace(c) && c != '{') {
+          return setError("Root object expected");
+        }
+        if (c == '{') {
+          m_depth = 1;
+          m_state = StateKey;
+        }
+        ++m_pos;
+        break;
+
+      case StateKey:
+      case StateNextKey:
+        if (c == '"') {
+          m_start = m_pos;
+          m_state = StateKeyString;
+        } else if (c == '}' && m_state == StateKey) {
+          m_depth = 0;
+          m_state = StateDone;
+        } else if (!isSpace(c)) {
+          return setError("Member name expected");
+        }
+        ++m_pos;
+        break;
+
+      case StateKeyString:
+        if (m_escape) {
+          m_escape = false;
+        } else if (c == '\\') {
+          m_escape = true;
+        } else if (c == '"') {
+          QJsonValue key;
+          if (!parseValue(m_buffer.mid(m_start, m_pos + 1 - m_start), key)) {
+            return setError("Invalid member name");
+          }
+          m_key = key.toString();
+          m_start = -1;
+          m_state = StateColon;
+        }
+        ++m_pos;
+        break;
+
+      case StateColon:
+        if (!isSpace(c) && c != ':') {
+          return setError("Colon expected");
+        }
+        if (c == ':') {
+          m_state = StateValue;
+        }
+        ++m_pos;
+        break;
+
+      case StateValue:
+        if (isSpace(c)) {
+          ++m_pos;
+        } else if (c == '[' && m_key == m_arrayName) {
+          m_arrayFound = true;
+          m_depth = 2;
+          m_state = StateRecord;
+          ++m_pos;
+        } else {
+          m_start = m_pos;
+          m_state = StateMemberValue;
+        }
+        break;
+
+      case StateMemberValue: {
+        if (!scanValue(1)) {
+          break;
+        }
+
+        QJsonValue value;
+        if (!parseValue(m_buffer.mid(m_start, m_pos - m_start), value)) {
+          return setError("Invalid member value");
+        }
+        m_members.insert(m_key, value);
+        m_start = -1;
+        m_state = StateAfterMember;
+        break;
+      }
+
+      case StateRecord:
+      case StateNextRecord:
+        if (c == ']' && m_state == StateRecord) {
+          m_depth = 1;
+          m_state = StateAfterMember;
+          ++m_pos;
+        } else if (isSpace(c)) {
+          ++m_pos;
+        } else {
+          m_start = m_pos;
+          m_state = StateRecordValue;
+        }
+        break;
+
+      case StateRecordValue: {
+        if (!scanValue(2)) {
+          break;
+        }
+
+        QJsonValue record;
+        if (!parseValue(m_buffer.mid(m_start, m_pos - m_start), record)) {
+          return setError("Invalid record");
+        }
+        m_start = -1;
+
+        if (!m_callback(record)) {
+          return setError("Record rejected");
+        }
+        ++m_recordCount;
+
+        if (m_buffer.at(m_pos) == ',') {
+          m_state = StateNextRecord;
+        } else {
+          m_depth = 1;
+          m_state = StateAfterMember;
+        }
+        ++m_pos;
+        break;
+      }
+
+      case StateAfterMember:
+        if (c == ',') {
+          m_state = StateNextKey;
+        } else if (c == '}') {
+          m_depth = 0;
+          m_state = StateDone;
+        } else if (!isSpace(c)) {
+          return setError("Comma expected");
+        }
+        ++m_pos;
+        break;
+
+      case StateDone:
+        if (!isSpace(c)) {
+          return setError("Garbage after the root object");
+        }
+        ++m_pos;
+        break;
+
+      case StateError:
+        Q_ASSERT(false);
+        return false;
+    }
+  }
+
+  // Drop what has been consumed. Only the value being scanned is kept.
+  int consumed = m_start >= 0 ? m_start : m_pos;
+  m_buffer.remove(0, consumed);
+  m_pos -= consumed;
+  if (m_start >= 0) {
+    m_start = 0;
+  }
+
+  return true;
+}
+
+bool JsonStreamParser::scanValue(int depth) {
+  while (m_pos < m_buffer.length()) {
+    char c = m_buffer.at(m_pos);
+
+    if (m_inString) {
+      if (m_escape) {
+        m_escape = false;
+      } else if (c == '\\') {
+        m_escape = true;
+      } else if (c == '"') {
+        m_inString = false;
+      }
+    } else if (c == '"') {
+      m_inString = true;
+    } else if (c == '{' || c == '[') {
+      ++m_depth;
+    } else if (c == '}' || c == ']') {
+      if (m_depth == depth) {
+        return true;
+      }
+      --m_depth;
+    } else if (c == ',' && m_depth == depth) {
+      return true;
+    }
+
+    ++m_pos;
+  }
+
+  return false;
+}
+
+// static
+bool JsonStreamParser::parseValue(const QByteArray& data, QJsonValue& value) {
+  // QJsonDocument doesn't parse scalars on their own.
+  QByteArray wrapped;
+  wrapped.reserve(data.length() + 2);
+  wrapped.append('[').append(data).append(']');
+
+  QJsonParseError error;
+  QJsonDocument doc = QJsonDocument::fromJson(wrapped, &error);
+  if (error.error != QJsonParseError::NoError || !doc.isArray()) {
+    return false;
+  }
+
+  QJsonArray array = doc.array();
+  if (array.size() != 1) {
+    return false;
+  }
+
+  value = array.at(0);
+  return true;
+}
+
+bool JsonStreamParser::setError(const char* reason) {
+  logger.error() << "Parsing failed:" << reason;
+  m_state = StateError;
+  m_buffer.clear();
+  m_start = -1;
+  m_pos = 0;
+  return false;
+}
@@ -0,0 +1,96 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef JSONSTREAMPARSER_H
+#define JSONSTREAMPARSER_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QString>
+
+#include <functional>
+
+// Incremental parser for JSON objects carrying a big array of records, such
+// as {"countries": [...]} or {"devices": [...]}. The data can be fed in
+// chunks, as it arrives from the network: each element of the array is
+// passed to the callback as soon as it is complete, and it's the only part of
+// the document turned into a DOM. Only the bytes of the element being
+// received are buffered.
+//
+// The other members of the root object are expected to be small and are
+// collected in members().
+class JsonStreamParser final {
+  Q_DISABLE_COPY_MOVE(JsonStreamParser)
+
+ public:
+  // Returns false to stop the parsing with an error.
+  using RecordCallback = std::function<bool(const QJsonValue& record)>;
+
+  JsonStreamParser(const QString& arrayName, RecordCallback&& callback);
+  ~JsonStreamParser();
+
+  // Returns false if the data is not valid. Once an error is found, the
+  // following chunks are ignored.
+  bool feed(const QByteArray& chunk);
+
+  // The root object has been parsed completely, without errors.
+  bool isComplete() const { return m_state == StateDone; }
+
+  bool hasError() const { return m_state == StateError; }
+
+  // Whether the root object had an array with the expected name.
+  bool hasArray() const { return m_arrayFound; }
+
+  int recordCount() const { return m_recordCount; }
+
+  const QJsonObject& members() const { return m_members; }
+
+ private:
+  enum State {
+    StateRoot,
+    StateKey,
+    StateNextKey,
+    StateKeyString,
+    StateColon,
+    StateValue,
+    StateMemberValue,
+    StateRecord,
+    StateNextRecord,
+    StateRecordValue,
+    StateAfterMember,
+    StateDone,
+    StateError,
+  };
+
+  // Scans a string, a number or a container up to the first separator at
+  // `depth`. Returns true when it's found, at m_pos.
+  bool scanValue(int depth);
+
+  static bool parseValue(const QByteArray& data, QJsonValue& value);
+
+  bool setError(const char* reason);
+
+ private:
+  const QString m_arrayName;
+  RecordCallback m_callback;
+
+  State m_state = StateRoot;
+
+  QByteArray m_buffer;
+  int m_pos = 0;
+  int m_start = -1;
+
+  int m_depth = 0;
+  bool m_inString = false;
+  bool m_escape = false;
+
+  QString m_key;
+  bool m_arrayFound = false;
+  int m_recordCount = 0;
+
+  QJsonObject m_members;
+};
+
+#endif  // JSONSTREAMPARSER_H
@@ -3,6 +3,7 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include "localsocketcontroller.h"
+#include "daemon/daemonstatusframe.h"
 #include "errorhandler.h"
 #include "ipaddress.h"
 #include "leakdetector.h"
@@ -22,6 +23,9 @@
 #include <QStandardPaths>
 #include <QHostAddress>
 
+// The status is polled if this many frames are missed in a row.
+constexpr int STATUS_FRAMES_MISSED = 3;
+
 namespace {
 Logger logger(LOG_CONTROLLER, "LocalSocketController");
 }
@@ -38,6 +42,10 @@ LocalSocketController::LocalSocketController() {
           &LocalSocketController::errorOccurred);
   connect(m_socket, &QLocalSocket::readyRead, this,
           &LocalSocketController::readData);
+
+  m_statusFrameTimer.setSingleShot(true);
+  connect(&m_statusFrameTimer, &QTimer::timeout, this,
+          &LocalSocketController::statusFrameMissed);
 }
 
 LocalSocketController::~LocalSocketController() {
@@ -53,6 +61,7 @@ void LocalSocketController::errorOccurred(
   }
 
   m_state = eDisconnected;
+  m_statusFrameTimer.stop();
   MozillaVPN::instance()->errorHandle(ErrorHandler::ControllerError);
   emit disconnected();
 }
@@ -219,6 +228,41 @@ void LocalSocketController::checkStatus() {
   }
 }
 
+bool LocalSocketController::subscribeStatus(int intervalMsec) {
+  logger.debug() << "Subscribe status";
+
+  m_statusSubscriptionMsec = intervalMsec;
+
+  // Otherwise, the subscription is sent when the daemon is ready, and the
+  // caller polls the status until then.
+  if (m_state != eReady) {
+    return false;
+  }
+
+  QJsonObject json;
+  json.insert("type", "subscribeStatus");
+  json.insert("interval", intervalMsec);
+  write(json);
+
+  m_statusPolling = false;
+  m_statusFrameTimer.start(intervalMsec * STATUS_FRAMES_MISSED);
+  return true;
+}
+
+void LocalSocketController::unsubscribeStatus() {
+  logger.debug() << "Unsubscribe status";
+
+  m_statusSubscriptionMsec = 0;
+  m_statusFrameTimer.stop();
+  m_statusPolling = false;
+
+  if (m_state == eReady) {
+    QJsonObject json;
+    json.insert("type", "unsubscribeStatus");
+    write(json);
+  }
+}
+
 void LocalSocketController::getBackendLogs(
     std::function<void(const QString&)>&& a_callback) {
   logger.debug() << "Backend logs";
@@ -267,6 +311,16 @@ void LocalSocketController::readData() {
   m_buffer.append(input);
 
   while (true) {
+    // Status frames are binary and have a fixed size.
+    if (!m_buffer.isEmpty() && m_buffer.at(0) == DaemonStatusFrame::MARKER) {
+      if (m_buffer.length() < DaemonStatusFrame::SIZE) {
+        break;
+      }
+      parseStatusFrame(m_buffer.constData());
+      m_buffer.remove(0, DaemonStatusFrame::SIZE);
+      continue;
+    }
+
     int pos = m_buffer.indexOf("\n");
     if (pos == -1) {
       break;
@@ -329,6 +383,10 @@ void LocalSocketController::parseCommand(const QByteArray& command) {
     }
 
     emit initialized(true, connected.toBool(), datetime);
+
+    if (m_statusSubscriptionMsec) {
+      subscribeStatus(m_statusSubscriptionMsec);
+    }
     return;
   }
 
@@ -365,6 +423,11 @@ void LocalSocketController::parseCommand(const QByteArray& command) {
     emit statusUpdated(serverIpv4Gateway.toString(),
                        deviceIpv4Address.toString(), txBytes.toDouble(),
                        rxBytes.toDouble());
+
+    // The counters of the status are cumulative, like the ones of the frames.
+    if (m_statusPolling) {
+      emit statusSampled(txBytes.toDouble(), rxBytes.toDouble());
+    }
     return;
   }
 
@@ -417,6 +480,41 @@ void LocalSocketController::parseCommand(const QByteArray& command) {
   logger.warning() << "Invalid command received:" << command;
 }
 
+void LocalSocketController::parseStatusFrame(const char* data) {
+  if (m_state != eReady || !m_statusSubscriptionMsec) {
+    return;
+  }
+
+  DaemonStatusFrame frame;
+  if (!frame.decode(data)) {
+    return;
+  }
+
+  if (m_statusPolling) {
+    logger.debug() << "Status frames resumed";
+    m_statusPolling = false;
+  }
+  m_statusFrameTimer.start(m_statusSubscriptionMsec * STATUS_FRAMES_MISSED);
+
+  if (frame.m_connected) {
+    emit statusSampled(frame.m_txBytes, frame.m_rxBytes);
+  }
+}
+
+void LocalSocketController::statusFrameMissed() {
+  if (m_state != eReady || !m_statusSubscriptionMsec) {
+    return;
+  }
+
+  if (!m_statusPolling) {
+    logger.warning() << "No status frames from the daemon - polling";
+    m_statusPolling = true;
+  }
+
+  checkStatus();
+  m_statusFrameTimer.start(m_statusSubscriptionMsec);
+}
+
 void LocalSocketController::write(const QJsonObject& json) {
   Q_ASSERT(m_socket);
   m_socket->write(QJsonDocument(json).toJson(QJsonDocument::Compact));
@@ -10,6 +10,7 @@
 #include <functional>
 #include <QLocalSocket>
 #include <QHostAddress>
+#include <QTimer>
 
 class QJsonObject;
 
@@ -33,6 +34,10 @@ class LocalSocketController final : public ControllerImpl {
 
   void checkStatus() override;
 
+  bool subscribeStatus(int intervalMsec) override;
+
+  void unsubscribeStatus() override;
+
   void getBackendLogs(std::function<void(const QString&)>&& callback) override;
 
   void cleanupBackendLogs() override;
@@ -43,6 +48,8 @@ class LocalSocketController final : public ControllerImpl {
   void errorOccurred(QLocalSocket::LocalSocketError socketError);
   void readData();
   void parseCommand(const QByteArray& command);
+  void parseStatusFrame(const char* data);
+  void statusFrameMissed();
 
   void write(const QJsonObject& json);
 
@@ -72,6 +79,13 @@ class LocalSocketController final : public ControllerImpl {
 
   QByteArray m_buffer;
 
+  // 0 if there is no status subscription.
+  int m_statusSubscriptionMsec = 0;
+
+  // A daemon that doesn't push the status frames is polled instead.
+  QTimer m_statusFrameTimer;
+  bool m_statusPolling = false;
+
   std::function<void(const QString&)> m_logCallback = nullptr;
 };
 
@@ -6,6 +6,7 @@
 #include "loghandler.h"
 
 #include <QMetaEnum>
+#include <QThreadStorage>
 
 Logger::Logger(const QString& module, const QString& className)
     : Logger(QStringList({module}), className) {}
@@ -19,12 +20,38 @@ Logger::Log Logger::info() { return Log(this, LogLevel::Info); }
 Logger::Log Logger::debug() { return Log(this, LogLevel::Debug); }
 
 Logger::Log::Log(Logger* logger, LogLevel logLevel)
-    : m_logger(logger), m_logLevel(logLevel), m_data(new Data()) {}
+    : m_logger(logger), m_logLevel(logLevel) {
+  Data*& head = freeList();
+  if (!head) {
+    m_data = new Data();
+    return;
+  }
+
+  m_data = head;
+  head = m_data->m_next;
+  m_data->m_next = nullptr;
+  m_data->m_ts.reset();
+}
 
 Logger::Log::~Log() {
+  // The handler swaps the message with an empty buffer of the same capacity.
   LogHandler::messageHandler(m_logLevel, m_logger->modules(),
-                             m_logger->className(), m_data->m_buffer.trimmed());
-  delete m_data;
+                             m_logger->className(), m_data->m_buffer);
+  m_data->m_buffer.truncate(0);
+
+  Data*& head = freeList();
+  m_data->m_next = head;
+  head = m_data;
+}
+
+// static
+Logger::Log::Data*& Logger::Log::freeList() {
+  // More than one buffer is only needed when a line is logged while another
+  // one is being built on the same thread. The lists are deleted when their
+  // thread exits; the storage itself is never deleted, because static
+  // objects can still log while the process shuts down.
+  static QThreadStorage<Data*>* s_freeList = new QThreadStorage<Data*>();
+  return s_freeList->localData();
 }
 
 #define CREATE_LOG_OP_REF(x)                  \
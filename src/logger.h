@@ -73,14 +73,22 @@ class Logger {
    private:
     void addMetaEnum(quint64 value, const QMetaObject* meta, const char* name);
 
+    struct Data;
+    static Data*& freeList();
+
     Logger* m_logger;
     LogLevel m_logLevel;
 
+    // Kept in a per-thread free list once the line is written, so that
+    // logging does not allocate when the buffer has grown to the size of the
+    // usual messages.
     struct Data {
       Data() : m_ts(&m_buffer, QIODevice::WriteOnly) {}
+      ~Data() { delete m_next; }
 
       QString m_buffer;
       QTextStream m_ts;
+      Data* m_next = nullptr;
     };
 
     Data* m_data;
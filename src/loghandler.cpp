@@ -5,30 +5,252 @@
 #include "loghandler.h"
 #include "constants.h"
 #include "logger.h"
+#include "logstore.h"
 
+#include <QAtomicInteger>
 #include <QDate>
 #include <QDir>
-#include <QFile>
 #include <QFileInfo>
 #include <QMessageLogContext>
 #include <QProcessEnvironment>
 #include <QStandardPaths>
 #include <QString>
 #include <QTextStream>
+#include <QThread>
+#include <QThreadStorage>
+#include <QWaitCondition>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 
 #ifdef MVPN_ANDROID
 #  include <android/log.h>
 #endif
 
-constexpr qint64 LOG_MAX_FILE_SIZE = 204800;
-constexpr const char* LOG_FILENAME = "mozillavpn.txt";
+// The logs are kept in up to LOG_MAX_SEGMENTS files of LOG_SEGMENT_SIZE bytes.
+constexpr quint32 LOG_SEGMENT_SIZE = 262144;
+constexpr int LOG_MAX_SEGMENTS = 8;
+constexpr const char* LOG_DIRNAME = "mozillavpn";
+
+// Text log file of the previous versions.
+constexpr const char* LOG_LEGACY_FILENAME = "mozillavpn.txt";
+
+// Records pre-allocated for each logging thread. Lines are dropped when a
+// thread fills its ring before the writer thread drains it.
+constexpr quint32 LOG_RING_SIZE = 512;
+
+// The writer thread waits this long after the first line of a burst, to write
+// the whole burst at once.
+constexpr unsigned long LOG_BATCH_MSEC = 50;
 
 namespace {
+// Held by the consumer of the rings: the writer thread, or a thread reading
+// or moving the log file.
 QMutex s_mutex;
 QString s_location =
     QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
 LogHandler* s_instance = nullptr;
 
+// Messages from Qt keep the file and function pointers of the
+// QMessageLogContext, which are string literals.
+struct LogRecord {
+  quint32 m_sequence = 0;
+  qint64 m_msecsSinceEpoch = 0;
+  LogLevel m_logLevel = LogLevel::Debug;
+  QStringList m_modules;
+  QString m_className;
+  QString m_message;
+  const char* m_file = nullptr;
+  const char* m_function = nullptr;
+  int32_t m_line = -1;
+  bool m_fromQT = false;
+};
+
+// Single-producer, single-consumer queue. The producer is the thread owning
+// the ring, the consumer is the holder of s_mutex.
+class LogRing final {
+ public:
+  LogRecord* beginWrite() {
+    quint32 head = m_head.loadRelaxed();
+    if (head - m_tail.loadAcquire() >= LOG_RING_SIZE) {
+      m_dropped.fetchAndAddRelaxed(1);
+      return nullptr;
+    }
+    return &m_records[head % LOG_RING_SIZE];
+  }
+
+  // Returns the number of queued records. The full barrier pairs with the
+  // one of the writer thread going idle (see LogWriter::run()).
+  quint32 endWrite() {
+    quint32 head = m_head.fetchAndAddOrdered(1) + 1;
+    return head - m_tail.loadRelaxed();
+  }
+
+  bool isEmpty() const { return m_head.loadAcquire() == m_tail.loadRelaxed(); }
+
+  LogRecord* peek() {
+    if (isEmpty()) {
+      return nullptr;
+    }
+    return &m_records[m_tail.loadRelaxed() % LOG_RING_SIZE];
+  }
+
+  void pop() { m_tail.storeRelease(m_tail.loadRelaxed() + 1); }
+
+  quint32 takeDropped() { return m_dropped.fetchAndStoreRelaxed(0); }
+
+  // Set when the owning thread exits. The consumer deletes the ring once it
+  // is drained.
+  QAtomicInt m_released;
+
+ private:
+  LogRecord m_records[LOG_RING_SIZE];
+  QAtomicInteger<quint32> m_head;
+  QAtomicInteger<quint32> m_tail;
+  QAtomicInteger<quint32> m_dropped;
+};
+
+struct LogRingOwner {
+  LogRingOwner() : m_ring(new LogRing()) {}
+  ~LogRingOwner() { m_ring->m_released.storeRelease(1); }
+
+  LogRing* m_ring;
+};
+
+QMutex s_ringsMutex;
+QVector<LogRing*> s_rings;
+
+// Orders the lines of the different threads.
+QAtomicInteger<quint32> s_sequence;
+
+enum WriterState {
+  WriterNotStarted = 0,
+  WriterRunning,
+  // The lines are written by the logging thread itself.
+  WriterStopped,
+};
+
+QAtomicInt s_writerState = WriterNotStarted;
+QAtomicInt s_writerIdle;
+QMutex s_wakeMutex;
+QWaitCondition s_wakeCondition;
+
+LogRing* localRing() {
+  // Never deleted: static objects can still log while the process exits.
+  static QThreadStorage<LogRingOwner*>* s_owners =
+      new QThreadStorage<LogRingOwner*>();
+
+  LogRingOwner*& owner = s_owners->localData();
+  if (!owner) {
+    owner = new LogRingOwner();
+
+    QMutexLocker lock(&s_ringsMutex);
+    s_rings.append(owner->m_ring);
+  }
+
+  return owner->m_ring;
+}
+
+bool hasPendingRecords() {
+  QMutexLocker lock(&s_ringsMutex);
+  for (LogRing* ring : s_rings) {
+    if (!ring->isEmpty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+class LogWriter final : public QThread {
+ public:
+  void stop() {
+    requestInterruption();
+    {
+      QMutexLocker lock(&s_wakeMutex);
+      s_wakeCondition.wakeAll();
+    }
+    wait();
+  }
+
+ protected:
+  void run() override {
+    QMutexLocker lock(&s_wakeMutex);
+    while (!isInterruptionRequested()) {
+      // A producer queues its record before checking the idle flag, and the
+      // flag is set here before checking the rings: one of the two sees the
+      // other one.
+      s_writerIdle.fetchAndStoreOrdered(1);
+      if (!hasPendingRecords()) {
+        s_wakeCondition.wait(&s_wakeMutex);
+      }
+      s_writerIdle.fetchAndStoreOrdered(0);
+
+      if (isInterruptionRequested()) {
+        break;
+      }
+
+      // A producer whose ring is half full cuts this short.
+      s_wakeCondition.wait(&s_wakeMutex, LOG_BATCH_MSEC);
+
+      lock.unlock();
+      LogHandler::flush();
+      lock.relock();
+    }
+  }
+};
+
+LogWriter* s_writer = nullptr;
+
+void stopWriter() {
+  s_writerState.storeRelease(WriterStopped);
+  s_writer->stop();
+  LogHandler::flush();
+}
+
+void startWriter() {
+#ifdef MVPN_WASM
+  // No threads: the lines are written synchronously.
+  s_writerState.storeRelease(WriterStopped);
+#else
+  // Set first: the lines logged while starting are queued as usual.
+  s_writerState.storeRelease(WriterRunning);
+  s_writer = new LogWriter();
+  s_writer->start(QThread::LowPriority);
+  std::atexit(stopWriter);
+#endif
+}
+
+void notifyWriter(quint32 queued) {
+  switch (s_writerState.loadAcquire()) {
+    case WriterRunning:
+      break;
+
+    case WriterNotStarted:
+      // Lines can be logged by the thread creating the LogHandler, or by the
+      // consumer while it is writing (for instance a warning from QFile).
+      // They stay queued until the next line in that case.
+      if (s_mutex.tryLock()) {
+        s_mutex.unlock();
+        LogHandler::instance();
+      }
+      return;
+
+    default:
+      if (s_mutex.tryLock()) {
+        s_mutex.unlock();
+        LogHandler::flush();
+      }
+      return;
+  }
+
+  if (queued == LOG_RING_SIZE / 2 ||
+      (s_writerIdle.loadAcquire() && s_writerIdle.testAndSetOrdered(1, 0))) {
+    QMutexLocker lock(&s_wakeMutex);
+    s_wakeCondition.wakeOne();
+  }
+}
+
 LogLevel qtTypeToLogLevel(QtMsgType type) {
   switch (type) {
     case QtDebugMsg:
@@ -58,18 +280,66 @@ LogHandler* LogHandler::instance() {
 void LogHandler::messageQTHandler(QtMsgType type,
                                   const QMessageLogContext& context,
                                   const QString& message) {
-  MutexLocker lock(&s_mutex);
-  maybeCreate(lock)->addLog(Log(qtTypeToLogLevel(type), context.file,
-                                context.function, context.line, message),
-                            lock);
+  LogRing* ring = localRing();
+  quint32 queued = 0;
+
+  LogRecord* record = ring->beginWrite();
+  if (record) {
+    record->m_sequence = s_sequence.fetchAndAddRelaxed(1);
+    record->m_msecsSinceEpoch = QDateTime::currentMSecsSinceEpoch();
+    record->m_logLevel = qtTypeToLogLevel(type);
+    record->m_message = message;
+    record->m_file = context.file;
+    record->m_function = context.function;
+    record->m_line = context.line;
+    record->m_fromQT = true;
+    queued = ring->endWrite();
+  }
+
+  notifyWriter(queued);
+
+  // Qt aborts right after a fatal message.
+  if (type == QtFatalMsg) {
+    flush();
+  }
 }
 
 // static
 void LogHandler::messageHandler(LogLevel logLevel, const QStringList& modules,
-                                const QString& className,
-                                const QString& message) {
+                                const QString& className, QString& message) {
+  LogRing* ring = localRing();
+  quint32 queued = 0;
+
+  LogRecord* record = ring->beginWrite();
+  if (record) {
+    record->m_sequence = s_sequence.fetchAndAddRelaxed(1);
+    record->m_msecsSinceEpoch = QDateTime::currentMSecsSinceEpoch();
+    record->m_logLevel = logLevel;
+    record->m_modules = modules;
+    record->m_className = className;
+    record->m_message.swap(message);
+    record->m_file = nullptr;
+    record->m_function = nullptr;
+    record->m_line = -1;
+    record->m_fromQT = false;
+    queued = ring->endWrite();
+  }
+
+  notifyWriter(queued);
+}
+
+// static
+void LogHandler::flush() {
   MutexLocker lock(&s_mutex);
-  maybeCreate(lock)->addLog(Log(logLevel, modules, className, message), lock);
+  maybeCreate(lock)->drain(lock);
+}
+
+// static
+quint64 LogHandler::droppedLines() {
+  MutexLocker lock(&s_mutex);
+  LogHandler* handler = maybeCreate(lock);
+  handler->drain(lock);
+  return handler->m_droppedLines;
 }
 
 // static
@@ -95,6 +365,10 @@ LogHandler* LogHandler::maybeCreate(const MutexLocker& proofOfLock) {
       }
     }
 
+    if (s_writerState.loadAcquire() == WriterNotStarted) {
+      startWriter();
+    }
+
     s_instance = new LogHandler(minLogLevel, modules, proofOfLock);
   }
 
@@ -185,21 +459,20 @@ void LogHandler::addLog(const Log& log, const MutexLocker& proofOfLock) {
     return;
   }
 
-  if (m_output) {
-    prettyOutput(*m_output, log);
-  }
-
-  if ((log.m_logLevel != LogLevel::Debug) || m_showDebug) {
-    QTextStream out(stderr);
-    prettyOutput(out, log);
-  }
-
   QByteArray buffer;
   {
     QTextStream out(&buffer);
     prettyOutput(out, log);
   }
 
+  if (m_store) {
+    m_store->append(log);
+  }
+
+  if ((log.m_logLevel != LogLevel::Debug) || m_showDebug) {
+    m_stderrBuffer.append(buffer);
+  }
+
   emit logEntryAdded(buffer);
 
 #if defined(MVPN_ANDROID) && defined(MVPN_DEBUG)
@@ -210,6 +483,97 @@ void LogHandler::addLog(const Log& log, const MutexLocker& proofOfLock) {
 #endif
 }
 
+void LogHandler::drain(const MutexLocker& proofOfLock) {
+  QVector<LogRing*> rings;
+  {
+    QMutexLocker lock(&s_ringsMutex);
+    rings = s_rings;
+  }
+
+  struct Entry {
+    quint32 m_sequence;
+    Log m_log;
+  };
+  QVector<Entry> entries;
+  quint64 dropped = 0;
+
+  for (LogRing* ring : rings) {
+    // Everything queued before the release is visible once it is seen.
+    bool released = ring->m_released.loadAcquire();
+
+    while (LogRecord* record = ring->peek()) {
+      Entry entry{record->m_sequence, Log()};
+      Log& log = entry.m_log;
+      log.m_logLevel = record->m_logLevel;
+      log.m_dateTime =
+          QDateTime::fromMSecsSinceEpoch(record->m_msecsSinceEpoch);
+      log.m_fromQT = record->m_fromQT;
+
+      if (record->m_fromQT) {
+        log.m_file = QString::fromUtf8(record->m_file);
+        log.m_function = QString::fromUtf8(record->m_function);
+        log.m_line = record->m_line;
+        // The message of Qt is shared with the caller: nothing to reuse.
+        log.m_message.swap(record->m_message);
+      } else {
+        log.m_modules = record->m_modules;
+        log.m_className = record->m_className;
+        // A deep copy: the buffer goes back to a logging thread, and a shared
+        // one would be reallocated, without its capacity, by the truncate.
+        log.m_message = QString(record->m_message.constData(),
+                                record->m_message.size())
+                            .trimmed();
+      }
+
+      record->m_message.truncate(0);
+      ring->pop();
+
+      entries.append(entry);
+    }
+
+    dropped += ring->takeDropped();
+
+    if (released) {
+      QMutexLocker lock(&s_ringsMutex);
+      s_rings.removeOne(ring);
+      delete ring;
+    }
+  }
+
+  // Sequence numbers can wrap: compare the distance.
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) {
+              return static_cast<qint32>(a.m_sequence - b.m_sequence) < 0;
+            });
+
+  for (const Entry& entry : entries) {
+    addLog(entry.m_log, proofOfLock);
+  }
+
+  if (dropped > 0) {
+    m_droppedLines += dropped;
+    addLog(Log(Warning, QStringList{LOG_MAIN}, "LogHandler",
+               QString("%1 log lines dropped").arg(dropped)),
+           proofOfLock);
+  }
+
+  writeBuffers(proofOfLock);
+}
+
+void LogHandler::writeBuffers(const MutexLocker& proofOfLock) {
+  Q_UNUSED(proofOfLock);
+
+  if (m_store) {
+    m_store->commit();
+  }
+
+  if (!m_stderrBuffer.isEmpty()) {
+    fwrite(m_stderrBuffer.constData(), 1, m_stderrBuffer.length(), stderr);
+    fflush(stderr);
+    m_stderrBuffer.truncate(0);
+  }
+}
+
 bool LogHandler::matchModule(const Log& log,
                              const MutexLocker& proofOfLock) const {
   Q_UNUSED(proofOfLock);
@@ -240,65 +604,64 @@ bool LogHandler::matchLogLevel(const Log& log,
 }
 
 // static
-void LogHandler::writeLogs(QTextStream& out) {
-  MutexLocker lock(&s_mutex);
-
-  if (!s_instance || !s_instance->m_logFile) {
-    return;
-  }
-
-  QString logFileName = s_instance->m_logFile->fileName();
-  s_instance->closeLogFile(lock);
+void LogHandler::writeLogs(QTextStream& out) { writeLogs(out, Filter()); }
 
+// static
+void LogHandler::writeLogs(QTextStream& out, const Filter& filter) {
+  QString path;
   {
-    QFile file(logFileName);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    MutexLocker lock(&s_mutex);
+
+    if (!s_instance || !s_instance->m_store) {
       return;
     }
 
-    out << file.readAll();
+    s_instance->drain(lock);
+    path = s_instance->m_store->path();
   }
 
-  s_instance->openLogFile(lock);
+  // The segments are read from disk while the writer thread keeps going.
+  LogStore::read(path, filter,
+                 [&out](const Log& log) { prettyOutput(out, log); });
 }
 
 // static
 void LogHandler::cleanupLogs() {
   MutexLocker lock(&s_mutex);
+  if (s_instance) {
+    s_instance->drain(lock);
+  }
   cleanupLogFile(lock);
 }
 
 // static
 void LogHandler::cleanupLogFile(const MutexLocker& proofOfLock) {
-  if (!s_instance || !s_instance->m_logFile) {
+  if (!s_instance || !s_instance->m_store) {
     return;
   }
 
-  QString logFileName = s_instance->m_logFile->fileName();
+  QString path = s_instance->m_store->path();
   s_instance->closeLogFile(proofOfLock);
-
-  {
-    QFile file(logFileName);
-    file.remove();
-  }
-
+  LogStore::removeAll(path);
   s_instance->openLogFile(proofOfLock);
 }
 
 // static
 void LogHandler::setLocation(const QString& path) {
   MutexLocker lock(&s_mutex);
+  if (s_instance) {
+    s_instance->drain(lock);
+  }
   s_location = path;
 
-  if (s_instance && s_instance->m_logFile) {
+  if (s_instance && s_instance->m_store) {
     cleanupLogFile(lock);
   }
 }
 
 void LogHandler::openLogFile(const MutexLocker& proofOfLock) {
   Q_UNUSED(proofOfLock);
-  Q_ASSERT(!m_logFile);
-  Q_ASSERT(!m_output);
+  Q_ASSERT(!m_store);
 
   QDir appDataLocation(s_location);
   if (!appDataLocation.exists()) {
@@ -312,34 +675,29 @@ void LogHandler::openLogFile(const MutexLocker& proofOfLock) {
     }
   }
 
-  QString logFileName = appDataLocation.filePath(LOG_FILENAME);
-  m_logFile = new QFile(logFileName);
-  if (m_logFile->size() > LOG_MAX_FILE_SIZE) {
-    m_logFile->remove();
-  }
+  appDataLocation.remove(LOG_LEGACY_FILENAME);
 
-  if (!m_logFile->open(QIODevice::WriteOnly | QIODevice::Append |
-                       QIODevice::Text)) {
-    delete m_logFile;
-    m_logFile = nullptr;
+  QString path = appDataLocation.filePath(LOG_DIRNAME);
+  m_store = new LogStore(path, LOG_SEGMENT_SIZE, LOG_MAX_SEGMENTS);
+  if (!m_store->open()) {
+    delete m_store;
+    m_store = nullptr;
     return;
   }
 
-  m_output = new QTextStream(m_logFile);
-
   addLog(Log(Debug, QStringList{LOG_MAIN}, "LogHandler",
-             QString("Log file: %1").arg(logFileName)),
+             QString("Log directory: %1").arg(path)),
          proofOfLock);
+  writeBuffers(proofOfLock);
 }
 
 void LogHandler::closeLogFile(const MutexLocker& proofOfLock) {
   Q_UNUSED(proofOfLock);
 
-  if (m_logFile) {
-    delete m_output;
-    m_output = nullptr;
+  if (m_store) {
+    writeBuffers(proofOfLock);
 
-    delete m_logFile;
-    m_logFile = nullptr;
+    delete m_store;
+    m_store = nullptr;
   }
 }
@@ -12,7 +12,7 @@
 #include <QMutexLocker>
 #include <QVector>
 
-class QFile;
+class LogStore;
 class QTextStream;
 
 class LogHandler final : public QObject {
@@ -58,18 +58,31 @@ class LogHandler final : public QObject {
     bool m_fromQT = false;
   };
 
+  struct Filter {
+    // Milliseconds since epoch, 0 for no bound.
+    qint64 m_from = 0;
+    qint64 m_to = 0;
+    LogLevel m_minLogLevel = Debug;
+    // Only the lines of these modules, and the Qt messages. All the lines if
+    // empty.
+    QStringList m_modules;
+  };
+
   static LogHandler* instance();
 
   static void messageQTHandler(QtMsgType type,
                                const QMessageLogContext& context,
                                const QString& message);
 
+  // The message is queued without being copied: it is swapped with an empty
+  // buffer, recycled from a previous line.
   static void messageHandler(LogLevel logLevel, const QStringList& modules,
-                             const QString& className, const QString& message);
+                             const QString& className, QString& message);
 
   static void prettyOutput(QTextStream& out, const LogHandler::Log& log);
 
   static void writeLogs(QTextStream& out);
+  static void writeLogs(QTextStream& out, const Filter& filter);
 
   static void cleanupLogs();
 
@@ -77,6 +90,13 @@ class LogHandler final : public QObject {
 
   static void enableDebug();
 
+  // Writes the lines still queued by the logging threads.
+  static void flush();
+
+  // Number of lines discarded because a thread logged faster than the writer
+  // thread could keep up with.
+  static quint64 droppedLines();
+
  signals:
   void logEntryAdded(const QByteArray& log);
 
@@ -88,6 +108,10 @@ class LogHandler final : public QObject {
 
   void addLog(const Log& log, const MutexLocker& proofOfLock);
 
+  void drain(const MutexLocker& proofOfLock);
+
+  void writeBuffers(const MutexLocker& proofOfLock);
+
   bool matchLogLevel(const Log& log, const MutexLocker& proofOfLock) const;
   bool matchModule(const Log& log, const MutexLocker& proofOfLock) const;
 
@@ -101,8 +125,12 @@ class LogHandler final : public QObject {
   const QStringList m_modules;
   bool m_showDebug = false;
 
-  QFile* m_logFile = nullptr;
-  QTextStream* m_output = nullptr;
+  LogStore* m_store = nullptr;
+
+  // Formatted lines waiting to be written at the end of a batch.
+  QByteArray m_stderrBuffer;
+
+  quint64 m_droppedLines = 0;
 };
 
 #endif  // LOGHANDLER_H
@@ -0,0 +1,504 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "logstore.h"
+
+#include <QDir>
+#include <QFile>
+
+#include <atomic>
+#include <cstring>
+
+// "MVLG" - the byte order of the writer is the only one accepted.
+constexpr quint32 SEGMENT_MAGIC = 0x4d564c47;
+constexpr quint32 SEGMENT_VERSION = 1;
+
+constexpr const char* SEGMENT_PREFIX = "segment-";
+constexpr const char* SEGMENT_SUFFIX = ".bin";
+constexpr int SEGMENT_SEQUENCE_DIGITS = 10;
+
+// Records start on 8 bytes boundaries, so that they can be read in place.
+constexpr quint32 RECORD_ALIGNMENT = 8;
+
+// Longer messages are truncated, to keep the record size in 16 bits.
+constexpr int MAX_PAYLOAD_SIZE = 16384;
+
+namespace {
+
+enum RecordType : quint8 {
+  // Defines a module or class name: the id is in `moduleId`.
+  RecordString = 1,
+  RecordLog = 2,
+  // File and function of the message are in `moduleId` and `classId`, the
+  // payload starts with the line number.
+  RecordQtLog = 3,
+};
+
+struct SegmentHeader {
+  quint32 magic;
+  quint32 version;
+  quint64 sequence;
+  // Bytes used, header included. Updated after the records are written:
+  // readers ignore what comes after.
+  quint32 used;
+  quint32 records;
+  // Index of the log records, to skip the segment when filtering.
+  qint64 firstTimestamp;
+  qint64 lastTimestamp;
+  // One bit per LogLevel.
+  quint32 levels;
+  quint32 reserved;
+};
+
+struct RecordHeader {
+  // Header and payload, without the alignment padding.
+  quint16 size;
+  quint8 type;
+  quint8 level;
+  quint16 moduleId;
+  quint16 classId;
+  qint64 timestamp;
+};
+
+static_assert(sizeof(SegmentHeader) % RECORD_ALIGNMENT == 0,
+              "The first record must be aligned");
+static_assert(sizeof(RecordHeader) == 16, "Unexpected record header size");
+
+quint32 alignedSize(quint32 size) {
+  return (size + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+}
+
+QString segmentFileName(quint64 sequence) {
+  return QString("%1%2%3")
+      .arg(SEGMENT_PREFIX)
+      .arg(sequence, SEGMENT_SEQUENCE_DIGITS, 10, QChar('0'))
+      .arg(SEGMENT_SUFFIX);
+}
+
+quint64 segmentSequence(const QString& fileName) {
+  return fileName.mid(static_cast<int>(strlen(SEGMENT_PREFIX)),
+                      SEGMENT_SEQUENCE_DIGITS)
+      .toULongLong();
+}
+
+QByteArray truncatedUtf8(const QString& string) {
+  QByteArray utf8 = string.toUtf8();
+  if (utf8.length() <= MAX_PAYLOAD_SIZE) {
+    return utf8;
+  }
+
+  // Don't cut a multi-byte sequence.
+  int length = MAX_PAYLOAD_SIZE;
+  while (length > 0 && (static_cast<quint8>(utf8.at(length)) & 0xC0) == 0x80) {
+    --length;
+  }
+  utf8.truncate(length);
+  return utf8;
+}
+
+bool matchIndex(const SegmentHeader& header, const LogHandler::Filter& filter) {
+  if (header.records == 0) {
+    return false;
+  }
+
+  if (filter.m_to != 0 && header.firstTimestamp > filter.m_to) {
+    return false;
+  }
+
+  if (filter.m_from != 0 && header.lastTimestamp < filter.m_from) {
+    return false;
+  }
+
+  return (header.levels >> filter.m_minLogLevel) != 0;
+}
+
+}  // namespace
+
+LogStore::LogStore(const QString& path, quint32 segmentSize, int maxSegments)
+    : m_path(path), m_segmentSize(segmentSize), m_maxSegments(maxSegments) {
+  Q_ASSERT(segmentSize % RECORD_ALIGNMENT == 0);
+  Q_ASSERT(segmentSize > sizeof(SegmentHeader) + MAX_PAYLOAD_SIZE * 2);
+  Q_ASSERT(maxSegments > 0);
+}
+
+LogStore::~LogStore() { close(); }
+
+bool LogStore::open() {
+  Q_ASSERT(!m_file);
+
+  if (!QDir().mkpath(m_path)) {
+    return false;
+  }
+
+  QStringList segments = segmentFileNames(m_path);
+  if (!segments.isEmpty() &&
+      openSegment(QDir(m_path).filePath(segments.last()), false)) {
+    return true;
+  }
+
+  return rotate();
+}
+
+void LogStore::close() { closeSegment(); }
+
+bool LogStore::append(const LogHandler::Log& log) {
+  if (!m_map) {
+    return false;
+  }
+
+  quint8 type;
+  QString first;
+  QString second;
+  QByteArray payload;
+
+  if (log.m_fromQT) {
+    type = RecordQtLog;
+    first = log.m_file;
+    second = log.m_function;
+
+    qint32 line = log.m_line;
+    payload.append(reinterpret_cast<const char*>(&line), sizeof(line));
+    payload.append(truncatedUtf8(log.m_message));
+  } else {
+    type = RecordLog;
+    first = log.m_modules.join('|');
+    second = log.m_className;
+    payload = truncatedUtf8(log.m_message);
+  }
+
+  qint64 timestamp = log.m_dateTime.toMSecsSinceEpoch();
+
+  // A full segment is detected by one of the writes: retry once in a new one.
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    if (attempt > 0 && !rotate()) {
+      return false;
+    }
+
+    int firstId = stringId(first);
+    if (firstId < 0) {
+      continue;
+    }
+
+    int secondId = stringId(second);
+    if (secondId < 0) {
+      continue;
+    }
+
+    if (writeRecord(type, log.m_logLevel, firstId, secondId, timestamp,
+                    payload)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void LogStore::commit() {
+  if (!m_map) {
+    return;
+  }
+
+  // The records must be visible before the new size.
+  std::atomic_thread_fence(std::memory_order_release);
+  reinterpret_cast<SegmentHeader*>(m_map)->used = m_offset;
+}
+
+// static
+void LogStore::read(const QString& path, const LogHandler::Filter& filter,
+                    std::function<void(const LogHandler::Log&)>&& callback) {
+  QDir dir(path);
+
+  for (const QString& fileName : segmentFileNames(path)) {
+    // A segment deleted or recreated meanwhile is simply skipped.
+    QFile file(dir.filePath(fileName));
+    if (!file.open(QIODevice::ReadOnly) ||
+        file.size() < static_cast<qint64>(sizeof(SegmentHeader))) {
+      continue;
+    }
+
+    const uchar* map = file.map(0, file.size());
+    if (!map) {
+      continue;
+    }
+
+    SegmentHeader header;
+    memcpy(&header, map, sizeof(header));
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (header.magic != SEGMENT_MAGIC || header.version != SEGMENT_VERSION ||
+        !matchIndex(header, filter)) {
+      continue;
+    }
+
+    quint32 end = static_cast<quint32>(
+        qMin(static_cast<qint64>(header.used), file.size()));
+
+    QHash<quint16, QString> strings;
+    // Whether a module string matches the filter, by string id.
+    QHash<quint16, bool> modules;
+
+    quint32 offset = sizeof(SegmentHeader);
+    while (offset + sizeof(RecordHeader) <= end) {
+      RecordHeader record;
+      memcpy(&record, map + offset, sizeof(record));
+      if (record.size < sizeof(RecordHeader) || offset + record.size > end) {
+        break;
+      }
+
+      const char* payload =
+          reinterpret_cast<const char*>(map + offset + sizeof(RecordHeader));
+      int payloadSize = record.size - sizeof(RecordHeader);
+      offset += alignedSize(record.size);
+
+      if (record.type == RecordString) {
+        strings.insert(record.moduleId,
+                       QString::fromUtf8(payload, payloadSize));
+        continue;
+      }
+
+      if (record.level < filter.m_minLogLevel ||
+          (filter.m_from != 0 && record.timestamp < filter.m_from) ||
+          (filter.m_to != 0 && record.timestamp > filter.m_to)) {
+        continue;
+      }
+
+      LogHandler::Log log;
+      log.m_logLevel = static_cast<LogLevel>(record.level);
+      log.m_dateTime = QDateTime::fromMSecsSinceEpoch(record.timestamp);
+
+      if (record.type == RecordQtLog) {
+        qint32 line;
+        if (payloadSize < static_cast<int>(sizeof(line))) {
+          continue;
+        }
+        memcpy(&line, payload, sizeof(line));
+
+        // The Qt messages match any module filter, as when they are logged.
+        log.m_fromQT = true;
+        log.m_file = strings.value(record.moduleId);
+        log.m_function = strings.value(record.classId);
+        log.m_line = line;
+        log.m_message = QString::fromUtf8(payload + sizeof(line),
+                                          payloadSize - sizeof(line));
+        callback(log);
+        continue;
+      }
+
+      if (record.type != RecordLog) {
+        continue;
+      }
+
+      log.m_modules = strings.value(record.moduleId).split('|');
+
+      if (!filter.m_modules.isEmpty()) {
+        auto match = modules.find(record.moduleId);
+        if (match == modules.end()) {
+          bool found = false;
+          for (const QString& module : log.m_modules) {
+            if (filter.m_modules.contains(module)) {
+              found = true;
+              break;
+            }
+          }
+          match = modules.insert(record.moduleId, found);
+        }
+
+        if (!match.value()) {
+          continue;
+        }
+      }
+
+      log.m_className = strings.value(record.classId);
+      log.m_message = QString::fromUtf8(payload, payloadSize);
+      callback(log);
+    }
+  }
+}
+
+// static
+void LogStore::removeAll(const QString& path) {
+  QDir dir(path);
+  for (const QString& fileName : segmentFileNames(path)) {
+    dir.remove(fileName);
+  }
+}
+
+// static
+QStringList LogStore::segmentFileNames(const QString& path) {
+  // The zero-padded sequence numbers sort by name.
+  return QDir(path).entryList(
+      QStringList{QString("%1*%2").arg(SEGMENT_PREFIX, SEGMENT_SUFFIX)},
+      QDir::Files, QDir::Name);
+}
+
+bool LogStore::openSegment(const QString& fileName, bool create) {
+  Q_ASSERT(!m_file);
+
+  m_file = new QFile(fileName);
+  if (!m_file->open(QIODevice::ReadWrite)) {
+    closeSegment();
+    return false;
+  }
+
+  // A segment of another size is not resumed: a new one is created.
+  if (create ? !m_file->resize(m_segmentSize)
+             : m_file->size() != m_segmentSize) {
+    closeSegment();
+    return false;
+  }
+
+  m_map = m_file->map(0, m_segmentSize);
+  if (!m_map) {
+    closeSegment();
+    return false;
+  }
+
+  SegmentHeader* header = reinterpret_cast<SegmentHeader*>(m_map);
+
+  if (create) {
+    memset(header, 0, sizeof(SegmentHeader));
+    header->magic = SEGMENT_MAGIC;
+    header->version = SEGMENT_VERSION;
+    header->sequence = m_sequence;
+    header->used = sizeof(SegmentHeader);
+    m_offset = sizeof(SegmentHeader);
+    return true;
+  }
+
+  if (header->magic != SEGMENT_MAGIC || header->version != SEGMENT_VERSION ||
+      header->used < sizeof(SegmentHeader) || header->used > m_segmentSize) {
+    closeSegment();
+    return false;
+  }
+
+  m_sequence = header->sequence;
+
+  // Collect the string ids, and stop at the first damaged record.
+  m_offset = sizeof(SegmentHeader);
+  while (m_offset + sizeof(RecordHeader) <= header->used) {
+    RecordHeader record;
+    memcpy(&record, m_map + m_offset, sizeof(record));
+    if (record.size < sizeof(RecordHeader) ||
+        m_offset + record.size > header->used) {
+      break;
+    }
+
+    if (record.type == RecordString) {
+      const char* payload =
+          reinterpret_cast<const char*>(m_map + m_offset + sizeof(record));
+      m_stringIds.insert(
+          QString::fromUtf8(payload, record.size - sizeof(record)),
+          record.moduleId);
+    }
+
+    m_offset += alignedSize(record.size);
+  }
+
+  header->used = m_offset;
+  return true;
+}
+
+void LogStore::closeSegment() {
+  if (!m_file) {
+    return;
+  }
+
+  commit();
+
+  if (m_map) {
+    m_file->unmap(m_map);
+    m_map = nullptr;
+  }
+
+  delete m_file;
+  m_file = nullptr;
+  m_offset = 0;
+  m_stringIds.clear();
+}
+
+bool LogStore::rotate() {
+  quint64 sequence = m_file ? m_sequence + 1 : 0;
+  closeSegment();
+
+  QStringList segments = segmentFileNames(m_path);
+  if (!segments.isEmpty()) {
+    sequence = qMax(sequence, segmentSequence(segments.last()) + 1);
+  }
+
+  m_sequence = sequence;
+
+  QString fileName = segmentFileName(sequence);
+  if (!openSegment(QDir(m_path).filePath(fileName), true)) {
+    return false;
+  }
+
+  // A segment still mapped by a reader can fail to be deleted on Windows. It
+  // is retried at the next rotation.
+  segments.append(fileName);
+  QDir dir(m_path);
+  while (segments.length() > m_maxSegments) {
+    dir.remove(segments.takeFirst());
+  }
+
+  return true;
+}
+
+int LogStore::stringId(const QString& string) {
+  if (string.isEmpty()) {
+    return 0;
+  }
+
+  auto it = m_stringIds.constFind(string);
+  if (it != m_stringIds.constEnd()) {
+    return it.value();
+  }
+
+  if (m_stringIds.size() >= 0xFFFF) {
+    return -1;
+  }
+
+  quint16 id = static_cast<quint16>(m_stringIds.size() + 1);
+  if (!writeRecord(RecordString, 0, id, 0, 0, truncatedUtf8(string))) {
+    return -1;
+  }
+
+  m_stringIds.insert(string, id);
+  return id;
+}
+
+bool LogStore::writeRecord(quint8 type, quint8 level, quint16 moduleId,
+                           quint16 classId, qint64 timestamp,
+                           const QByteArray& payload) {
+  quint32 size = sizeof(RecordHeader) + payload.length();
+  if (alignedSize(size) > freeSpace()) {
+    return false;
+  }
+
+  RecordHeader record;
+  record.size = static_cast<quint16>(size);
+  record.type = type;
+  record.level = level;
+  record.moduleId = moduleId;
+  record.classId = classId;
+  record.timestamp = timestamp;
+
+  memcpy(m_map + m_offset, &record, sizeof(record));
+  memcpy(m_map + m_offset + sizeof(record), payload.constData(),
+         payload.length());
+  m_offset += alignedSize(size);
+
+  if (type != RecordString) {
+    SegmentHeader* header = reinterpret_cast<SegmentHeader*>(m_map);
+    if (header->records == 0) {
+      header->firstTimestamp = timestamp;
+    }
+    header->lastTimestamp = timestamp;
+    header->levels |= 1u << level;
+    header->records++;
+  }
+
+  return true;
+}
+
+quint32 LogStore::freeSpace() const { return m_segmentSize - m_offset; }
@@ -0,0 +1,87 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef LOGSTORE_H
+#define LOGSTORE_H
+
+#include "loghandler.h"
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+#include <functional>
+
+class QFile;
+
+// Binary log storage made of fixed-size, memory-mapped segment files. When
+// the current segment is full, a new one is created and the oldest ones are
+// deleted, so that only the last `maxSegments` segments are kept.
+//
+// Each segment starts with a header carrying a small index (time range and
+// levels of its records), followed by records made of a 16 bytes header
+// (size, type, level, module id, class id, timestamp) and a UTF-8 payload.
+// Module and class names are stored once per segment, as string records, and
+// referenced by id: a segment can be read without the other ones.
+//
+// The store is written by a single thread. Reading only needs the directory
+// and never touches the writer state, so the logs can be exported without
+// blocking it.
+class LogStore final {
+  Q_DISABLE_COPY_MOVE(LogStore)
+
+ public:
+  LogStore(const QString& path, quint32 segmentSize, int maxSegments);
+  ~LogStore();
+
+  const QString& path() const { return m_path; }
+
+  // Opens the newest segment, or creates the first one.
+  bool open();
+
+  void close();
+
+  bool append(const LogHandler::Log& log);
+
+  // Makes the records appended since the previous call visible to readers.
+  void commit();
+
+  // Calls `callback` for each stored line matching `filter`, oldest first.
+  static void read(const QString& path, const LogHandler::Filter& filter,
+                   std::function<void(const LogHandler::Log&)>&& callback);
+
+  // Deletes all the segments. The store of this path must be closed.
+  static void removeAll(const QString& path);
+
+ private:
+  static QStringList segmentFileNames(const QString& path);
+
+  bool openSegment(const QString& fileName, bool create);
+  void closeSegment();
+  bool rotate();
+
+  // Returns the id of the string in the current segment, writing it first if
+  // needed: 0 for an empty string, -1 if the segment is full.
+  int stringId(const QString& string);
+
+  bool writeRecord(quint8 type, quint8 level, quint16 moduleId,
+                   quint16 classId, qint64 timestamp,
+                   const QByteArray& payload);
+
+  quint32 freeSpace() const;
+
+ private:
+  const QString m_path;
+  const quint32 m_segmentSize;
+  const int m_maxSegments;
+
+  QFile* m_file = nullptr;
+  uchar* m_map = nullptr;
+  quint32 m_offset = 0;
+  quint64 m_sequence = 0;
+
+  QHash<QString, quint16> m_stringIds;
+};
+
+#endif  // LOGSTORE_H
@@ -49,6 +49,8 @@ class Server final {
   }
 
  private:
+  friend class ServerListSnapshot;
+
   QString m_hostname;
   QString m_ipv4AddrIn;
   QString m_ipv4Gateway;
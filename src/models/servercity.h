@@ -32,6 +32,8 @@ class ServerCity final {
   const QList<Server> servers() const { return m_servers; }
 
  private:
+  friend class ServerListSnapshot;
+
   QString m_name;
   QString m_code;
   double m_latitude;
@@ -33,6 +33,8 @@ class ServerCountry final {
   void sortCities();
 
  private:
+  friend class ServerListSnapshot;
+
   QString m_name;
   QString m_code;
 
@@ -4,23 +4,25 @@
 
 #include "servercountrymodel.h"
 #include "collator.h"
+#include "jsonstreamparser.h"
 #include "leakdetector.h"
 #include "logger.h"
 #include "servercountry.h"
 #include "serverdata.h"
 #include "serveri18n.h"
+#include "serverlistsnapshot.h"
 #include "settingsholder.h"
 
-#include <QJsonArray>
-#include <QJsonDocument>
 #include <QJsonObject>
+#include <QJsonValue>
 #include <QRandomGenerator>
 
 namespace {
 Logger logger(LOG_MODEL, "ServerCountryModel");
 }
 
-ServerCountryModel::ServerCountryModel() {
+ServerCountryModel::ServerCountryModel()
+    : m_snapshotFileName(ServerListSnapshot::defaultFileName()) {
   MVPN_COUNT_CTOR(ServerCountryModel);
 }
 
@@ -35,15 +37,30 @@ bool ServerCountryModel::fromSettings() {
   logger.debug() << "Reading the server list from settings";
 
   const QByteArray json = settingsHolder->servers();
-  if (json.isEmpty() || !fromJsonInternal(json)) {
+  if (json.isEmpty()) {
     return false;
   }
 
+  QList<ServerCountry> countries;
+  if (ServerListSnapshot::load(m_snapshotFileName, json, countries)) {
+    logger.debug() << "Server list loaded from the snapshot";
+  } else {
+    if (!parseJson(json, countries)) {
+      return false;
+    }
+
+    ServerListSnapshot::save(m_snapshotFileName, json, countries);
+  }
+
+  sortCountries(countries);
+  updateCountries(countries);
+
   m_rawJson = json;
   return true;
 }
 
-bool ServerCountryModel::fromJson(const QByteArray& s) {
+bool ServerCountryModel::fromJson(const QByteArray& s,
+                                  QList<ServerCountry>* parsedCountries) {
   logger.debug() << "Reading from JSON";
 
   if (!s.isEmpty() && m_rawJson == s) {
@@ -51,53 +68,194 @@ bool ServerCountryModel::fromJson(const QByteArray& s) {
     return true;
   }
 
-  if (!fromJsonInternal(s)) {
+  QList<ServerCountry> countries;
+  if (parsedCountries) {
+    countries.swap(*parsedCountries);
+  } else if (!parseJson(s, countries)) {
     return false;
   }
 
+  ServerListSnapshot::save(m_snapshotFileName, s, countries);
+
+  sortCountries(countries);
+  updateCountries(countries);
+
   m_rawJson = s;
   return true;
 }
 
-bool ServerCountryModel::fromJsonInternal(const QByteArray& s) {
-  beginResetModel();
+// static
+bool ServerCountryModel::parseJson(const QByteArray& s,
+                                   QList<ServerCountry>& countries) {
+  // Only one country at a time is turned into a QJsonObject.
+  JsonStreamParser parser("countries", [&countries](const QJsonValue& value) {
+    return parseCountry(value, countries);
+  });
 
-  m_rawJson = "";
-  m_countries.clear();
+  return parser.feed(s) && parser.isComplete() && parser.hasArray();
+}
 
-  QJsonDocument doc = QJsonDocument::fromJson(s);
-  if (!doc.isObject()) {
+// static
+bool ServerCountryModel::parseCountry(const QJsonValue& value,
+                                      QList<ServerCountry>& countries) {
+  if (!value.isObject()) {
     return false;
   }
 
-  QJsonObject obj = doc.object();
-
-  QJsonValue countries = obj.value("countries");
-  if (!countries.isArray()) {
+  ServerCountry country;
+  if (!country.fromJson(value.toObject())) {
     return false;
   }
 
-  QJsonArray countriesArray = countries.toArray();
-  for (QJsonValue countryValue : countriesArray) {
-    if (!countryValue.isObject()) {
-      return false;
+  countries.append(country);
+  return true;
+}
+
+void ServerCountryModel::updateCountries(QList<ServerCountry>& countries) {
+  QHash<QString, int> newIndex;
+  for (int i = 0; i < countries.length(); ++i) {
+    newIndex.insert(countries.at(i).code(), i);
+  }
+
+  // Rows are matched by country code. Duplicated codes, or countries which
+  // changed their relative order (a renamed country, for instance), are not
+  // worth a diff: reset the whole model.
+  bool reset = newIndex.size() != countries.length() ||
+               m_countryIndex.size() != m_countries.length();
+
+  int lastRow = -1;
+  for (int i = 0; !reset && i < m_countries.length(); ++i) {
+    auto it = newIndex.constFind(m_countries.at(i).code());
+    if (it == newIndex.constEnd()) {
+      continue;
     }
 
-    QJsonObject countryObj = countryValue.toObject();
+    reset = it.value() < lastRow;
+    lastRow = it.value();
+  }
 
-    ServerCountry country;
-    if (!country.fromJson(countryObj)) {
-      return false;
+  if (reset) {
+    beginResetModel();
+    m_countries.swap(countries);
+    rebuildIndexes();
+    endResetModel();
+
+    emit serversChanged();
+    return;
+  }
+
+  bool changed = false;
+
+  // Removed countries, in contiguous blocks from the bottom.
+  for (int last = m_countries.length() - 1; last >= 0; --last) {
+    if (newIndex.contains(m_countries.at(last).code())) {
+      continue;
     }
 
-    m_countries.append(country);
+    int first = last;
+    while (first > 0 && !newIndex.contains(m_countries.at(first - 1).code())) {
+      --first;
+    }
+
+    beginRemoveRows(QModelIndex(), first, last);
+    m_countries.erase(m_countries.begin() + first,
+                      m_countries.begin() + last + 1);
+    endRemoveRows();
+
+    changed = true;
+    last = first;
   }
 
-  sortCountries();
+  // The remaining countries are in the same order as the new ones: what does
+  // not match is a block of new countries. m_countryIndex still refers to the
+  // previous list here.
+  for (int first = 0; first < countries.length(); ++first) {
+    if (first < m_countries.length() &&
+        m_countries.at(first).code() == countries.at(first).code()) {
+      continue;
+    }
 
-  endResetModel();
+    int last = first;
+    while (last + 1 < countries.length() &&
+           !m_countryIndex.contains(countries.at(last + 1).code())) {
+      ++last;
+    }
 
-  return true;
+    beginInsertRows(QModelIndex(), first, last);
+    for (int i = first; i <= last; ++i) {
+      m_countries.insert(i, countries.at(i));
+    }
+    endInsertRows();
+
+    changed = true;
+    first = last;
+  }
+
+  Q_ASSERT(m_countries.length() == countries.length());
+
+  for (int i = 0; i < countries.length(); ++i) {
+    if (!ServerListSnapshot::identical(m_countries.at(i), countries.at(i))) {
+      m_countries[i] = countries.at(i);
+
+      QModelIndex modelIndex = index(i, 0);
+      emit dataChanged(modelIndex, modelIndex);
+      changed = true;
+    }
+  }
+
+  rebuildIndexes();
+
+  if (changed) {
+    emit serversChanged();
+  }
+}
+
+void ServerCountryModel::rebuildIndexes() {
+  m_countryIndex.clear();
+  m_cityNameIndex.clear();
+  m_cityCodeIndex.clear();
+  m_publicKeyIndex.clear();
+
+  for (int row = 0; row < m_countries.length(); ++row) {
+    const ServerCountry& country = m_countries.at(row);
+    if (m_countryIndex.contains(country.code())) {
+      continue;
+    }
+
+    m_countryIndex.insert(country.code(), row);
+
+    const QList<ServerCity>& cities = country.cities();
+    for (int i = 0; i < cities.length(); ++i) {
+      const ServerCity& city = cities.at(i);
+      QPair<int, int> position(row, i);
+
+      CityKey nameKey(country.code(), city.name());
+      if (!m_cityNameIndex.contains(nameKey)) {
+        m_cityNameIndex.insert(nameKey, position);
+      }
+
+      CityKey codeKey(country.code(), city.code());
+      if (!m_cityCodeIndex.contains(codeKey)) {
+        m_cityCodeIndex.insert(codeKey, position);
+      }
+
+      for (const Server& server : city.servers()) {
+        if (!m_publicKeyIndex.contains(server.publicKey())) {
+          m_publicKeyIndex.insert(server.publicKey(), position);
+        }
+      }
+    }
+  }
+}
+
+const ServerCity* ServerCountryModel::findCity(const QString& countryCode,
+                                               const QString& cityName) const {
+  auto it = m_cityNameIndex.constFind(CityKey(countryCode, cityName));
+  if (it == m_cityNameIndex.constEnd()) {
+    return nullptr;
+  }
+
+  return &m_countries.at(it.value().first).cities().at(it.value().second);
 }
 
 QHash<int, QByteArray> ServerCountryModel::roleNames() const {
@@ -151,19 +309,14 @@ bool ServerCountryModel::pickIfExists(const QString& countryCode,
                                       ServerData& data) const {
   logger.debug() << "Checking if the server exists" << countryCode << cityCode;
 
-  for (const ServerCountry& country : m_countries) {
-    if (country.code() == countryCode) {
-      for (const ServerCity& city : country.cities()) {
-        if (city.code() == cityCode) {
-          data.update(country.code(), city.name());
-          return true;
-        }
-      }
-      break;
-    }
+  auto it = m_cityCodeIndex.constFind(CityKey(countryCode, cityCode));
+  if (it == m_cityCodeIndex.constEnd()) {
+    return false;
   }
 
-  return false;
+  const ServerCountry& country = m_countries.at(it.value().first);
+  data.update(country.code(), country.cities().at(it.value().second).name());
+  return true;
 }
 
 QStringList ServerCountryModel::pickRandom() {
@@ -218,44 +371,43 @@ bool ServerCountryModel::pickByIPv4Address(const QString& ipv4Address,
   return false;
 }
 
+bool ServerCountryModel::pickByPublicKey(const QString& publicKey,
+                                         ServerData& data) const {
+  auto it = m_publicKeyIndex.constFind(publicKey);
+  if (it == m_publicKeyIndex.constEnd()) {
+    return false;
+  }
+
+  const ServerCountry& country = m_countries.at(it.value().first);
+  data.update(country.code(), country.cities().at(it.value().second).name());
+  return true;
+}
+
 bool ServerCountryModel::exists(ServerData& data) const {
   logger.debug() << "Check if the server is still valid.";
   Q_ASSERT(data.initialized());
 
-  for (const ServerCountry& country : m_countries) {
-    if (country.code() == data.exitCountryCode()) {
-      for (const ServerCity& city : country.cities()) {
-        if (data.exitCityName() == city.name()) {
-          return true;
-        }
-      }
-
-      break;
-    }
-  }
-
-  return false;
+  return findCity(data.exitCountryCode(), data.exitCityName()) != nullptr;
 }
 
 const QList<Server> ServerCountryModel::servers(const ServerData& data) const {
-  for (const ServerCountry& country : m_countries) {
-    if (country.code() == data.exitCountryCode()) {
-      return country.servers(data);
-    }
+  const ServerCity* city =
+      findCity(data.exitCountryCode(), data.exitCityName());
+  if (!city) {
+    return QList<Server>();
   }
 
-  return QList<Server>();
+  return city->servers();
 }
 
 const QString ServerCountryModel::countryName(
     const QString& countryCode) const {
-  for (const ServerCountry& country : m_countries) {
-    if (country.code() == countryCode) {
-      return country.name();
-    }
+  auto it = m_countryIndex.constFind(countryCode);
+  if (it == m_countryIndex.constEnd()) {
+    return QString();
   }
 
-  return QString();
+  return m_countries.at(it.value()).name();
 }
 
 const QString ServerCountryModel::localizedCountryName(
@@ -266,7 +418,8 @@ const QString ServerCountryModel::localizedCountryName(
 
 void ServerCountryModel::retranslate() {
   beginResetModel();
-  sortCountries();
+  sortCountries(m_countries);
+  rebuildIndexes();
   endResetModel();
 }
 
@@ -282,13 +435,14 @@ bool sortCountryCallback(const ServerCountry& a, const ServerCountry& b,
 
 }  // anonymous namespace
 
-void ServerCountryModel::sortCountries() {
+// static
+void ServerCountryModel::sortCountries(QList<ServerCountry>& countries) {
   Collator collator;
-  std::sort(m_countries.begin(), m_countries.end(),
+  std::sort(countries.begin(), countries.end(),
             std::bind(sortCountryCallback, std::placeholders::_1,
                       std::placeholders::_2, &collator));
 
-  for (ServerCountry& country : m_countries) {
+  for (ServerCountry& country : countries) {
     country.sortCities();
   }
 }
@@ -9,7 +9,10 @@
 
 #include <QAbstractListModel>
 #include <QByteArray>
+#include <QHash>
+#include <QJsonValue>
 #include <QObject>
+#include <QPair>
 
 class ServerData;
 
@@ -30,10 +33,23 @@ class ServerCountryModel final : public QAbstractListModel {
 
   [[nodiscard]] bool fromSettings();
 
-  [[nodiscard]] bool fromJson(const QByteArray& data);
+  // `parsedCountries`, if set, is the list already parsed from `data` by a
+  // streaming parser (see parseCountry()).
+  [[nodiscard]] bool fromJson(const QByteArray& data,
+                              QList<ServerCountry>* parsedCountries = nullptr);
+
+  // Record callback for a JsonStreamParser of the "countries" array.
+  [[nodiscard]] static bool parseCountry(const QJsonValue& value,
+                                         QList<ServerCountry>& countries);
 
   bool initialized() const { return !m_rawJson.isEmpty(); }
 
+  // Where the binary snapshot of the server list is kept (see
+  // ServerListSnapshot). An empty name disables the snapshot.
+  void setSnapshotFileName(const QString& fileName) {
+    m_snapshotFileName = fileName;
+  }
+
   Q_INVOKABLE QStringList pickRandom();
 
   void pickRandom(ServerData& data) const;
@@ -44,6 +60,8 @@ class ServerCountryModel final : public QAbstractListModel {
   // For windows data migration.
   bool pickByIPv4Address(const QString& ipv4Address, ServerData& data) const;
 
+  bool pickByPublicKey(const QString& publicKey, ServerData& data) const;
+
   bool exists(ServerData& data) const;
 
   const QList<Server> servers(const ServerData& data) const;
@@ -66,15 +84,36 @@ class ServerCountryModel final : public QAbstractListModel {
 
   QVariant data(const QModelIndex& index, int role) const override;
 
+ signals:
+  // Emitted when the list of servers has actually changed.
+  void serversChanged();
+
  private:
-  [[nodiscard]] bool fromJsonInternal(const QByteArray& data);
+  [[nodiscard]] static bool parseJson(const QByteArray& data,
+                                      QList<ServerCountry>& countries);
 
-  void sortCountries();
+  static void sortCountries(QList<ServerCountry>& countries);
+
+  void updateCountries(QList<ServerCountry>& countries);
+
+  void rebuildIndexes();
+
+  const ServerCity* findCity(const QString& countryCode,
+                             const QString& cityName) const;
 
  private:
   QByteArray m_rawJson;
+  QString m_snapshotFileName;
 
   QList<ServerCountry> m_countries;
+
+  // Positions (country row, city) in m_countries. When a country code is
+  // repeated, only the first country is indexed, as a linear search would do.
+  typedef QPair<QString, QString> CityKey;
+  QHash<QString, int> m_countryIndex;
+  QHash<CityKey, QPair<int, int>> m_cityNameIndex;
+  QHash<CityKey, QPair<int, int>> m_cityCodeIndex;
+  QHash<QString, QPair<int, int>> m_publicKeyIndex;
 };
 
 #endif  // SERVERCOUNTRYMODEL_H
@@ -0,0 +1,464 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "serverlistsnapshot.h"
+#include "logger.h"
+#include "server.h"
+#include "servercity.h"
+#include "servercountry.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QVector>
+#include <QtEndian>
+
+#include <cstring>
+
+constexpr const char* SNAPSHOT_FILENAME = "servers.bin";
+
+// "MVSL" - the byte order of the writer is the only one accepted.
+constexpr quint32 SNAPSHOT_MAGIC = 0x4d56534c;
+constexpr quint32 SNAPSHOT_VERSION = 1;
+
+constexpr int SNAPSHOT_HASH_SIZE = 32;
+
+namespace {
+Logger logger(LOG_MODEL, "ServerListSnapshot");
+
+// All the records have a size multiple of 8 bytes: the sections stay aligned
+// and the string pool can be read in place.
+
+struct Header {
+  quint32 magic;
+  quint32 version;
+  char hash[SNAPSHOT_HASH_SIZE];
+  quint32 stringCount;
+  quint32 countryCount;
+  quint32 cityCount;
+  quint32 serverCount;
+  quint32 portRangeCount;
+  // Size of the string pool, in UTF-16 code units.
+  quint32 poolSize;
+};
+
+struct StringRecord {
+  quint32 offset;
+  quint32 length;
+};
+
+struct CountryRecord {
+  quint32 name;
+  quint32 code;
+  quint32 firstCity;
+  quint32 cityCount;
+};
+
+struct CityRecord {
+  double latitude;
+  double longitude;
+  quint32 name;
+  quint32 code;
+  quint32 firstServer;
+  quint32 serverCount;
+};
+
+struct ServerRecord {
+  quint32 hostname;
+  quint32 ipv4AddrIn;
+  quint32 ipv4Gateway;
+  quint32 ipv6AddrIn;
+  quint32 ipv6Gateway;
+  quint32 publicKey;
+  quint32 socksName;
+  quint32 weight;
+  quint32 multihopPort;
+  quint32 firstPortRange;
+  quint32 portRangeCount;
+  quint32 reserved;
+};
+
+struct PortRangeRecord {
+  quint32 first;
+  quint32 last;
+};
+
+static_assert(sizeof(Header) % 8 == 0, "Unaligned snapshot header");
+static_assert(sizeof(StringRecord) % 8 == 0, "Unaligned string record");
+static_assert(sizeof(CountryRecord) % 8 == 0, "Unaligned country record");
+static_assert(sizeof(CityRecord) % 8 == 0, "Unaligned city record");
+static_assert(sizeof(ServerRecord) % 8 == 0, "Unaligned server record");
+static_assert(sizeof(PortRangeRecord) % 8 == 0, "Unaligned port record");
+
+QByteArray hashJson(const QByteArray& json) {
+  return QCryptographicHash::hash(json, QCryptographicHash::Sha256);
+}
+
+class StringTable final {
+ public:
+  quint32 intern(const QString& string) {
+    auto i = m_index.constFind(string);
+    if (i != m_index.constEnd()) {
+      return i.value();
+    }
+
+    quint32 id = m_records.length();
+    m_records.append({static_cast<quint32>(m_pool.length()),
+                      static_cast<quint32>(string.length())});
+    m_pool.append(string);
+    m_index.insert(string, id);
+    return id;
+  }
+
+  const QVector<StringRecord>& records() const { return m_records; }
+
+  // Padded to keep the file size a multiple of 8 bytes.
+  QString pool() const {
+    QString pool = m_pool;
+    while (pool.length() % 4) {
+      pool.append(QChar());
+    }
+    return pool;
+  }
+
+ private:
+  QHash<QString, quint32> m_index;
+  QVector<StringRecord> m_records;
+  QString m_pool;
+};
+
+template <typename T>
+void appendRecords(QByteArray& out, const QVector<T>& records) {
+  out.append(reinterpret_cast<const char*>(records.constData()),
+             records.length() * static_cast<int>(sizeof(T)));
+}
+
+template <typename T>
+T readRecord(const uchar* section, quint32 index) {
+  return qFromUnaligned<T>(section + index * sizeof(T));
+}
+
+bool validRange(quint32 first, quint32 count, quint32 total) {
+  return first <= total && count <= total - first;
+}
+
+}  // namespace
+
+// static
+QString ServerListSnapshot::defaultFileName() {
+  QString path =
+      QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+  if (path.isEmpty()) {
+    return QString();
+  }
+
+  return QDir(path).filePath(SNAPSHOT_FILENAME);
+}
+
+// static
+bool ServerListSnapshot::load(const QString& fileName, const QByteArray& json,
+                              QList<ServerCountry>& countries) {
+  if (fileName.isEmpty()) {
+    return false;
+  }
+
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+
+  qint64 size = file.size();
+  uchar* data = file.map(0, size);
+  if (!data) {
+    logger.warning() << "Unable to map the server snapshot";
+    return false;
+  }
+
+  bool ok = deserialize(data, size, json, countries);
+  file.unmap(data);
+
+  if (!ok) {
+    logger.debug() << "The server snapshot is outdated or corrupted";
+  }
+  return ok;
+}
+
+// static
+bool ServerListSnapshot::save(const QString& fileName, const QByteArray& json,
+                              const QList<ServerCountry>& countries) {
+  if (fileName.isEmpty()) {
+    return false;
+  }
+
+  QDir().mkpath(QFileInfo(fileName).absolutePath());
+
+  QSaveFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly)) {
+    logger.warning() << "Unable to write the server snapshot";
+    return false;
+  }
+
+  file.write(serialize(countries, json));
+  return file.commit();
+}
+
+// static
+QByteArray ServerListSnapshot::serialize(const QList<ServerCountry>& countries,
+                                         const QByteArray& json) {
+  StringTable strings;
+  QVector<CountryRecord> countryRecords;
+  QVector<CityRecord> cityRecords;
+  QVector<ServerRecord> serverRecords;
+  QVector<PortRangeRecord> portRangeRecords;
+
+  countryRecords.reserve(countries.length());
+
+  for (const ServerCountry& country : countries) {
+    countryRecords.append({strings.intern(country.m_name),
+                           strings.intern(country.m_code),
+                           static_cast<quint32>(cityRecords.length()),
+                           static_cast<quint32>(country.m_cities.length())});
+
+    for (const ServerCity& city : country.m_cities) {
+      cityRecords.append({city.m_latitude, city.m_longitude,
+                          strings.intern(city.m_name),
+                          strings.intern(city.m_code),
+                          static_cast<quint32>(serverRecords.length()),
+                          static_cast<quint32>(city.m_servers.length())});
+
+      for (const Server& server : city.m_servers) {
+        serverRecords.append(
+            {strings.intern(server.m_hostname),
+             strings.intern(server.m_ipv4AddrIn),
+             strings.intern(server.m_ipv4Gateway),
+             strings.intern(server.m_ipv6AddrIn),
+             strings.intern(server.m_ipv6Gateway),
+             strings.intern(server.m_publicKey),
+             strings.intern(server.m_socksName), server.m_weight,
+             server.m_multihopPort,
+             static_cast<quint32>(portRangeRecords.length()),
+             static_cast<quint32>(server.m_portRanges.length()), 0});
+
+        for (const QPair<uint32_t, uint32_t>& range : server.m_portRanges) {
+          portRangeRecords.append({range.first, range.second});
+        }
+      }
+    }
+  }
+
+  QString pool = strings.pool();
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  header.magic = SNAPSHOT_MAGIC;
+  header.version = SNAPSHOT_VERSION;
+  QByteArray hash = hashJson(json);
+  Q_ASSERT(hash.length() == SNAPSHOT_HASH_SIZE);
+  memcpy(header.hash, hash.constData(), SNAPSHOT_HASH_SIZE);
+  header.stringCount = strings.records().length();
+  header.countryCount = countryRecords.length();
+  header.cityCount = cityRecords.length();
+  header.serverCount = serverRecords.length();
+  header.portRangeCount = portRangeRecords.length();
+  header.poolSize = pool.length();
+
+  QByteArray out;
+  out.reserve(sizeof(Header) +
+              strings.records().length() * sizeof(StringRecord) +
+              countryRecords.length() * sizeof(CountryRecord) +
+              cityRecords.length() * sizeof(CityRecord) +
+              serverRecords.length() * sizeof(ServerRecord) +
+              portRangeRecords.length() * sizeof(PortRangeRecord) +
+              pool.length() * sizeof(QChar));
+
+  out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  appendRecords(out, strings.records());
+  appendRecords(out, countryRecords);
+  appendRecords(out, cityRecords);
+  appendRecords(out, serverRecords);
+  appendRecords(out, portRangeRecords);
+  out.append(reinterpret_cast<const char*>(pool.constData()),
+             pool.length() * static_cast<int>(sizeof(QChar)));
+
+  return out;
+}
+
+// static
+bool ServerListSnapshot::deserialize(const uchar* data, qint64 size,
+                                     const QByteArray& json,
+                                     QList<ServerCountry>& countries) {
+  if (size < static_cast<qint64>(sizeof(Header))) {
+    return false;
+  }
+
+  Header header = qFromUnaligned<Header>(data);
+  if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION) {
+    return false;
+  }
+
+  if (hashJson(json) != QByteArray::fromRawData(header.hash,
+                                                 SNAPSHOT_HASH_SIZE)) {
+    return false;
+  }
+
+  quint64 expectedSize =
+      sizeof(Header) + quint64(header.stringCount) * sizeof(StringRecord) +
+      quint64(header.countryCount) * sizeof(CountryRecord) +
+      quint64(header.cityCount) * sizeof(CityRecord) +
+      quint64(header.serverCount) * sizeof(ServerRecord) +
+      quint64(header.portRangeCount) * sizeof(PortRangeRecord) +
+      quint64(header.poolSize) * sizeof(QChar);
+  if (expectedSize != static_cast<quint64>(size)) {
+    return false;
+  }
+
+  const uchar* strings = data + sizeof(Header);
+  const uchar* countryData =
+      strings + header.stringCount * sizeof(StringRecord);
+  const uchar* cityData =
+      countryData + header.countryCount * sizeof(CountryRecord);
+  const uchar* serverData = cityData + header.cityCount * sizeof(CityRecord);
+  const uchar* portRangeData =
+      serverData + header.serverCount * sizeof(ServerRecord);
+  const uchar* poolData =
+      portRangeData + header.portRangeCount * sizeof(PortRangeRecord);
+
+  // The pool is 8-byte aligned, as the mapping and all the records before it.
+  const QChar* pool = reinterpret_cast<const QChar*>(poolData);
+
+  // Each distinct string is copied once here. The objects below share them.
+  QVector<QString> stringTable;
+  stringTable.reserve(header.stringCount);
+  for (quint32 i = 0; i < header.stringCount; ++i) {
+    StringRecord record = readRecord<StringRecord>(strings, i);
+    if (!validRange(record.offset, record.length, header.poolSize)) {
+      return false;
+    }
+    stringTable.append(QString(pool + record.offset, record.length));
+  }
+
+  bool ok = true;
+  auto string = [&](quint32 id) -> QString {
+    if (id >= header.stringCount) {
+      ok = false;
+      return QString();
+    }
+    return stringTable.at(id);
+  };
+
+  QList<ServerCountry> list;
+  list.reserve(header.countryCount);
+
+  for (quint32 i = 0; i < header.countryCount; ++i) {
+    CountryRecord countryRecord = readRecord<CountryRecord>(countryData, i);
+    if (!validRange(countryRecord.firstCity, countryRecord.cityCount,
+                    header.cityCount)) {
+      return false;
+    }
+
+    ServerCountry country;
+    country.m_name = string(countryRecord.name);
+    country.m_code = string(countryRecord.code);
+    country.m_cities.reserve(countryRecord.cityCount);
+
+    for (quint32 j = 0; j < countryRecord.cityCount; ++j) {
+      CityRecord cityRecord =
+          readRecord<CityRecord>(cityData, countryRecord.firstCity + j);
+      if (!validRange(cityRecord.firstServer, cityRecord.serverCount,
+                      header.serverCount)) {
+        return false;
+      }
+
+      ServerCity city;
+      city.m_name = string(cityRecord.name);
+      city.m_code = string(cityRecord.code);
+      city.m_latitude = cityRecord.latitude;
+      city.m_longitude = cityRecord.longitude;
+      city.m_servers.reserve(cityRecord.serverCount);
+
+      for (quint32 k = 0; k < cityRecord.serverCount; ++k) {
+        ServerRecord serverRecord =
+            readRecord<ServerRecord>(serverData, cityRecord.firstServer + k);
+        if (!validRange(serverRecord.firstPortRange,
+                        serverRecord.portRangeCount, header.portRangeCount)) {
+          return false;
+        }
+
+        Server server;
+        server.m_hostname = string(serverRecord.hostname);
+        server.m_ipv4AddrIn = string(serverRecord.ipv4AddrIn);
+        server.m_ipv4Gateway = string(serverRecord.ipv4Gateway);
+        server.m_ipv6AddrIn = string(serverRecord.ipv6AddrIn);
+        server.m_ipv6Gateway = string(serverRecord.ipv6Gateway);
+        server.m_publicKey = string(serverRecord.publicKey);
+        server.m_socksName = string(serverRecord.socksName);
+        server.m_weight = serverRecord.weight;
+        server.m_multihopPort = serverRecord.multihopPort;
+
+        for (quint32 p = 0; p < serverRecord.portRangeCount; ++p) {
+          PortRangeRecord range = readRecord<PortRangeRecord>(
+              portRangeData, serverRecord.firstPortRange + p);
+          server.m_portRanges.append(
+              QPair<uint32_t, uint32_t>(range.first, range.last));
+        }
+
+        city.m_servers.append(server);
+      }
+
+      country.m_cities.append(city);
+    }
+
+    list.append(country);
+  }
+
+  if (!ok) {
+    return false;
+  }
+
+  countries.swap(list);
+  return true;
+}
+
+// static
+bool ServerListSnapshot::identical(const ServerCountry& a,
+                                   const ServerCountry& b) {
+  if (a.m_name != b.m_name || a.m_code != b.m_code ||
+      a.m_cities.length() != b.m_cities.length()) {
+    return false;
+  }
+
+  for (int i = 0; i < a.m_cities.length(); ++i) {
+    const ServerCity& cityA = a.m_cities.at(i);
+    const ServerCity& cityB = b.m_cities.at(i);
+    if (cityA.m_name != cityB.m_name || cityA.m_code != cityB.m_code ||
+        cityA.m_latitude != cityB.m_latitude ||
+        cityA.m_longitude != cityB.m_longitude ||
+        cityA.m_servers.length() != cityB.m_servers.length()) {
+      return false;
+    }
+
+    for (int j = 0; j < cityA.m_servers.length(); ++j) {
+      const Server& serverA = cityA.m_servers.at(j);
+      const Server& serverB = cityB.m_servers.at(j);
+      if (serverA.m_hostname != serverB.m_hostname ||
+          serverA.m_ipv4AddrIn != serverB.m_ipv4AddrIn ||
+          serverA.m_ipv4Gateway != serverB.m_ipv4Gateway ||
+          serverA.m_ipv6AddrIn != serverB.m_ipv6AddrIn ||
+          serverA.m_ipv6Gateway != serverB.m_ipv6Gateway ||
+          serverA.m_portRanges != serverB.m_portRanges ||
+          serverA.m_publicKey != serverB.m_publicKey ||
+          serverA.m_socksName != serverB.m_socksName ||
+          serverA.m_weight != serverB.m_weight ||
+          serverA.m_multihopPort != serverB.m_multihopPort) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
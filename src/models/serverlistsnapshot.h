@@ -0,0 +1,45 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef SERVERLISTSNAPSHOT_H
+#define SERVERLISTSNAPSHOT_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+class ServerCountry;
+
+// Compact binary copy of the server list, stored next to the settings so that
+// the startup can skip the JSON parsing. The file is memory-mapped and made of
+// fixed-size records (countries, cities, servers and port ranges) which refer
+// to each other by index, plus a table of interned UTF-16 strings: every
+// distinct string is materialized once and then shared by all the objects
+// using it.
+//
+// The snapshot stores the hash of the JSON it has been generated from, and it
+// is ignored if the JSON in the settings is not the same anymore.
+class ServerListSnapshot final {
+ public:
+  static QString defaultFileName();
+
+  [[nodiscard]] static bool load(const QString& fileName,
+                                 const QByteArray& json,
+                                 QList<ServerCountry>& countries);
+
+  static bool save(const QString& fileName, const QByteArray& json,
+                   const QList<ServerCountry>& countries);
+
+  static QByteArray serialize(const QList<ServerCountry>& countries,
+                              const QByteArray& json);
+
+  [[nodiscard]] static bool deserialize(const uchar* data, qint64 size,
+                                        const QByteArray& json,
+                                        QList<ServerCountry>& countries);
+
+  // Deep comparison, used to compute the changes between two server lists.
+  static bool identical(const ServerCountry& a, const ServerCountry& b);
+};
+
+#endif  // SERVERLISTSNAPSHOT_H
@@ -19,6 +19,7 @@
 #include "logoutobserver.h"
 #include "models/device.h"
 #include "networkrequest.h"
+#include "networkresponsecache.h"
 #include "qmlengineholder.h"
 #include "settingsholder.h"
 #include "tasks/account/taskaccount.h"
@@ -100,6 +101,11 @@ MozillaVPN::MozillaVPN() : m_private(new Private()) {
   Q_ASSERT(!s_instance);
   s_instance = this;
 
+  m_private->m_serverLatency.initialize(&m_private->m_serverCountryModel,
+                                       &m_private->m_controller);
+  m_private->m_serverSelector.initialize(&m_private->m_serverCountryModel,
+                                        &m_private->m_serverLatency);
+
   connect(&m_alertTimer, &QTimer::timeout, this,
           [this]() { setAlert(NoAlert); });
 
@@ -314,7 +320,7 @@ void MozillaVPN::initialize() {
 
   Q_ASSERT(!m_private->m_serverData.initialized());
   if (!m_private->m_serverData.fromSettings()) {
-    m_private->m_serverCountryModel.pickRandom(m_private->m_serverData);
+    pickLocation();
     Q_ASSERT(m_private->m_serverData.initialized());
     m_private->m_serverData.writeSettings();
   }
@@ -670,8 +676,9 @@ void MozillaVPN::deviceRemoved(const QString& publicKey) {
   m_private->m_deviceModel.removeDeviceFromPublicKey(publicKey);
 }
 
-bool MozillaVPN::setServerList(const QByteArray& serverData) {
-  if (!m_private->m_serverCountryModel.fromJson(serverData)) {
+bool MozillaVPN::setServerList(const QByteArray& serverData,
+                               QList<ServerCountry>* parsedCountries) {
+  if (!m_private->m_serverCountryModel.fromJson(serverData, parsedCountries)) {
     logger.error() << "Failed to store the server-countries";
     return false;
   }
@@ -680,10 +687,11 @@ bool MozillaVPN::setServerList(const QByteArray& serverData) {
   return true;
 }
 
-void MozillaVPN::serversFetched(const QByteArray& serverData) {
+void MozillaVPN::serversFetched(const QByteArray& serverData,
+                                QList<ServerCountry>* parsedCountries) {
   logger.debug() << "Server fetched!";
 
-  if (!setServerList(serverData)) {
+  if (!setServerList(serverData, parsedCountries)) {
     // This is OK. The check is done elsewhere.
     return;
   }
@@ -691,12 +699,18 @@ void MozillaVPN::serversFetched(const QByteArray& serverData) {
   // The serverData could be unset or invalid with the new server list.
   if (!m_private->m_serverData.initialized() ||
       !m_private->m_serverCountryModel.exists(m_private->m_serverData)) {
-    m_private->m_serverCountryModel.pickRandom(m_private->m_serverData);
+    pickLocation();
     Q_ASSERT(m_private->m_serverData.initialized());
     m_private->m_serverData.writeSettings();
   }
 }
 
+void MozillaVPN::pickLocation() {
+  if (!m_private->m_serverSelector.pickLocation(m_private->m_serverData)) {
+    m_private->m_serverCountryModel.pickRandom(m_private->m_serverData);
+  }
+}
+
 void MozillaVPN::deviceRemovalCompleted(const QString& publicKey) {
   logger.debug() << "Device removal task completed";
   m_private->m_deviceModel.stopDeviceRemovalFromPublicKey(publicKey, keys());
@@ -887,6 +901,7 @@ void MozillaVPN::reset(bool forceInitialState) {
   SettingsHolder::instance()->clear();
   m_private->m_keys.forgetKeys();
   m_private->m_serverData.forget();
+  NetworkResponseCache::instance()->clear();
 
   if (FeatureInAppPurchase::instance()->isSupported()) {
     IAPHandler* iap = IAPHandler::instance();
@@ -1105,11 +1120,13 @@ void MozillaVPN::startSchedulingPeriodicOperations() {
   logger.debug() << "Start scheduling account and servers"
                  << Constants::schedulePeriodicTaskTimerMsec();
   m_periodicOperationsTimer.start(Constants::schedulePeriodicTaskTimerMsec());
+  m_private->m_serverLatency.start();
 }
 
 void MozillaVPN::stopSchedulingPeriodicOperations() {
   logger.debug() << "Stop scheduling account and servers";
   m_periodicOperationsTimer.stop();
+  m_private->m_serverLatency.stop();
 }
 
 bool MozillaVPN::writeAndShowLogs(QStandardPaths::StandardLocation location) {
@@ -26,6 +26,8 @@
 #include "models/whatsnewmodel.h"
 #include "networkwatcher.h"
 #include "releasemonitor.h"
+#include "serverlatency.h"
+#include "serverselector.h"
 #include "statusicon.h"
 #include "theme.h"
 
@@ -221,6 +223,8 @@ class MozillaVPN final : public QObject {
   ServerCountryModel* serverCountryModel() {
     return &m_private->m_serverCountryModel;
   }
+  ServerLatency* serverLatency() { return &m_private->m_serverLatency; }
+  ServerSelector* serverSelector() { return &m_private->m_serverSelector; }
   StatusIcon* statusIcon() { return &m_private->m_statusIcon; }
   SurveyModel* surveyModel() { return &m_private->m_surveyModel; }
   Theme* theme() { return &m_private->m_theme; }
@@ -237,7 +241,10 @@ class MozillaVPN final : public QObject {
   void deviceRemoved(const QString& publicKey);
   void deviceRemovalCompleted(const QString& publicKey);
 
-  void serversFetched(const QByteArray& serverData);
+  // `parsedCountries`, if set, is the server list already parsed while it
+  // was being received.
+  void serversFetched(const QByteArray& serverData,
+                      QList<ServerCountry>* parsedCountries = nullptr);
 
   void accountChecked(const QByteArray& json);
 
@@ -287,7 +294,9 @@ class MozillaVPN final : public QObject {
 
   void setToken(const QString& token);
 
-  [[nodiscard]] bool setServerList(const QByteArray& serverData);
+  [[nodiscard]] bool setServerList(
+      const QByteArray& serverData,
+      QList<ServerCountry>* parsedCountries = nullptr);
 
   Q_INVOKABLE void reset(bool forceInitialState);
 
@@ -329,6 +338,8 @@ class MozillaVPN final : public QObject {
 
   void setAlert(AlertType alert);
 
+  void pickLocation();
+
   bool writeAndShowLogs(QStandardPaths::StandardLocation location);
 
   bool writeLogs(QStandardPaths::StandardLocation location,
@@ -417,6 +428,8 @@ class MozillaVPN final : public QObject {
     ReleaseMonitor m_releaseMonitor;
     ServerCountryModel m_serverCountryModel;
     ServerData m_serverData;
+    ServerLatency m_serverLatency;
+    ServerSelector m_serverSelector;
     StatusIcon m_statusIcon;
     SurveyModel m_surveyModel;
     Theme m_theme;
@@ -11,6 +11,7 @@
 #include "logger.h"
 #include "mozillavpn.h"
 #include "networkmanager.h"
+#include "networkresponsecache.h"
 #include "settingsholder.h"
 #include "task.h"
 
@@ -19,6 +20,7 @@
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QJsonObject>
+#include <QMetaMethod>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QNetworkRequest>
@@ -30,12 +32,17 @@
 constexpr uint32_t REQUEST_TIMEOUT_MSEC = 15000;
 constexpr int REQUEST_MAX_REDIRECTS = 4;
 
+constexpr int HTTP_NOT_MODIFIED = 304;
+
 constexpr const char* IPINFO_URL_IPV4 = "https://%1/api/v1/vpn/ipinfo";
 constexpr const char* IPINFO_URL_IPV6 = "https://[%1]/api/v1/vpn/ipinfo";
 
 namespace {
 Logger logger(LOG_NETWORKING, "NetworkRequest");
 QList<QSslCertificate> s_intervention_certs;
+
+// Cached GET requests in flight, by cache key.
+QHash<QString, NetworkRequest*> s_cachedRequests;
 }  // namespace
 
 NetworkRequest::NetworkRequest(Task* parent, int status,
@@ -80,6 +87,24 @@ NetworkRequest::NetworkRequest(Task* parent, int status,
 NetworkRequest::~NetworkRequest() {
   MVPN_COUNT_DTOR(NetworkRequest);
 
+  if (m_leader) {
+    detachFromLeader();
+  } else if (!m_cacheKey.isEmpty() &&
+             s_cachedRequests.value(m_cacheKey) == this) {
+    s_cachedRequests.remove(m_cacheKey);
+
+    // Deleted before completing: the first follower takes over.
+    if (!m_followers.isEmpty()) {
+      NetworkRequest* leader = m_followers.takeFirst();
+      leader->m_leader = nullptr;
+      leader->m_followers.swap(m_followers);
+      for (NetworkRequest* follower : leader->m_followers) {
+        follower->m_leader = leader;
+      }
+      leader->startCachedRequest();
+    }
+  }
+
   // During the shutdown, the QML NetworkManager can be released before the
   // deletion of the pending network requests.
   if (NetworkManager::exists()) {
@@ -114,6 +139,29 @@ NetworkRequest* NetworkRequest::createForGetUrl(Task* parent,
   return r;
 }
 
+// static
+NetworkRequest* NetworkRequest::createForDownload(Task* parent,
+                                                  const QString& url,
+                                                  qint64 offset) {
+  Q_ASSERT(parent);
+  Q_ASSERT(offset >= 0);
+
+  NetworkRequest* r = new NetworkRequest(parent, 0, false);
+  r->m_streaming = true;
+  r->m_request.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
+                            QNetworkRequest::NoLessSafeRedirectPolicy);
+
+  if (offset > 0) {
+    r->m_request.setRawHeader("Range",
+                              "bytes=" + QByteArray::number(offset) + "-");
+  }
+
+  r->m_request.setUrl(url);
+
+  r->getRequest();
+  return r;
+}
+
 // static
 NetworkRequest* NetworkRequest::createForAuthenticationVerification(
     Task* parent, const QString& pkceCodeSuccess,
@@ -241,7 +289,7 @@ NetworkRequest* NetworkRequest::createForServers(Task* parent) {
   url.setPath("/api/v1/vpn/servers");
   r->m_request.setUrl(url);
 
-  r->getRequest();
+  r->getCachedRequest();
   return r;
 }
 
@@ -254,7 +302,7 @@ NetworkRequest* NetworkRequest::createForSurveyData(Task* parent) {
   url.setPath("/api/v1/vpn/surveys");
   r->m_request.setUrl(url);
 
-  r->getRequest();
+  r->getCachedRequest();
   return r;
 }
 
@@ -267,7 +315,7 @@ NetworkRequest* NetworkRequest::createForVersions(Task* parent) {
   url.setPath("/api/v1/vpn/versions");
   r->m_request.setUrl(url);
 
-  r->getRequest();
+  r->getCachedRequest();
   return r;
 }
 
@@ -280,7 +328,7 @@ NetworkRequest* NetworkRequest::createForAccount(Task* parent) {
   url.setPath("/api/v1/vpn/account");
   r->m_request.setUrl(url);
 
-  r->getRequest();
+  r->getCachedRequest();
   return r;
 }
 
@@ -415,7 +463,7 @@ NetworkRequest* NetworkRequest::createForGetFeatureList(Task* parent) {
   url.setPath("/api/v1/vpn/featurelist");
   r->m_request.setUrl(url);
 
-  r->getRequest();
+  r->getCachedRequest();
   return r;
 }
 
@@ -781,20 +829,31 @@ void NetworkRequest::replyFinished() {
   m_completed = true;
   m_timer.stop();
 
+  if (!m_cacheKey.isEmpty()) {
+    s_cachedRequests.remove(m_cacheKey);
+  }
+
   int status = statusCode();
 
   QString expect = m_status ? QString::number(m_status) : "any";
   logger.debug() << "Network reply received - status:" << status
                  << "- expected:" << expect;
 
-  QByteArray data = m_reply->readAll();
+  QByteArray remainder = m_reply->readAll();
+  QByteArray data = m_data.isEmpty() ? remainder : m_data + remainder;
+  m_data.clear();
 
   if (m_reply->error() != QNetworkReply::NoError) {
     QUrl::FormattingOptions options = QUrl::RemoveQuery | QUrl::RemoveUserInfo;
     logger.error() << "Network error:" << m_reply->errorString()
                    << "status code:" << status << "- body:" << data;
     logger.error() << "Failed to access:" << m_request.url().toString(options);
-    emit requestFailed(m_reply->error(), data);
+    emitFailed(m_reply->error(), data, status);
+    return;
+  }
+
+  if (!m_cacheKey.isEmpty() && status == HTTP_NOT_MODIFIED) {
+    completeWithCache(status);
     return;
   }
 
@@ -803,7 +862,115 @@ void NetworkRequest::replyFinished() {
   if (m_status && status != m_status) {
     logger.error() << "Status code unexpected - status code:" << status
                    << "- expected:" << m_status;
-    emit requestFailed(QNetworkReply::ConnectionRefusedError, data);
+    emitFailed(QNetworkReply::ConnectionRefusedError, data, status);
+    return;
+  }
+
+  if (!m_cacheKey.isEmpty()) {
+    NetworkResponseCache* cache = NetworkResponseCache::instance();
+    cache->store(m_cacheKey, {m_reply->rawHeader("ETag"),
+                              m_reply->rawHeader("Last-Modified"), data});
+    cache->setDelivered(m_cacheKey);
+  }
+
+  static const QMetaMethod dataReceivedSignal =
+      QMetaMethod::fromSignal(&NetworkRequest::requestDataReceived);
+  if (!remainder.isEmpty() && isSignalConnected(dataReceivedSignal)) {
+    emit requestDataReceived(remainder);
+  }
+
+  emitCompleted(m_streaming ? QByteArray() : data, status);
+}
+
+void NetworkRequest::replyReadyRead() {
+  Q_ASSERT(m_reply);
+
+  static const QMetaMethod dataReceivedSignal =
+      QMetaMethod::fromSignal(&NetworkRequest::requestDataReceived);
+  if (m_completed || !isSignalConnected(dataReceivedSignal)) {
+    // Left in the reply, for replyFinished().
+    return;
+  }
+
+  QByteArray chunk = m_reply->readAll();
+  if (chunk.isEmpty()) {
+    return;
+  }
+
+  if (!m_streaming) {
+    m_data.append(chunk);
+  }
+  emit requestDataReceived(chunk);
+}
+
+void NetworkRequest::completeWithCache(int status) {
+  NetworkResponseCache* cache = NetworkResponseCache::instance();
+  NetworkResponseCache::Entry entry = cache->find(m_cacheKey);
+  if (!entry.isValid()) {
+    logger.error() << "Not modified, but nothing cached";
+    emitFailed(QNetworkReply::ConnectionRefusedError, QByteArray(), status);
+    return;
+  }
+
+  bool delivered = cache->isDelivered(m_cacheKey);
+  cache->setDelivered(m_cacheKey);
+  logger.debug() << "Not modified - delivered:" << delivered;
+
+  QList<QPointer<NetworkRequest>> followers = takeFollowers(status);
+  emitCached(entry.m_body, delivered);
+
+  for (const QPointer<NetworkRequest>& follower : followers) {
+    if (follower) {
+      follower->emitCached(entry.m_body, delivered);
+      follower->deleteLater();
+    }
+  }
+}
+
+QList<QPointer<NetworkRequest>> NetworkRequest::takeFollowers(int status) {
+  // Detached before emitting anything: a consumer can delete any of them.
+  QList<QPointer<NetworkRequest>> followers;
+  for (NetworkRequest* follower : m_followers) {
+    follower->m_leader = nullptr;
+    follower->m_completed = true;
+    follower->m_leaderStatus = status;
+    followers.append(follower);
+  }
+  m_followers.clear();
+  return followers;
+}
+
+void NetworkRequest::emitFailed(QNetworkReply::NetworkError error,
+                                const QByteArray& data, int status) {
+  QList<QPointer<NetworkRequest>> followers = takeFollowers(status);
+  emit requestFailed(error, data);
+
+  for (const QPointer<NetworkRequest>& follower : followers) {
+    if (follower) {
+      emit follower->requestFailed(error, data);
+      follower->deleteLater();
+    }
+  }
+}
+
+void NetworkRequest::emitCompleted(const QByteArray& data, int status) {
+  QList<QPointer<NetworkRequest>> followers = takeFollowers(status);
+  emit requestCompleted(data);
+
+  for (const QPointer<NetworkRequest>& follower : followers) {
+    if (follower) {
+      emit follower->requestCompleted(data);
+      follower->deleteLater();
+    }
+  }
+}
+
+void NetworkRequest::emitCached(const QByteArray& data, bool delivered) {
+  static const QMetaMethod unchangedSignal =
+      QMetaMethod::fromSignal(&NetworkRequest::requestUnchanged);
+
+  if (delivered && isSignalConnected(unchangedSignal)) {
+    emit requestUnchanged();
     return;
   }
 
@@ -836,8 +1003,12 @@ void NetworkRequest::timeout() {
   m_completed = true;
   m_reply->abort();
 
+  if (!m_cacheKey.isEmpty()) {
+    s_cachedRequests.remove(m_cacheKey);
+  }
+
   logger.error() << "Network request timeout";
-  emit requestFailed(QNetworkReply::TimeoutError, QByteArray());
+  emitFailed(QNetworkReply::TimeoutError, QByteArray(), 0);
 }
 
 void NetworkRequest::getRequest() {
@@ -847,6 +1018,44 @@ void NetworkRequest::getRequest() {
   m_timer.start(REQUEST_TIMEOUT_MSEC);
 }
 
+void NetworkRequest::getCachedRequest() {
+  m_cacheKey = NetworkResponseCache::key(m_request.url(),
+                                         m_request.rawHeader("Authorization"));
+
+  NetworkRequest* leader = s_cachedRequests.value(m_cacheKey);
+  if (leader) {
+    logger.debug() << "Coalesced with a pending request";
+    m_leader = leader;
+    leader->m_followers.append(this);
+    return;
+  }
+
+  startCachedRequest();
+}
+
+void NetworkRequest::startCachedRequest() {
+  Q_ASSERT(!m_cacheKey.isEmpty());
+  Q_ASSERT(!m_leader);
+
+  s_cachedRequests.insert(m_cacheKey, this);
+
+  NetworkResponseCache::Entry entry =
+      NetworkResponseCache::instance()->find(m_cacheKey);
+  if (!entry.m_etag.isEmpty()) {
+    m_request.setRawHeader("If-None-Match", entry.m_etag);
+  } else if (!entry.m_lastModified.isEmpty()) {
+    m_request.setRawHeader("If-Modified-Since", entry.m_lastModified);
+  }
+
+  getRequest();
+}
+
+void NetworkRequest::detachFromLeader() {
+  Q_ASSERT(m_leader);
+  m_leader->m_followers.removeOne(this);
+  m_leader = nullptr;
+}
+
 void NetworkRequest::deleteRequest() {
   QNetworkAccessManager* manager =
       NetworkManager::instance()->networkAccessManager();
@@ -870,6 +1079,8 @@ void NetworkRequest::handleReply(QNetworkReply* reply) {
 
   connect(m_reply, &QNetworkReply::finished, this,
           &NetworkRequest::replyFinished);
+  connect(m_reply, &QNetworkReply::readyRead, this,
+          &NetworkRequest::replyReadyRead);
   connect(m_reply, &QNetworkReply::sslErrors, this, &NetworkRequest::sslErrors);
   connect(m_reply, &QNetworkReply::metaDataChanged, this,
           &NetworkRequest::handleHeaderReceived);
@@ -879,7 +1090,11 @@ void NetworkRequest::handleReply(QNetworkReply* reply) {
 }
 
 int NetworkRequest::statusCode() const {
-  Q_ASSERT(m_reply);
+  if (!m_reply) {
+    // Coalesced requests report the status of their leader.
+    Q_ASSERT(!m_cacheKey.isEmpty());
+    return m_leaderStatus;
+  }
 
   QVariant statusCode =
       m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
@@ -8,6 +8,7 @@
 #include <QNetworkReply>
 #include <QNetworkRequest>
 #include <QObject>
+#include <QPointer>
 #include <QTimer>
 
 class QHostAddress;
@@ -28,6 +29,12 @@ class NetworkRequest final : public QObject {
   static NetworkRequest* createForGetUrl(Task* parent, const QString& url,
                                          int status = 0);
 
+  // Big downloads: the body is only delivered through requestDataReceived,
+  // and never buffered. If `offset` is not 0, only the bytes from there are
+  // requested (HTTP Range): the server replies 206, or 200 if it ignores it.
+  static NetworkRequest* createForDownload(Task* parent, const QString& url,
+                                           qint64 offset);
+
   static NetworkRequest* createForAuthenticationVerification(
       Task* parent, const QString& pkceCodeSuccess,
       const QString& pkceCodeVerifier);
@@ -143,6 +150,20 @@ class NetworkRequest final : public QObject {
 
   void deleteRequest();
   void getRequest();
+
+  // GET requests of the polled endpoints: conditional, served from the
+  // NetworkResponseCache on "304 Not Modified", and coalesced with an
+  // identical request in flight.
+  void getCachedRequest();
+  void startCachedRequest();
+  void detachFromLeader();
+
+  void completeWithCache(int status);
+  QList<QPointer<NetworkRequest>> takeFollowers(int status);
+  void emitFailed(QNetworkReply::NetworkError error, const QByteArray& data,
+                  int status);
+  void emitCompleted(const QByteArray& data, int status);
+  void emitCached(const QByteArray& data, bool delivered);
   void postRequest(const QByteArray& body);
 
   void handleReply(QNetworkReply* reply);
@@ -152,6 +173,7 @@ class NetworkRequest final : public QObject {
 
  private slots:
   void replyFinished();
+  void replyReadyRead();
   void timeout();
   void sslErrors(const QList<QSslError>& errors);
 
@@ -161,6 +183,17 @@ class NetworkRequest final : public QObject {
   void requestRedirected(NetworkRequest* request, const QUrl& url);
   void requestCompleted(const QByteArray& data);
 
+  // Chunks of the body, as they arrive, for the consumers which parse it
+  // incrementally. Only emitted if connected, and always before
+  // requestCompleted. The complete body is passed to requestCompleted anyway,
+  // except for the downloads.
+  void requestDataReceived(const QByteArray& chunk);
+
+  // Emitted instead of requestCompleted when the server replies "304 Not
+  // Modified" and the cached body has already been delivered by this process.
+  // Only for the consumers connected to it.
+  void requestUnchanged();
+
  private:
   QNetworkRequest m_request;
   QTimer m_timer;
@@ -170,6 +203,18 @@ class NetworkRequest final : public QObject {
   QNetworkReply* m_reply = nullptr;
   int m_status = 0;
   bool m_completed = false;
+
+  // The body read so far by replyReadyRead().
+  QByteArray m_data;
+  bool m_streaming = false;
+
+  // Empty if the request is not cached.
+  QString m_cacheKey;
+
+  // A coalesced request has no reply: it gets the outcome of its leader.
+  NetworkRequest* m_leader = nullptr;
+  QList<NetworkRequest*> m_followers;
+  int m_leaderStatus = 0;
 };
 
 #endif  // NETWORKREQUEST_H
@@ -0,0 +1,137 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "networkresponsecache.h"
+#include "logger.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QUrl>
+
+constexpr const char* CACHE_DIRECTORY = "api";
+
+constexpr quint32 CACHE_MAGIC = 0x4d565243;  // "MVRC"
+constexpr quint8 CACHE_VERSION = 1;
+
+// The server list is the biggest of the cached responses, by far.
+constexpr int CACHE_MAX_BODY_SIZE = 4 * 1024 * 1024;
+
+namespace {
+Logger logger(LOG_NETWORKING, "NetworkResponseCache");
+}  // namespace
+
+NetworkResponseCache::NetworkResponseCache(const QString& path)
+    : m_path(path) {}
+
+NetworkResponseCache::~NetworkResponseCache() = default;
+
+// static
+NetworkResponseCache* NetworkResponseCache::instance() {
+  static NetworkResponseCache s_instance(
+      QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation))
+          .filePath(CACHE_DIRECTORY));
+  return &s_instance;
+}
+
+// static
+QString NetworkResponseCache::key(const QUrl& url,
+                                  const QByteArray& authorization) {
+  QCryptographicHash hash(QCryptographicHash::Sha256);
+  hash.addData(url.toEncoded(QUrl::RemoveFragment));
+  hash.addData("\n", 1);
+  hash.addData(authorization);
+  return QString::fromLatin1(hash.result().toHex());
+}
+
+QString NetworkResponseCache::fileName(const QString& key) const {
+  return QDir(m_path).filePath(key);
+}
+
+NetworkResponseCache::Entry NetworkResponseCache::find(const QString& key) {
+  auto i = m_entries.constFind(key);
+  if (i != m_entries.constEnd()) {
+    return i.value();
+  }
+
+  QFile file(fileName(key));
+  if (!file.open(QIODevice::ReadOnly)) {
+    return Entry();
+  }
+
+  QDataStream stream(&file);
+  stream.setVersion(QDataStream::Qt_5_15);
+
+  quint32 magic = 0;
+  quint8 version = 0;
+  Entry entry;
+  stream >> magic >> version;
+  if (magic != CACHE_MAGIC || version != CACHE_VERSION) {
+    logger.warning() << "Unsupported cache entry - removing it";
+    file.close();
+    file.remove();
+    return Entry();
+  }
+
+  stream >> entry.m_etag >> entry.m_lastModified >> entry.m_body;
+  if (stream.status() != QDataStream::Ok || !entry.isValid()) {
+    logger.warning() << "Corrupted cache entry - removing it";
+    file.close();
+    file.remove();
+    return Entry();
+  }
+
+  m_entries.insert(key, entry);
+  return entry;
+}
+
+void NetworkResponseCache::store(const QString& key, const Entry& entry) {
+  if (!entry.isValid() || entry.m_body.length() > CACHE_MAX_BODY_SIZE) {
+    remove(key);
+    return;
+  }
+
+  m_entries.insert(key, entry);
+
+  if (!QDir().mkpath(m_path)) {
+    logger.error() << "Unable to create the cache directory";
+    return;
+  }
+
+  QSaveFile file(fileName(key));
+  if (!file.open(QIODevice::WriteOnly)) {
+    logger.error() << "Unable to write the cache entry";
+    return;
+  }
+
+  QDataStream stream(&file);
+  stream.setVersion(QDataStream::Qt_5_15);
+  stream << CACHE_MAGIC << CACHE_VERSION << entry.m_etag
+         << entry.m_lastModified << entry.m_body;
+
+  if (!file.commit()) {
+    logger.error() << "Unable to commit the cache entry";
+  }
+}
+
+void NetworkResponseCache::remove(const QString& key) {
+  m_entries.remove(key);
+  m_delivered.remove(key);
+  QFile::remove(fileName(key));
+}
+
+void NetworkResponseCache::clear() {
+  logger.debug() << "Clearing the response cache";
+
+  m_entries.clear();
+  m_delivered.clear();
+
+  QDir dir(m_path);
+  if (dir.exists() && !dir.removeRecursively()) {
+    logger.error() << "Unable to remove the cache directory";
+  }
+}
@@ -0,0 +1,71 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef NETWORKRESPONSECACHE_H
+#define NETWORKRESPONSECACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QString>
+
+class QUrl;
+
+// On-disk cache of the last response of the API endpoints which are polled
+// periodically, together with its validators (ETag and Last-Modified), so
+// that the next request can be conditional and a "304 Not Modified" reply can
+// be served from here.
+//
+// The entries are keyed by a hash of the URL and of the Authorization header:
+// the token is never written to disk, and the responses of different accounts
+// never mix.
+class NetworkResponseCache final {
+  Q_DISABLE_COPY_MOVE(NetworkResponseCache)
+
+ public:
+  struct Entry {
+    QByteArray m_etag;
+    QByteArray m_lastModified;
+    QByteArray m_body;
+
+    bool isValid() const {
+      return !m_etag.isEmpty() || !m_lastModified.isEmpty();
+    }
+  };
+
+  explicit NetworkResponseCache(const QString& path);
+  ~NetworkResponseCache();
+
+  static NetworkResponseCache* instance();
+
+  static QString key(const QUrl& url, const QByteArray& authorization);
+
+  // Returns an invalid entry if nothing is cached for this key.
+  Entry find(const QString& key);
+
+  // Entries without validators, or too big, are not stored.
+  void store(const QString& key, const Entry& entry);
+
+  void remove(const QString& key);
+
+  void clear();
+
+  // A response is delivered when its body has been handed to a consumer in
+  // this process: a later "304 Not Modified" doesn't need to be parsed again.
+  bool isDelivered(const QString& key) const {
+    return m_delivered.contains(key);
+  }
+  void setDelivered(const QString& key) { m_delivered.insert(key); }
+
+ private:
+  QString fileName(const QString& key) const;
+
+ private:
+  const QString m_path;
+
+  QHash<QString, Entry> m_entries;
+  QSet<QString> m_delivered;
+};
+
+#endif  // NETWORKRESPONSECACHE_H
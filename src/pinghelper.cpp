@@ -6,40 +6,28 @@
 #include "leakdetector.h"
 #include "logger.h"
 #include "pingsender.h"
+#include "pingsenderfactory.h"
 #include "platforms/dummy/dummypingsender.h"
 #include "timersingleshot.h"
 
-#if defined(MVPN_LINUX) || defined(MVPN_ANDROID)
-#  include "platforms/linux/linuxpingsender.h"
-#elif defined(MVPN_MACOS) || defined(MVPN_IOS)
-#  include "platforms/macos/macospingsender.h"
-#elif defined(MVPN_WINDOWS)
-#  include "platforms/windows/windowspingsender.h"
-#elif defined(MVPN_DUMMY) || defined(UNIT_TEST)
-#else
-#  error "Unsupported platform"
-#endif
-
 #include <QDateTime>
 
-#include <cmath>
-
 // Any X seconds, a new ping.
 constexpr uint32_t PING_TIMEOUT_SEC = 1;
 
-// Maximum window size for ping statistics.
-constexpr int PING_STATS_WINDOW = 32;
-
 namespace {
 Logger logger(LOG_NETWORKING, "PingHelper");
 bool s_has_critical_ping_error = false;
+
+qint64 currentUsec() { return QDateTime::currentMSecsSinceEpoch() * 1000; }
+
+uint usecToMsec(uint usec) { return (usec + 500) / 1000; }
 }  // namespace
 
 PingHelper::PingHelper() {
   MVPN_COUNT_CTOR(PingHelper);
 
   m_sequence = 0;
-  m_pingData.resize(PING_STATS_WINDOW);
 
   connect(&m_pingTimer, &QTimer::timeout, this, &PingHelper::nextPing);
 }
@@ -56,28 +44,17 @@ void PingHelper::start(const QString& serverIpv4Gateway,
   if (s_has_critical_ping_error) {
     m_pingSender = new DummyPingSender(m_source, this);
   } else {
-    m_pingSender =
-#if defined(MVPN_LINUX) || defined(MVPN_ANDROID)
-        new LinuxPingSender(m_source, this);
-#elif defined(MVPN_MACOS) || defined(MVPN_IOS)
-        new MacOSPingSender(m_source, this);
-#elif defined(MVPN_WINDOWS)
-        new WindowsPingSender(m_source, this);
-#else
-        new DummyPingSender(m_source, this);
-#endif
+    m_pingSender = PingSenderFactory::create(m_source, this);
   }
+  connect(m_pingSender, &PingSender::recvPingLatency, this,
+          &PingHelper::pingLatencyReceived);
   connect(m_pingSender, &PingSender::recvPing, this, &PingHelper::pingReceived);
   connect(m_pingSender, &PingSender::criticalPingError, this,
           &PingHelper::handlePingError);
 
   // Reset the ping statistics
   m_sequence = 0;
-  for (int i = 0; i < PING_STATS_WINDOW; i++) {
-    m_pingData[i].timestamp = -1;
-    m_pingData[i].latency = -1;
-    m_pingData[i].sequence = 0;
-  }
+  m_stats.reset();
 
   m_pingTimer.start(PING_TIMEOUT_SEC * 1000);
 }
@@ -99,107 +76,52 @@ void PingHelper::nextPing() {
 #endif
 
   // The ICMP sequence number is used to match replies with their originating
-  // request, and serves as an index into the circular buffer. Overflows of
-  // the sequence number acceptable.
-  int index = m_sequence % PING_STATS_WINDOW;
-  m_pingData[index].timestamp = QDateTime::currentMSecsSinceEpoch();
-  m_pingData[index].latency = -1;
-  m_pingData[index].sequence = m_sequence;
+  // request in the statistics window. Overflows of the sequence number are
+  // acceptable.
+  m_stats.addSent(m_sequence, currentUsec());
   m_pingSender->sendPing(m_gateway, m_sequence);
 
   m_sequence++;
 }
 
 void PingHelper::pingReceived(quint16 sequence) {
-  int index = sequence % PING_STATS_WINDOW;
-  if (m_pingData[index].sequence == sequence) {
-    qint64 sendTime = m_pingData[index].timestamp;
-    m_pingData[index].latency = QDateTime::currentMSecsSinceEpoch() - sendTime;
-    emit pingSentAndReceived(m_pingData[index].latency);
-#ifdef MVPN_DEBUG
-    logger.debug() << "Ping answer received seq:" << sequence
-                   << "avg:" << latency()
-                   << "loss:" << QString("%1%").arg(loss() * 100.0)
-                   << "stddev:" << stddev();
-#endif
-  }
+  // If the sender has already reported a precise latency, this is ignored.
+  pingCompleted(sequence, m_stats.addReceived(sequence, currentUsec()));
 }
 
-uint PingHelper::latency() const {
-  int recvCount = 0;
-  qint64 totalMsec = 0;
-
-  for (const PingSendData& data : m_pingData) {
-    if (data.latency < 0) {
-      continue;
-    }
-    recvCount++;
-    totalMsec += data.latency;
-  }
+void PingHelper::pingLatencyReceived(quint16 sequence, qint64 usec) {
+  pingCompleted(sequence, m_stats.addReceivedLatency(sequence, usec));
+}
 
-  if (recvCount <= 0) {
-    return 0.0;
+void PingHelper::pingCompleted(quint16 sequence, qint64 usec) {
+  if (usec < 0) {
+    return;
   }
 
-  // Add half the denominator to produce nearest-integer rounding.
-  totalMsec += recvCount / 2;
-  return static_cast<uint>(totalMsec / recvCount);
+  emit pingSentAndReceived((usec + 500) / 1000);
+#ifdef MVPN_DEBUG
+  logger.debug() << "Ping answer received seq:" << sequence
+                 << "avg:" << latency() << "loss:"
+                 << QString("%1%").arg(loss() * 100.0)
+                 << "stddev:" << stddev();
+#else
+  Q_UNUSED(sequence);
+#endif
 }
 
-uint PingHelper::stddev() const {
-  int recvCount = 0;
-  qint64 totalVariance = 0;
-  uint average = PingHelper::latency();
+uint PingHelper::latency() const { return usecToMsec(m_stats.latency()); }
 
-  for (const PingSendData& data : m_pingData) {
-    if (data.latency < 0) {
-      continue;
-    }
-    recvCount++;
-    totalVariance += (average - data.latency) * (average - data.latency);
-  }
+uint PingHelper::stddev() const { return usecToMsec(m_stats.stddev()); }
 
-  if (recvCount <= 0) {
-    return 0.0;
-  }
+uint PingHelper::maximum() const { return usecToMsec(m_stats.maximum()); }
 
-  return std::sqrt((double)totalVariance / recvCount);
-}
-
-uint PingHelper::maximum() const {
-  uint maxRtt = 0;
-
-  for (const PingSendData& data : m_pingData) {
-    if (data.latency < 0) {
-      continue;
-    }
-    if (data.latency > maxRtt) {
-      maxRtt = data.latency;
-    }
-  }
-  return maxRtt;
+uint PingHelper::percentile(double percent) const {
+  return usecToMsec(m_stats.percentile(percent));
 }
 
 double PingHelper::loss() const {
-  int sendCount = 0;
-  int recvCount = 0;
   // Don't count pings that are possibly still in flight as losses.
-  qint64 sendBefore =
-      QDateTime::currentMSecsSinceEpoch() - (PING_TIMEOUT_SEC * 1000);
-
-  for (const PingSendData& data : m_pingData) {
-    if (data.latency >= 0) {
-      recvCount++;
-      sendCount++;
-    } else if ((data.timestamp > 0) && (data.timestamp < sendBefore)) {
-      sendCount++;
-    }
-  }
-
-  if (sendCount <= 0) {
-    return 0.0;
-  }
-  return (double)(sendCount - recvCount) / sendCount;
+  return m_stats.loss(currentUsec() - (PING_TIMEOUT_SEC * 1000000));
 }
 
 void PingHelper::handlePingError() {
@@ -5,10 +5,10 @@
 #ifndef PINGHELPER_H
 #define PINGHELPER_H
 
-#include <QList>
+#include "pingstats.h"
+
 #include <QObject>
 #include <QTimer>
-#include <QVector>
 
 class PingSender;
 
@@ -25,9 +25,12 @@ class PingHelper final : public QObject {
              const QString& deviceIpv4Address);
 
   void stop();
+
+  // All the latencies are in msecs.
   uint latency() const;
   uint stddev() const;
   uint maximum() const;
+  uint percentile(double percent) const;
   double loss() const;
 
  signals:
@@ -37,6 +40,8 @@ class PingHelper final : public QObject {
   void nextPing();
 
   void pingReceived(quint16 sequence);
+  void pingLatencyReceived(quint16 sequence, qint64 usec);
+  void pingCompleted(quint16 sequence, qint64 usec);
   void handlePingError();
 
  private:
@@ -44,18 +49,8 @@ class PingHelper final : public QObject {
   QString m_source;
   quint16 m_sequence = 0;
 
-  class PingSendData {
-   public:
-    PingSendData() {
-      timestamp = -1;
-      latency = -1;
-      sequence = 0;
-    }
-    qint64 timestamp;
-    qint64 latency;
-    quint16 sequence;
-  };
-  QVector<PingSendData> m_pingData;
+  // Timestamps and latencies are in usecs.
+  PingStats m_stats;
 
   QTimer m_pingTimer;
   PingSender* m_pingSender = nullptr;
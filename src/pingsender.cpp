@@ -51,6 +51,12 @@ quint16 PingSender::inetChecksum(const void* data, size_t len) {
   return (answer);
 }
 
+void PingSender::sendPingBatch(const QList<QPair<QString, quint16>>& pings) {
+  for (const QPair<QString, quint16>& ping : pings) {
+    sendPing(ping.first, ping.second);
+  }
+}
+
 // QProcess is not supported on iOS
 #if !defined(MVPN_IOS) && !defined(MVPN_WASM)
 // Send a ping by launching the "ping" command.
@@ -6,7 +6,9 @@
 #define PINGSENDER_H
 
 #include <QElapsedTimer>
+#include <QList>
 #include <QObject>
+#include <QPair>
 
 class PingSender : public QObject {
   Q_OBJECT
@@ -17,6 +19,25 @@ class PingSender : public QObject {
 
   virtual void sendPing(const QString& destination, quint16 sequence) = 0;
 
+  // Sends many pings at once, as (destination, sequence) pairs. Backends able
+  // to batch system calls override this; by default, pings are sent one by
+  // one.
+  virtual void sendPingBatch(const QList<QPair<QString, quint16>>& pings);
+
+  // True if many pings to different destinations can be in flight at the
+  // same time, with their replies reported by recvPingReply(). Otherwise,
+  // only recvPing() is emitted, and the pings must be sent one at a time.
+  virtual bool supportsMultipleTargets() const { return false; }
+
+  // Pads the echo requests so that their IP packets are `size` bytes long,
+  // and sends them with the DF bit set, as path MTU probes. 0 goes back to
+  // plain pings. Returns false if the backend can't send probes, which is
+  // the default.
+  virtual bool setProbeSize(int size) {
+    Q_UNUSED(size);
+    return false;
+  }
+
   static quint16 inetChecksum(const void* data, size_t length);
 
  protected:
@@ -28,6 +49,15 @@ class PingSender : public QObject {
 
  signals:
   void recvPing(quint16 sequence);
+
+  // Emitted right before recvPing() by the backends able to measure the
+  // round-trip time themselves (in usecs), without event loop delays.
+  void recvPingLatency(quint16 sequence, qint64 usec);
+
+  // Emitted right before recvPing() by the backends supporting multiple
+  // targets (see PingSenderFactory): `source` is the host which answered, and
+  // `usec` the round-trip time, or -1 if the backend doesn't know it.
+  void recvPingReply(const QString& source, quint16 sequence, qint64 usec);
   void criticalPingError();
 };
 
@@ -0,0 +1,25 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef PINGSENDERFACTORY_H
+#define PINGSENDERFACTORY_H
+
+#include <QString>
+
+class PingSender;
+class QObject;
+
+class PingSenderFactory final {
+ public:
+  // Creates the native ping sender for the current platform. An empty source
+  // address lets the kernel pick the outgoing interface, where supported.
+  static PingSender* create(const QString& source, QObject* parent);
+
+  // True if the native ping sender can probe the servers without a source
+  // address. Whether it keeps many probes in flight at the same time depends
+  // on the sender: see PingSender::supportsMultipleTargets().
+  static bool supportsServerLatency();
+};
+
+#endif  // PINGSENDERFACTORY_H
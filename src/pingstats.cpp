@@ -0,0 +1,275 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "pingstats.h"
+
+#include <QtAlgorithms>
+
+#include <cmath>
+
+// Percentile buckets are log-linear (HDR-style): values below
+// 2^(BUCKET_PRECISION_BITS+1) have their own bucket, bigger values are
+// grouped in 2^BUCKET_PRECISION_BITS sub-buckets per power of two. This keeps
+// the relative error of a percentile below ~3%.
+constexpr int BUCKET_PRECISION_BITS = 5;
+constexpr int BUCKET_SUB_COUNT = 1 << BUCKET_PRECISION_BITS;
+constexpr int BUCKET_LINEAR_COUNT = BUCKET_SUB_COUNT * 2;
+constexpr int BUCKET_MAX_BITS = 32;
+constexpr qint64 BUCKET_MAX_VALUE = (Q_INT64_C(1) << BUCKET_MAX_BITS) - 1;
+constexpr int BUCKET_COUNT =
+    BUCKET_LINEAR_COUNT +
+    (BUCKET_MAX_BITS - BUCKET_PRECISION_BITS - 1) * BUCKET_SUB_COUNT;
+
+constexpr int PingStats::DEFAULT_WINDOW_SIZE;
+constexpr int PingStats::MAX_WINDOW_SIZE;
+
+PingStats::PingStats(int windowSize) {
+  m_buckets.resize(BUCKET_COUNT);
+  setWindowSize(windowSize);
+}
+
+void PingStats::setWindowSize(int windowSize) {
+  m_slots.resize(qBound(1, windowSize, MAX_WINDOW_SIZE));
+  m_maxDeque.reserve(m_slots.size());
+  reset();
+}
+
+void PingStats::reset() {
+  m_slots.fill(Slot());
+  m_buckets.fill(0);
+  m_maxDeque.clear();
+  m_maxHead = 0;
+
+  m_sendIndex = 0;
+  m_sentInWindow = 0;
+  m_recvCount = 0;
+  m_sum = 0;
+  m_sumSquares = 0;
+}
+
+void PingStats::addSent(quint16 sequence, qint64 timestamp) {
+  quint64 index = m_sendIndex++;
+  Slot& slot = m_slots[index % m_slots.size()];
+  evict(slot);
+
+  slot.timestamp = timestamp;
+  slot.latency = -1;
+  slot.index = index;
+  slot.sequence = sequence;
+  m_sentInWindow++;
+
+  // Drop the maximum candidates that just left the window.
+  quint64 windowSize = m_slots.size();
+  while (m_maxHead < m_maxDeque.size() &&
+         m_maxDeque[m_maxHead].index + windowSize <= index) {
+    m_maxHead++;
+  }
+  if (m_maxHead == m_maxDeque.size()) {
+    m_maxDeque.clear();
+    m_maxHead = 0;
+  } else if (m_maxHead >= m_slots.size()) {
+    m_maxDeque.remove(0, m_maxHead);
+    m_maxHead = 0;
+  }
+}
+
+qint64 PingStats::addReceived(quint16 sequence, qint64 timestamp) {
+  Slot* slot = findSlot(sequence);
+  if (!slot) {
+    return -1;
+  }
+  return record(*slot, timestamp - slot->timestamp);
+}
+
+qint64 PingStats::addReceivedLatency(quint16 sequence, qint64 latency) {
+  Slot* slot = findSlot(sequence);
+  if (!slot) {
+    return -1;
+  }
+  return record(*slot, latency);
+}
+
+PingStats::Slot* PingStats::findSlot(quint16 sequence) {
+  if (m_sendIndex == 0) {
+    return nullptr;
+  }
+
+  // Find the most recent probe carrying this sequence number.
+  quint64 last = m_sendIndex - 1;
+  quint16 distance = m_slots[last % m_slots.size()].sequence - sequence;
+  if (distance >= m_slots.size() || distance > last) {
+    return nullptr;
+  }
+
+  quint64 index = last - distance;
+  Slot& slot = m_slots[index % m_slots.size()];
+  if (slot.index != index || slot.sequence != sequence ||
+      slot.timestamp < 0 || slot.latency >= 0) {
+    return nullptr;
+  }
+
+  return &slot;
+}
+
+qint64 PingStats::record(Slot& slot, qint64 latency) {
+  slot.latency = qMax(Q_INT64_C(0), latency);
+
+  m_recvCount++;
+  m_sum += slot.latency;
+  m_sumSquares += slot.latency * slot.latency;
+  m_buckets[bucketFor(slot.latency)]++;
+  insertMaximum(slot.index, slot.latency);
+
+  return slot.latency;
+}
+
+void PingStats::evict(Slot& slot) {
+  if (slot.timestamp < 0) {
+    return;
+  }
+
+  m_sentInWindow--;
+
+  if (slot.latency >= 0) {
+    m_recvCount--;
+    m_sum -= slot.latency;
+    m_sumSquares -= slot.latency * slot.latency;
+    m_buckets[bucketFor(slot.latency)]--;
+  }
+}
+
+void PingStats::insertMaximum(quint64 index, qint64 latency) {
+  // Replies usually arrive in order and this is a plain monotonic-deque push.
+  // A late reply is inserted in the middle, unless a more recent probe is at
+  // least as slow, in which case it can never become the maximum.
+  int end = m_maxDeque.size();
+  while (end > m_maxHead && m_maxDeque[end - 1].index > index) {
+    if (m_maxDeque[end - 1].latency >= latency) {
+      return;
+    }
+    end--;
+  }
+
+  int begin = end;
+  while (begin > m_maxHead && m_maxDeque[begin - 1].latency <= latency) {
+    begin--;
+  }
+
+  MaxEntry entry{index, latency};
+  if (begin == end) {
+    m_maxDeque.insert(begin, entry);
+    return;
+  }
+
+  m_maxDeque[begin] = entry;
+  if (end - begin > 1) {
+    m_maxDeque.remove(begin + 1, end - begin - 1);
+  }
+}
+
+uint PingStats::latency() const {
+  if (m_recvCount <= 0) {
+    return 0;
+  }
+
+  // Add half the denominator to produce nearest-integer rounding.
+  return static_cast<uint>((m_sum + m_recvCount / 2) / m_recvCount);
+}
+
+uint PingStats::stddev() const {
+  if (m_recvCount <= 0) {
+    return 0;
+  }
+
+  double mean = static_cast<double>(m_sum) / m_recvCount;
+  double variance =
+      static_cast<double>(m_sumSquares) / m_recvCount - mean * mean;
+  if (variance <= 0) {
+    return 0;
+  }
+
+  return static_cast<uint>(std::sqrt(variance));
+}
+
+uint PingStats::maximum() const {
+  if (m_maxHead >= m_maxDeque.size()) {
+    return 0;
+  }
+  return static_cast<uint>(m_maxDeque[m_maxHead].latency);
+}
+
+uint PingStats::percentile(double percent) const {
+  if (m_recvCount <= 0) {
+    return 0;
+  }
+
+  qint64 target = static_cast<qint64>(
+      std::ceil(qBound(0.0, percent, 100.0) / 100.0 * m_recvCount));
+  target = qMax(Q_INT64_C(1), target);
+
+  qint64 count = 0;
+  for (int bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+    count += m_buckets[bucket];
+    if (count >= target) {
+      // The percentile can never exceed the real maximum of the window.
+      return qMin(static_cast<uint>(bucketValue(bucket)), maximum());
+    }
+  }
+
+  return maximum();
+}
+
+double PingStats::loss(qint64 sendBefore) const {
+  // Only the most recent probes can still be in flight: walk back from the
+  // newest one until we reach the first probe older than `sendBefore`.
+  int inFlight = 0;
+  int windowSize = m_slots.size();
+  quint64 index = m_sendIndex;
+  for (int i = 0; i < m_sentInWindow && i < windowSize; ++i) {
+    const Slot& slot = m_slots[--index % windowSize];
+    if (slot.timestamp < sendBefore) {
+      break;
+    }
+    if (slot.latency < 0) {
+      inFlight++;
+    }
+  }
+
+  int sendCount = m_sentInWindow - inFlight;
+  if (sendCount <= 0) {
+    return 0.0;
+  }
+  return static_cast<double>(sendCount - m_recvCount) / sendCount;
+}
+
+// static
+int PingStats::bucketFor(qint64 value) {
+  value = qBound(Q_INT64_C(0), value, BUCKET_MAX_VALUE);
+  if (value < BUCKET_LINEAR_COUNT) {
+    return static_cast<int>(value);
+  }
+
+  int msb = 63 - qCountLeadingZeroBits(static_cast<quint64>(value));
+  int shift = msb - BUCKET_PRECISION_BITS;
+  return BUCKET_LINEAR_COUNT +
+         (msb - BUCKET_PRECISION_BITS - 1) * BUCKET_SUB_COUNT +
+         static_cast<int>((value >> shift) - BUCKET_SUB_COUNT);
+}
+
+// static
+qint64 PingStats::bucketValue(int bucket) {
+  if (bucket < BUCKET_LINEAR_COUNT) {
+    return bucket;
+  }
+
+  int msb = (bucket - BUCKET_LINEAR_COUNT) / BUCKET_SUB_COUNT +
+            BUCKET_PRECISION_BITS + 1;
+  int shift = msb - BUCKET_PRECISION_BITS;
+  qint64 lower = static_cast<qint64>(
+                     (bucket - BUCKET_LINEAR_COUNT) % BUCKET_SUB_COUNT +
+                     BUCKET_SUB_COUNT)
+                 << shift;
+  // Report the middle of the bucket.
+  return lower + ((Q_INT64_C(1) << shift) >> 1);
+}
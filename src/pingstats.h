@@ -0,0 +1,93 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef PINGSTATS_H
+#define PINGSTATS_H
+
+#include <QVector>
+
+// Incremental latency statistics over a sliding window of ping probes.
+// Timestamps and latencies can use any unit, as long as it is consistent.
+//
+// Every probe occupies a slot in a circular buffer. Sending a probe evicts the
+// oldest slot and receiving a reply fills the matching slot. The running sum,
+// sum of squares, windowed maximum (monotonic deque) and percentile buckets
+// are all updated on those two events, so reading the statistics never needs
+// to walk the window.
+class PingStats final {
+ public:
+  explicit PingStats(int windowSize = DEFAULT_WINDOW_SIZE);
+
+  static constexpr int DEFAULT_WINDOW_SIZE = 32;
+
+  // The window cannot be larger than the ICMP sequence space.
+  static constexpr int MAX_WINDOW_SIZE = 65536;
+
+  int windowSize() const { return m_slots.size(); }
+  void setWindowSize(int windowSize);
+
+  void reset();
+
+  void addSent(quint16 sequence, qint64 timestamp);
+
+  // Returns the latency of the matching probe, or -1 if the sequence number is
+  // unknown, outside of the window or already answered.
+  qint64 addReceived(quint16 sequence, qint64 timestamp);
+
+  // Same as addReceived(), for a latency measured by the ping sender.
+  qint64 addReceivedLatency(quint16 sequence, qint64 latency);
+
+  uint latency() const;
+  uint stddev() const;
+  uint maximum() const;
+  uint percentile(double percent) const;
+
+  // Probes sent after `sendBefore` and not yet answered are considered in
+  // flight and are not counted as lost.
+  double loss(qint64 sendBefore) const;
+
+  int sentCount() const { return m_sentInWindow; }
+  int receivedCount() const { return m_recvCount; }
+
+ private:
+  struct Slot {
+    qint64 timestamp = -1;
+    qint64 latency = -1;
+    quint64 index = 0;
+    quint16 sequence = 0;
+  };
+
+  struct MaxEntry {
+    quint64 index;
+    qint64 latency;
+  };
+
+  Slot* findSlot(quint16 sequence);
+  qint64 record(Slot& slot, qint64 latency);
+  void evict(Slot& slot);
+  void insertMaximum(quint64 index, qint64 latency);
+
+  static int bucketFor(qint64 value);
+  static qint64 bucketValue(int bucket);
+
+ private:
+  QVector<Slot> m_slots;
+
+  // Total number of probes sent since the last reset.
+  quint64 m_sendIndex = 0;
+
+  int m_sentInWindow = 0;
+  int m_recvCount = 0;
+  qint64 m_sum = 0;
+  qint64 m_sumSquares = 0;
+
+  // Ordered by probe index, with strictly decreasing latency. The front is the
+  // maximum of the window.
+  QVector<MaxEntry> m_maxDeque;
+  int m_maxHead = 0;
+
+  QVector<int> m_buckets;
+};
+
+#endif  // PINGSTATS_H
@@ -16,6 +16,9 @@ class DummyPingSender final : public PingSender {
   ~DummyPingSender();
 
   void sendPing(const QString& dest, quint16 sequence) override;
+
+  // The replies are faked by the caller.
+  bool supportsMultipleTargets() const override { return true; }
 };
 
 #endif  // DUMMYPINGSENDER_H
@@ -0,0 +1,171 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "cgroupmigrator.h"
+#include "logger.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QSet>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/vfs.h>
+
+#include <linux/magic.h>
+
+namespace {
+Logger logger(LOG_LINUX, "CgroupMigrator");
+
+/* Reads the pids listed by a cgroup.procs file. */
+QSet<int> readMembers(int fd) {
+  QByteArray data;
+  char buf[4096];
+  for (;;) {
+    ssize_t len = read(fd, buf, sizeof(buf));
+    if (len < 0 && errno == EINTR) {
+      continue;
+    }
+    if (len <= 0) {
+      break;
+    }
+    data.append(buf, static_cast<int>(len));
+  }
+
+  QSet<int> members;
+  int pid = 0;
+  for (char c : data) {
+    if (c >= '0' && c <= '9') {
+      pid = pid * 10 + (c - '0');
+    } else if (pid > 0) {
+      members.insert(pid);
+      pid = 0;
+    }
+  }
+  if (pid > 0) {
+    members.insert(pid);
+  }
+  return members;
+}
+}  // namespace
+
+// static
+CgroupMigrator::Version CgroupMigrator::version(const QString& cgroup) {
+  struct statfs fs;
+  if (statfs(qPrintable(cgroup), &fs) < 0) {
+    return VersionUnknown;
+  }
+  if (fs.f_type == CGROUP2_SUPER_MAGIC) {
+    return Version2;
+  }
+  if (fs.f_type == CGROUP_SUPER_MAGIC) {
+    return Version1;
+  }
+  return VersionUnknown;
+}
+
+// static
+CgroupMigrator::Result CgroupMigrator::migrate(const QString& cgroup,
+                                               const QList<int>& pids) {
+  Result result;
+  result.version = version(cgroup);
+  if (result.version == VersionUnknown) {
+    logger.error() << "Not a control group:" << cgroup;
+    for (int pid : pids) {
+      result.failures.append(Failure{pid, ENOTDIR});
+    }
+    return result;
+  }
+
+  QString procsFile = cgroup + "/cgroup.procs";
+  int fd = open(qPrintable(procsFile), O_RDWR | O_CLOEXEC);
+  if (fd < 0) {
+    int error = errno;
+    logger.error() << "Failed to open" << procsFile + ":" << strerror(error);
+    for (int pid : pids) {
+      result.failures.append(Failure{pid, error});
+    }
+    return result;
+  }
+
+  const QSet<int> members = readMembers(fd);
+
+  char buf[16];
+  for (int pid : pids) {
+    if (members.contains(pid)) {
+      result.skipped++;
+      continue;
+    }
+
+    /* One pid per write: the kernel doesn't parse more than that. */
+    int len = snprintf(buf, sizeof(buf), "%d", pid);
+    ssize_t written;
+    do {
+      written = write(fd, buf, len);
+    } while (written < 0 && errno == EINTR);
+
+    if (written == len) {
+      result.moved++;
+    } else if (written < 0 && errno == ESRCH) {
+      result.vanished++;
+    } else {
+      result.failures.append(Failure{pid, written < 0 ? errno : EIO});
+    }
+  }
+  close(fd);
+
+  logger.debug() << "Migrated to" << cgroup << "- moved:" << result.moved
+                 << "skipped:" << result.skipped
+                 << "vanished:" << result.vanished
+                 << "failed:" << result.failures.count();
+  return result;
+}
+
+// static
+QString CgroupMigrator::cgroupOf(int pid, const QString& root,
+                                 const QString& controller) {
+  QFile file(QString("/proc/%1/cgroup").arg(pid));
+  if (!file.open(QIODevice::ReadOnly)) {
+    return QString();
+  }
+
+  QString path = parseProcCgroup(file.readAll(), controller);
+  if (path.isNull()) {
+    return QString();
+  }
+  if (path == "/") {
+    return root;
+  }
+  return root + path;
+}
+
+// static
+QString CgroupMigrator::parseProcCgroup(const QByteArray& data,
+                                        const QString& controller) {
+  /* hierarchy-ID:controller-list:cgroup-path, with the cgroup v2 hierarchy
+   * listed as "0::/path". */
+  for (const QByteArray& line : data.split('\n')) {
+    int first = line.indexOf(':');
+    int second = line.indexOf(':', first + 1);
+    if (first < 0 || second < 0) {
+      continue;
+    }
+
+    QByteArray controllers = line.mid(first + 1, second - first - 1);
+    bool match;
+    if (controller.isEmpty()) {
+      match = line.left(first) == "0" && controllers.isEmpty();
+    } else {
+      match = controllers.split(',').contains(controller.toLatin1());
+    }
+
+    if (match) {
+      return QString::fromLocal8Bit(line.mid(second + 1));
+    }
+  }
+  return QString();
+}
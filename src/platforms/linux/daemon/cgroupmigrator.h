@@ -0,0 +1,67 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef CGROUPMIGRATOR_H
+#define CGROUPMIGRATOR_H
+
+#include <QList>
+#include <QString>
+#include <QVector>
+
+// Moves batches of processes into a control group of either a cgroup v1
+// hierarchy (such as the net_cls one from LinuxDependencies::findCgroupPath)
+// or the unified cgroup v2 hierarchy.
+//
+// The kernel takes a single pid per write to cgroup.procs, and each write
+// serializes with every fork in the system. A batch opens the target once,
+// reads its members once and skips the processes which are already there.
+class CgroupMigrator final {
+ public:
+  enum Version {
+    VersionUnknown,
+    Version1,
+    Version2,
+  };
+
+  struct Failure {
+    int pid;
+    int error;
+  };
+
+  struct Result {
+    Version version = VersionUnknown;
+    int moved = 0;
+    // Already in the target cgroup.
+    int skipped = 0;
+    // Exited before they could be moved.
+    int vanished = 0;
+    QVector<Failure> failures;
+  };
+
+  static Version version(const QString& cgroup);
+
+  // Moves the processes, and all of their threads, into `cgroup`: the path of
+  // its directory.
+  static Result migrate(const QString& cgroup, const QList<int>& pids);
+
+  // Directory of the cgroup of `pid` in the hierarchy mounted at `root`, as
+  // listed by /proc/<pid>/cgroup: the cgroup v1 hierarchy of `controller`,
+  // or the cgroup v2 one if `controller` is empty. Null if the process is
+  // gone.
+  static QString cgroupOf(int pid, const QString& root,
+                          const QString& controller);
+
+  // Path of the cgroup relative to the root of its hierarchy, from the
+  // content of a /proc/<pid>/cgroup file. Null if the hierarchy is missing.
+  static QString parseProcCgroup(const QByteArray& data,
+                                 const QString& controller);
+
+ private:
+  CgroupMigrator() = default;
+  ~CgroupMigrator() = default;
+
+  Q_DISABLE_COPY(CgroupMigrator)
+};
+
+#endif  // CGROUPMIGRATOR_H
@@ -0,0 +1,175 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "cgroupsockmark.h"
+#include "logger.h"
+
+#include <QScopeGuard>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include <linux/bpf.h>
+
+namespace {
+Logger logger(LOG_LINUX, "CgroupSockMark");
+
+int sys_bpf(enum bpf_cmd cmd, union bpf_attr* attr) {
+  return static_cast<int>(syscall(__NR_bpf, cmd, attr, sizeof(*attr)));
+}
+}  // namespace
+
+CgroupSockMark::~CgroupSockMark() { detach(); }
+
+bool CgroupSockMark::attach(const QString& cgroup, uint32_t mark) {
+  detach();
+
+  /* sk->mark = mark; return 1; */
+  struct bpf_insn insns[4];
+  memset(insns, 0, sizeof(insns));
+  insns[0].code = BPF_ALU64 | BPF_MOV | BPF_K;
+  insns[0].dst_reg = BPF_REG_2;
+  insns[0].imm = static_cast<int32_t>(mark);
+  insns[1].code = BPF_STX | BPF_MEM | BPF_W;
+  insns[1].dst_reg = BPF_REG_1;
+  insns[1].src_reg = BPF_REG_2;
+  insns[1].off = offsetof(struct bpf_sock, mark);
+  insns[2].code = BPF_ALU64 | BPF_MOV | BPF_K;
+  insns[2].dst_reg = BPF_REG_0;
+  insns[2].imm = 1;
+  insns[3].code = BPF_JMP | BPF_EXIT;
+
+  static const char license[] = "MPL-2.0";
+
+  union bpf_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.prog_type = BPF_PROG_TYPE_CGROUP_SOCK;
+  attr.expected_attach_type = BPF_CGROUP_INET_SOCK_CREATE;
+  attr.insns = reinterpret_cast<uint64_t>(insns);
+  attr.insn_cnt = sizeof(insns) / sizeof(insns[0]);
+  attr.license = reinterpret_cast<uint64_t>(license);
+
+  m_progFd = sys_bpf(BPF_PROG_LOAD, &attr);
+  if (m_progFd < 0) {
+    logger.error() << "Failed to load the socket mark program:"
+                   << strerror(errno);
+    return false;
+  }
+
+  m_cgroupFd = open(qPrintable(cgroup), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (m_cgroupFd < 0) {
+    logger.error() << "Failed to open" << cgroup + ":" << strerror(errno);
+    detach();
+    return false;
+  }
+
+  /* Without flags, the program replaces the one already attached, if any. */
+  memset(&attr, 0, sizeof(attr));
+  attr.target_fd = m_cgroupFd;
+  attr.attach_bpf_fd = m_progFd;
+  attr.attach_type = BPF_CGROUP_INET_SOCK_CREATE;
+  if (sys_bpf(BPF_PROG_ATTACH, &attr) < 0) {
+    logger.error() << "Failed to attach the socket mark program to" << cgroup
+                   << ":" << strerror(errno);
+    close(m_cgroupFd);
+    m_cgroupFd = -1;
+    detach();
+    return false;
+  }
+
+  logger.debug() << "Marking the sockets of" << cgroup << "with" << mark;
+  return true;
+}
+
+void CgroupSockMark::detach() {
+  if (m_cgroupFd >= 0) {
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.target_fd = m_cgroupFd;
+    attr.attach_type = BPF_CGROUP_INET_SOCK_CREATE;
+    if (sys_bpf(BPF_PROG_DETACH, &attr) < 0) {
+      logger.warning() << "Failed to detach the socket mark program:"
+                       << strerror(errno);
+    }
+    close(m_cgroupFd);
+    m_cgroupFd = -1;
+  }
+
+  if (m_progFd >= 0) {
+    close(m_progFd);
+    m_progFd = -1;
+  }
+}
+
+// static
+int CgroupSockMark::remarkSockets(int pid, uint32_t mark,
+                                  const QVector<uint32_t>& marks) {
+#if defined(__NR_pidfd_open) && defined(__NR_pidfd_getfd)
+  char path[32];
+  snprintf(path, sizeof(path), "/proc/%d/fd", pid);
+  DIR* dir = opendir(path);
+  if (!dir) {
+    return errno == ENOENT ? 0 : -1;
+  }
+  auto dirGuard = qScopeGuard([&] { closedir(dir); });
+
+  int pidfd = static_cast<int>(syscall(__NR_pidfd_open, pid, 0));
+  if (pidfd < 0) {
+    return errno == ESRCH ? 0 : -1;
+  }
+  auto pidfdGuard = qScopeGuard([&] { close(pidfd); });
+
+  int changed = 0;
+  while (struct dirent* entry = readdir(dir)) {
+    /* Only the sockets: the other files are not duplicated. */
+    char target[64];
+    ssize_t len =
+        readlinkat(dirfd(dir), entry->d_name, target, sizeof(target) - 1);
+    if (len <= 0) {
+      continue;
+    }
+    target[len] = '\0';
+    if (strncmp(target, "socket:", 7) != 0) {
+      continue;
+    }
+
+    int fd = static_cast<int>(
+        syscall(__NR_pidfd_getfd, pidfd, atoi(entry->d_name), 0));
+    if (fd < 0) {
+      continue;
+    }
+
+    int domain = 0;
+    uint32_t current = 0;
+    socklen_t domainLen = sizeof(domain);
+    socklen_t markLen = sizeof(current);
+    if (getsockopt(fd, SOL_SOCKET, SO_DOMAIN, &domain, &domainLen) == 0 &&
+        (domain == AF_INET || domain == AF_INET6) &&
+        getsockopt(fd, SOL_SOCKET, SO_MARK, &current, &markLen) == 0 &&
+        current != mark && (current == 0 || marks.contains(current))) {
+      /* The kernel drops the cached route when the mark changes. */
+      if (setsockopt(fd, SOL_SOCKET, SO_MARK, &mark, sizeof(mark)) == 0) {
+        changed++;
+      }
+    }
+    close(fd);
+  }
+
+  return changed;
+#else
+  Q_UNUSED(pid);
+  Q_UNUSED(mark);
+  Q_UNUSED(marks);
+  errno = ENOSYS;
+  return -1;
+#endif
+}
@@ -0,0 +1,47 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef CGROUPSOCKMARK_H
+#define CGROUPSOCKMARK_H
+
+#include <QString>
+#include <QVector>
+
+#include <cstdint>
+
+// Split tunnel classification for cgroup v2, which has no net_cls controller.
+//
+// A BPF_PROG_TYPE_CGROUP_SOCK program attached to the cgroup sets the
+// firewall mark of every IPv4 and IPv6 socket its processes create. The
+// routing policy and the netfilter rules match the mark, so that the packets
+// are classified in the kernel.
+//
+// The kernel doesn't move the sockets along with the processes on cgroup v2,
+// unlike net_cls which updates their classid: the sockets the processes
+// already have are marked again with remarkSockets() when they move.
+class CgroupSockMark final {
+  Q_DISABLE_COPY_MOVE(CgroupSockMark)
+
+ public:
+  CgroupSockMark() = default;
+  ~CgroupSockMark();
+
+  // Replaces any program left attached to the cgroup by a previous run.
+  bool attach(const QString& cgroup, uint32_t mark);
+  void detach();
+
+  bool isAttached() const { return m_progFd >= 0; }
+
+  // Sets the mark of the IPv4 and IPv6 sockets opened by `pid`. Sockets with
+  // a mark other than 0 or one of `marks` belong to the application and are
+  // left alone. Returns how many sockets changed, -1 on errors.
+  static int remarkSockets(int pid, uint32_t mark,
+                           const QVector<uint32_t>& marks);
+
+ private:
+  int m_cgroupFd = -1;
+  int m_progFd = -1;
+};
+
+#endif  // CGROUPSOCKMARK_H
@@ -3,6 +3,7 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include "dbusservice.h"
+#include "cgroupmigrator.h"
 #include "dbus_adaptor.h"
 #include "leakdetector.h"
 #include "logger.h"
@@ -10,9 +11,12 @@
 #include "polkithelper.h"
 
 #include <QCoreApplication>
+#include <QDBusServiceWatcher>
 #include <QJsonDocument>
 #include <QJsonObject>
 
+#include <string.h>
+
 namespace {
 Logger logger(LOG_LINUX, "DBusService");
 }
@@ -21,6 +25,8 @@ constexpr const char* APP_STATE_ACTIVE = "active";
 constexpr const char* APP_STATE_EXCLUDED = "excluded";
 constexpr const char* APP_STATE_BLOCKED = "blocked";
 
+constexpr int STATUS_LEASE_MSEC = 30000;
+
 DBusService::DBusService(QObject* parent) : Daemon(parent) {
   MVPN_COUNT_CTOR(DBusService);
 
@@ -33,6 +39,14 @@ DBusService::DBusService(QObject* parent) : Daemon(parent) {
   connect(m_pidtracker, SIGNAL(terminated(const QString&, int)), this,
           SLOT(appTerminated(const QString&, int)));
 
+  m_statusWatcher = new QDBusServiceWatcher(this);
+  m_statusWatcher->setWatchMode(QDBusServiceWatcher::WatchForUnregistration);
+  connect(m_statusWatcher, &QDBusServiceWatcher::serviceUnregistered, this,
+          [this](const QString& service) {
+            logger.debug() << "Status subscriber gone:" << service;
+            removeStatusClient(service);
+          });
+
   if (!removeInterfaceIfExists()) {
     qFatal("Interface `%s` exists and cannot be removed. Cannot proceed!",
            WG_INTERFACE);
@@ -44,6 +58,8 @@ DBusService::~DBusService() { MVPN_COUNT_DTOR(DBusService); }
 IPUtils* DBusService::iputils() {
   if (!m_iputils) {
     m_iputils = new IPUtilsLinux(this);
+    connect(m_wgutils, &WireguardUtils::networkEvent, m_iputils,
+            &IPUtilsLinux::networkChanged);
   }
   return m_iputils;
 }
@@ -109,6 +125,16 @@ bool DBusService::activate(const QString& jsonConfig) {
   return Daemon::activate(config);
 }
 
+void DBusService::prepareActivation(const InterfaceConfig& config) {
+  Q_UNUSED(config);
+
+  // The first hop of a new activation: the interface may be reused, but the
+  // hops of the previous activation are gone.
+  if (m_connections.isEmpty() && m_iputils) {
+    m_iputils->resetHops();
+  }
+}
+
 bool DBusService::deactivate(bool emitSignals) {
   logger.debug() << "Deactivate";
   firewallClear();
@@ -119,6 +145,49 @@ QString DBusService::status() {
   return QString(QJsonDocument(getStatus()).toJson(QJsonDocument::Compact));
 }
 
+QString DBusService::subscribeStatus(int intervalMsec) {
+  QString client = statusClient();
+
+  QTimer* lease = m_statusLeases.value(client);
+  if (!lease) {
+    lease = new QTimer(this);
+    lease->setSingleShot(true);
+    connect(lease, &QTimer::timeout, this, [this, client]() {
+      logger.debug() << "Status subscription expired:" << client;
+      removeStatusClient(client);
+    });
+    m_statusLeases.insert(client, lease);
+
+    if (!client.isEmpty()) {
+      m_statusWatcher->setConnection(connection());
+      m_statusWatcher->addWatchedService(client);
+    }
+  }
+
+  Daemon::subscribeStatus(QString("dbus-%1").arg(client), intervalMsec);
+  lease->start(STATUS_LEASE_MSEC);
+  return status();
+}
+
+void DBusService::unsubscribeStatus() { removeStatusClient(statusClient()); }
+
+QString DBusService::statusClient() const {
+  return calledFromDBus() ? message().service() : QString();
+}
+
+void DBusService::removeStatusClient(const QString& client) {
+  QTimer* lease = m_statusLeases.take(client);
+  if (!lease) {
+    return;
+  }
+
+  lease->deleteLater();
+  if (!client.isEmpty()) {
+    m_statusWatcher->removeWatchedService(client);
+  }
+  Daemon::unsubscribeStatus(QString("dbus-%1").arg(client));
+}
+
 QString DBusService::getLogs() {
   logger.debug() << "Log request";
   return Daemon::logs();
@@ -129,7 +198,7 @@ void DBusService::appLaunched(const QString& name, int rootpid) {
   ProcessGroup* group = m_pidtracker->track(name, rootpid);
   if (m_firewallApps.contains(name)) {
     group->state = m_firewallApps[name];
-    group->moveToCgroup(getAppStateCgroup(group->state));
+    migrateGroups({group}, group->state);
   }
 }
 
@@ -148,7 +217,7 @@ QString DBusService::runningApps() {
     appObject.insert("rootpid", QJsonValue(group->rootpid));
     appObject.insert("state", QJsonValue(group->state));
 
-    for (auto pid : group->kthreads.keys()) {
+    for (auto pid : group->pids) {
       pidList.append(QJsonValue(pid));
     }
 
@@ -163,17 +232,18 @@ QString DBusService::runningApps() {
 bool DBusService::firewallApp(const QString& appName, const QString& state) {
   logger.debug() << "Setting" << appName << "to firewall state" << state;
   m_firewallApps[appName] = state;
-  QString cgroup = getAppStateCgroup(state);
 
   /* Change matching applications' state to excluded */
+  QList<ProcessGroup*> groups;
   for (auto i = m_pidtracker->begin(); i != m_pidtracker->end(); i++) {
     ProcessGroup* group = *i;
     if (group->name != appName) {
       continue;
     }
     group->state = state;
-    group->moveToCgroup(cgroup);
+    groups.append(group);
   }
+  migrateGroups(groups, state);
 
   return true;
 }
@@ -186,7 +256,7 @@ bool DBusService::firewallPid(int rootpid, const QString& state) {
   }
 
   group->state = state;
-  group->moveToCgroup(getAppStateCgroup(group->state));
+  migrateGroups({group}, group->state);
 
   logger.debug() << "Setting" << group->name << "PID:" << rootpid
                  << "to firewall state" << state;
@@ -195,9 +265,8 @@ bool DBusService::firewallPid(int rootpid, const QString& state) {
 
 /* Clear the firewall and return all applications to the active state */
 bool DBusService::firewallClear() {
-  const QString cgroup = getAppStateCgroup(APP_STATE_ACTIVE);
-
   m_firewallApps.clear();
+  QList<ProcessGroup*> groups;
   for (auto i = m_pidtracker->begin(); i != m_pidtracker->end(); i++) {
     ProcessGroup* group = *i;
     if (group->state == APP_STATE_ACTIVE) {
@@ -205,11 +274,12 @@ bool DBusService::firewallClear() {
     }
 
     group->state = APP_STATE_ACTIVE;
-    group->moveToCgroup(cgroup);
+    groups.append(group);
 
     logger.debug() << "Setting" << group->name << "PID:" << group->rootpid
                    << "to firewall state" << group->state;
   }
+  migrateGroups(groups, APP_STATE_ACTIVE);
   return true;
 }
 
@@ -222,3 +292,94 @@ QString DBusService::getAppStateCgroup(const QString& state) {
   }
   return m_wgutils->getDefaultCgroup();
 }
+
+void DBusService::migrateGroups(const QList<ProcessGroup*>& groups,
+                                const QString& state) {
+  /* Do nothing if Cgroups are not supported. */
+  QString cgroup = getAppStateCgroup(state);
+  if (cgroup.isNull()) {
+    return;
+  }
+
+  /* The active applications go back where they were: on cgroup v2, the
+   * default cgroup is the root, outside of their systemd scopes. */
+  if (state == APP_STATE_ACTIVE) {
+    restoreGroups(groups);
+    return;
+  }
+
+  QString root = m_wgutils->getDefaultCgroup();
+  QString controller = m_wgutils->getCgroupController();
+  QString excludeCgroup = m_wgutils->getExcludeCgroup();
+  QString blockCgroup = m_wgutils->getBlockCgroup();
+
+  /* A single batch for all the processes of all the groups. */
+  QList<int> pids;
+  for (ProcessGroup* group : groups) {
+    for (int pid : group->pids) {
+      pids.append(pid);
+
+      if (group->cgroups.contains(pid)) {
+        continue;
+      }
+      QString original = CgroupMigrator::cgroupOf(pid, root, controller);
+      if (!original.isNull() && original != excludeCgroup &&
+          original != blockCgroup) {
+        group->cgroups.insert(pid, original);
+      }
+    }
+  }
+
+  migratePids(cgroup, pids);
+}
+
+void DBusService::restoreGroups(const QList<ProcessGroup*>& groups) {
+  QString root = m_wgutils->getDefaultCgroup();
+  bool unified = m_wgutils->getCgroupController().isEmpty();
+
+  /* One batch per original cgroup. */
+  QMap<QString, QList<int>> batches;
+  for (ProcessGroup* group : groups) {
+    for (int pid : group->pids) {
+      /* The children forked after the move weren't recorded: they go where
+       * the root of their application was. */
+      QString original = group->cgroups.value(pid);
+      if (original.isNull()) {
+        original = group->cgroups.value(group->rootpid);
+      }
+      if (original.isNull() && !group->cgroups.isEmpty()) {
+        original = group->cgroups.begin().value();
+      }
+      if (original.isNull()) {
+        if (unified) {
+          logger.warning() << "No cgroup to restore" << group->name
+                           << "PID:" << pid;
+          continue;
+        }
+        original = root;
+      }
+      batches[original].append(pid);
+    }
+    group->cgroups.clear();
+  }
+
+  for (auto i = batches.constBegin(); i != batches.constEnd(); ++i) {
+    migratePids(i.key(), i.value());
+  }
+}
+
+void DBusService::migratePids(const QString& cgroup, const QList<int>& pids) {
+  if (pids.isEmpty()) {
+    return;
+  }
+
+  CgroupMigrator::Result result = CgroupMigrator::migrate(cgroup, pids);
+  for (const CgroupMigrator::Failure& failure : result.failures) {
+    ProcessGroup* group = m_pidtracker->group(failure.pid);
+    logger.error() << "Failed to move" << (group ? group->name : QString())
+                   << "PID:" << failure.pid << "to" << cgroup + ":"
+                   << strerror(failure.error);
+  }
+
+  m_wgutils->remarkSockets(pids, cgroup);
+}
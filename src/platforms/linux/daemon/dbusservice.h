@@ -12,9 +12,13 @@
 #include "pidtracker.h"
 #include "wireguardutilslinux.h"
 
+#include <QDBusContext>
+#include <QHash>
+
 class DbusAdaptor;
+class QDBusServiceWatcher;
 
-class DBusService final : public Daemon {
+class DBusService final : public Daemon, protected QDBusContext {
   Q_OBJECT
   Q_DISABLE_COPY_MOVE(DBusService)
   Q_CLASSINFO("D-Bus Interface", "org.mozilla.vpn.dbus")
@@ -27,12 +31,20 @@ class DBusService final : public Daemon {
 
   using Daemon::activate;
 
+  void prepareActivation(const InterfaceConfig& config) override;
+
  public slots:
   bool activate(const QString& jsonConfig);
 
   bool deactivate(bool emitSignals = true) override;
   QString status();
 
+  // Each client has its own subscription, keyed by its unique bus name. It
+  // ends when the client leaves the bus, or expires unless it's renewed by
+  // calling subscribeStatus() again.
+  QString subscribeStatus(int intervalMsec);
+  void unsubscribeStatus();
+
   QString version();
   QString getLogs();
 
@@ -51,6 +63,13 @@ class DBusService final : public Daemon {
  private:
   bool removeInterfaceIfExists();
   QString getAppStateCgroup(const QString& state);
+  void migrateGroups(const QList<ProcessGroup*>& groups, const QString& state);
+  void restoreGroups(const QList<ProcessGroup*>& groups);
+  void migratePids(const QString& cgroup, const QList<int>& pids);
+
+  // Unique bus name of the caller, empty if not called through D-Bus.
+  QString statusClient() const;
+  void removeStatusClient(const QString& client);
 
  private slots:
   void appLaunched(const QString& name, int rootpid);
@@ -65,6 +84,10 @@ class DBusService final : public Daemon {
   AppTracker* m_apptracker = nullptr;
   PidTracker* m_pidtracker = nullptr;
   QMap<QString, QString> m_firewallApps;
+
+  // Lease timers of the status subscriptions, by client.
+  QHash<QString, QTimer*> m_statusLeases;
+  QDBusServiceWatcher* m_statusWatcher = nullptr;
 };
 
 #endif  // DBUSSERVICE_H
@@ -7,8 +7,13 @@
 #include "daemon/wireguardutils.h"
 #include "leakdetector.h"
 #include "logger.h"
+#include "netlinktransaction.h"
+#include "pathmtuprober.h"
 
 #include <arpa/inet.h>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
 #include <net/if.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
@@ -16,8 +21,15 @@
 #include <QHostAddress>
 #include <QScopeGuard>
 
-constexpr uint32_t ETH_MTU = 1500;
-constexpr uint32_t WG_MTU_OVERHEAD = 80;
+constexpr int ETH_MTU = 1500;
+constexpr int WG_MTU_OVERHEAD = 80;
+
+// The tunnel carries IPv6, which doesn't work below this MTU. If the path is
+// even smaller, the outer packets are fragmented instead.
+constexpr int MIN_TUNNEL_MTU = 1280;
+
+// Network changes come in bursts: the path is probed once things settle.
+constexpr int NETWORK_SETTLE_MSEC = 2000;
 
 namespace {
 Logger logger(LOG_LINUX, "IPUtilsLinux");
@@ -26,6 +38,21 @@ Logger logger(LOG_LINUX, "IPUtilsLinux");
 IPUtilsLinux::IPUtilsLinux(QObject* parent) : IPUtils(parent) {
   MVPN_COUNT_CTOR(IPUtilsLinux);
   logger.debug() << "IPUtilsLinux created.";
+
+  m_prober = new PathMtuProber(this);
+  connect(m_prober, &PathMtuProber::discovered, this,
+          [this](int mtu) { pathMtuDiscovered(mtu); });
+
+  m_networkTimer.setSingleShot(true);
+  connect(&m_networkTimer, &QTimer::timeout, this, [this]() {
+    if (m_endpoint.isEmpty() || if_nametoindex(WG_INTERFACE) != m_ifindex) {
+      return;
+    }
+    // The paths towards the other servers are probed again when they are
+    // used.
+    m_pathMtus.remove(m_endpoint);
+    startProbe();
+  });
 }
 
 IPUtilsLinux::~IPUtilsLinux() {
@@ -38,42 +65,121 @@ bool IPUtilsLinux::addInterfaceIPs(const InterfaceConfig& config) {
 }
 
 bool IPUtilsLinux::setMTUAndUp(const InterfaceConfig& config) {
-  Q_UNUSED(config);
+  unsigned int ifindex = if_nametoindex(WG_INTERFACE);
+  if (ifindex == 0) {
+    logger.error() << "Failed to find the interface:" << strerror(errno);
+    return false;
+  }
+  if (ifindex != m_ifindex) {
+    m_ifindex = ifindex;
+    resetHops();
+  }
 
-  // Create socket file descriptor to perform the ioctl operations on
-  int sockfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
-  if (sockfd < 0) {
-    logger.error() << "Failed to create ioctl socket.";
+  // Multihop nests the tunnels in the same interface: the packets of the exit
+  // hop (index 0) are encapsulated again for every hop up to the entry one,
+  // which has the highest index and is the only server we talk to directly.
+  if (config.m_hopindex + 1 >= m_tunnelDepth) {
+    m_tunnelDepth = config.m_hopindex + 1;
+    m_endpoint = config.m_serverIpv4AddrIn;
+  }
+
+  if (!setLinkMtuAndUp(tunnelMtu())) {
     return false;
   }
-  auto guard = qScopeGuard([&] { close(sockfd); });
 
-  // Setup the interface to interact with
-  struct ifreq ifr;
-  strncpy(ifr.ifr_name, WG_INTERFACE, IFNAMSIZ);
+  if (m_pathMtus.contains(m_endpoint)) {
+    m_prober->stop();
+  } else {
+    startProbe();
+  }
+  return true;
+}
 
-  // MTU
-  // FIXME: We need to know how many layers deep this particular
-  // interface is into a tunnel to work effectively. Otherwise
-  // we will run into fragmentation issues.
-  ifr.ifr_mtu = ETH_MTU - WG_MTU_OVERHEAD;
-  int ret = ioctl(sockfd, SIOCSIFMTU, &ifr);
-  if (ret) {
-    logger.error() << "Failed to set MTU -- Return code: " << ret;
+void IPUtilsLinux::resetHops() {
+  m_tunnelDepth = 0;
+  m_endpoint.clear();
+}
+
+void IPUtilsLinux::networkChanged() {
+  m_networkTimer.start(NETWORK_SETTLE_MSEC);
+}
+
+int IPUtilsLinux::tunnelMtu() const {
+  // Until the probe completes, trust the kernel, but don't assume that a path
+  // leaving through a jumbo frame LAN carries more than Ethernet.
+  int pathMtu = m_pathMtus.value(m_endpoint, 0);
+  if (pathMtu <= 0) {
+    pathMtu = PathMtuProber::kernelPathMtu(m_endpoint);
+    if (pathMtu <= 0 || pathMtu > ETH_MTU) {
+      pathMtu = ETH_MTU;
+    }
+  }
+
+  return qMax(pathMtu - WG_MTU_OVERHEAD * m_tunnelDepth, MIN_TUNNEL_MTU);
+}
+
+bool IPUtilsLinux::setLinkMtuAndUp(int mtu) {
+  logger.debug() << "Setting the MTU to" << mtu << "for" << m_tunnelDepth
+                 << "hops";
+
+  int nlsock = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (nlsock < 0) {
+    logger.error() << "Failed to create netlink socket:" << strerror(errno);
     return false;
   }
+  auto guard = qScopeGuard([&] { close(nlsock); });
 
-  // Up
-  ifr.ifr_flags |= (IFF_UP | IFF_RUNNING);
-  ret = ioctl(sockfd, SIOCSIFFLAGS, &ifr);
-  if (ret) {
-    logger.error() << "Failed to set device up -- Return code: " << ret;
+  char buf[NLMSG_SPACE(sizeof(struct ifinfomsg)) + RTA_SPACE(sizeof(uint32_t))];
+  memset(buf, 0, sizeof(buf));
+
+  struct nlmsghdr* nlmsg = (struct nlmsghdr*)buf;
+  nlmsg->nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+  nlmsg->nlmsg_type = RTM_NEWLINK;
+  nlmsg->nlmsg_flags = NLM_F_REQUEST;
+
+  struct ifinfomsg* ifinfo = (struct ifinfomsg*)NLMSG_DATA(nlmsg);
+  ifinfo->ifi_family = AF_UNSPEC;
+  ifinfo->ifi_index = m_ifindex;
+  ifinfo->ifi_flags = IFF_UP;
+  ifinfo->ifi_change = IFF_UP;
+
+  // The MTU and the flags are changed by the same request.
+  struct rtattr* attr = (struct rtattr*)(buf + NLMSG_ALIGN(nlmsg->nlmsg_len));
+  uint32_t value = mtu;
+  attr->rta_type = IFLA_MTU;
+  attr->rta_len = RTA_LENGTH(sizeof(value));
+  memcpy(RTA_DATA(attr), &value, sizeof(value));
+  nlmsg->nlmsg_len = NLMSG_ALIGN(nlmsg->nlmsg_len) + RTA_ALIGN(attr->rta_len);
+
+  NetlinkTransaction transaction(nlsock, m_nlseq);
+  transaction.append(nlmsg);
+  if (!transaction.commit()) {
+    logger.error() << "Failed to set the MTU and bring the device up:"
+                   << strerror(transaction.error(0));
     return false;
   }
 
   return true;
 }
 
+void IPUtilsLinux::startProbe() {
+  int upperBound = PathMtuProber::kernelPathMtu(m_endpoint);
+  if (upperBound <= 0) {
+    return;
+  }
+  m_prober->start(m_endpoint, upperBound);
+}
+
+void IPUtilsLinux::pathMtuDiscovered(int mtu) {
+  m_pathMtus.insert(m_endpoint, mtu);
+
+  // The interface may be gone, or recreated, while the probe was running.
+  if (if_nametoindex(WG_INTERFACE) != m_ifindex) {
+    return;
+  }
+  setLinkMtuAndUp(tunnelMtu());
+}
+
 bool IPUtilsLinux::addIP4AddressToDevice(const InterfaceConfig& config) {
   struct ifreq ifr;
   struct sockaddr_in* ifrAddr = (struct sockaddr_in*)&ifr.ifr_addr;
@@ -7,20 +7,57 @@
 
 #include "daemon/iputils.h"
 
+#include <QHash>
+#include <QTimer>
+
 #include <arpa/inet.h>
 
+class PathMtuProber;
+
 class IPUtilsLinux final : public IPUtils {
  public:
   IPUtilsLinux(QObject* parent);
   ~IPUtilsLinux();
   bool addInterfaceIPs(const InterfaceConfig& config) override;
+
+  // The MTU is derived from the path MTU towards the outermost server, minus
+  // the overhead of every WireGuard layer. The path MTU is probed in the
+  // background, and the MTU is lowered when the probe finds a smaller one.
   bool setMTUAndUp(const InterfaceConfig& config) override;
 
+  // A new activation starts: the hops are counted again.
+  void resetHops();
+
+  // The route towards the server may have changed: probe it again.
+  void networkChanged();
+
  private:
   bool addIP4AddressToDevice(const InterfaceConfig& config);
   bool addIP6AddressToDevice(const InterfaceConfig& config);
 
+  int tunnelMtu() const;
+  bool setLinkMtuAndUp(int mtu);
+
+  void startProbe();
+  void pathMtuDiscovered(int mtu);
+
  private:
+  PathMtuProber* m_prober = nullptr;
+  QTimer m_networkTimer;
+
+  // Index of the interface configured by setMTUAndUp(). A new index means
+  // that the interface has been recreated, and the hops are counted again,
+  // as they are on every activation.
+  unsigned int m_ifindex = 0;
+  int m_tunnelDepth = 0;
+
+  // Endpoint of the outermost hop, which the packets of all the layers go to.
+  QString m_endpoint;
+
+  // Path MTU towards each server, as discovered by the probes.
+  QHash<QString, int> m_pathMtus;
+  uint32_t m_nlseq = 0;
+
   struct in6_ifreq {
     struct in6_addr addr;
     uint32_t prefixlen;
@@ -0,0 +1,213 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "netlinktransaction.h"
+#include "leakdetector.h"
+#include "logger.h"
+
+#include <errno.h>
+#include <linux/netlink.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// Keep each datagram well below the default socket buffer size. Every ACK is
+// queued as its own skb, so the number of messages per chunk is capped too,
+// otherwise the receive buffer overflows with ENOBUFS.
+constexpr int MAX_CHUNK_SIZE = 32768;
+constexpr int MAX_CHUNK_MESSAGES = 64;
+constexpr int ACK_BUFFER_SIZE = 16384;
+
+namespace {
+Logger logger(LOG_LINUX, "NetlinkTransaction");
+}  // namespace
+
+NetlinkTransaction::NetlinkTransaction(int nlsock, uint32_t& sequence)
+    : m_nlsock(nlsock), m_sequence(sequence) {
+  MVPN_COUNT_CTOR(NetlinkTransaction);
+}
+
+NetlinkTransaction::~NetlinkTransaction() {
+  MVPN_COUNT_DTOR(NetlinkTransaction);
+}
+
+void NetlinkTransaction::append(const struct nlmsghdr* nlmsg, int undoType,
+                                int undoFlags) {
+  int offset = m_buffer.length();
+  int length = nlmsg->nlmsg_len;
+  m_buffer.append(reinterpret_cast<const char*>(nlmsg), length);
+  m_buffer.append(NLMSG_ALIGN(length) - length, '\0');
+
+  struct nlmsghdr* copy =
+      reinterpret_cast<struct nlmsghdr*>(m_buffer.data() + offset);
+  copy->nlmsg_flags |= NLM_F_REQUEST | NLM_F_ACK;
+  copy->nlmsg_pid = getpid();
+
+  m_offsets.append(offset);
+  m_undo.append({undoType, undoFlags});
+  m_errors.append(EINPROGRESS);
+}
+
+bool NetlinkTransaction::commit() {
+  m_errors.fill(EINPROGRESS);
+
+  auto messageEnd = [&](int index) {
+    return index + 1 < m_offsets.length() ? m_offsets.at(index + 1)
+                                          : m_buffer.length();
+  };
+
+  int first = 0;
+  while (first < m_offsets.length()) {
+    int last = first + 1;
+    while (last < m_offsets.length() && last - first < MAX_CHUNK_MESSAGES &&
+           messageEnd(last) - m_offsets.at(first) <= MAX_CHUNK_SIZE) {
+      ++last;
+    }
+
+    if (!sendChunk(first, last)) {
+      // Don't send anything else after a socket failure.
+      int error = m_errors.at(first);
+      for (int i = last; i < m_offsets.length(); ++i) {
+        m_errors[i] = error;
+      }
+      break;
+    }
+
+    first = last;
+  }
+
+  bool success = true;
+  for (int i = 0; i < m_errors.length(); ++i) {
+    if (m_errors.at(i) != 0) {
+      const struct nlmsghdr* nlmsg = reinterpret_cast<const struct nlmsghdr*>(
+          m_buffer.constData() + m_offsets.at(i));
+      logger.debug() << "Netlink request" << i << "of type"
+                     << nlmsg->nlmsg_type << "failed:" << strerror(m_errors[i]);
+      success = false;
+    }
+  }
+
+  return success;
+}
+
+bool NetlinkTransaction::sendChunk(int first, int last) {
+  uint32_t firstSequence = m_sequence;
+  for (int i = first; i < last; ++i) {
+    struct nlmsghdr* nlmsg =
+        reinterpret_cast<struct nlmsghdr*>(m_buffer.data() + m_offsets.at(i));
+    nlmsg->nlmsg_seq = m_sequence++;
+  }
+
+  int end = last < m_offsets.length() ? m_offsets.at(last) : m_buffer.length();
+
+  struct sockaddr_nl nladdr;
+  memset(&nladdr, 0, sizeof(nladdr));
+  nladdr.nl_family = AF_NETLINK;
+
+  struct iovec iov;
+  iov.iov_base = m_buffer.data() + m_offsets.at(first);
+  iov.iov_len = end - m_offsets.at(first);
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_name = &nladdr;
+  msg.msg_namelen = sizeof(nladdr);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  ssize_t result = sendmsg(m_nlsock, &msg, 0);
+  if (result != static_cast<ssize_t>(iov.iov_len)) {
+    int error = result < 0 ? errno : EMSGSIZE;
+    logger.warning() << "Failed to send netlink requests:" << strerror(error);
+    for (int i = first; i < last; ++i) {
+      m_errors[i] = error;
+    }
+    return false;
+  }
+
+  return readAcks(firstSequence, first, last);
+}
+
+bool NetlinkTransaction::readAcks(uint32_t firstSequence, int first,
+                                  int last) {
+  char buf[ACK_BUFFER_SIZE];
+  int pending = last - first;
+
+  // rtnetlink handles the requests within sendmsg(): all their ACKs are
+  // queued by the time it returns, and there is nothing to wait for.
+  while (pending > 0) {
+    ssize_t len = recv(m_nlsock, buf, sizeof(buf), MSG_DONTWAIT);
+    if (len < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      int error = errno == EAGAIN ? ENOMSG : errno;
+      if (error == ENOMSG) {
+        logger.warning() << "Missing" << pending << "netlink ACKs";
+      } else {
+        logger.warning() << "Failed to receive netlink ACKs:"
+                         << strerror(error);
+      }
+      for (int i = first; i < last; ++i) {
+        if (m_errors.at(i) == EINPROGRESS) {
+          m_errors[i] = error;
+        }
+      }
+      return false;
+    }
+
+    struct nlmsghdr* nlmsg = reinterpret_cast<struct nlmsghdr*>(buf);
+    for (; NLMSG_OK(nlmsg, len); nlmsg = NLMSG_NEXT(nlmsg, len)) {
+      if (nlmsg->nlmsg_type != NLMSG_ERROR) {
+        continue;
+      }
+
+      // Sequence numbers can wrap: compare the distance from the first one.
+      uint32_t index = nlmsg->nlmsg_seq - firstSequence;
+      if (index >= static_cast<uint32_t>(last - first)) {
+        continue;
+      }
+
+      int& error = m_errors[first + index];
+      if (error != EINPROGRESS) {
+        continue;
+      }
+
+      struct nlmsgerr* err = static_cast<struct nlmsgerr*>(NLMSG_DATA(nlmsg));
+      error = -err->error;
+      pending--;
+    }
+  }
+
+  return true;
+}
+
+void NetlinkTransaction::rollback() {
+  NetlinkTransaction revert(m_nlsock, m_sequence);
+
+  for (int i = m_offsets.length() - 1; i >= 0; --i) {
+    const Undo& action = m_undo.at(i);
+    if (m_errors.at(i) != 0 || action.type == 0) {
+      continue;
+    }
+
+    revert.append(reinterpret_cast<const struct nlmsghdr*>(
+        m_buffer.constData() + m_offsets.at(i)));
+
+    struct nlmsghdr* nlmsg = reinterpret_cast<struct nlmsghdr*>(
+        revert.m_buffer.data() + revert.m_offsets.last());
+    nlmsg->nlmsg_type = action.type;
+    nlmsg->nlmsg_flags = action.flags | NLM_F_REQUEST | NLM_F_ACK;
+  }
+
+  if (revert.isEmpty()) {
+    return;
+  }
+
+  logger.info() << "Rolling back" << revert.count() << "netlink requests";
+  if (!revert.commit()) {
+    logger.warning() << "Failed to roll back some netlink requests";
+  }
+}
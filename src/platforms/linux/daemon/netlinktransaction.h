@@ -0,0 +1,70 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef NETLINKTRANSACTION_H
+#define NETLINKTRANSACTION_H
+
+#include <QByteArray>
+#include <QVector>
+
+#include <cstdint>
+
+struct nlmsghdr;
+
+// Batch of rtnetlink requests sent with as few sendmsg() calls as possible.
+//
+// Every message gets its own sequence number and requests an ACK, and the
+// ACKs are matched back to the messages by sequence number when the
+// transaction is committed. The kernel handles the requests synchronously, so
+// committing never waits for the event loop.
+//
+// A message can carry an "undo" type (for instance RTM_DELROUTE for an
+// RTM_NEWROUTE) used to revert the messages which succeeded when another one
+// of the batch failed. Only the messages which create something, and fail
+// with NLM_F_EXCL if it's already there, should have one: undoing a
+// replacement would delete what was there before.
+class NetlinkTransaction final {
+ public:
+  NetlinkTransaction(int nlsock, uint32_t& sequence);
+  ~NetlinkTransaction();
+
+  // Copies the message into the batch. The sequence number, the port ID and
+  // the NLM_F_ACK flag are set by the transaction.
+  void append(const struct nlmsghdr* nlmsg, int undoType = 0,
+              int undoFlags = 0);
+
+  int count() const { return m_offsets.length(); }
+  bool isEmpty() const { return m_offsets.isEmpty(); }
+
+  // Sends the batch and reads all the ACKs. Returns false if any message
+  // failed.
+  bool commit();
+
+  // Error code (errno) of the message at `index`, 0 on success.
+  int error(int index) const { return m_errors.at(index); }
+
+  // Sends the undo messages of the requests which succeeded, newest first.
+  void rollback();
+
+ private:
+  struct Undo {
+    int type;
+    int flags;
+  };
+
+  bool sendChunk(int first, int last);
+  bool readAcks(uint32_t firstSequence, int first, int last);
+
+ private:
+  int m_nlsock;
+  uint32_t& m_sequence;
+
+  // Messages are stored back to back, each one aligned to NLMSG_ALIGNTO.
+  QByteArray m_buffer;
+  QVector<int> m_offsets;
+  QVector<Undo> m_undo;
+  QVector<int> m_errors;
+};
+
+#endif  // NETLINKTRANSACTION_H
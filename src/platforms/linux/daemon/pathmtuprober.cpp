@@ -0,0 +1,185 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "pathmtuprober.h"
+#include "leakdetector.h"
+#include "logger.h"
+#include "platforms/linux/linuxpingsender.h"
+#include "wireguardutilslinux.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <QScopeGuard>
+
+// Every IPv4 host must accept datagrams of this size: if the pings of this
+// size are not answered, the host doesn't answer pings at all.
+constexpr int PROBE_MIN_SIZE = 576;
+
+// The search stops when the bounds are this close.
+constexpr int PROBE_GRANULARITY = 8;
+
+constexpr int PROBE_TIMEOUT_MSEC = 1000;
+constexpr int PROBE_ATTEMPTS = 2;
+
+// Any port will do: the socket is connected to look up the route, and nothing
+// is sent.
+constexpr quint16 PROBE_ROUTE_PORT = 51820;
+
+namespace {
+Logger logger(LOG_LINUX, "PathMtuProber");
+
+PingSender* createPingSender() {
+  LinuxPingSender* pingSender = new LinuxPingSender(QString());
+  pingSender->setFirewallMark(WG_FIREWALL_MARK);
+  return pingSender;
+}
+}  // namespace
+
+PathMtuProber::PathMtuProber(QObject* parent)
+    : PathMtuProber(createPingSender(), parent) {}
+
+PathMtuProber::PathMtuProber(PingSender* pingSender, QObject* parent)
+    : QObject(parent), m_pingSender(pingSender) {
+  MVPN_COUNT_CTOR(PathMtuProber);
+
+  m_pingSender->setParent(this);
+  connect(m_pingSender, &PingSender::recvPing, this,
+          &PathMtuProber::probeReceived);
+
+  m_timer.setSingleShot(true);
+  connect(&m_timer, &QTimer::timeout, this, &PathMtuProber::probeTimedOut);
+}
+
+PathMtuProber::~PathMtuProber() { MVPN_COUNT_DTOR(PathMtuProber); }
+
+// static
+int PathMtuProber::kernelPathMtu(const QString& dest) {
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(PROBE_ROUTE_PORT);
+  if (inet_pton(AF_INET, dest.toLocal8Bit().constData(), &addr.sin_addr) !=
+      1) {
+    return 0;
+  }
+
+  int sockfd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP);
+  if (sockfd < 0) {
+    logger.warning() << "Failed to create the route socket:" << strerror(errno);
+    return 0;
+  }
+  auto guard = qScopeGuard([&] { close(sockfd); });
+
+  // Without the mark, the route goes through the tunnel once it is up.
+  uint32_t mark = WG_FIREWALL_MARK;
+  if (setsockopt(sockfd, SOL_SOCKET, SO_MARK, &mark, sizeof(mark)) != 0) {
+    logger.warning() << "Failed to set the firewall mark:" << strerror(errno);
+    return 0;
+  }
+
+  if (connect(sockfd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+    logger.warning() << "No route to" << dest << "-" << strerror(errno);
+    return 0;
+  }
+
+  int mtu = 0;
+  socklen_t len = sizeof(mtu);
+  if (getsockopt(sockfd, IPPROTO_IP, IP_MTU, &mtu, &len) != 0) {
+    logger.warning() << "Failed to read the path MTU:" << strerror(errno);
+    return 0;
+  }
+
+  return mtu;
+}
+
+void PathMtuProber::start(const QString& dest, int upperBound) {
+  stop();
+
+  if (!m_pingSender->setProbeSize(PROBE_MIN_SIZE)) {
+    logger.warning() << "Path MTU probes are not supported";
+    return;
+  }
+
+  logger.debug() << "Probing the path MTU up to" << upperBound;
+
+  m_dest = dest;
+  m_size = qMax(upperBound, PROBE_MIN_SIZE);
+  m_low = 0;
+  m_high = m_size + 1;
+  sendProbe();
+}
+
+void PathMtuProber::stop() {
+  if (!isRunning()) {
+    return;
+  }
+
+  m_timer.stop();
+  m_dest.clear();
+  m_pingSender->setProbeSize(0);
+}
+
+void PathMtuProber::sendProbe() {
+  m_attempts = 0;
+  m_pingSender->setProbeSize(m_size);
+  probeTimedOut();
+}
+
+void PathMtuProber::probeReceived(quint16 sequence) {
+  // Answers to all the attempts at the current size are accepted.
+  quint16 age = m_sequence - sequence;
+  if (!isRunning() || age >= m_attempts) {
+    return;
+  }
+
+  m_timer.stop();
+  next(true);
+}
+
+void PathMtuProber::probeTimedOut() {
+  if (m_attempts >= PROBE_ATTEMPTS) {
+    next(false);
+    return;
+  }
+
+  ++m_attempts;
+  m_pingSender->sendPing(m_dest, ++m_sequence);
+  m_timer.start(PROBE_TIMEOUT_MSEC);
+}
+
+void PathMtuProber::next(bool success) {
+  if (success) {
+    m_low = m_size;
+  } else {
+    m_high = m_size;
+  }
+
+  if (m_low == 0) {
+    if (m_size == PROBE_MIN_SIZE) {
+      logger.debug() << "No answer from" << m_dest << "- giving up";
+      stop();
+      return;
+    }
+
+    m_size = PROBE_MIN_SIZE;
+    sendProbe();
+    return;
+  }
+
+  if (m_high - m_low <= PROBE_GRANULARITY) {
+    int mtu = m_low;
+    logger.debug() << "Path MTU discovered:" << mtu;
+    stop();
+    emit discovered(mtu);
+    return;
+  }
+
+  m_size = (m_low + m_high) / 2;
+  sendProbe();
+}
@@ -0,0 +1,83 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef PATHMTUPROBER_H
+#define PATHMTUPROBER_H
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+class PingSender;
+
+#ifdef UNIT_TEST
+class TestPathMtuProber;
+#endif
+
+// Packetization layer path MTU discovery towards an IPv4 host (RFC 4821),
+// with ICMP echo requests of increasing size sent with the DF bit set.
+//
+// ICMP "fragmentation needed" errors are often filtered on the way, so the
+// prober doesn't rely on them: a size is good when its echo is answered. The
+// largest size is tried first, which is what most paths support, then the
+// prober checks that the host answers small pings at all and bisects.
+//
+// The probes, and the route looked up by kernelPathMtu(), carry
+// WG_FIREWALL_MARK: they measure the path outside of the VPN tunnel, even
+// when the default route goes through it.
+class PathMtuProber final : public QObject {
+  Q_OBJECT
+  Q_DISABLE_COPY_MOVE(PathMtuProber)
+
+#ifdef UNIT_TEST
+  friend class TestPathMtuProber;
+#endif
+
+ public:
+  explicit PathMtuProber(QObject* parent = nullptr);
+  // Probes with `pingSender`, which must support PingSender::setProbeSize().
+  // The prober takes its ownership.
+  PathMtuProber(PingSender* pingSender, QObject* parent);
+  ~PathMtuProber();
+
+  // Path MTU towards `dest` outside of the tunnel, as currently known by the
+  // kernel: the MTU of the route, lowered by the ICMP errors received so far.
+  // 0 on errors.
+  static int kernelPathMtu(const QString& dest);
+
+  // Restarts the discovery. Sizes above `upperBound` are not tried.
+  void start(const QString& dest, int upperBound);
+  void stop();
+
+  bool isRunning() const { return !m_dest.isEmpty(); }
+
+ signals:
+  // Not emitted if the host doesn't answer the pings.
+  void discovered(int mtu);
+
+ private:
+  void sendProbe();
+  void probeReceived(quint16 sequence);
+  void probeTimedOut();
+
+  // Moves to the next size, or ends the discovery.
+  void next(bool success);
+
+ private:
+  PingSender* m_pingSender = nullptr;
+  QTimer m_timer;
+
+  QString m_dest;
+  quint16 m_sequence = 0;
+  int m_attempts = 0;
+
+  // Current probe size, and the bounds of the search: `m_low` is the largest
+  // size known to go through (0 until one does), `m_high` the smallest known
+  // to be dropped.
+  int m_size = 0;
+  int m_low = 0;
+  int m_high = 0;
+};
+
+#endif  // PATHMTUPROBER_H
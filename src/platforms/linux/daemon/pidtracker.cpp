@@ -6,9 +6,16 @@
 #include "leakdetector.h"
 #include "logger.h"
 
+#include <QHash>
+#include <QMultiHash>
+#include <QPair>
+
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <limits.h>
 #include <sys/select.h>
@@ -22,14 +29,173 @@
 constexpr size_t CN_MCAST_MSG_SIZE =
     sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op);
 
+// Datagrams received per system call, and batches read per wakeup before
+// going back to the event loop.
+constexpr int PROC_EVENT_BATCH = 64;
+constexpr int PROC_EVENT_MAX_BATCHES = 64;
+
+// Larger than any proc connector datagram.
+constexpr int PROC_EVENT_SIZE = 512;
+
+// Room for the events of a fork storm while the daemon is busy.
+constexpr int PROC_EVENT_RCVBUF = 4 * 1024 * 1024;
+
+constexpr int PID_TABLE_MIN_CAPACITY = 64;
+
 namespace {
 Logger logger(LOG_LINUX, "PidTracker");
+}  // namespace
+
+struct PidTracker::ReadBuffers {
+  char data[PROC_EVENT_BATCH][PROC_EVENT_SIZE];
+  struct iovec iov[PROC_EVENT_BATCH];
+  struct sockaddr_nl addr[PROC_EVENT_BATCH];
+  struct mmsghdr msgs[PROC_EVENT_BATCH];
+};
+
+PidTable::PidTable() { rehash(PID_TABLE_MIN_CAPACITY); }
+
+int PidTable::slot(int pid) const {
+  quint32 hash = static_cast<quint32>(pid) * 2654435769u;
+  return static_cast<int>(hash ^ (hash >> 16)) & m_mask;
+}
+
+PidTable::Entry* PidTable::probe(int pid) {
+  Q_ASSERT(pid > 0);
+  Entry* entries = m_entries.data();
+  int i = slot(pid);
+  while (entries[i].pid != pid && entries[i].pid != 0) {
+    i = (i + 1) & m_mask;
+  }
+  return &entries[i];
+}
+
+PidTable::Entry* PidTable::find(int pid) {
+  Entry* entry = probe(pid);
+  return entry->pid == pid ? entry : nullptr;
+}
+
+PidTable::Entry* PidTable::insert(int pid) {
+  /* Keep the load factor under 1/2, so that the clusters stay short. */
+  if ((m_count + 1) * 2 > m_entries.size()) {
+    rehash(m_entries.size() * 2);
+  }
+
+  Entry* entry = probe(pid);
+  if (entry->pid == 0) {
+    entry->pid = pid;
+    ++m_count;
+  }
+  return entry;
+}
+
+void PidTable::remove(int pid) {
+  Entry* entries = m_entries.data();
+  int hole = probe(pid) - entries;
+  if (entries[hole].pid == 0) {
+    return;
+  }
+
+  /* Move back the entries of the cluster which the hole would hide. */
+  for (int i = (hole + 1) & m_mask; entries[i].pid != 0;
+       i = (i + 1) & m_mask) {
+    int home = slot(entries[i].pid);
+    bool reachable = hole < i ? (home > hole && home <= i)
+                              : (home > hole || home <= i);
+    if (!reachable) {
+      entries[hole] = entries[i];
+      hole = i;
+    }
+  }
+
+  entries[hole] = Entry();
+  --m_count;
+}
+
+void PidTable::clear() { rehash(PID_TABLE_MIN_CAPACITY); }
+
+void PidTable::swap(PidTable& other) {
+  m_entries.swap(other.m_entries);
+  qSwap(m_mask, other.m_mask);
+  qSwap(m_count, other.m_count);
+}
+
+QList<int> PidTable::keys() const {
+  QList<int> list;
+  list.reserve(m_count);
+  for (const Entry& entry : m_entries) {
+    if (entry.pid != 0) {
+      list.append(entry.pid);
+    }
+  }
+  return list;
+}
+
+void PidTable::rehash(int capacity) {
+  Q_ASSERT((capacity & (capacity - 1)) == 0);
+
+  QVector<Entry> old;
+  old.swap(m_entries);
+  m_entries.resize(capacity);
+  m_mask = capacity - 1;
+
+  for (const Entry& entry : old) {
+    if (entry.pid != 0) {
+      *probe(entry.pid) = entry;
+    }
+  }
+}
+
+// static
+bool PidTracker::readProcStat(int pid, int& ppid, uint& threads) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+
+  char buf[1024];
+  ssize_t len = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  if (len <= 0) {
+    return false;
+  }
+  buf[len] = '\0';
+
+  /* The command name can contain anything: skip it up to the last paren. */
+  const char* fields = strrchr(buf, ')');
+  if (!fields) {
+    return false;
+  }
+
+  /* Fields 3 (state), 4 (ppid) and 20 (num_threads) of proc(5). */
+  char state;
+  if (sscanf(fields + 1,
+             " %c %d %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s "
+             "%*s %u",
+             &state, &ppid, &threads) != 3) {
+    return false;
+  }
+
+  /* Zombies already sent their exit events. */
+  return state != 'Z' && state != 'X' && threads > 0;
 }
 
-PidTracker::PidTracker(QObject* parent) : QObject(parent) {
+PidTracker::PidTracker(QObject* parent)
+    : QObject(parent), m_readBuffers(new ReadBuffers) {
   MVPN_COUNT_CTOR(PidTracker);
   logger.debug() << "PidTracker created.";
 
+  memset(m_readBuffers.data(), 0, sizeof(ReadBuffers));
+  for (int i = 0; i < PROC_EVENT_BATCH; ++i) {
+    m_readBuffers->iov[i].iov_base = m_readBuffers->data[i];
+    m_readBuffers->iov[i].iov_len = PROC_EVENT_SIZE;
+    m_readBuffers->msgs[i].msg_hdr.msg_name = &m_readBuffers->addr[i];
+    m_readBuffers->msgs[i].msg_hdr.msg_iov = &m_readBuffers->iov[i];
+    m_readBuffers->msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
   m_nlsock = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_CONNECTOR);
   if (m_nlsock < 0) {
     logger.error() << "Failed to create netlink socket:" << strerror(errno);
@@ -48,6 +214,16 @@ PidTracker::PidTracker(QObject* parent) : QObject(parent) {
     return;
   }
 
+  /* Make room for bursts of events, beyond rmem_max if we are allowed to. */
+  int rcvbuf = PROC_EVENT_RCVBUF;
+  if (setsockopt(m_nlsock, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf,
+                 sizeof(rcvbuf)) < 0 &&
+      setsockopt(m_nlsock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) <
+          0) {
+    logger.warning() << "Failed to enlarge the netlink socket buffer:"
+                     << strerror(errno);
+  }
+
   char buf[NLMSG_SPACE(CN_MCAST_MSG_SIZE)];
   struct nlmsghdr* nlmsg = (struct nlmsghdr*)buf;
   struct cn_msg* cnmsg = (struct cn_msg*)NLMSG_DATA(nlmsg);
@@ -94,103 +270,147 @@ PidTracker::~PidTracker() {
 }
 
 ProcessGroup* PidTracker::track(const QString& name, int rootpid) {
-  ProcessGroup* group = m_processTree.value(rootpid, nullptr);
-  if (group) {
+  PidTable::Entry* entry = m_processTree.find(rootpid);
+  if (entry) {
     logger.warning() << "Ignoring attempt to track duplicate PID";
-    return group;
+    return entry->group;
   }
-  group = new ProcessGroup(name, rootpid);
-  group->kthreads[rootpid] = 1;
+  ProcessGroup* group = new ProcessGroup(name, rootpid);
+  group->pids.insert(rootpid);
   group->refcount = 1;
 
   m_processGroups.append(group);
-  m_processTree[rootpid] = group;
+  entry = m_processTree.insert(rootpid);
+  entry->threads = 1;
+  entry->group = group;
 
   return group;
 }
 
+ProcessGroup* PidTracker::group(int pid) {
+  PidTable::Entry* entry = m_processTree.find(pid);
+  return entry ? entry->group : nullptr;
+}
+
 void PidTracker::handleProcEvent(struct cn_msg* cnmsg) {
   struct proc_event* ev = (struct proc_event*)cnmsg->data;
 
   if (ev->what == proc_event::PROC_EVENT_FORK) {
     auto forkdata = &ev->event_data.fork;
     /* If the child process already exists, track a new kernel thread. */
-    ProcessGroup* group = m_processTree.value(forkdata->child_tgid, nullptr);
-    if (group) {
-      group->kthreads[forkdata->child_tgid]++;
+    PidTable::Entry* entry = m_processTree.find(forkdata->child_tgid);
+    if (entry) {
+      /* A process seen by a resync before its own fork event is not new. */
+      if (forkdata->child_pid != forkdata->child_tgid) {
+        entry->threads++;
+      }
       return;
     }
 
     /* Track a new userspace process if was forked from a known parent. */
-    group = m_processTree.value(forkdata->parent_tgid, nullptr);
-    if (!group) {
+    entry = m_processTree.find(forkdata->parent_tgid);
+    if (!entry) {
       return;
     }
-    m_processTree[forkdata->child_tgid] = group;
-    group->kthreads[forkdata->child_tgid] = 1;
+    ProcessGroup* group = entry->group;
+    entry = m_processTree.insert(forkdata->child_tgid);
+    entry->threads = 1;
+    entry->group = group;
+    group->pids.insert(forkdata->child_tgid);
     group->refcount++;
     emit pidForked(group->name, forkdata->parent_tgid, forkdata->child_tgid);
   }
 
   if (ev->what == proc_event::PROC_EVENT_EXIT) {
     auto exitdata = &ev->event_data.exit;
-    ProcessGroup* group = m_processTree.value(exitdata->process_tgid, nullptr);
-    if (!group) {
+    PidTable::Entry* entry = m_processTree.find(exitdata->process_tgid);
+    if (!entry) {
       return;
     }
 
     /* Decrement the number of kernel threads in this userspace process. */
-    uint threadcount = group->kthreads.value(exitdata->process_tgid, 0);
-    if (threadcount == 0) {
+    if (entry->threads > 1) {
+      entry->threads--;
       return;
     }
-    if (threadcount > 1) {
-      group->kthreads[exitdata->process_tgid] = threadcount - 1;
-      return;
-    }
-    group->kthreads.remove(exitdata->process_tgid);
+    removeProcess(entry->group, exitdata->process_tgid);
+  }
+}
 
-    /* A userspace process exits when all of its kernel threads exit. */
-    Q_ASSERT(group->refcount > 0);
-    group->refcount--;
-    if (group->refcount == 0) {
-      emit terminated(group->name, group->rootpid);
-      m_processGroups.removeAll(group);
-      delete group;
-    }
+void PidTracker::removeProcess(ProcessGroup* group, int pid) {
+  m_processTree.remove(pid);
+  group->pids.remove(pid);
+
+  /* A userspace process exits when all of its kernel threads exit. */
+  Q_ASSERT(group->refcount > 0);
+  group->refcount--;
+  if (group->refcount == 0) {
+    emit terminated(group->name, group->rootpid);
+    m_processGroups.removeAll(group);
+    delete group;
   }
 }
 
 void PidTracker::readData() {
-  struct sockaddr_nl src;
-  socklen_t srclen = sizeof(src);
-  ssize_t recvlen;
-
-  recvlen = recvfrom(m_nlsock, m_readBuf, sizeof(m_readBuf), MSG_DONTWAIT,
-                     (struct sockaddr*)&src, &srclen);
-  if (recvlen == ENOBUFS) {
-    logger.error()
-        << "Failed to read netlink socket: buffer full, message dropped";
-    return;
-  }
-  if (recvlen < 0) {
-    logger.error() << "Failed to read netlink socket:" << strerror(errno);
-    return;
-  }
-  if (srclen != sizeof(src)) {
-    logger.error() << "Failed to read netlink socket: invalid address length";
-    return;
+  ReadBuffers* buffers = m_readBuffers.data();
+  bool overflow = false;
+
+  /* Drain the socket, a batch of datagrams per system call. */
+  for (int batch = 0; batch < PROC_EVENT_MAX_BATCHES; ++batch) {
+    for (int i = 0; i < PROC_EVENT_BATCH; ++i) {
+      buffers->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_nl);
+    }
+
+    int count = recvmmsg(m_nlsock, buffers->msgs, PROC_EVENT_BATCH,
+                         MSG_DONTWAIT, nullptr);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == ENOBUFS) {
+        /* The events which didn't fit are lost, the next ones are not. */
+        m_counters.dropped++;
+        overflow = true;
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        logger.error() << "Failed to read netlink socket:" << strerror(errno);
+      }
+      break;
+    }
+
+    for (int i = 0; i < count; ++i) {
+      const struct msghdr& hdr = buffers->msgs[i].msg_hdr;
+      const struct sockaddr_nl& src = buffers->addr[i];
+      if (hdr.msg_namelen != sizeof(src)) {
+        logger.error()
+            << "Failed to read netlink socket: invalid address length";
+        continue;
+      }
+
+      /* We are only interested in process-control messages from the kernel */
+      if ((src.nl_groups != CN_IDX_PROC) || (src.nl_pid != 0)) {
+        continue;
+      }
+
+      handleDatagram(buffers->data[i], buffers->msgs[i].msg_len);
+    }
+
+    if (count < PROC_EVENT_BATCH) {
+      break;
+    }
   }
 
-  /* We are only interested in process-control messages from the kernel */
-  if ((src.nl_groups != CN_IDX_PROC) || (src.nl_pid != 0)) {
-    return;
+  if (overflow) {
+    resync();
   }
+}
 
+void PidTracker::handleDatagram(char* data, int length) {
   /* Handle the process-control messages. */
   struct nlmsghdr* msg;
-  for (msg = (struct nlmsghdr*)m_readBuf; NLMSG_OK(msg, recvlen);
-       msg = NLMSG_NEXT(msg, recvlen)) {
+  for (msg = (struct nlmsghdr*)data; NLMSG_OK(msg, length);
+       msg = NLMSG_NEXT(msg, length)) {
     struct cn_msg* cnmsg = (struct cn_msg*)NLMSG_DATA(msg);
     if (msg->nlmsg_type == NLMSG_NOOP) {
       continue;
@@ -199,6 +419,7 @@ void PidTracker::readData() {
         (msg->nlmsg_type == NLMSG_OVERRUN)) {
       break;
     }
+    m_counters.processed++;
     handleProcEvent(cnmsg);
     if (msg->nlmsg_type == NLMSG_DONE) {
       break;
@@ -206,22 +427,96 @@ void PidTracker::readData() {
   }
 }
 
-bool ProcessGroup::moveToCgroup(const QString& name) {
-  /* Do nothing if Cgroups are not supported. */
-  if (name.isNull()) {
-    return true;
+void PidTracker::resync() {
+  m_counters.resynced++;
+  logger.warning() << "Process events dropped - rescanning /proc. Processed:"
+                   << m_counters.processed
+                   << "overflows:" << m_counters.dropped
+                   << "resyncs:" << m_counters.resynced;
+
+  DIR* dir = opendir("/proc");
+  if (!dir) {
+    logger.error() << "Failed to open /proc:" << strerror(errno);
+    return;
   }
 
-  QString cgProcsFile = name + "/cgroup.procs";
-  FILE* fp = fopen(qPrintable(cgProcsFile), "w");
-  if (!fp) {
-    return false;
+  /* Read the parent and the thread count of every live process. */
+  QMultiHash<int, int> children;
+  QHash<int, uint> threads;
+  while (struct dirent* ent = readdir(dir)) {
+    char* end;
+    long pid = strtol(ent->d_name, &end, 10);
+    if (*end != '\0' || pid <= 0 || pid > INT_MAX) {
+      continue;
+    }
+    int ppid;
+    uint count;
+    if (readProcStat(static_cast<int>(pid), ppid, count)) {
+      children.insert(ppid, pid);
+      threads.insert(pid, count);
+    }
+  }
+  closedir(dir);
+
+  /* The tracked processes which are still alive stay in their groups... */
+  PidTable tree;
+  QList<int> queue;
+  for (int pid : m_processTree.keys()) {
+    auto i = threads.constFind(pid);
+    if (i == threads.constEnd()) {
+      continue;
+    }
+    PidTable::Entry* entry = tree.insert(pid);
+    entry->threads = i.value();
+    entry->group = m_processTree.find(pid)->group;
+    queue.append(pid);
   }
 
-  for (auto pid : kthreads.keys()) {
-    fprintf(fp, "%d\n", pid);
-    fflush(fp);
+  /* ...and their descendants, forked while the events were dropped, join. */
+  QList<QPair<int, int>> forked;
+  while (!queue.isEmpty()) {
+    int pid = queue.takeFirst();
+    ProcessGroup* group = tree.find(pid)->group;
+    for (int child : children.values(pid)) {
+      if (tree.find(child)) {
+        continue;
+      }
+      PidTable::Entry* entry = tree.insert(child);
+      entry->threads = threads.value(child);
+      entry->group = group;
+      queue.append(child);
+      if (!m_processTree.find(child)) {
+        forked.append(qMakePair(pid, child));
+      }
+    }
   }
-  fclose(fp);
-  return true;
+  m_processTree.swap(tree);
+
+  /* Recount the groups. The ones left empty are gone. */
+  for (ProcessGroup* group : m_processGroups) {
+    group->pids.clear();
+    group->refcount = 0;
+  }
+  for (int pid : m_processTree.keys()) {
+    ProcessGroup* group = m_processTree.find(pid)->group;
+    group->pids.insert(pid);
+    group->refcount++;
+  }
+
+  for (const auto& pair : forked) {
+    emit pidForked(m_processTree.find(pair.second)->group->name, pair.first,
+                   pair.second);
+  }
+
+  const QList<ProcessGroup*> groups = m_processGroups;
+  for (ProcessGroup* group : groups) {
+    if (group->refcount == 0) {
+      emit terminated(group->name, group->rootpid);
+      m_processGroups.removeAll(group);
+      delete group;
+    }
+  }
+
+  logger.debug() << "Tracking" << m_processTree.count() << "processes in"
+                 << m_processGroups.count() << "groups";
 }
@@ -7,13 +7,20 @@
 
 #include <QHash>
 #include <QList>
+#include <QScopedPointer>
+#include <QSet>
 #include <QSocketNotifier>
 #include <QString>
+#include <QVector>
 
 #include "leakdetector.h"
 
 struct cn_msg;
 
+#ifdef UNIT_TEST
+class TestPidTracker;
+#endif
+
 class ProcessGroup {
  public:
   ProcessGroup(const QString& groupName, int groupRootPid,
@@ -26,15 +33,60 @@ class ProcessGroup {
   }
   ~ProcessGroup() { MVPN_COUNT_DTOR(ProcessGroup); }
 
-  bool moveToCgroup(const QString& name);
-
-  QHash<int, uint> kthreads;
+  // The userspace processes of the group. Their thread counts are kept by
+  // the PidTracker.
+  QSet<int> pids;
+  // Control groups of the processes before the firewall moved them, by pid:
+  // they go back there when the application is active again.
+  QHash<int, QString> cgroups;
   QString name;
   QString state;
   int rootpid;
   int refcount;
 };
 
+// Open-addressing hash table from the pid of a userspace process to its
+// thread count and its group. Linear probing, no tombstones: removing an entry
+// shifts the following ones of the same cluster back.
+class PidTable final {
+ public:
+  struct Entry {
+    int pid = 0;
+    uint threads = 0;
+    ProcessGroup* group = nullptr;
+  };
+
+  PidTable();
+
+  // The returned pointer is valid until the next insert() or remove().
+  Entry* find(int pid);
+
+  // Returns the entry of the pid, adding an empty one if it doesn't exist.
+  Entry* insert(int pid);
+  void remove(int pid);
+
+  void clear();
+  void swap(PidTable& other);
+
+  int count() const { return m_count; }
+  QList<int> keys() const;
+
+ private:
+  int slot(int pid) const;
+  // The entry of the pid, or the empty one where it would be added.
+  Entry* probe(int pid);
+  void rehash(int capacity);
+
+ private:
+  QVector<Entry> m_entries;
+  int m_mask = 0;
+  int m_count = 0;
+
+#ifdef UNIT_TEST
+  friend class TestPidTracker;
+#endif
+};
+
 class PidTracker final : public QObject {
   Q_OBJECT
   Q_DISABLE_COPY_MOVE(PidTracker)
@@ -48,7 +100,15 @@ class PidTracker final : public QObject {
   QList<int> pids() { return m_processTree.keys(); }
   QList<ProcessGroup*>::iterator begin() { return m_processGroups.begin(); }
   QList<ProcessGroup*>::iterator end() { return m_processGroups.end(); }
-  ProcessGroup* group(int pid) { return m_processTree.value(pid); }
+  ProcessGroup* group(int pid);
+
+  struct Counters {
+    quint64 processed = 0;
+    // Times the socket buffer overflowed: one or more events were lost.
+    quint64 dropped = 0;
+    quint64 resynced = 0;
+  };
+  const Counters& counters() const { return m_counters; }
 
  signals:
   void pidForked(const QString& name, int parent, int child);
@@ -56,17 +116,32 @@ class PidTracker final : public QObject {
   void terminated(const QString& name, int rootpid);
 
  private:
+  void handleDatagram(char* data, int length);
   void handleProcEvent(struct cn_msg*);
+  void removeProcess(ProcessGroup* group, int pid);
+
+  // Reads the parent and the thread count of a process from /proc.
+  static bool readProcStat(int pid, int& ppid, uint& threads);
+
+  // Rebuilds the process tree from /proc after the kernel dropped events.
+  void resync();
 
  private slots:
   void readData();
 
  private:
+  struct ReadBuffers;
+
   int m_nlsock;
-  char m_readBuf[2048];
+  QScopedPointer<ReadBuffers> m_readBuffers;
   QSocketNotifier* m_socket = nullptr;
-  QHash<int, ProcessGroup*> m_processTree;
+  PidTable m_processTree;
   QList<ProcessGroup*> m_processGroups;
+  Counters m_counters;
+
+#ifdef UNIT_TEST
+  friend class TestPidTracker;
+#endif
 };
 
 #endif  // PIDTRACKER_H
@@ -0,0 +1,419 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wireguardstatscache.h"
+#include "leakdetector.h"
+#include "logger.h"
+
+#include <errno.h>
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+// From linux/wireguard.h, which is not available on all the supported
+// distributions.
+constexpr const char* WG_GENL_NAME = "wireguard";
+constexpr uint8_t WG_GENL_VERSION = 1;
+constexpr uint8_t WG_CMD_GET_DEVICE = 0;
+constexpr uint16_t WGDEVICE_A_IFNAME = 2;
+constexpr uint16_t WGDEVICE_A_PEERS = 8;
+constexpr uint16_t WGPEER_A_PUBLIC_KEY = 1;
+constexpr uint16_t WGPEER_A_LAST_HANDSHAKE_TIME = 6;
+constexpr uint16_t WGPEER_A_RX_BYTES = 7;
+constexpr uint16_t WGPEER_A_TX_BYTES = 8;
+
+// A dump message fits in a page on most systems, but the kernel can use up to
+// 32KB.
+constexpr int RECV_BUFFER_SIZE = 32768;
+constexpr int REQUEST_BUFFER_SIZE = 256;
+constexpr int RECV_TIMEOUT_MSEC = 1000;
+
+namespace {
+Logger logger(LOG_LINUX, "WireguardStatsCache");
+
+qint64 clockMsec(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return static_cast<qint64>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+const struct nlattr* firstAttr(const void* data) {
+  return reinterpret_cast<const struct nlattr*>(data);
+}
+
+const struct nlattr* nextAttr(const struct nlattr* attr) {
+  return reinterpret_cast<const struct nlattr*>(
+      reinterpret_cast<const char*>(attr) + NLA_ALIGN(attr->nla_len));
+}
+
+bool attrOk(const struct nlattr* attr, int remaining) {
+  return remaining >= static_cast<int>(sizeof(struct nlattr)) &&
+         attr->nla_len >= sizeof(struct nlattr) && attr->nla_len <= remaining;
+}
+
+const void* attrData(const struct nlattr* attr) {
+  return reinterpret_cast<const char*>(attr) + NLA_HDRLEN;
+}
+
+int attrDataLen(const struct nlattr* attr) {
+  return attr->nla_len - NLA_HDRLEN;
+}
+
+int attrType(const struct nlattr* attr) {
+  return attr->nla_type & NLA_TYPE_MASK;
+}
+
+// Iterates over the attributes in [data, data + len).
+template <typename F>
+void forEachAttr(const void* data, int len, F&& callback) {
+  const struct nlattr* attr = firstAttr(data);
+  while (attrOk(attr, len)) {
+    callback(attr);
+    int step = NLA_ALIGN(attr->nla_len);
+    len -= step;
+    attr = nextAttr(attr);
+  }
+}
+
+uint64_t attrU64(const struct nlattr* attr) {
+  uint64_t value = 0;
+  if (attrDataLen(attr) >= static_cast<int>(sizeof(value))) {
+    memcpy(&value, attrData(attr), sizeof(value));
+  }
+  return value;
+}
+
+}  // namespace
+
+WireguardStatsCache::WireguardStatsCache(const char* ifname)
+    : m_ifname(ifname) {
+  MVPN_COUNT_CTOR(WireguardStatsCache);
+  m_buffer.resize(RECV_BUFFER_SIZE);
+}
+
+WireguardStatsCache::~WireguardStatsCache() {
+  MVPN_COUNT_DTOR(WireguardStatsCache);
+  closeSocket();
+}
+
+bool WireguardStatsCache::openSocket() {
+  if (m_socket >= 0) {
+    return true;
+  }
+
+  m_socket = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+  if (m_socket < 0) {
+    logger.warning() << "Failed to create genetlink socket:" << strerror(errno);
+    return false;
+  }
+
+  struct timeval tv;
+  tv.tv_sec = RECV_TIMEOUT_MSEC / 1000;
+  tv.tv_usec = (RECV_TIMEOUT_MSEC % 1000) * 1000;
+  setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  struct sockaddr_nl nladdr;
+  memset(&nladdr, 0, sizeof(nladdr));
+  nladdr.nl_family = AF_NETLINK;
+  if (bind(m_socket, reinterpret_cast<struct sockaddr*>(&nladdr),
+           sizeof(nladdr)) != 0) {
+    logger.warning() << "Failed to bind genetlink socket:" << strerror(errno);
+    closeSocket();
+    return false;
+  }
+
+  if (!resolveFamily()) {
+    closeSocket();
+    return false;
+  }
+
+  return true;
+}
+
+void WireguardStatsCache::closeSocket() {
+  if (m_socket >= 0) {
+    close(m_socket);
+  }
+  m_socket = -1;
+  m_familyId = 0;
+}
+
+bool WireguardStatsCache::sendRequest(uint16_t type, uint8_t cmd,
+                                      uint16_t flags, uint16_t attrId,
+                                      const char* value) {
+  char buf[REQUEST_BUFFER_SIZE];
+  memset(buf, 0, sizeof(buf));
+
+  int attrLen = static_cast<int>(strlen(value)) + 1;
+  int len = NLMSG_LENGTH(GENL_HDRLEN) + NLA_HDRLEN + NLA_ALIGN(attrLen);
+  if (len > REQUEST_BUFFER_SIZE) {
+    return false;
+  }
+
+  struct nlmsghdr* nlmsg = reinterpret_cast<struct nlmsghdr*>(buf);
+  nlmsg->nlmsg_len = len;
+  nlmsg->nlmsg_type = type;
+  nlmsg->nlmsg_flags = NLM_F_REQUEST | flags;
+  nlmsg->nlmsg_seq = ++m_sequence;
+
+  struct genlmsghdr* genl = static_cast<struct genlmsghdr*>(NLMSG_DATA(nlmsg));
+  genl->cmd = cmd;
+  genl->version = type == GENL_ID_CTRL ? 1 : WG_GENL_VERSION;
+
+  struct nlattr* attr = reinterpret_cast<struct nlattr*>(
+      reinterpret_cast<char*>(genl) + GENL_HDRLEN);
+  attr->nla_type = attrId;
+  attr->nla_len = NLA_HDRLEN + attrLen;
+  memcpy(reinterpret_cast<char*>(attr) + NLA_HDRLEN, value, attrLen);
+
+  if (send(m_socket, buf, len, 0) != len) {
+    logger.warning() << "Failed to send genetlink request:" << strerror(errno);
+    return false;
+  }
+
+  return true;
+}
+
+bool WireguardStatsCache::resolveFamily() {
+  if (!sendRequest(GENL_ID_CTRL, CTRL_CMD_GETFAMILY, 0,
+                   CTRL_ATTR_FAMILY_NAME, WG_GENL_NAME)) {
+    return false;
+  }
+
+  ssize_t len = recv(m_socket, m_buffer.data(), m_buffer.size(), 0);
+  if (len < 0) {
+    logger.warning() << "Failed to resolve the genetlink family:"
+                     << strerror(errno);
+    return false;
+  }
+
+  const struct nlmsghdr* nlmsg =
+      reinterpret_cast<const struct nlmsghdr*>(m_buffer.constData());
+  int remaining = static_cast<int>(len);
+  for (; NLMSG_OK(nlmsg, remaining); nlmsg = NLMSG_NEXT(nlmsg, remaining)) {
+    if (nlmsg->nlmsg_seq != m_sequence) {
+      continue;
+    }
+
+    if (nlmsg->nlmsg_type == NLMSG_ERROR) {
+      const struct nlmsgerr* err =
+          static_cast<const struct nlmsgerr*>(NLMSG_DATA(nlmsg));
+      logger.warning() << "WireGuard genetlink family not available:"
+                       << strerror(-err->error);
+      return false;
+    }
+
+    if (nlmsg->nlmsg_type != GENL_ID_CTRL) {
+      continue;
+    }
+
+    const char* payload =
+        static_cast<const char*>(NLMSG_DATA(nlmsg)) + GENL_HDRLEN;
+    int payloadLen = NLMSG_PAYLOAD(nlmsg, GENL_HDRLEN);
+    forEachAttr(payload, payloadLen, [&](const struct nlattr* attr) {
+      if (attrType(attr) == CTRL_ATTR_FAMILY_ID &&
+          attrDataLen(attr) >= static_cast<int>(sizeof(uint16_t))) {
+        memcpy(&m_familyId, attrData(attr), sizeof(uint16_t));
+      }
+    });
+  }
+
+  return m_familyId != 0;
+}
+
+bool WireguardStatsCache::refresh() {
+  if (!openSocket() ||
+      !sendRequest(m_familyId, WG_CMD_GET_DEVICE, NLM_F_DUMP,
+                   WGDEVICE_A_IFNAME, m_ifname.constData())) {
+    closeSocket();
+    m_peers.clear();
+    return false;
+  }
+
+  qint64 now = clockMsec(CLOCK_MONOTONIC);
+  qint64 realNow = clockMsec(CLOCK_REALTIME);
+  ++m_generation;
+
+  bool done = false;
+  int error = 0;
+  while (!done) {
+    ssize_t len = recv(m_socket, m_buffer.data(), m_buffer.size(), 0);
+    if (len < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      error = errno;
+      break;
+    }
+
+    done = parseDump(m_buffer.constData(), static_cast<int>(len), now,
+                     realNow, error);
+  }
+
+  if (error != 0) {
+    // ENODEV is expected when the interface is down: the socket is fine.
+    if (error != ENODEV) {
+      logger.warning() << "Failed to dump" << m_ifname << ":"
+                       << strerror(error);
+      closeSocket();
+    }
+    m_peers.clear();
+    return false;
+  }
+
+  prunePeers();
+  return true;
+}
+
+bool WireguardStatsCache::parseDump(const char* data, int len, qint64 now,
+                                    qint64 realNow, int& error) {
+  const struct nlmsghdr* nlmsg = reinterpret_cast<const struct nlmsghdr*>(data);
+  for (; NLMSG_OK(nlmsg, len); nlmsg = NLMSG_NEXT(nlmsg, len)) {
+    if (nlmsg->nlmsg_seq != m_sequence) {
+      continue;
+    }
+
+    if (nlmsg->nlmsg_type == NLMSG_DONE) {
+      return true;
+    }
+
+    if (nlmsg->nlmsg_type == NLMSG_ERROR) {
+      const struct nlmsgerr* err =
+          static_cast<const struct nlmsgerr*>(NLMSG_DATA(nlmsg));
+      error = -err->error;
+      return true;
+    }
+
+    if (nlmsg->nlmsg_type == m_familyId) {
+      parseDevice(nlmsg, now, realNow);
+    }
+  }
+
+  return false;
+}
+
+void WireguardStatsCache::prunePeers() {
+  int count = 0;
+  for (int i = 0; i < m_peers.length(); ++i) {
+    if (m_peers.at(i).m_generation == m_generation) {
+      if (count != i) {
+        m_peers[count] = m_peers.at(i);
+      }
+      ++count;
+    }
+  }
+  m_peers.resize(count);
+}
+
+void WireguardStatsCache::parseDevice(const struct nlmsghdr* nlmsg,
+                                      qint64 now, qint64 realNow) {
+  const char* payload =
+      static_cast<const char*>(NLMSG_DATA(nlmsg)) + GENL_HDRLEN;
+  int payloadLen = NLMSG_PAYLOAD(nlmsg, GENL_HDRLEN);
+
+  forEachAttr(payload, payloadLen, [&](const struct nlattr* attr) {
+    if (attrType(attr) != WGDEVICE_A_PEERS) {
+      return;
+    }
+
+    // Each peer is a nested attribute in the peer list.
+    forEachAttr(attrData(attr), attrDataLen(attr),
+                [&](const struct nlattr* peer) {
+                  parsePeer(peer, now, realNow);
+                });
+  });
+}
+
+void WireguardStatsCache::parsePeer(const struct nlattr* attr, qint64 now,
+                                    qint64 realNow) {
+  const struct nlattr* keyAttr = nullptr;
+  const struct nlattr* handshakeAttr = nullptr;
+  const struct nlattr* rxAttr = nullptr;
+  const struct nlattr* txAttr = nullptr;
+
+  // The allowed IPs are skipped without being parsed.
+  forEachAttr(attrData(attr), attrDataLen(attr),
+              [&](const struct nlattr* child) {
+                switch (attrType(child)) {
+                  case WGPEER_A_PUBLIC_KEY:
+                    keyAttr = child;
+                    break;
+                  case WGPEER_A_LAST_HANDSHAKE_TIME:
+                    handshakeAttr = child;
+                    break;
+                  case WGPEER_A_RX_BYTES:
+                    rxAttr = child;
+                    break;
+                  case WGPEER_A_TX_BYTES:
+                    txAttr = child;
+                    break;
+                  default:
+                    break;
+                }
+              });
+
+  if (!keyAttr || attrDataLen(keyAttr) != KEY_LEN) {
+    return;
+  }
+
+  const uint8_t* key = static_cast<const uint8_t*>(attrData(keyAttr));
+  Peer* peer = nullptr;
+  for (Peer& candidate : m_peers) {
+    if (memcmp(candidate.m_key, key, KEY_LEN) == 0) {
+      peer = &candidate;
+      break;
+    }
+  }
+  if (!peer) {
+    m_peers.append(Peer());
+    peer = &m_peers.last();
+    memcpy(peer->m_key, key, KEY_LEN);
+  }
+  peer->m_generation = m_generation;
+
+  // A peer with many allowed IPs is split across messages, and only the first
+  // part carries the statistics.
+  if (!rxAttr || !txAttr) {
+    return;
+  }
+
+  qint64 rxBytes = static_cast<qint64>(attrU64(rxAttr));
+  qint64 txBytes = static_cast<qint64>(attrU64(txAttr));
+  qint64 elapsed = now - peer->m_sampleTime;
+  if (peer->m_sampleTime > 0 && elapsed > 0) {
+    peer->m_rxRate = rxBytes >= peer->m_rxBytes
+                         ? (rxBytes - peer->m_rxBytes) * 1000 / elapsed
+                         : 0;
+    peer->m_txRate = txBytes >= peer->m_txBytes
+                         ? (txBytes - peer->m_txBytes) * 1000 / elapsed
+                         : 0;
+  }
+  peer->m_rxBytes = rxBytes;
+  peer->m_txBytes = txBytes;
+  peer->m_sampleTime = now;
+
+  if (handshakeAttr &&
+      attrDataLen(handshakeAttr) >= static_cast<int>(2 * sizeof(int64_t))) {
+    // struct __kernel_timespec
+    int64_t ts[2];
+    memcpy(ts, attrData(handshakeAttr), sizeof(ts));
+    peer->m_handshake = ts[0] * 1000 + ts[1] / 1000000;
+  }
+  peer->m_handshakeAge =
+      peer->m_handshake > 0 ? realNow - peer->m_handshake : -1;
+}
+
+const WireguardStatsCache::Peer* WireguardStatsCache::find(
+    const uint8_t key[KEY_LEN]) const {
+  for (const Peer& peer : m_peers) {
+    if (memcmp(peer.m_key, key, KEY_LEN) == 0) {
+      return &peer;
+    }
+  }
+  return nullptr;
+}
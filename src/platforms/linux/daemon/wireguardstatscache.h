@@ -0,0 +1,91 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef WIREGUARDSTATSCACHE_H
+#define WIREGUARDSTATSCACHE_H
+
+#include <QByteArray>
+#include <QVector>
+
+#include <cstdint>
+
+#ifdef UNIT_TEST
+class TestWireguardStatsCache;
+#endif
+
+// Statistics of the peers of a WireGuard interface, read from a generic
+// netlink socket kept open for the lifetime of the object.
+//
+// Each refresh() is a single WG_CMD_GET_DEVICE dump into a preallocated
+// buffer. The peers are updated in place and looked up by raw public key:
+// after the first refresh, nothing is allocated unless a peer is added.
+class WireguardStatsCache final {
+ public:
+  static constexpr int KEY_LEN = 32;
+
+  struct Peer {
+    uint8_t m_key[KEY_LEN];
+
+    // Last handshake, in msecs since epoch. 0 if none.
+    qint64 m_handshake = 0;
+    qint64 m_rxBytes = 0;
+    qint64 m_txBytes = 0;
+
+    // Computed between the last two refreshes: bytes per second and msecs
+    // since the last handshake. -1 if unknown: the rates need two samples.
+    qint64 m_rxRate = -1;
+    qint64 m_txRate = -1;
+    qint64 m_handshakeAge = -1;
+
+    // Monotonic time of the last refresh which saw the peer.
+    qint64 m_sampleTime = 0;
+    quint32 m_generation = 0;
+  };
+
+  explicit WireguardStatsCache(const char* ifname);
+  ~WireguardStatsCache();
+
+  // Dumps the interface. Returns false (and forgets all the peers) if the
+  // interface doesn't exist or the socket failed.
+  bool refresh();
+
+  const Peer* find(const uint8_t key[KEY_LEN]) const;
+  const QVector<Peer>& peers() const { return m_peers; }
+
+ private:
+  bool openSocket();
+  void closeSocket();
+  bool resolveFamily();
+
+  // Sends a generic netlink request with a single string attribute.
+  bool sendRequest(uint16_t type, uint8_t cmd, uint16_t flags, uint16_t attrId,
+                   const char* value);
+
+  // Parses a datagram of the dump. Returns true when the dump is over, and
+  // sets `error` if it failed.
+  bool parseDump(const char* data, int len, qint64 now, qint64 realNow,
+                 int& error);
+  void parseDevice(const struct nlmsghdr* nlmsg, qint64 now, qint64 realNow);
+  void parsePeer(const struct nlattr* attr, qint64 now, qint64 realNow);
+
+  // Forgets the peers not seen by the last dump.
+  void prunePeers();
+
+ private:
+  const QByteArray m_ifname;
+
+  int m_socket = -1;
+  uint16_t m_familyId = 0;
+  uint32_t m_sequence = 0;
+
+  QByteArray m_buffer;
+  QVector<Peer> m_peers;
+  quint32 m_generation = 0;
+
+#ifdef UNIT_TEST
+  friend class TestWireguardStatsCache;
+#endif
+};
+
+#endif  // WIREGUARDSTATSCACHE_H
@@ -5,6 +5,7 @@
 #include "wireguardutilslinux.h"
 #include "leakdetector.h"
 #include "logger.h"
+#include "netlinktransaction.h"
 #include "platforms/linux/linuxdependencies.h"
 
 #include <QHostAddress>
@@ -34,11 +35,9 @@ extern "C" {
 #endif
 // End import wireguard
 
-/* Packets sent outside the VPN need to be marked for the routing policy
- * to direct them appropriately. The value of the mark and the table ID
- * aren't important, so long as they are unique.
+/* The routing policy looks up the packets without WG_FIREWALL_MARK in this
+ * table. Its ID isn't important, so long as it is unique.
  */
-constexpr uint32_t WG_FIREWALL_MARK = 0xca6c;
 constexpr uint32_t WG_ROUTE_TABLE = 0xca6c;
 
 /* Traffic classifiers can be used to mark packets which should be either
@@ -50,6 +49,12 @@ constexpr const char* VPN_BLOCK_CGROUP = "/mozvpn.block";
 constexpr uint32_t VPN_EXCLUDE_CLASS_ID = 0x00110011;
 constexpr uint32_t VPN_BLOCK_CLASS_ID = 0x00220022;
 
+/* Without net_cls (cgroup v2), the sockets created in the excluded cgroup
+ * carry WG_FIREWALL_MARK, and the ones created in the blocked cgroup carry
+ * this mark, which is dropped by the firewall.
+ */
+constexpr uint32_t VPN_BLOCK_MARK = 0xca6d;
+
 static void nlmsg_append_attr(struct nlmsghdr* nlmsg, size_t maxlen,
                               int attrtype, const void* attrdata,
                               size_t attrlen);
@@ -66,7 +71,7 @@ void NetfilterLogger(int level, const char* msg) {
 }  // namespace
 
 WireguardUtilsLinux::WireguardUtilsLinux(QObject* parent)
-    : WireguardUtils(parent) {
+    : WireguardUtils(parent), m_statsCache(WG_INTERFACE) {
   MVPN_COUNT_CTOR(WireguardUtilsLinux);
   NetfilterSetLogger((GoUintptr)&NetfilterLogger);
   NetfilterCreateTables();
@@ -88,6 +93,29 @@ WireguardUtilsLinux::WireguardUtilsLinux(QObject* parent)
   connect(m_notifier, &QSocketNotifier::activated, this,
           &WireguardUtilsLinux::nlsockReady);
 
+  m_eventsock = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                       NETLINK_ROUTE);
+  if (m_eventsock < 0) {
+    logger.warning() << "Failed to create netlink event socket:"
+                     << strerror(errno);
+  } else {
+    struct sockaddr_nl evaddr;
+    memset(&evaddr, 0, sizeof(evaddr));
+    evaddr.nl_family = AF_NETLINK;
+    evaddr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+    if (bind(m_eventsock, (struct sockaddr*)&evaddr, sizeof(evaddr)) != 0) {
+      logger.warning() << "Failed to bind netlink event socket:"
+                       << strerror(errno);
+      close(m_eventsock);
+      m_eventsock = -1;
+    } else {
+      m_eventNotifier =
+          new QSocketNotifier(m_eventsock, QSocketNotifier::Read, this);
+      connect(m_eventNotifier, &QSocketNotifier::activated, this,
+              &WireguardUtilsLinux::eventsockReady);
+    }
+  }
+
   /* Create control groups for split tunnelling */
   m_cgroups = LinuxDependencies::findCgroupPath("net_cls");
   if (!m_cgroups.isNull()) {
@@ -97,6 +125,20 @@ WireguardUtilsLinux::WireguardUtilsLinux(QObject* parent)
     } else if (!setupCgroupClass(m_cgroups + VPN_BLOCK_CGROUP,
                                  VPN_BLOCK_CLASS_ID)) {
       m_cgroups.clear();
+    } else {
+      m_cgroupController = "net_cls";
+    }
+  } else {
+    m_cgroups = LinuxDependencies::findCgroup2Path();
+    if (!m_cgroups.isNull()) {
+      if (!setupCgroupMark(m_cgroups + VPN_EXCLUDE_CGROUP, WG_FIREWALL_MARK,
+                           m_excludeSockMark) ||
+          !setupCgroupMark(m_cgroups + VPN_BLOCK_CGROUP, VPN_BLOCK_MARK,
+                           m_blockSockMark)) {
+        m_excludeSockMark.detach();
+        m_blockSockMark.detach();
+        m_cgroups.clear();
+      }
     }
   }
 
@@ -109,6 +151,10 @@ WireguardUtilsLinux::~WireguardUtilsLinux() {
   if (m_nlsock >= 0) {
     close(m_nlsock);
   }
+  if (m_eventsock >= 0) {
+    delete m_eventNotifier;
+    close(m_eventsock);
+  }
   logger.debug() << "WireguardUtilsLinux destroyed.";
 }
 
@@ -146,16 +192,26 @@ bool WireguardUtilsLinux::addInterface(const InterfaceConfig& config) {
     return false;
   }
 
-  // Create routing policy rules
-  if (!rtmSendRule(RTM_NEWRULE,
-                   NLM_F_REQUEST | NLM_F_CREATE | NLM_F_REPLACE | NLM_F_ACK,
-                   AF_INET)) {
-    return false;
-  }
-  if (!rtmSendRule(RTM_NEWRULE,
-                   NLM_F_REQUEST | NLM_F_CREATE | NLM_F_REPLACE | NLM_F_ACK,
-                   AF_INET6)) {
-    return false;
+  // Create routing policy rules. The rules cannot be replaced: the ones left
+  // by a previous run are kept as they are, and only the new ones are undone.
+  NetlinkTransaction rules(m_nlsock, m_nlseq);
+  const int ruleFlags = NLM_F_REQUEST | NLM_F_CREATE | NLM_F_EXCL;
+  rtmAppendRules(rules, RTM_NEWRULE, ruleFlags, AF_INET);
+  rtmAppendRules(rules, RTM_NEWRULE, ruleFlags, AF_INET6);
+  if (!rules.commit()) {
+    auto failed = [&](int index) {
+      return rules.error(index) != 0 && rules.error(index) != EEXIST;
+    };
+
+    // The first two rules are the IPv4 ones. IPv6 can be unavailable.
+    if (failed(0) || failed(1)) {
+      logger.error() << "Failed to create the routing policy rules";
+      rules.rollback();
+      return false;
+    }
+    if (failed(2) || failed(3)) {
+      logger.warning() << "Failed to create the IPv6 routing policy rules";
+    }
   }
 
   // Configure firewall rules
@@ -163,7 +219,10 @@ bool WireguardUtilsLinux::addInterface(const InterfaceConfig& config) {
   if (NetfilterIfup(goIfname, device->fwmark) != 0) {
     return false;
   }
-  if (!m_cgroups.isNull()) {
+  if (m_blockSockMark.isAttached()) {
+    /* The excluded sockets already carry the firewall mark. */
+    NetfilterBlockMark(VPN_BLOCK_MARK);
+  } else if (!m_cgroups.isNull()) {
     NetfilterMarkCgroup(VPN_EXCLUDE_CLASS_ID, device->fwmark);
     NetfilterBlockCgroup(VPN_BLOCK_CLASS_ID);
   }
@@ -280,11 +339,11 @@ bool WireguardUtilsLinux::deleteInterface() {
   NetfilterClearTables();
 
   // Clear routing policy rules
-  if (!rtmSendRule(RTM_DELRULE, NLM_F_REQUEST | NLM_F_ACK, AF_INET)) {
-    return false;
-  }
-  if (!rtmSendRule(RTM_DELRULE, NLM_F_REQUEST | NLM_F_ACK, AF_INET6)) {
-    return false;
+  NetlinkTransaction rules(m_nlsock, m_nlseq);
+  rtmAppendRules(rules, RTM_DELRULE, NLM_F_REQUEST, AF_INET);
+  rtmAppendRules(rules, RTM_DELRULE, NLM_F_REQUEST, AF_INET6);
+  if (!rules.commit()) {
+    logger.warning() << "Failed to remove some routing policy rules";
   }
 
   // Delete the interface
@@ -297,72 +356,226 @@ bool WireguardUtilsLinux::deleteInterface() {
   return true;
 }
 
+static void copyPeerStats(const WireguardStatsCache::Peer& peer,
+                          WireguardUtils::PeerStatus& status) {
+  status.m_handshake = peer.m_handshake;
+  status.m_txBytes = peer.m_txBytes;
+  status.m_rxBytes = peer.m_rxBytes;
+  status.m_txRate = peer.m_txRate;
+  status.m_rxRate = peer.m_rxRate;
+  status.m_handshakeAge = peer.m_handshakeAge;
+}
+
 QList<WireguardUtils::PeerStatus> WireguardUtilsLinux::getPeerStatus() {
-  wg_device* device = nullptr;
-  wg_peer* peer = nullptr;
   QList<WireguardUtils::PeerStatus> peerList;
 
-  if (wg_get_device(&device, WG_INTERFACE) != 0) {
+  if (!m_statsCache.refresh()) {
     logger.warning() << "Unable to get stats for" << WG_INTERFACE;
     return peerList;
   }
 
-  wg_for_each_peer(device, peer) {
-    PeerStatus status;
-    wg_key_b64_string keystring;
-    wg_key_to_base64(keystring, peer->public_key);
-    status.m_pubkey = QString(keystring);
-    status.m_handshake = peer->last_handshake_time.tv_sec * 1000;
-    status.m_handshake += peer->last_handshake_time.tv_nsec / 1000000;
-    status.m_txBytes = peer->tx_bytes;
-    status.m_rxBytes = peer->rx_bytes;
-    logger.debug() << "found" << printableKey(status.m_pubkey) << "handshake"
-                   << peer->last_handshake_time.tv_sec;
+  for (const WireguardStatsCache::Peer& peer : m_statsCache.peers()) {
+    PeerStatus status(QString::fromLatin1(
+        QByteArray(reinterpret_cast<const char*>(peer.m_key),
+                   WireguardStatsCache::KEY_LEN)
+            .toBase64()));
+    copyPeerStats(peer, status);
     peerList.append(status);
   }
-  wg_free_device(device);
   return peerList;
 }
 
+bool WireguardUtilsLinux::findPeerStatus(const QString& pubkey,
+                                         PeerStatus& status) {
+  // The daemon keeps asking for the same peer: decode its key once.
+  if (pubkey != m_statsPubkey) {
+    QByteArray key = QByteArray::fromBase64(pubkey.toLatin1());
+    if (key.length() != WireguardStatsCache::KEY_LEN) {
+      logger.warning() << "Invalid public key:" << printableKey(pubkey);
+      return false;
+    }
+    memcpy(m_statsKey, key.constData(), WireguardStatsCache::KEY_LEN);
+    m_statsPubkey = pubkey;
+  }
+
+  if (!m_statsCache.refresh()) {
+    return false;
+  }
+
+  const WireguardStatsCache::Peer* peer = m_statsCache.find(m_statsKey);
+  if (!peer) {
+    return false;
+  }
+
+  status.m_pubkey = m_statsPubkey;
+  copyPeerStats(*peer, status);
+  return true;
+}
+
+QHash<QString, WireguardUtils::PeerStatus>
+WireguardUtilsLinux::findPeerStatuses(const QStringList& pubkeys) {
+  QHash<QString, PeerStatus> result;
+
+  if (!m_statsCache.refresh()) {
+    logger.warning() << "Unable to get stats for" << WG_INTERFACE;
+    return result;
+  }
+
+  // The cache is indexed by raw key: the other peers are not converted.
+  for (const QString& pubkey : pubkeys) {
+    QByteArray key = QByteArray::fromBase64(pubkey.toLatin1());
+    if (key.length() != WireguardStatsCache::KEY_LEN) {
+      logger.warning() << "Invalid public key:" << printableKey(pubkey);
+      continue;
+    }
+
+    const WireguardStatsCache::Peer* peer = m_statsCache.find(
+        reinterpret_cast<const uint8_t*>(key.constData()));
+    if (!peer) {
+      continue;
+    }
+
+    PeerStatus status(pubkey);
+    copyPeerStats(*peer, status);
+    result.insert(pubkey, status);
+  }
+  return result;
+}
+
 bool WireguardUtilsLinux::updateRoutePrefix(const IPAddress& prefix,
                                             int hopindex) {
   logger.debug() << "Adding route to" << prefix.toString();
-  const int flags = NLM_F_REQUEST | NLM_F_CREATE | NLM_F_REPLACE | NLM_F_ACK;
-  return rtmSendRoute(RTM_NEWROUTE, flags, prefix, hopindex);
+  return updateRoutePrefixes({prefix}, hopindex, false);
 }
 
 bool WireguardUtilsLinux::deleteRoutePrefix(const IPAddress& prefix,
                                             int hopindex) {
   logger.debug() << "Removing route to" << prefix.toString();
-  const int flags = NLM_F_REQUEST | NLM_F_ACK;
-  return rtmSendRoute(RTM_DELROUTE, flags, prefix, hopindex);
+  return deleteRoutePrefixes({prefix}, hopindex);
+}
+
+bool WireguardUtilsLinux::updateRoutePrefixes(const QList<IPAddress>& prefixes,
+                                              int hopindex, bool rollback) {
+  logger.debug() << "Adding" << prefixes.length() << "routes for hop"
+                 << hopindex;
+  const int flags = NLM_F_REQUEST | NLM_F_CREATE | NLM_F_EXCL;
+  return rtmSendRoutes(RTM_NEWROUTE, flags, prefixes, hopindex, rollback);
+}
+
+bool WireguardUtilsLinux::deleteRoutePrefixes(const QList<IPAddress>& prefixes,
+                                              int hopindex) {
+  logger.debug() << "Removing" << prefixes.length() << "routes for hop"
+                 << hopindex;
+  return rtmSendRoutes(RTM_DELROUTE, NLM_F_REQUEST, prefixes, hopindex,
+                       false);
 }
 
 bool WireguardUtilsLinux::addExclusionRoute(const QHostAddress& address) {
   logger.debug() << "Adding exclusion route for" << address.toString();
-  const int flags = NLM_F_REQUEST | NLM_F_CREATE | NLM_F_REPLACE | NLM_F_ACK;
-  return rtmSendExclude(RTM_NEWRULE, flags, address);
+  const int flags = NLM_F_REQUEST | NLM_F_CREATE | NLM_F_REPLACE;
+  NetlinkTransaction transaction(m_nlsock, m_nlseq);
+  if (!rtmAppendExclude(transaction, RTM_NEWRULE, flags, address)) {
+    return false;
+  }
+  return transaction.commit();
 }
 
 bool WireguardUtilsLinux::deleteExclusionRoute(const QHostAddress& address) {
   logger.debug() << "Removing exclusion route for" << address.toString();
-  return rtmSendExclude(RTM_DELRULE, NLM_F_REQUEST | NLM_F_ACK, address);
+  NetlinkTransaction transaction(m_nlsock, m_nlseq);
+  if (!rtmAppendExclude(transaction, RTM_DELRULE, NLM_F_REQUEST, address)) {
+    return false;
+  }
+  return transaction.commit();
 }
 
-bool WireguardUtilsLinux::rtmSendRoute(int action, int flags,
-                                       const IPAddress& prefix, int hopindex) {
-  constexpr size_t rtm_max_size = sizeof(struct rtmsg) +
-                                  2 * RTA_SPACE(sizeof(uint32_t)) +
-                                  RTA_SPACE(sizeof(struct in6_addr));
-  int index = if_nametoindex(WG_INTERFACE);
-  if (index <= 0) {
+bool WireguardUtilsLinux::rtmSendRoutes(int action, int flags,
+                                        const QList<IPAddress>& prefixes,
+                                        int hopindex, bool rollback) {
+  if (prefixes.isEmpty()) {
+    return true;
+  }
+
+  int ifindex = if_nametoindex(WG_INTERFACE);
+  if (ifindex <= 0) {
     logger.error() << "if_nametoindex() failed:" << strerror(errno);
     return false;
   }
 
+  NetlinkTransaction transaction(m_nlsock, m_nlseq);
+  for (const IPAddress& prefix : prefixes) {
+    if (!rtmAppendRoute(transaction, action, flags, prefix, hopindex,
+                        ifindex)) {
+      logger.warning() << "Invalid destination prefix" << prefix.toString();
+      return false;
+    }
+  }
+
+  if (transaction.commit()) {
+    return true;
+  }
+
+  QVector<int> errors(prefixes.length());
+  for (int i = 0; i < prefixes.length(); ++i) {
+    errors[i] = transaction.error(i);
+  }
+
+  // The routes which were already there are replaced in a second batch. They
+  // are never undone: what they were before is unknown.
+  if (flags & NLM_F_EXCL) {
+    NetlinkTransaction existing(m_nlsock, m_nlseq);
+    QVector<int> indexes;
+    const int replaceFlags = (flags & ~NLM_F_EXCL) | NLM_F_REPLACE;
+    for (int i = 0; i < prefixes.length(); ++i) {
+      if (errors.at(i) == EEXIST) {
+        rtmAppendRoute(existing, action, replaceFlags, prefixes.at(i),
+                       hopindex, ifindex);
+        indexes.append(i);
+      }
+    }
+    if (!indexes.isEmpty() && !existing.commit()) {
+      for (int j = 0; j < indexes.length(); ++j) {
+        errors[indexes.at(j)] = existing.error(j);
+      }
+    } else {
+      for (int i : indexes) {
+        errors[i] = 0;
+      }
+    }
+  }
+
+  // IPv6 can be unavailable on the host: only the IPv4 failures are fatal.
+  bool fatal = false;
+  for (int i = 0; i < prefixes.length(); ++i) {
+    int error = errors.at(i);
+    if (error == 0) {
+      continue;
+    }
+
+    logger.warning() << "Routing update failed for" << prefixes.at(i).toString()
+                     << strerror(error);
+    if (prefixes.at(i).type() == QAbstractSocket::IPv4Protocol) {
+      fatal = true;
+    }
+  }
+
+  // Only the routes created by the transaction are removed.
+  if (fatal && rollback) {
+    transaction.rollback();
+  }
+  return !fatal;
+}
+
+bool WireguardUtilsLinux::rtmAppendRoute(NetlinkTransaction& transaction,
+                                         int action, int flags,
+                                         const IPAddress& prefix, int hopindex,
+                                         int ifindex) {
+  constexpr size_t rtm_max_size = sizeof(struct rtmsg) +
+                                  2 * RTA_SPACE(sizeof(uint32_t)) +
+                                  RTA_SPACE(sizeof(struct in6_addr));
+
   wg_allowedip ip;
   if (!buildAllowedIp(&ip, prefix)) {
-    logger.warning() << "Invalid destination prefix";
     return false;
   }
 
@@ -374,8 +587,6 @@ bool WireguardUtilsLinux::rtmSendRoute(int action, int flags,
   nlmsg->nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
   nlmsg->nlmsg_type = action;
   nlmsg->nlmsg_flags = flags;
-  nlmsg->nlmsg_pid = getpid();
-  nlmsg->nlmsg_seq = m_nlseq++;
   rtm->rtm_dst_len = ip.cidr;
   rtm->rtm_family = ip.family;
   rtm->rtm_type = RTN_UNICAST;
@@ -395,14 +606,15 @@ bool WireguardUtilsLinux::rtmSendRoute(int action, int flags,
   } else {
     nlmsg_append_attr(nlmsg, sizeof(buf), RTA_DST, &ip.ip4, sizeof(ip.ip4));
   }
-  nlmsg_append_attr32(nlmsg, sizeof(buf), RTA_OIF, index);
+  nlmsg_append_attr32(nlmsg, sizeof(buf), RTA_OIF, ifindex);
 
-  struct sockaddr_nl nladdr;
-  memset(&nladdr, 0, sizeof(nladdr));
-  nladdr.nl_family = AF_NETLINK;
-  size_t result = sendto(m_nlsock, buf, nlmsg->nlmsg_len, 0,
-                         (struct sockaddr*)&nladdr, sizeof(nladdr));
-  return (result == nlmsg->nlmsg_len);
+  // A route that wasn't there before is undone by deleting it.
+  if (action == RTM_NEWROUTE && (flags & NLM_F_EXCL)) {
+    transaction.append(nlmsg, RTM_DELROUTE, NLM_F_REQUEST);
+  } else {
+    transaction.append(nlmsg);
+  }
+  return true;
 }
 
 // PRIVATE METHODS
@@ -521,17 +733,18 @@ static void nlmsg_append_attr32(struct nlmsghdr* nlmsg, size_t maxlen,
   nlmsg_append_attr(nlmsg, maxlen, attrtype, &value, sizeof(value));
 }
 
-bool WireguardUtilsLinux::rtmSendRule(int action, int flags, int addrfamily) {
+void WireguardUtilsLinux::rtmAppendRules(NetlinkTransaction& transaction,
+                                         int action, int flags,
+                                         int addrfamily) {
   constexpr size_t fib_max_size =
       sizeof(struct fib_rule_hdr) + 2 * RTA_SPACE(sizeof(uint32_t));
+  const int undoType =
+      action == RTM_NEWRULE && (flags & NLM_F_EXCL) ? RTM_DELRULE : 0;
 
   char buf[NLMSG_SPACE(fib_max_size)];
   struct nlmsghdr* nlmsg = reinterpret_cast<struct nlmsghdr*>(buf);
   struct fib_rule_hdr* rule =
       static_cast<struct fib_rule_hdr*>(NLMSG_DATA(nlmsg));
-  struct sockaddr_nl nladdr;
-  memset(&nladdr, 0, sizeof(nladdr));
-  nladdr.nl_family = AF_NETLINK;
 
   /* Create a routing policy rule to select the wireguard routing table for
    * unmarked packets. This is equivalent to:
@@ -541,19 +754,13 @@ bool WireguardUtilsLinux::rtmSendRule(int action, int flags, int addrfamily) {
   nlmsg->nlmsg_len = NLMSG_LENGTH(sizeof(struct fib_rule_hdr));
   nlmsg->nlmsg_type = action;
   nlmsg->nlmsg_flags = flags;
-  nlmsg->nlmsg_pid = getpid();
-  nlmsg->nlmsg_seq = m_nlseq++;
   rule->family = addrfamily;
   rule->table = RT_TABLE_UNSPEC;
   rule->action = FR_ACT_TO_TBL;
   rule->flags = FIB_RULE_INVERT;
   nlmsg_append_attr32(nlmsg, sizeof(buf), FRA_FWMARK, WG_FIREWALL_MARK);
   nlmsg_append_attr32(nlmsg, sizeof(buf), FRA_TABLE, WG_ROUTE_TABLE);
-  ssize_t result = sendto(m_nlsock, buf, nlmsg->nlmsg_len, 0,
-                          (struct sockaddr*)&nladdr, sizeof(nladdr));
-  if (result != nlmsg->nlmsg_len) {
-    return false;
-  }
+  transaction.append(nlmsg, undoType, NLM_F_REQUEST);
 
   /* Create a routing policy rule to suppress zero-length prefix lookups from
    * in the main routing table. This is equivalent to:
@@ -563,24 +770,17 @@ bool WireguardUtilsLinux::rtmSendRule(int action, int flags, int addrfamily) {
   nlmsg->nlmsg_len = NLMSG_LENGTH(sizeof(struct fib_rule_hdr));
   nlmsg->nlmsg_type = action;
   nlmsg->nlmsg_flags = flags;
-  nlmsg->nlmsg_pid = getpid();
-  nlmsg->nlmsg_seq = m_nlseq++;
   rule->family = addrfamily;
   rule->table = RT_TABLE_MAIN;
   rule->action = FR_ACT_TO_TBL;
   rule->flags = 0;
   nlmsg_append_attr32(nlmsg, sizeof(buf), FRA_SUPPRESS_PREFIXLEN, 0);
-  result = sendto(m_nlsock, buf, nlmsg->nlmsg_len, 0, (struct sockaddr*)&nladdr,
-                  sizeof(nladdr));
-  if (result != nlmsg->nlmsg_len) {
-    return false;
-  }
-
-  return true;
+  transaction.append(nlmsg, undoType, NLM_F_REQUEST);
 }
 
-bool WireguardUtilsLinux::rtmSendExclude(int action, int flags,
-                                         const QHostAddress& address) {
+bool WireguardUtilsLinux::rtmAppendExclude(NetlinkTransaction& transaction,
+                                           int action, int flags,
+                                           const QHostAddress& address) {
   constexpr size_t fib_max_size =
       sizeof(struct fib_rule_hdr) + RTA_SPACE(sizeof(struct in6_addr));
 
@@ -588,9 +788,6 @@ bool WireguardUtilsLinux::rtmSendExclude(int action, int flags,
   struct nlmsghdr* nlmsg = reinterpret_cast<struct nlmsghdr*>(buf);
   struct fib_rule_hdr* rule =
       static_cast<struct fib_rule_hdr*>(NLMSG_DATA(nlmsg));
-  struct sockaddr_nl nladdr;
-  memset(&nladdr, 0, sizeof(nladdr));
-  nladdr.nl_family = AF_NETLINK;
 
   /* Create a routing policy rule to select the main routing table for
    * packets matching the destination address. This is equivalent to:
@@ -600,8 +797,6 @@ bool WireguardUtilsLinux::rtmSendExclude(int action, int flags,
   nlmsg->nlmsg_len = NLMSG_LENGTH(sizeof(struct fib_rule_hdr));
   nlmsg->nlmsg_type = action;
   nlmsg->nlmsg_flags = flags;
-  nlmsg->nlmsg_pid = getpid();
-  nlmsg->nlmsg_seq = m_nlseq++;
   rule->table = RT_TABLE_MAIN;
   rule->action = FR_ACT_TO_TBL;
   rule->flags = 0;
@@ -620,12 +815,7 @@ bool WireguardUtilsLinux::rtmSendExclude(int action, int flags,
     return false;
   }
 
-  ssize_t result = sendto(m_nlsock, buf, nlmsg->nlmsg_len, 0,
-                          (struct sockaddr*)&nladdr, sizeof(nladdr));
-  if (result != nlmsg->nlmsg_len) {
-    return false;
-  }
-
+  transaction.append(nlmsg);
   return true;
 }
 
@@ -653,6 +843,81 @@ void WireguardUtilsLinux::nlsockReady() {
   }
 }
 
+void WireguardUtilsLinux::eventsockReady() {
+  int ifindex = if_nametoindex(WG_INTERFACE);
+  bool changed = false;
+  char buf[8192];
+
+  // Drain the socket: a single signal for a burst of notifications.
+  while (true) {
+    ssize_t len = recv(m_eventsock, buf, sizeof(buf), 0);
+    if (len < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == ENOBUFS) {
+        // Some notifications have been dropped.
+        changed = true;
+        continue;
+      }
+      break;
+    }
+
+    struct nlmsghdr* nlmsg = (struct nlmsghdr*)buf;
+    for (; NLMSG_OK(nlmsg, len); nlmsg = NLMSG_NEXT(nlmsg, len)) {
+      switch (nlmsg->nlmsg_type) {
+        case RTM_NEWLINK:
+        case RTM_DELLINK: {
+          // The WireGuard interface changes because of the activation. By
+          // name: its index is gone when it is deleted.
+          struct ifinfomsg* ifi =
+              static_cast<struct ifinfomsg*>(NLMSG_DATA(nlmsg));
+          int attrlen = IFLA_PAYLOAD(nlmsg);
+          bool ours = ifindex != 0 && ifi->ifi_index == ifindex;
+          for (struct rtattr* attr = IFLA_RTA(ifi); RTA_OK(attr, attrlen);
+               attr = RTA_NEXT(attr, attrlen)) {
+            if (attr->rta_type == IFLA_IFNAME &&
+                qstrcmp(static_cast<const char*>(RTA_DATA(attr)),
+                        WG_INTERFACE) == 0) {
+              ours = true;
+            }
+          }
+          if (!ours) {
+            changed = true;
+          }
+          break;
+        }
+
+        case RTM_NEWROUTE:
+        case RTM_DELROUTE: {
+          // Our own routes change because of the activation, not because
+          // of the network.
+          struct rtmsg* rtm = static_cast<struct rtmsg*>(NLMSG_DATA(nlmsg));
+          int attrlen = RTM_PAYLOAD(nlmsg);
+          int oif = 0;
+          for (struct rtattr* attr = RTM_RTA(rtm); RTA_OK(attr, attrlen);
+               attr = RTA_NEXT(attr, attrlen)) {
+            if (attr->rta_type == RTA_OIF) {
+              oif = *static_cast<int*>(RTA_DATA(attr));
+            }
+          }
+          if (ifindex == 0 || oif != ifindex) {
+            changed = true;
+          }
+          break;
+        }
+
+        default:
+          break;
+      }
+    }
+  }
+
+  if (changed) {
+    emit networkEvent();
+  }
+}
+
 // static
 bool WireguardUtilsLinux::setupCgroupClass(const QString& path,
                                            unsigned long classid) {
@@ -675,6 +940,20 @@ bool WireguardUtilsLinux::setupCgroupClass(const QString& path,
   return true;
 }
 
+// static
+bool WireguardUtilsLinux::setupCgroupMark(const QString& path, uint32_t mark,
+                                          CgroupSockMark& sockMark) {
+  logger.debug() << "Creating control group:" << path;
+  int flags = S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH;
+  int err = mkdir(qPrintable(path), flags);
+  if ((err < 0) && (errno != EEXIST)) {
+    logger.error() << "Failed to create" << path + ":" << strerror(errno);
+    return false;
+  }
+
+  return sockMark.attach(path, mark);
+}
+
 QString WireguardUtilsLinux::getExcludeCgroup() const {
   if (m_cgroups.isNull()) {
     return QString();
@@ -689,6 +968,33 @@ QString WireguardUtilsLinux::getBlockCgroup() const {
   return m_cgroups + VPN_BLOCK_CGROUP;
 }
 
+void WireguardUtilsLinux::remarkSockets(const QList<int>& pids,
+                                        const QString& cgroup) {
+  if (!m_excludeSockMark.isAttached()) {
+    return;
+  }
+
+  uint32_t mark = 0;
+  if (cgroup == getExcludeCgroup()) {
+    mark = WG_FIREWALL_MARK;
+  } else if (cgroup == getBlockCgroup()) {
+    mark = VPN_BLOCK_MARK;
+  }
+
+  int changed = 0;
+  for (int pid : pids) {
+    int count = CgroupSockMark::remarkSockets(
+        pid, mark, {WG_FIREWALL_MARK, VPN_BLOCK_MARK});
+    if (count < 0) {
+      logger.warning() << "Failed to mark the sockets of PID:" << pid << "-"
+                       << strerror(errno);
+      continue;
+    }
+    changed += count;
+  }
+  logger.debug() << "Marked" << changed << "sockets with" << mark;
+}
+
 // static
 bool WireguardUtilsLinux::buildAllowedIp(wg_allowedip* ip,
                                          const IPAddress& prefix) {
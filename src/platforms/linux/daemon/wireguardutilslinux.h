@@ -5,12 +5,23 @@
 #ifndef WIREGUARDUTILSLINUX_H
 #define WIREGUARDUTILSLINUX_H
 
+#include "cgroupsockmark.h"
 #include "daemon/wireguardutils.h"
+#include "wireguardstatscache.h"
+
 #include <QHostAddress>
 #include <QObject>
 #include <QSocketNotifier>
 #include <QStringList>
 
+class NetlinkTransaction;
+
+/* Packets sent outside the VPN need to be marked for the routing policy
+ * to direct them appropriately. The value of the mark isn't important, so
+ * long as it is unique.
+ */
+constexpr uint32_t WG_FIREWALL_MARK = 0xca6c;
+
 class WireguardUtilsLinux final : public WireguardUtils {
   Q_OBJECT
 
@@ -24,10 +35,18 @@ class WireguardUtilsLinux final : public WireguardUtils {
   bool updatePeer(const InterfaceConfig& config) override;
   bool deletePeer(const InterfaceConfig& config) override;
   QList<PeerStatus> getPeerStatus() override;
+  bool findPeerStatus(const QString& pubkey, PeerStatus& status) override;
+  QHash<QString, PeerStatus> findPeerStatuses(
+      const QStringList& pubkeys) override;
 
   bool updateRoutePrefix(const IPAddress& prefix, int hopindex) override;
   bool deleteRoutePrefix(const IPAddress& prefix, int hopindex) override;
 
+  bool updateRoutePrefixes(const QList<IPAddress>& prefixes, int hopindex,
+                           bool rollback) override;
+  bool deleteRoutePrefixes(const QList<IPAddress>& prefixes,
+                           int hopindex) override;
+
   bool addExclusionRoute(const QHostAddress& address) override;
   bool deleteExclusionRoute(const QHostAddress& address) override;
 
@@ -35,24 +54,55 @@ class WireguardUtilsLinux final : public WireguardUtils {
   QString getExcludeCgroup() const;
   QString getBlockCgroup() const;
 
+  // Controller of the cgroup v1 hierarchy, empty with cgroup v2.
+  QString getCgroupController() const { return m_cgroupController; }
+
+  // Marks the sockets that the processes already have as the ones they
+  // create in `cgroup`, where they have just moved. Only needed on cgroup v2.
+  void remarkSockets(const QList<int>& pids, const QString& cgroup);
+
  private:
   QStringList currentInterfaces();
   bool setPeerEndpoint(struct sockaddr* sa, const QString& address, int port);
   bool addPeerPrefix(struct wg_peer* peer, const IPAddress& prefix);
-  bool rtmSendRule(int action, int flags, int addrfamily);
-  bool rtmSendRoute(int action, int flags, const IPAddress& prefix,
-                    int hopindex);
-  bool rtmSendExclude(int action, int flags, const QHostAddress& address);
+  void rtmAppendRules(NetlinkTransaction& transaction, int action, int flags,
+                      int addrfamily);
+  bool rtmAppendRoute(NetlinkTransaction& transaction, int action, int flags,
+                      const IPAddress& prefix, int hopindex, int ifindex);
+  bool rtmAppendExclude(NetlinkTransaction& transaction, int action, int flags,
+                        const QHostAddress& address);
+  bool rtmSendRoutes(int action, int flags, const QList<IPAddress>& prefixes,
+                     int hopindex, bool rollback);
   static bool setupCgroupClass(const QString& path, unsigned long classid);
+  static bool setupCgroupMark(const QString& path, uint32_t mark,
+                              CgroupSockMark& sockMark);
   static bool buildAllowedIp(struct wg_allowedip*, const IPAddress& prefix);
 
   int m_nlsock = -1;
-  int m_nlseq = 0;
+  uint32_t m_nlseq = 0;
   QSocketNotifier* m_notifier = nullptr;
+
+  // Subscribed to the link and route notifications of the kernel. Separate
+  // from m_nlsock, so that the notifications don't get in the way of the
+  // ACKs of our requests.
+  int m_eventsock = -1;
+  QSocketNotifier* m_eventNotifier = nullptr;
   QString m_cgroups;
+  QString m_cgroupController;
+
+  // Only used with cgroup v2, in place of the net_cls classids.
+  CgroupSockMark m_excludeSockMark;
+  CgroupSockMark m_blockSockMark;
+
+  WireguardStatsCache m_statsCache;
+
+  // Raw key of the last peer looked up by findPeerStatus().
+  QString m_statsPubkey;
+  uint8_t m_statsKey[WireguardStatsCache::KEY_LEN];
 
  private slots:
   void nlsockReady();
+  void eventsockReady();
 };
 
 #endif  // WIREGUARDUTILSLINUX_H
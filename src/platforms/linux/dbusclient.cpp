@@ -33,6 +33,8 @@ DBusClient::DBusClient(QObject* parent) : QObject(parent) {
           &DBusClient::connected);
   connect(m_dbus, &OrgMozillaVpnDbusInterface::disconnected, this,
           &DBusClient::disconnected);
+  connect(m_dbus, &OrgMozillaVpnDbusInterface::statusSampled, this,
+          &DBusClient::statusSampled);
 }
 
 DBusClient::~DBusClient() { MVPN_COUNT_DTOR(DBusClient); }
@@ -115,6 +117,24 @@ QDBusPendingCallWatcher* DBusClient::status() {
   return watcher;
 }
 
+QDBusPendingCallWatcher* DBusClient::subscribeStatus(int intervalMsec) {
+  logger.debug() << "Subscribe status via DBus";
+  QDBusPendingReply<QString> reply = m_dbus->subscribeStatus(intervalMsec);
+  QDBusPendingCallWatcher* watcher = new QDBusPendingCallWatcher(reply, this);
+  QObject::connect(watcher, &QDBusPendingCallWatcher::finished, watcher,
+                   &QDBusPendingCallWatcher::deleteLater);
+  return watcher;
+}
+
+QDBusPendingCallWatcher* DBusClient::unsubscribeStatus() {
+  logger.debug() << "Unsubscribe status via DBus";
+  QDBusPendingReply<> reply = m_dbus->unsubscribeStatus();
+  QDBusPendingCallWatcher* watcher = new QDBusPendingCallWatcher(reply, this);
+  QObject::connect(watcher, &QDBusPendingCallWatcher::finished, watcher,
+                   &QDBusPendingCallWatcher::deleteLater);
+  return watcher;
+}
+
 QDBusPendingCallWatcher* DBusClient::getLogs() {
   logger.debug() << "Get logs via DBus";
   QDBusPendingReply<QString> reply = m_dbus->getLogs();
@@ -37,6 +37,10 @@ class DBusClient final : public QObject {
 
   QDBusPendingCallWatcher* status();
 
+  QDBusPendingCallWatcher* subscribeStatus(int intervalMsec);
+
+  QDBusPendingCallWatcher* unsubscribeStatus();
+
   QDBusPendingCallWatcher* getLogs();
 
   QDBusPendingCallWatcher* cleanupLogs();
@@ -44,6 +48,8 @@ class DBusClient final : public QObject {
  signals:
   void connected(const QString& pubkey);
   void disconnected();
+  void statusSampled(bool connected, qint64 txBytes, qint64 rxBytes,
+                     qint64 handshake);
 
  private:
   OrgMozillaVpnDbusInterface* m_dbus;
@@ -21,6 +21,9 @@
 #include <QProcess>
 #include <QString>
 
+// The daemon drops the status subscription after 30 seconds without renewal.
+constexpr int STATUS_LEASE_RENEWAL_MSEC = 10000;
+
 namespace {
 Logger logger({LOG_LINUX, LOG_CONTROLLER}, "LinuxController");
 }
@@ -33,6 +36,11 @@ LinuxController::LinuxController() {
           &LinuxController::peerConnected);
   connect(m_dbus, &DBusClient::disconnected, this,
           &LinuxController::disconnected);
+  connect(m_dbus, &DBusClient::statusSampled, this,
+          &LinuxController::peerStatusSampled);
+
+  connect(&m_statusLeaseTimer, &QTimer::timeout, this,
+          &LinuxController::requestStatusSubscription);
 }
 
 LinuxController::~LinuxController() { MVPN_COUNT_DTOR(LinuxController); }
@@ -240,6 +248,73 @@ void LinuxController::checkStatusCompleted(QDBusPendingCallWatcher* call) {
                      txBytes.toDouble(), rxBytes.toDouble());
 }
 
+bool LinuxController::subscribeStatus(int intervalMsec) {
+  logger.debug() << "Subscribe status";
+
+  m_statusSubscriptionMsec = intervalMsec;
+  requestStatusSubscription();
+  m_statusLeaseTimer.start(STATUS_LEASE_RENEWAL_MSEC);
+
+  // The reply of the daemon comes later: until then, the status is polled.
+  return m_statusSubscribed;
+}
+
+void LinuxController::requestStatusSubscription() {
+  QDBusPendingCallWatcher* watcher =
+      m_dbus->subscribeStatus(m_statusSubscriptionMsec);
+  connect(watcher, &QDBusPendingCallWatcher::finished, this,
+          &LinuxController::subscribeStatusCompleted);
+}
+
+void LinuxController::subscribeStatusCompleted(QDBusPendingCallWatcher* call) {
+  QDBusPendingReply<QString> reply = *call;
+  if (reply.isError()) {
+    logger.error() << "Unable to subscribe to the status:"
+                   << reply.error().message();
+    if (m_statusSubscribed) {
+      m_statusSubscribed = false;
+      emit statusSubscribed(false);
+    }
+    return;
+  }
+
+  // Unsubscribed in the meantime.
+  if (!m_statusSubscriptionMsec || m_statusSubscribed) {
+    return;
+  }
+
+  m_statusSubscribed = true;
+  emit statusSubscribed(true);
+}
+
+void LinuxController::unsubscribeStatus() {
+  logger.debug() << "Unsubscribe status";
+
+  m_statusSubscriptionMsec = 0;
+  m_statusSubscribed = false;
+  m_statusLeaseTimer.stop();
+  m_dbus->unsubscribeStatus();
+}
+
+void LinuxController::peerStatusSampled(bool connected, qint64 txBytes,
+                                        qint64 rxBytes, qint64 handshake) {
+  Q_UNUSED(handshake);
+
+  if (!m_statusSubscriptionMsec || !connected) {
+    return;
+  }
+
+  // The signal is broadcasted: other clients can be subscribed with a shorter
+  // interval. Leave some room for the delivery jitter.
+  if (m_lastStatusSample.isValid() &&
+      m_lastStatusSample.elapsed() < m_statusSubscriptionMsec * 9 / 10) {
+    return;
+  }
+  m_lastStatusSample.start();
+
+  emit statusSampled(txBytes, rxBytes);
+}
+
 void LinuxController::getBackendLogs(
     std::function<void(const QString&)>&& a_callback) {
   std::function<void(const QString&)> callback = std::move(a_callback);
@@ -7,8 +7,10 @@
 
 #include "controllerimpl.h"
 
+#include <QElapsedTimer>
 #include <QObject>
 #include <QHostAddress>
+#include <QTimer>
 
 class DBusClient;
 class QDBusPendingCallWatcher;
@@ -33,6 +35,10 @@ class LinuxController final : public ControllerImpl {
 
   void checkStatus() override;
 
+  bool subscribeStatus(int intervalMsec) override;
+
+  void unsubscribeStatus() override;
+
   void getBackendLogs(std::function<void(const QString&)>&& callback) override;
 
   void cleanupBackendLogs() override;
@@ -41,10 +47,14 @@ class LinuxController final : public ControllerImpl {
   void checkStatusCompleted(QDBusPendingCallWatcher* call);
   void initializeCompleted(QDBusPendingCallWatcher* call);
   void operationCompleted(QDBusPendingCallWatcher* call);
+  void subscribeStatusCompleted(QDBusPendingCallWatcher* call);
   void peerConnected(const QString& pubkey);
+  void peerStatusSampled(bool connected, qint64 txBytes, qint64 rxBytes,
+                         qint64 handshake);
 
  private:
   void activateNext();
+  void requestStatusSubscription();
 
  private:
   class HopConnection {
@@ -62,6 +72,13 @@ class LinuxController final : public ControllerImpl {
   const Keys* m_keys = nullptr;
 
   DBusClient* m_dbus = nullptr;
+
+  // 0 if there is no status subscription.
+  int m_statusSubscriptionMsec = 0;
+  // True once the daemon has accepted the subscription.
+  bool m_statusSubscribed = false;
+  QTimer m_statusLeaseTimer;
+  QElapsedTimer m_lastStatusSample;
 };
 
 #endif  // LINUXCONTROLLER_H
@@ -11,6 +11,8 @@ class LinuxDependencies final {
  public:
   static bool checkDependencies();
   static QString findCgroupPath(const QString& type);
+  // The mount point of the unified cgroup v2 hierarchy.
+  static QString findCgroup2Path();
 
  private:
   LinuxDependencies() = default;
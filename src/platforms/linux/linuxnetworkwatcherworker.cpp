@@ -33,10 +33,25 @@
   (NM_802_11_AP_SEC_PAIR_WEP40 | NM_802_11_AP_SEC_PAIR_WEP104)
 
 constexpr const char* DBUS_NETWORKMANAGER = "org.freedesktop.NetworkManager";
+constexpr const char* DBUS_NETWORKMANAGER_PATH =
+    "/org/freedesktop/NetworkManager";
+constexpr const char* DBUS_DEVICE = "org.freedesktop.NetworkManager.Device";
+constexpr const char* DBUS_WIRELESS =
+    "org.freedesktop.NetworkManager.Device.Wireless";
+constexpr const char* DBUS_ACCESSPOINT =
+    "org.freedesktop.NetworkManager.AccessPoint";
+constexpr const char* DBUS_PROPERTIES = "org.freedesktop.DBus.Properties";
+
+// Past this, the access points which are not active are forgotten.
+constexpr int ACCESSPOINT_CACHE_MAX = 32;
 
 namespace {
 Logger logger(LOG_LINUX, "LinuxNetworkWatcherWorker");
+
+QString objectPath(const QVariant& value) {
+  return value.value<QDBusObjectPath>().path();
 }
+}  // namespace
 
 static inline bool checkUnsecureFlags(int rsnFlags, int wpaFlags) {
   // If neither WPA nor WPA2/RSN are supported, then the network is unencrypted
@@ -72,47 +87,105 @@ void LinuxNetworkWatcherWorker::initialize() {
   // documentation:
   // https://developer.gnome.org/NetworkManager/stable/gdbus-org.freedesktop.NetworkManager.html
 
-  QDBusInterface nm(DBUS_NETWORKMANAGER, "/org/freedesktop/NetworkManager",
-                    DBUS_NETWORKMANAGER, QDBusConnection::systemBus());
-  if (!nm.isValid()) {
+  if (!QDBusConnection::systemBus().isConnected()) {
     logger.error()
         << "Failed to connect to the network manager via system dbus";
     return;
   }
 
-  QDBusMessage msg = nm.call("GetDevices");
-  QDBusArgument arg = msg.arguments().at(0).value<QDBusArgument>();
-  if (arg.currentType() != QDBusArgument::ArrayType) {
-    logger.error() << "Expected an array of devices";
-    return;
-  }
+  fetch(DBUS_NETWORKMANAGER_PATH, DBUS_NETWORKMANAGER,
+        &LinuxNetworkWatcherWorker::devicesFetched);
+}
 
-  QList<QDBusObjectPath> paths = qdbus_cast<QList<QDBusObjectPath> >(arg);
-  for (const QDBusObjectPath& path : paths) {
-    QString devicePath = path.path();
-    QDBusInterface device(DBUS_NETWORKMANAGER, devicePath,
-                          "org.freedesktop.NetworkManager.Device",
-                          QDBusConnection::systemBus());
-    if (device.property("DeviceType").toInt() != NM_DEVICE_TYPE_WIFI) {
-      continue;
-    }
+void LinuxNetworkWatcherWorker::fetch(const QString& path,
+                                      const char* interface,
+                                      FetchCallback callback) {
+  QDBusMessage msg = QDBusMessage::createMethodCall(
+      DBUS_NETWORKMANAGER, path, DBUS_PROPERTIES, "GetAll");
+  msg << QString(interface);
+
+  QDBusPendingCallWatcher* watcher = new QDBusPendingCallWatcher(
+      QDBusConnection::systemBus().asyncCall(msg), this);
+  connect(watcher, &QDBusPendingCallWatcher::finished, this,
+          [this, path, callback](QDBusPendingCallWatcher* call) {
+            call->deleteLater();
+
+            QDBusPendingReply<QVariantMap> reply = *call;
+            if (reply.isError()) {
+              logger.error() << "Failed to fetch" << path << "-"
+                             << reply.error().message();
+              return;
+            }
+
+            (this->*callback)(path, reply.value());
+          });
+}
 
-    logger.debug() << "Found a wifi device:" << devicePath;
-    m_devicePaths.append(devicePath);
+void LinuxNetworkWatcherWorker::subscribe(const QString& path,
+                                          const char* interface) {
+  // Filtered by the bus on the interface name: the changes of the other
+  // interfaces of the object don't wake us up.
+  QDBusConnection::systemBus().connect(
+      DBUS_NETWORKMANAGER, path, DBUS_PROPERTIES, "PropertiesChanged",
+      QStringList{interface}, QString(), this,
+      SLOT(propertyChanged(QString, QVariantMap, QStringList)));
+}
 
-    // Here we monitor the changes.
-    QDBusConnection::systemBus().connect(
-        DBUS_NETWORKMANAGER, devicePath, "org.freedesktop.DBus.Properties",
-        "PropertiesChanged", this,
-        SLOT(propertyChanged(QString, QVariantMap, QStringList)));
+void LinuxNetworkWatcherWorker::unsubscribe(const QString& path,
+                                            const char* interface) {
+  QDBusConnection::systemBus().disconnect(
+      DBUS_NETWORKMANAGER, path, DBUS_PROPERTIES, "PropertiesChanged",
+      QStringList{interface}, QString(), this,
+      SLOT(propertyChanged(QString, QVariantMap, QStringList)));
+}
+
+void LinuxNetworkWatcherWorker::devicesFetched(const QString& path,
+                                               const QVariantMap& properties) {
+  Q_UNUSED(path);
+
+  QList<QDBusObjectPath> paths =
+      qdbus_cast<QList<QDBusObjectPath> >(properties.value("Devices"));
+  if (paths.isEmpty()) {
+    logger.warning() << "No network devices found";
+    return;
+  }
+
+  for (const QDBusObjectPath& devicePath : paths) {
+    fetch(devicePath.path(), DBUS_DEVICE,
+          &LinuxNetworkWatcherWorker::deviceFetched);
   }
+}
 
-  if (m_devicePaths.isEmpty()) {
-    logger.warning() << "No wifi devices found";
+void LinuxNetworkWatcherWorker::deviceFetched(const QString& path,
+                                              const QVariantMap& properties) {
+  if (properties.value("DeviceType").toInt() != NM_DEVICE_TYPE_WIFI) {
     return;
   }
 
+  logger.debug() << "Found a wifi device:" << path;
+  m_devices.insert(path, QString());
+
+  // Here we monitor the changes.
+  subscribe(path, DBUS_WIRELESS);
+  fetch(path, DBUS_WIRELESS, &LinuxNetworkWatcherWorker::wirelessFetched);
+}
+
+void LinuxNetworkWatcherWorker::wirelessFetched(const QString& path,
+                                                const QVariantMap& properties) {
   // We could be already be activated.
+  setActiveAccessPoint(
+      path, objectPath(properties.value("ActiveAccessPoint")));
+}
+
+void LinuxNetworkWatcherWorker::accessPointFetched(
+    const QString& path, const QVariantMap& properties) {
+  if (!isActive(path)) {
+    // We roamed away while waiting for the reply.
+    return;
+  }
+
+  AccessPoint& accessPoint = m_accessPoints[path];
+  updateAccessPoint(accessPoint, properties);
   checkDevices();
 }
 
@@ -121,54 +194,138 @@ void LinuxNetworkWatcherWorker::propertyChanged(QString interface,
                                                 QStringList list) {
   Q_UNUSED(list);
 
-  logger.debug() << "Properties changed for interface" << interface;
+  const QString path = message().path();
+
+  if (interface == DBUS_ACCESSPOINT) {
+    auto i = m_accessPoints.find(path);
+    if (i != m_accessPoints.end() && updateAccessPoint(*i, properties)) {
+      logger.debug() << "Security changed for access point" << path;
+      checkDevices();
+    }
+    return;
+  }
 
   if (!properties.contains("ActiveAccessPoint")) {
-    logger.debug() << "Access point did not changed. Ignoring the changes";
+    // Scans and the like.
     return;
   }
 
-  checkDevices();
+  setActiveAccessPoint(
+      path, objectPath(properties.value("ActiveAccessPoint")));
+}
+
+void LinuxNetworkWatcherWorker::setActiveAccessPoint(
+    const QString& devicePath, const QString& accessPointPath) {
+  auto device = m_devices.find(devicePath);
+  if (device == m_devices.end()) {
+    return;
+  }
+
+  // NetworkManager uses "/" for no access point.
+  QString newPath = accessPointPath == "/" ? QString() : accessPointPath;
+  if (device.value() == newPath) {
+    return;
+  }
+
+  QString oldPath = device.value();
+  device.value() = newPath;
+  if (!oldPath.isEmpty() && !isActive(oldPath)) {
+    unsubscribe(oldPath, DBUS_ACCESSPOINT);
+  }
+
+  if (newPath.isEmpty()) {
+    logger.debug() << "No access point for" << devicePath;
+    return;
+  }
+
+  logger.debug() << "Access point changed for" << devicePath;
+  subscribe(newPath, DBUS_ACCESSPOINT);
+
+  if (m_accessPoints.contains(newPath)) {
+    // Roaming back to a known access point: nothing to fetch.
+    checkDevices();
+    return;
+  }
+
+  if (m_accessPoints.count() >= ACCESSPOINT_CACHE_MAX) {
+    for (auto i = m_accessPoints.begin(); i != m_accessPoints.end();) {
+      if (isActive(i.key())) {
+        ++i;
+      } else {
+        i = m_accessPoints.erase(i);
+      }
+    }
+  }
+
+  fetch(newPath, DBUS_ACCESSPOINT,
+        &LinuxNetworkWatcherWorker::accessPointFetched);
+}
+
+bool LinuxNetworkWatcherWorker::isActive(
+    const QString& accessPointPath) const {
+  for (const QString& path : m_devices) {
+    if (path == accessPointPath) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// static
+bool LinuxNetworkWatcherWorker::updateAccessPoint(
+    AccessPoint& accessPoint, const QVariantMap& properties) {
+  bool changed = false;
+
+  auto i = properties.constFind("RsnFlags");
+  if (i != properties.constEnd() && i->toUInt() != accessPoint.m_rsnFlags) {
+    accessPoint.m_rsnFlags = i->toUInt();
+    changed = true;
+  }
+
+  i = properties.constFind("WpaFlags");
+  if (i != properties.constEnd() && i->toUInt() != accessPoint.m_wpaFlags) {
+    accessPoint.m_wpaFlags = i->toUInt();
+    changed = true;
+  }
+
+  i = properties.constFind("Ssid");
+  if (i != properties.constEnd()) {
+    accessPoint.m_ssid = i->toString();
+  }
+
+  i = properties.constFind("HwAddress");
+  if (i != properties.constEnd()) {
+    accessPoint.m_bssid = i->toString();
+  }
+
+  return changed;
 }
 
 void LinuxNetworkWatcherWorker::checkDevices() {
   logger.debug() << "Checking devices";
 
-  for (const QString& devicePath : m_devicePaths) {
-    QDBusInterface wifiDevice(DBUS_NETWORKMANAGER, devicePath,
-                              "org.freedesktop.NetworkManager.Device.Wireless",
-                              QDBusConnection::systemBus());
-
-    // Check the access point path
-    QString accessPointPath = wifiDevice.property("ActiveAccessPoint")
-                                  .value<QDBusObjectPath>()
-                                  .path();
-    if (accessPointPath.isEmpty()) {
-      logger.warning() << "No access point found";
+  // Only the cache is used: no D-Bus round-trips here.
+  for (auto device = m_devices.constBegin(); device != m_devices.constEnd();
+       ++device) {
+    if (device.value().isEmpty()) {
       continue;
     }
 
-    QDBusInterface ap(DBUS_NETWORKMANAGER, accessPointPath,
-                      "org.freedesktop.NetworkManager.AccessPoint",
-                      QDBusConnection::systemBus());
-
-    QVariant rsnFlags = ap.property("RsnFlags");
-    QVariant wpaFlags = ap.property("WpaFlags");
-    if (!rsnFlags.isValid() || !wpaFlags.isValid()) {
-      // We are probably not connected.
+    auto i = m_accessPoints.constFind(device.value());
+    if (i == m_accessPoints.constEnd()) {
+      // Still being fetched. We will check again once it's done.
       continue;
     }
 
-    if (!checkUnsecureFlags(rsnFlags.toInt(), wpaFlags.toInt())) {
-      QString ssid = ap.property("Ssid").toString();
-      QString bssid = ap.property("HwAddress").toString();
-
+    const AccessPoint& accessPoint = i.value();
+    if (!checkUnsecureFlags(accessPoint.m_rsnFlags, accessPoint.m_wpaFlags)) {
       // We have found 1 unsecured network. We don't need to check other wifi
       // network devices.
       logger.warning() << "Unsecured AP detected!"
-                       << "rsnFlags:" << rsnFlags.toInt()
-                       << "wpaFlags:" << wpaFlags.toInt() << "ssid:" << ssid;
-      emit unsecuredNetwork(ssid, bssid);
+                       << "rsnFlags:" << accessPoint.m_rsnFlags
+                       << "wpaFlags:" << accessPoint.m_wpaFlags
+                       << "ssid:" << accessPoint.m_ssid;
+      emit unsecuredNetwork(accessPoint.m_ssid, accessPoint.m_bssid);
       break;
     }
   }
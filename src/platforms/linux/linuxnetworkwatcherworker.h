@@ -5,13 +5,18 @@
 #ifndef LINUXNETWORKWATCHERWORKER_H
 #define LINUXNETWORKWATCHERWORKER_H
 
-#include <QMap>
+#include <QDBusContext>
+#include <QHash>
 #include <QObject>
 #include <QVariant>
 
 class QThread;
 
-class LinuxNetworkWatcherWorker final : public QObject {
+// Watches the wifi devices of NetworkManager without blocking D-Bus calls:
+// each object is fetched once, with an asynchronous GetAll, and then kept up
+// to date by its PropertiesChanged signals. The security of the active access
+// points is evaluated from this cache.
+class LinuxNetworkWatcherWorker final : public QObject, public QDBusContext {
   Q_OBJECT
   Q_DISABLE_COPY_MOVE(LinuxNetworkWatcherWorker)
 
@@ -32,10 +37,41 @@ class LinuxNetworkWatcherWorker final : public QObject {
                        QStringList list);
 
  private:
-  // We collect the list of DBus wifi network device paths during the
-  // initialization. When a property of them changes, we check if the access
-  // point is active and unsecure.
-  QStringList m_devicePaths;
+  struct AccessPoint {
+    uint m_rsnFlags = 0;
+    uint m_wpaFlags = 0;
+    QString m_ssid;
+    QString m_bssid;
+  };
+
+  using FetchCallback = void (LinuxNetworkWatcherWorker::*)(
+      const QString& path, const QVariantMap& properties);
+
+  void fetch(const QString& path, const char* interface,
+             FetchCallback callback);
+  void subscribe(const QString& path, const char* interface);
+  void unsubscribe(const QString& path, const char* interface);
+
+  void devicesFetched(const QString& path, const QVariantMap& properties);
+  void deviceFetched(const QString& path, const QVariantMap& properties);
+  void wirelessFetched(const QString& path, const QVariantMap& properties);
+  void accessPointFetched(const QString& path, const QVariantMap& properties);
+
+  void setActiveAccessPoint(const QString& devicePath,
+                            const QString& accessPointPath);
+  bool isActive(const QString& accessPointPath) const;
+
+  // Returns true if the security of the access point changed.
+  static bool updateAccessPoint(AccessPoint& accessPoint,
+                                const QVariantMap& properties);
+
+ private:
+  // The wifi devices, and the path of their active access point. Empty if
+  // they are not connected.
+  QHash<QString, QString> m_devices;
+
+  // The access points seen as active so far.
+  QHash<QString, AccessPoint> m_accessPoints;
 };
 
 #endif  // LINUXNETWORKWATCHERWORKER_H
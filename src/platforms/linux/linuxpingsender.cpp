@@ -15,11 +15,31 @@
 #include <netinet/ip.h>
 #include <netinet/ip_icmp.h>
 #include <sys/socket.h>
+#include <time.h>
 #include <unistd.h>
 
+// Maximum number of packets sent or received with a single system call.
+constexpr int PING_BATCH_SIZE = 32;
+
+// Size of the receive buffer for each packet.
+constexpr int PING_PACKET_SIZE = 2048;
+
+// Number of send timestamps we keep to compute the round-trip time.
+constexpr int PING_SEND_TIMES = 1024;
+
 namespace {
 Logger logger({LOG_LINUX, LOG_NETWORKING}, "LinuxPingSender");
+
+qint64 timespecToUsec(const struct timespec& ts) {
+  return static_cast<qint64>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+qint64 currentUsec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return timespecToUsec(ts);
 }
+}  // namespace
 
 int LinuxPingSender::createSocket() {
   // Try creating an ICMP socket. This would be the ideal choice, but it can
@@ -72,28 +92,41 @@ LinuxPingSender::LinuxPingSender(const QString& source, QObject* parent)
     return;
   }
 
-  struct sockaddr_in addr;
-  memset(&addr, 0, sizeof addr);
-  addr.sin_family = AF_INET;
-  if (inet_aton(source.toLocal8Bit().constData(), &addr.sin_addr) == 0) {
-    logger.error() << "source" << source << "error:" << strerror(errno);
-    return;
+  // Without a source address, the socket is left unbound and the kernel picks
+  // the outgoing interface for every destination.
+  if (!source.isEmpty()) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    if (inet_aton(source.toLocal8Bit().constData(), &addr.sin_addr) == 0) {
+      logger.error() << "source" << source << "error:" << strerror(errno);
+      return;
+    }
+    if (bind(m_socket, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+      close(m_socket);
+      m_socket = -1;
+      logger.error() << "bind error:" << strerror(errno);
+      return;
+    }
   }
-  if (bind(m_socket, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
-    close(m_socket);
-    m_socket = -1;
-    logger.error() << "bind error:" << strerror(errno);
-    return;
+
+  // Ask the kernel to timestamp the replies when they are received, so that
+  // the round-trip time does not include the event loop latency.
+  int enable = 1;
+  m_kernelTimestamps = setsockopt(m_socket, SOL_SOCKET, SO_TIMESTAMPNS,
+                                  &enable, sizeof(enable)) == 0;
+  if (!m_kernelTimestamps) {
+    logger.warning() << "Kernel timestamps not available:" << strerror(errno);
   }
 
+  m_sendTimes.resize(PING_SEND_TIMES);
+  m_recvBuffer.resize(PING_BATCH_SIZE * PING_PACKET_SIZE);
+  m_controlBuffer.resize(PING_BATCH_SIZE *
+                         CMSG_SPACE(sizeof(struct timespec)));
+
   m_notifier = new QSocketNotifier(m_socket, QSocketNotifier::Read, this);
-  if (m_ident) {
-    connect(m_notifier, &QSocketNotifier::activated, this,
-            &LinuxPingSender::rawSocketReady);
-  } else {
-    connect(m_notifier, &QSocketNotifier::activated, this,
-            &LinuxPingSender::icmpSocketReady);
-  }
+  connect(m_notifier, &QSocketNotifier::activated, this,
+          &LinuxPingSender::socketReady);
 }
 
 LinuxPingSender::~LinuxPingSender() {
@@ -112,80 +145,231 @@ void LinuxPingSender::sendPing(const QString& dest, quint16 sequence) {
     QStringList args;
     args << "-c"
          << "1";
-    args << "-I" << m_source;
+    if (!m_source.isEmpty()) {
+      args << "-I" << m_source;
+    }
     args << dest;
     genericSendPing(args, sequence);
     return;
   }
 #endif
 
-  struct sockaddr_in addr;
-  memset(&addr, 0, sizeof(addr));
-  addr.sin_family = AF_INET;
-  if (inet_aton(dest.toLocal8Bit().constData(), &addr.sin_addr) == 0) {
-    return;
+  sendPingBatch({qMakePair(dest, sequence)});
+}
+
+bool LinuxPingSender::setProbeSize(int size) {
+  if (m_socket < 0) {
+    return false;
   }
 
-  struct icmphdr packet;
-  memset(&packet, 0, sizeof(packet));
-  packet.type = ICMP_ECHO;
-  packet.un.echo.id = htons(m_ident);
-  packet.un.echo.sequence = htons(sequence);
-  packet.checksum = inetChecksum(&packet, sizeof(packet));
+  int payload = size - static_cast<int>(sizeof(struct iphdr)) -
+                static_cast<int>(sizeof(struct icmphdr));
+  m_padding.fill('\0', qMax(payload, 0));
+
+  // Probing sets DF and ignores the path MTU cached by the kernel: the
+  // probe itself is what verifies it.
+  int pmtudisc = size > 0 ? IP_PMTUDISC_PROBE : IP_PMTUDISC_DONT;
+  if (setsockopt(m_socket, IPPROTO_IP, IP_MTU_DISCOVER, &pmtudisc,
+                 sizeof(pmtudisc)) != 0) {
+    logger.warning() << "Failed to set the DF bit:" << strerror(errno);
+    return false;
+  }
+
+  return true;
+}
 
-  int rc = sendto(m_socket, &packet, sizeof(packet), 0, (struct sockaddr*)&addr,
-                  sizeof(addr));
-  if (rc < 0) {
-    logger.error() << "failed to send:" << strerror(errno);
+bool LinuxPingSender::setFirewallMark(uint32_t mark) {
+  if (m_socket < 0) {
+    return false;
   }
+
+  if (setsockopt(m_socket, SOL_SOCKET, SO_MARK, &mark, sizeof(mark)) != 0) {
+    logger.warning() << "Failed to set the firewall mark:" << strerror(errno);
+    return false;
+  }
+
+  return true;
 }
 
-void LinuxPingSender::icmpSocketReady() {
-  socklen_t slen = 0;
-  unsigned char data[2048];
-  int rc = recvfrom(m_socket, data, sizeof(data), MSG_DONTWAIT, NULL, &slen);
-  if (rc <= 0) {
-    logger.error() << "recvfrom failed:" << strerror(errno);
+void LinuxPingSender::sendPingBatch(
+    const QList<QPair<QString, quint16>>& pings) {
+  if (m_socket < 0) {
+    PingSender::sendPingBatch(pings);
     return;
   }
 
-  struct icmphdr packet;
-  if (rc >= (int)sizeof(packet)) {
-    memcpy(&packet, data, sizeof(packet));
-    if (packet.type == ICMP_ECHOREPLY) {
-      emit recvPing(htons(packet.un.echo.sequence));
+  struct sockaddr_in addrs[PING_BATCH_SIZE];
+  struct icmphdr packets[PING_BATCH_SIZE];
+  struct iovec iovs[PING_BATCH_SIZE][2];
+  struct mmsghdr msgs[PING_BATCH_SIZE];
+  quint16 sequences[PING_BATCH_SIZE];
+
+  int offset = 0;
+  while (offset < pings.length()) {
+    memset(msgs, 0, sizeof(msgs));
+
+    int count = 0;
+    for (; offset < pings.length() && count < PING_BATCH_SIZE; ++offset) {
+      const QPair<QString, quint16>& ping = pings.at(offset);
+
+      struct sockaddr_in& addr = addrs[count];
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      if (inet_aton(ping.first.toLocal8Bit().constData(), &addr.sin_addr) ==
+          0) {
+        continue;
+      }
+
+      struct icmphdr& packet = packets[count];
+      memset(&packet, 0, sizeof(packet));
+      packet.type = ICMP_ECHO;
+      packet.un.echo.id = htons(m_ident);
+      packet.un.echo.sequence = htons(ping.second);
+      // The padding is made of zeroes: it doesn't change the checksum.
+      packet.checksum = inetChecksum(&packet, sizeof(packet));
+
+      iovs[count][0].iov_base = &packet;
+      iovs[count][0].iov_len = sizeof(packet);
+      iovs[count][1].iov_base = m_padding.data();
+      iovs[count][1].iov_len = m_padding.length();
+
+      msgs[count].msg_hdr.msg_name = &addr;
+      msgs[count].msg_hdr.msg_namelen = sizeof(addr);
+      msgs[count].msg_hdr.msg_iov = iovs[count];
+      msgs[count].msg_hdr.msg_iovlen = m_padding.isEmpty() ? 1 : 2;
+
+      sequences[count] = ping.second;
+      ++count;
+    }
+
+    if (count == 0) {
+      continue;
+    }
+
+    int rc = sendmmsg(m_socket, msgs, count, 0);
+    qint64 now = currentUsec();
+    if (rc < 0) {
+      logger.error() << "failed to send:" << strerror(errno);
+      continue;
+    }
+    if (rc < count) {
+      logger.warning() << "Only" << rc << "pings out of" << count << "sent";
+    }
+
+    for (int i = 0; i < rc; ++i) {
+      recordSendTime(sequences[i], now);
     }
   }
 }
 
-void LinuxPingSender::rawSocketReady() {
-  socklen_t slen = 0;
-  unsigned char data[2048];
-  int rc = recvfrom(m_socket, data, sizeof(data), MSG_DONTWAIT, NULL, &slen);
-  if (rc <= 0) {
-    logger.error() << "recvfrom failed:" << strerror(errno);
-    return;
+void LinuxPingSender::recordSendTime(quint16 sequence, qint64 usec) {
+  SendTime& sendTime = m_sendTimes[sequence % m_sendTimes.size()];
+  sendTime.usec = usec;
+  sendTime.sequence = sequence;
+}
+
+void LinuxPingSender::socketReady() {
+  struct iovec iovs[PING_BATCH_SIZE];
+  struct sockaddr_in addrs[PING_BATCH_SIZE];
+  struct mmsghdr msgs[PING_BATCH_SIZE];
+  size_t controlSize = CMSG_SPACE(sizeof(struct timespec));
+
+  // Drain the socket: a single wakeup can cover many replies.
+  for (;;) {
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < PING_BATCH_SIZE; ++i) {
+      iovs[i].iov_base = m_recvBuffer.data() + i * PING_PACKET_SIZE;
+      iovs[i].iov_len = PING_PACKET_SIZE;
+      msgs[i].msg_hdr.msg_name = &addrs[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      msgs[i].msg_hdr.msg_control = m_controlBuffer.data() + i * controlSize;
+      msgs[i].msg_hdr.msg_controllen = controlSize;
+    }
+
+    int rc = recvmmsg(m_socket, msgs, PING_BATCH_SIZE, MSG_DONTWAIT, nullptr);
+    if (rc <= 0) {
+      if (rc < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        logger.error() << "recvmmsg failed:" << strerror(errno);
+      }
+      return;
+    }
+
+    qint64 now = currentUsec();
+    for (int i = 0; i < rc; ++i) {
+      qint64 recvUsec = now;
+      if (m_kernelTimestamps) {
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg;
+             cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg)) {
+          if (cmsg->cmsg_level == SOL_SOCKET &&
+              cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            recvUsec = timespecToUsec(ts);
+            break;
+          }
+        }
+      }
+
+      processReply(reinterpret_cast<const unsigned char*>(iovs[i].iov_base),
+                   msgs[i].msg_len, addrs[i], recvUsec);
+    }
+
+    if (rc < PING_BATCH_SIZE) {
+      return;
+    }
   }
+}
 
-  // Check the IP header
-  const struct iphdr* ip = (struct iphdr*)data;
-  int iphdrlen = ip->ihl * 4;
-  if (rc < iphdrlen || iphdrlen < (int)sizeof(struct iphdr)) {
-    logger.error() << "malformed IP packet:" << strerror(errno);
-    return;
+void LinuxPingSender::processReply(const unsigned char* data, int length,
+                                   const struct sockaddr_in& source,
+                                   qint64 recvUsec) {
+  // Raw sockets receive the IP header too.
+  if (m_ident) {
+    const struct iphdr* ip = (const struct iphdr*)data;
+    int iphdrlen = ip->ihl * 4;
+    if (length < iphdrlen || iphdrlen < (int)sizeof(struct iphdr)) {
+      logger.error() << "malformed IP packet";
+      return;
+    }
+
+    if (inetChecksum(data + iphdrlen, length - iphdrlen) != 0) {
+      logger.warning() << "invalid checksum";
+      return;
+    }
+
+    data += iphdrlen;
+    length -= iphdrlen;
   }
 
-  // Check the ICMP packet
   struct icmphdr packet;
-  if (inetChecksum(data + iphdrlen, rc - iphdrlen) != 0) {
-    logger.warning() << "invalid checksum";
+  if (length < (int)sizeof(packet)) {
     return;
   }
-  if (rc >= (iphdrlen + (int)sizeof(packet))) {
-    memcpy(&packet, data + iphdrlen, sizeof(packet));
-    quint16 id = htons(m_ident);
-    if ((packet.type == ICMP_ECHOREPLY) && (packet.un.echo.id == id)) {
-      emit recvPing(htons(packet.un.echo.sequence));
-    }
+
+  memcpy(&packet, data, sizeof(packet));
+  if (packet.type != ICMP_ECHOREPLY) {
+    return;
+  }
+  if (m_ident && packet.un.echo.id != htons(m_ident)) {
+    return;
   }
+
+  quint16 sequence = ntohs(packet.un.echo.sequence);
+
+  qint64 usec = -1;
+  SendTime& sendTime = m_sendTimes[sequence % m_sendTimes.size()];
+  if (sendTime.sequence == sequence && sendTime.usec >= 0) {
+    usec = qMax(Q_INT64_C(0), recvUsec - sendTime.usec);
+    sendTime.usec = -1;
+    emit recvPingLatency(sequence, usec);
+  }
+
+  char address[INET_ADDRSTRLEN];
+  if (inet_ntop(AF_INET, &source.sin_addr, address, sizeof(address))) {
+    emit recvPingReply(QString::fromLatin1(address), sequence, usec);
+  }
+
+  emit recvPing(sequence);
 }
@@ -7,7 +7,9 @@
 
 #include "pingsender.h"
 
+#include <QByteArray>
 #include <QObject>
+#include <QVector>
 
 class QSocketNotifier;
 
@@ -20,19 +22,49 @@ class LinuxPingSender final : public PingSender {
   ~LinuxPingSender();
 
   void sendPing(const QString& dest, quint16 sequence) override;
+  void sendPingBatch(const QList<QPair<QString, quint16>>& pings) override;
+
+  // Without a socket, the pings are sent by the `ping` command.
+  bool supportsMultipleTargets() const override { return m_socket >= 0; }
+
+  // Returns false if the pings are not sent by this object's own socket,
+  // and can't be used as probes.
+  bool setProbeSize(int size) override;
+
+  // Marks the pings for the routing policy, e.g. to send them outside of the
+  // VPN tunnel. Requires CAP_NET_ADMIN.
+  bool setFirewallMark(uint32_t mark);
 
  private:
   int createSocket();
 
+  void recordSendTime(quint16 sequence, qint64 usec);
+  void processReply(const unsigned char* data, int length,
+                    const struct sockaddr_in& source, qint64 recvUsec);
+
  private slots:
-  void rawSocketReady();
-  void icmpSocketReady();
+  void socketReady();
 
  private:
   QSocketNotifier* m_notifier = nullptr;
   QString m_source;
   int m_socket = 0;
   quint16 m_ident = 0;
+  bool m_kernelTimestamps = false;
+
+  // Send time of the most recent pings, indexed by sequence number.
+  struct SendTime {
+    qint64 usec = -1;
+    quint16 sequence = 0;
+  };
+  QVector<SendTime> m_sendTimes;
+
+  // Zeroes appended to the echo requests by setProbeSize().
+  QByteArray m_padding;
+
+  // Receive buffers for recvmmsg(), allocated once.
+  QByteArray m_recvBuffer;
+  QByteArray m_controlBuffer;
 };
 
 #endif  // LINUXPINGSENDER_H
@@ -345,6 +345,8 @@ NetworkRequest* NetworkRequest::createForProducts(Task* parent) {
 
 void NetworkRequest::replyFinished() {}
 
+void NetworkRequest::replyReadyRead() {}
+
 void NetworkRequest::timeout() {}
 
 void NetworkRequest::getRequest() {}
@@ -0,0 +1,253 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "serverlatency.h"
+#include "constants.h"
+#include "controller.h"
+#include "leakdetector.h"
+#include "logger.h"
+#include "models/server.h"
+#include "models/servercountrymodel.h"
+#include "pingsender.h"
+#include "pingsenderfactory.h"
+
+#include <QDateTime>
+#include <QHostAddress>
+
+// How often a new batch of pings is sent during a refresh.
+constexpr uint32_t SERVER_LATENCY_SEND_MSEC = 20;
+
+// Maximum number of pings in flight at the same time.
+constexpr int SERVER_LATENCY_MAX_PENDING = 32;
+
+// After this timeout, a ping is considered lost.
+constexpr qint64 SERVER_LATENCY_TIMEOUT_MSEC = 2000;
+
+// Smoothing factor for the latency and loss averages.
+constexpr double SERVER_LATENCY_SMOOTHING = 0.25;
+
+namespace {
+Logger logger(LOG_NETWORKING, "ServerLatency");
+}
+
+ServerLatency::ServerLatency() {
+  MVPN_COUNT_CTOR(ServerLatency);
+
+  connect(&m_sendTimer, &QTimer::timeout, this, &ServerLatency::sendPings);
+  connect(&m_refreshTimer, &QTimer::timeout, this, &ServerLatency::refresh);
+}
+
+ServerLatency::~ServerLatency() { MVPN_COUNT_DTOR(ServerLatency); }
+
+void ServerLatency::initialize(const ServerCountryModel* model,
+                               const Controller* controller) {
+  Q_ASSERT(model);
+  Q_ASSERT(controller);
+
+  m_model = model;
+  m_controller = controller;
+
+  connect(m_controller, &Controller::stateChanged, this,
+          &ServerLatency::controllerStateChanged);
+}
+
+void ServerLatency::start() {
+  if (!PingSenderFactory::supportsServerLatency()) {
+    logger.debug() << "Server latency measurement not supported";
+    return;
+  }
+
+  logger.debug() << "Starting server latency measurements";
+  m_refreshTimer.start(Constants::serverLatencyRefreshMsec());
+  refresh();
+}
+
+void ServerLatency::stop() {
+  logger.debug() << "Stopping server latency measurements";
+
+  m_refreshTimer.stop();
+  cancel();
+}
+
+void ServerLatency::cancel() {
+  m_sendTimer.stop();
+  m_queue.clear();
+  m_queueHead = 0;
+  m_pending.clear();
+
+  if (m_pingSender) {
+    // This can be called from one of the sender's own signals.
+    m_pingSender->deleteLater();
+    m_pingSender = nullptr;
+  }
+}
+
+void ServerLatency::controllerStateChanged() {
+  // Once the VPN is activated, the pings still in flight would be routed
+  // through the tunnel.
+  if (isRefreshing() && m_controller->state() != Controller::StateOff) {
+    logger.debug() << "Refresh cancelled by the VPN activation";
+    cancel();
+  }
+}
+
+void ServerLatency::refresh() {
+  if (isRefreshing() || !m_model) {
+    return;
+  }
+
+  // When the VPN is active, the pings would be routed through the tunnel and
+  // would measure the path via the current server. Keep the previous results.
+  if (m_controller->state() != Controller::StateOff) {
+    logger.debug() << "Skipping the refresh while the VPN is active";
+    return;
+  }
+
+  m_queue.clear();
+  m_queueHead = 0;
+  for (const ServerCountry& country : m_model->countries()) {
+    for (const ServerCity& city : country.cities()) {
+      for (const Server& server : city.servers()) {
+        // Normalized, to match the source address of the replies.
+        QHostAddress address(server.ipv4AddrIn());
+        if (address.protocol() == QAbstractSocket::IPv4Protocol) {
+          m_queue.append(qMakePair(server.publicKey(), address.toString()));
+        }
+      }
+    }
+  }
+
+  if (m_queue.isEmpty()) {
+    return;
+  }
+
+  logger.debug() << "Measuring the latency of" << m_queue.length()
+                 << "servers";
+
+  m_pingSender = PingSenderFactory::create(QString(), this);
+  connect(m_pingSender, &PingSender::recvPingReply, this,
+          &ServerLatency::pingReceived);
+
+  // Without its own socket, the sender doesn't know which host answered: one
+  // server is probed at a time.
+  if (m_pingSender->supportsMultipleTargets()) {
+    m_maxPending = SERVER_LATENCY_MAX_PENDING;
+  } else {
+    logger.debug() << "Probing one server at a time";
+    m_maxPending = 1;
+    connect(m_pingSender, &PingSender::recvPing, this,
+            &ServerLatency::serialPingReceived);
+  }
+  connect(m_pingSender, &PingSender::criticalPingError, this, [this]() {
+    logger.warning() << "Unable to ping the servers";
+    stop();
+  });
+
+  m_sendTimer.start(SERVER_LATENCY_SEND_MSEC);
+  sendPings();
+}
+
+void ServerLatency::sendPings() {
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+  // The number of pending pings is bounded: walking them is cheap.
+  QHash<PingKey, PendingPing>::iterator i = m_pending.begin();
+  while (i != m_pending.end()) {
+    if ((now - i->timestamp) < SERVER_LATENCY_TIMEOUT_MSEC) {
+      ++i;
+      continue;
+    }
+    pingTimedOut(i->publicKey);
+    i = m_pending.erase(i);
+  }
+
+  QList<QPair<QString, quint16>> batch;
+  while (m_queueHead < m_queue.length() &&
+         m_pending.size() < m_maxPending) {
+    const QPair<QString, QString>& target = m_queue.at(m_queueHead++);
+
+    // Skip the sequence numbers still in use by a pending ping to the same
+    // address.
+    while (m_pending.contains(PingKey(target.second, m_sequence))) {
+      ++m_sequence;
+    }
+
+    m_pending.insert(PingKey(target.second, m_sequence), {target.first, now});
+    batch.append(qMakePair(target.second, m_sequence));
+    ++m_sequence;
+  }
+
+  if (!batch.isEmpty()) {
+    m_pingSender->sendPingBatch(batch);
+  }
+
+  maybeFinish();
+}
+
+void ServerLatency::pingReceived(const QString& source, quint16 sequence,
+                                 qint64 usec) {
+  // Stale replies, and replies from other hosts, are not found.
+  QHash<PingKey, PendingPing>::iterator i =
+      m_pending.find(PingKey(source, sequence));
+  if (i == m_pending.end()) {
+    return;
+  }
+
+  double rtt = usec >= 0 ? usec / 1000.0
+                         : QDateTime::currentMSecsSinceEpoch() - i->timestamp;
+
+  Measurement& m = m_measurements[i->publicKey];
+  if (m.latency < 0) {
+    m.latency = rtt;
+  } else {
+    m.latency += SERVER_LATENCY_SMOOTHING * (rtt - m.latency);
+  }
+  m.loss -= SERVER_LATENCY_SMOOTHING * m.loss;
+
+  m_pending.erase(i);
+  maybeFinish();
+}
+
+void ServerLatency::serialPingReceived(quint16 sequence) {
+  if (m_pending.size() != 1) {
+    return;
+  }
+
+  pingReceived(m_pending.constBegin().key().first, sequence, -1);
+}
+
+void ServerLatency::pingTimedOut(const QString& publicKey) {
+  Measurement& m = m_measurements[publicKey];
+  m.loss += SERVER_LATENCY_SMOOTHING * (1.0 - m.loss);
+}
+
+void ServerLatency::maybeFinish() {
+  if (m_queueHead < m_queue.length() || !m_pending.isEmpty()) {
+    return;
+  }
+
+  logger.debug() << "Server latency refresh completed";
+
+  m_sendTimer.stop();
+  m_queue.clear();
+  m_queueHead = 0;
+
+  m_pingSender->deleteLater();
+  m_pingSender = nullptr;
+
+  emit updated();
+}
+
+uint ServerLatency::latency(const QString& publicKey) const {
+  QHash<QString, Measurement>::const_iterator i =
+      m_measurements.find(publicKey);
+  if (i == m_measurements.end() || i->latency < 0) {
+    return 0;
+  }
+  return static_cast<uint>(i->latency + 0.5);
+}
+
+double ServerLatency::loss(const QString& publicKey) const {
+  return m_measurements.value(publicKey).loss;
+}
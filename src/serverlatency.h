@@ -0,0 +1,102 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef SERVERLATENCY_H
+#define SERVERLATENCY_H
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPair>
+#include <QTimer>
+
+class Controller;
+class PingSender;
+class ServerCountryModel;
+
+#ifdef UNIT_TEST
+class TestServerLatency;
+#endif
+
+// Measures the round-trip time to every server of the ServerCountryModel
+// through a single ping socket. Probes to many servers are kept in flight at
+// the same time and the replies are demultiplexed by source address and
+// sequence number. Senders which can't tell the source of the replies probe
+// one server at a time.
+class ServerLatency final : public QObject {
+  Q_OBJECT
+  Q_DISABLE_COPY_MOVE(ServerLatency)
+
+ public:
+  ServerLatency();
+  ~ServerLatency();
+
+  void initialize(const ServerCountryModel* model,
+                  const Controller* controller);
+
+  void start();
+  void stop();
+
+  // Probes every server of the current server list once.
+  void refresh();
+
+  bool isRefreshing() const { return m_pingSender != nullptr; }
+
+  // Returns the smoothed round-trip time in msecs, or 0 if unknown.
+  uint latency(const QString& publicKey) const;
+
+  // Returns the smoothed packet loss (0.0 - 1.0), or 0.0 if unknown.
+  double loss(const QString& publicKey) const;
+
+ signals:
+  void updated();
+
+ private:
+  void sendPings();
+  void pingReceived(const QString& source, quint16 sequence, qint64 usec);
+  void serialPingReceived(quint16 sequence);
+  void pingTimedOut(const QString& publicKey);
+  void maybeFinish();
+
+  // Drops the refresh in progress, if any, keeping the previous results.
+  void cancel();
+  void controllerStateChanged();
+
+ private:
+  struct PendingPing {
+    QString publicKey;
+    qint64 timestamp;
+  };
+
+  // (address, sequence number)
+  typedef QPair<QString, quint16> PingKey;
+
+  struct Measurement {
+    double latency = -1;
+    double loss = 0;
+  };
+
+  // Servers (public key, address) waiting to be probed.
+  QList<QPair<QString, QString>> m_queue;
+  int m_queueHead = 0;
+
+  QHash<PingKey, PendingPing> m_pending;
+  int m_maxPending = 0;
+  QHash<QString, Measurement> m_measurements;
+
+  PingSender* m_pingSender = nullptr;
+  quint16 m_sequence = 0;
+
+  QTimer m_sendTimer;
+  QTimer m_refreshTimer;
+
+  const ServerCountryModel* m_model = nullptr;
+  const Controller* m_controller = nullptr;
+
+#ifdef UNIT_TEST
+  friend class TestServerLatency;
+#endif
+};
+
+#endif  // SERVERLATENCY_H
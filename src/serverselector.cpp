@@ -0,0 +1,239 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "serverselector.h"
+#include "leakdetector.h"
+#include "logger.h"
+#include "models/servercountrymodel.h"
+#include "models/serverdata.h"
+#include "serverlatency.h"
+
+#include <QDateTime>
+#include <QRandomGenerator>
+
+#include <cmath>
+
+// Latency (in msecs) halving the score of a server. Servers not measured yet
+// are scored as if they had this latency.
+constexpr double SERVER_SELECTOR_LATENCY_REFERENCE_MSEC = 50;
+
+// Each recent connection failure divides the score of a server by this value.
+constexpr double SERVER_SELECTOR_FAILURE_PENALTY = 10;
+
+// For how long a connection failure is taken into account.
+constexpr qint64 SERVER_SELECTOR_FAILURE_MSEC = 600000;
+
+// How many times we try to avoid the excluded server before walking the list.
+constexpr int SERVER_SELECTOR_MAX_ATTEMPTS = 8;
+
+namespace {
+Logger logger(LOG_MAIN, "ServerSelector");
+}
+
+ServerSelector::ServerSelector() : m_generator(QRandomGenerator::global()) {
+  MVPN_COUNT_CTOR(ServerSelector);
+}
+
+ServerSelector::~ServerSelector() { MVPN_COUNT_DTOR(ServerSelector); }
+
+void ServerSelector::initialize(const ServerCountryModel* model,
+                                const ServerLatency* latency) {
+  Q_ASSERT(model);
+  Q_ASSERT(latency);
+
+  m_model = model;
+  m_latency = latency;
+
+  connect(m_model, &ServerCountryModel::serversChanged, this,
+          &ServerSelector::invalidate);
+  connect(m_latency, &ServerLatency::updated, this,
+          &ServerSelector::invalidate);
+
+  invalidate();
+}
+
+void ServerSelector::invalidate() { m_dirty = true; }
+
+double ServerSelector::score(const Server& server) const {
+  double score = server.weight();
+  if (score <= 0) {
+    return 0;
+  }
+
+  if (m_latency) {
+    uint latency = m_latency->latency(server.publicKey());
+    double msec =
+        latency > 0 ? latency : SERVER_SELECTOR_LATENCY_REFERENCE_MSEC;
+    score *= SERVER_SELECTOR_LATENCY_REFERENCE_MSEC /
+             (SERVER_SELECTOR_LATENCY_REFERENCE_MSEC + msec);
+
+    double reachable = 1.0 - m_latency->loss(server.publicKey());
+    score *= reachable * reachable;
+  }
+
+  QHash<QString, Failure>::const_iterator i =
+      m_failures.find(server.publicKey());
+  if (i != m_failures.end() &&
+      (QDateTime::currentMSecsSinceEpoch() - i->m_lastFailure) <
+          SERVER_SELECTOR_FAILURE_MSEC) {
+    score /= std::pow(SERVER_SELECTOR_FAILURE_PENALTY, i->m_count);
+  }
+
+  return score;
+}
+
+void ServerSelector::maybeRebuild() {
+  if (m_failureExpiry &&
+      QDateTime::currentMSecsSinceEpoch() >= m_failureExpiry) {
+    expireFailures();
+  }
+
+  if (!m_dirty || !m_model) {
+    return;
+  }
+
+  m_dirty = false;
+  m_cities.clear();
+  m_locations.clear();
+
+  QVector<double> locationWeights;
+  QVector<double> serverWeights;
+
+  for (const ServerCountry& country : m_model->countries()) {
+    for (const ServerCity& city : country.cities()) {
+      CityTable table;
+      table.m_servers = city.servers();
+
+      double citySum = 0;
+      serverWeights.resize(0);
+      for (const Server& server : table.m_servers) {
+        double value = score(server);
+        serverWeights.append(value);
+        citySum += value;
+      }
+      table.m_table.build(serverWeights);
+
+      Location location(country.code(), city.name());
+      m_cities.insert(location, table);
+
+      if (!table.m_servers.isEmpty()) {
+        m_locations.append(location);
+        locationWeights.append(citySum);
+      }
+    }
+  }
+
+  m_locationTable.build(locationWeights);
+
+  logger.debug() << "Selection tables rebuilt for" << m_locations.size()
+                 << "locations";
+}
+
+Server ServerSelector::pick(const QString& countryCode,
+                            const QString& cityName,
+                            const QString& excludedPublicKey) {
+  maybeRebuild();
+
+  QHash<Location, CityTable>::const_iterator i =
+      m_cities.find(Location(countryCode, cityName));
+  if (i == m_cities.end() || i->m_table.isEmpty()) {
+    return Server();
+  }
+
+  const QList<Server>& servers = i->m_servers;
+
+  for (int attempt = 0; attempt < SERVER_SELECTOR_MAX_ATTEMPTS; ++attempt) {
+    const Server& server = servers.at(i->m_table.pick(m_generator));
+    if (excludedPublicKey.isEmpty() ||
+        server.publicKey() != excludedPublicKey) {
+      return server;
+    }
+  }
+
+  // The excluded server takes most of the weight. Take the best of the others.
+  const Server* best = nullptr;
+  double bestScore = -1;
+  for (const Server& server : servers) {
+    if (server.publicKey() == excludedPublicKey) {
+      continue;
+    }
+    double value = score(server);
+    if (value > bestScore) {
+      best = &server;
+      bestScore = value;
+    }
+  }
+
+  return best ? *best : Server();
+}
+
+int ServerSelector::serverCount(const QString& countryCode,
+                                const QString& cityName) {
+  maybeRebuild();
+  return m_cities.value(Location(countryCode, cityName)).m_servers.length();
+}
+
+bool ServerSelector::pickLocation(ServerData& data) {
+  maybeRebuild();
+
+  int index = m_locationTable.pick(m_generator);
+  if (index < 0) {
+    return false;
+  }
+
+  const Location& location = m_locations.at(index);
+  data.update(location.first, location.second);
+  return true;
+}
+
+void ServerSelector::recordFailure(const QString& publicKey) {
+  if (publicKey.isEmpty()) {
+    return;
+  }
+
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+  Failure& failure = m_failures[publicKey];
+  if ((now - failure.m_lastFailure) >= SERVER_SELECTOR_FAILURE_MSEC) {
+    failure.m_count = 0;
+  }
+  failure.m_count++;
+  failure.m_lastFailure = now;
+
+  logger.debug() << "Connection failure" << failure.m_count << "for"
+                 << publicKey;
+
+  if (!m_failureExpiry) {
+    m_failureExpiry = now + SERVER_SELECTOR_FAILURE_MSEC;
+  }
+
+  invalidate();
+}
+
+void ServerSelector::expireFailures() {
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  m_failureExpiry = 0;
+
+  QHash<QString, Failure>::iterator i = m_failures.begin();
+  while (i != m_failures.end()) {
+    qint64 expiry = i->m_lastFailure + SERVER_SELECTOR_FAILURE_MSEC;
+    if (expiry <= now) {
+      i = m_failures.erase(i);
+      continue;
+    }
+
+    if (!m_failureExpiry || expiry < m_failureExpiry) {
+      m_failureExpiry = expiry;
+    }
+    ++i;
+  }
+
+  invalidate();
+}
+
+void ServerSelector::recordSuccess(const QString& publicKey) {
+  if (m_failures.remove(publicKey)) {
+    invalidate();
+  }
+}
@@ -0,0 +1,93 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef SERVERSELECTOR_H
+#define SERVERSELECTOR_H
+
+#include "aliastable.h"
+#include "models/server.h"
+
+#include <QHash>
+#include <QObject>
+#include <QPair>
+#include <QVector>
+
+class QRandomGenerator;
+class ServerCountryModel;
+class ServerData;
+class ServerLatency;
+
+#ifdef UNIT_TEST
+class TestServerSelector;
+#endif
+
+// Picks servers and locations combining the weight provided by the server
+// list with the latency and the loss measured by ServerLatency and with the
+// recent connection failures. The alias tables are rebuilt lazily, only when
+// one of these inputs has changed, so that each pick is O(1).
+class ServerSelector final : public QObject {
+  Q_OBJECT
+  Q_DISABLE_COPY_MOVE(ServerSelector)
+
+ public:
+  ServerSelector();
+  ~ServerSelector();
+
+  void initialize(const ServerCountryModel* model,
+                  const ServerLatency* latency);
+
+  // Returns an uninitialized server if the location does not exist or if the
+  // only server of the location is the excluded one.
+  Server pick(const QString& countryCode, const QString& cityName,
+              const QString& excludedPublicKey = QString());
+
+  int serverCount(const QString& countryCode, const QString& cityName);
+
+  // Picks a location, favoring the ones with more and better servers.
+  bool pickLocation(ServerData& data);
+
+  void recordFailure(const QString& publicKey);
+  void recordSuccess(const QString& publicKey);
+
+  double score(const Server& server) const;
+
+ private:
+  void invalidate();
+  void maybeRebuild();
+  void expireFailures();
+
+ private:
+  const ServerCountryModel* m_model = nullptr;
+  const ServerLatency* m_latency = nullptr;
+
+  typedef QPair<QString, QString> Location;
+
+  struct CityTable {
+    QList<Server> m_servers;
+    AliasTable m_table;
+  };
+  QHash<Location, CityTable> m_cities;
+
+  QVector<Location> m_locations;
+  AliasTable m_locationTable;
+
+  struct Failure {
+    int m_count = 0;
+    qint64 m_lastFailure = 0;
+  };
+  QHash<QString, Failure> m_failures;
+
+  // When the oldest failure stops counting, the tables must be rebuilt.
+  qint64 m_failureExpiry = 0;
+
+  bool m_dirty = true;
+
+  QRandomGenerator* m_generator = nullptr;
+
+#ifdef UNIT_TEST
+  friend class TestServerSelector;
+#endif
+};
+
+#endif  // SERVERSELECTOR_H
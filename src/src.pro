@@ -55,6 +55,7 @@ RCC_DIR = .rcc
 UI_DIR = .ui
 
 SOURCES += \
+        aliastable.cpp \
         apppermission.cpp \
         authenticationlistener.cpp \
         authenticationinapp/authenticationinapp.cpp \
@@ -102,11 +103,14 @@ SOURCES += \
         inspector/inspectorwebsocketconnection.cpp \
         inspector/inspectorwebsocketserver.cpp \
         ipaddress.cpp \
+        ipprefixset.cpp \
+        jsonstreamparser.cpp \
         l18nstringsimpl.cpp \
         leakdetector.cpp \
         localizer.cpp \
         logger.cpp \
         loghandler.cpp \
+        logstore.cpp \
         logoutobserver.cpp \
         main.cpp \
         models/device.cpp \
@@ -121,6 +125,7 @@ SOURCES += \
         models/servercountry.cpp \
         models/servercountrymodel.cpp \
         models/serverdata.cpp \
+        models/serverlistsnapshot.cpp \
         models/supportcategorymodel.cpp \
         models/survey.cpp \
         models/surveymodel.cpp \
@@ -129,10 +134,13 @@ SOURCES += \
         mozillavpn.cpp \
         networkmanager.cpp \
         networkrequest.cpp \
+        networkresponsecache.cpp \
         networkwatcher.cpp \
         notificationhandler.cpp \
         pinghelper.cpp \
         pingsender.cpp \
+        pingsenderfactory.cpp \
+        pingstats.cpp \
         platforms/dummy/dummyapplistprovider.cpp \
         platforms/dummy/dummyiaphandler.cpp \
         platforms/dummy/dummynetworkwatcher.cpp \
@@ -145,6 +153,8 @@ SOURCES += \
         rfc/rfc4291.cpp \
         rfc/rfc5735.cpp \
         serveri18n.cpp \
+        serverlatency.cpp \
+        serverselector.cpp \
         settingsholder.cpp \
         simplenetworkmanager.cpp \
         statusicon.cpp \
@@ -167,6 +177,7 @@ SOURCES += \
         tasks/surveydata/tasksurveydata.cpp \
         taskscheduler.cpp \
         theme.cpp \
+        throughputseries.cpp \
         timercontroller.cpp \
         timersingleshot.cpp \
         update/updater.cpp \
@@ -174,6 +185,7 @@ SOURCES += \
         urlopener.cpp
 
 HEADERS += \
+        aliastable.h \
         appimageprovider.h \
         apppermission.h \
         applistprovider.h \
@@ -235,10 +247,13 @@ HEADERS += \
         inspector/inspectorwebsocketconnection.h \
         inspector/inspectorwebsocketserver.h \
         ipaddress.h \
+        ipprefixset.h \
+        jsonstreamparser.h \
         leakdetector.h \
         localizer.h \
         logger.h \
         loghandler.h \
+        logstore.h \
         logoutobserver.h \
         models/device.h \
         models/devicemodel.h \
@@ -252,6 +267,7 @@ HEADERS += \
         models/servercountry.h \
         models/servercountrymodel.h \
         models/serverdata.h \
+        models/serverlistsnapshot.h \
         models/supportcategorymodel.h \
         models/survey.h \
         models/surveymodel.h \
@@ -260,11 +276,14 @@ HEADERS += \
         mozillavpn.h \
         networkmanager.h \
         networkrequest.h \
+        networkresponsecache.h \
         networkwatcher.h \
         networkwatcherimpl.h \
         notificationhandler.h \
         pinghelper.h \
         pingsender.h \
+        pingsenderfactory.h \
+        pingstats.h \
         platforms/dummy/dummyapplistprovider.h \
         platforms/dummy/dummyiaphandler.h \
         platforms/dummy/dummynetworkwatcher.h \
@@ -277,6 +296,8 @@ HEADERS += \
         rfc/rfc4291.h \
         rfc/rfc5735.h \
         serveri18n.h \
+        serverlatency.h \
+        serverselector.h \
         settingsholder.h \
         simplenetworkmanager.h \
         statusicon.h \
@@ -300,6 +321,7 @@ HEADERS += \
         tasks/surveydata/tasksurveydata.h \
         taskscheduler.h \
         theme.h \
+        throughputseries.h \
         timercontroller.h \
         timersingleshot.h \
         update/updater.h \
@@ -337,8 +359,10 @@ balrog {
     message(Balrog enabled)
     DEFINES += MVPN_BALROG
 
-    SOURCES += update/balrog.cpp
-    HEADERS += update/balrog.h
+    SOURCES += update/balrog.cpp \
+        update/resumabledownload.cpp
+    HEADERS += update/balrog.h \
+        update/resumabledownload.h
 }
 
 DUMMY {
@@ -431,12 +455,17 @@ else:linux:!android {
             ../3rdparty/wireguard-tools/contrib/embeddable-wg-library/wireguard.c \
             daemon/daemon.cpp \
             platforms/linux/daemon/apptracker.cpp \
+            platforms/linux/daemon/cgroupmigrator.cpp \
+            platforms/linux/daemon/cgroupsockmark.cpp \
             platforms/linux/daemon/dbusservice.cpp \
             platforms/linux/daemon/dnsutilslinux.cpp \
             platforms/linux/daemon/iputilslinux.cpp \
             platforms/linux/daemon/linuxdaemon.cpp \
+            platforms/linux/daemon/netlinktransaction.cpp \
+            platforms/linux/daemon/pathmtuprober.cpp \
             platforms/linux/daemon/pidtracker.cpp \
             platforms/linux/daemon/polkithelper.cpp \
+            platforms/linux/daemon/wireguardstatscache.cpp \
             platforms/linux/daemon/wireguardutilslinux.cpp
 
     HEADERS += \
@@ -447,12 +476,17 @@ else:linux:!android {
             daemon/iputils.h \
             daemon/wireguardutils.h \
             platforms/linux/daemon/apptracker.h \
+            platforms/linux/daemon/cgroupmigrator.h \
+            platforms/linux/daemon/cgroupsockmark.h \
             platforms/linux/daemon/dbusservice.h \
             platforms/linux/daemon/dbustypeslinux.h \
             platforms/linux/daemon/dnsutilslinux.h \
             platforms/linux/daemon/iputilslinux.h \
+            platforms/linux/daemon/netlinktransaction.h \
+            platforms/linux/daemon/pathmtuprober.h \
             platforms/linux/daemon/pidtracker.h \
             platforms/linux/daemon/polkithelper.h \
+            platforms/linux/daemon/wireguardstatscache.h \
             platforms/linux/daemon/wireguardutilslinux.h
 
     isEmpty(USRPATH) {
@@ -532,14 +566,16 @@ else:android {
                    adjust/adjustproxy.cpp \
                    adjust/adjustproxyconnection.cpp \
                    adjust/adjustproxypackagehandler.cpp \
-                   adjust/adjusttasksubmission.cpp
+                   adjust/adjusttasksubmission.cpp \
+                   adjust/adjustupstreampool.cpp
 
         HEADERS += adjust/adjustfiltering.h \
                    adjust/adjusthandler.h \
                    adjust/adjustproxy.h \
                    adjust/adjustproxyconnection.h \
                    adjust/adjustproxypackagehandler.h \
-                   adjust/adjusttasksubmission.h
+                   adjust/adjusttasksubmission.h \
+                   adjust/adjustupstreampool.h
     }
 
     versionAtLeast(QT_VERSION, 5.15.1) {
@@ -723,6 +759,7 @@ else:macos {
                    daemon/daemon.h \
                    daemon/daemonlocalserver.h \
                    daemon/daemonlocalserverconnection.h \
+                   daemon/daemonstatusframe.h \
                    daemon/dnsutils.h \
                    daemon/iputils.h \
                    daemon/wireguardutils.h \
@@ -755,7 +792,8 @@ else:ios {
                    adjust/adjustproxy.cpp \
                    adjust/adjustproxyconnection.cpp \
                    adjust/adjustproxypackagehandler.cpp \
-                   adjust/adjusttasksubmission.cpp
+                   adjust/adjusttasksubmission.cpp \
+                   adjust/adjustupstreampool.cpp
 
         OBJECTIVE_SOURCES += platforms/ios/iosadjusthelper.mm
 
@@ -764,7 +802,8 @@ else:ios {
                    adjust/adjustproxy.h \
                    adjust/adjustproxyconnection.h \
                    adjust/adjustproxypackagehandler.h \
-                   adjust/adjusttasksubmission.h
+                   adjust/adjusttasksubmission.h \
+                   adjust/adjustupstreampool.h
 
         OBJECTIVE_HEADERS += platforms/ios/iosadjusthelper.h
     }
@@ -882,6 +921,7 @@ else:win* {
         daemon/daemon.h \
         daemon/daemonlocalserver.h \
         daemon/daemonlocalserverconnection.h \
+        daemon/daemonstatusframe.h \
         daemon/dnsutils.h \
         daemon/iputils.h \
         daemon/wireguardutils.h \
@@ -11,11 +11,34 @@ class Task : public QObject {
   Q_OBJECT
 
  public:
+  // Tasks sharing a resource run one after the other, in the order they have
+  // been scheduled. A task using all the resources runs alone.
+  enum Resource : quint32 {
+    ResourceNone = 0,
+    ResourceController = 1 << 0,
+    ResourceAll = 0xFFFFFFFF,
+  };
+
+  enum Priority {
+    PriorityLow,
+    PriorityNormal,
+    PriorityHigh,
+  };
+
   explicit Task(const QString& name) : m_name(name) {}
   virtual ~Task() = default;
 
   const QString& name() const { return m_name; }
 
+  // Overwrite this method if the task can run while other tasks are running.
+  virtual quint32 resources() const { return ResourceAll; }
+
+  virtual Priority priority() const { return PriorityNormal; }
+
+  // Overwrite this method if the task can be dropped when a task with the
+  // same name is already waiting to run: the pending one does the same work.
+  virtual bool coalescable() const { return false; }
+
   virtual void run() = 0;
   virtual void cancel() { m_cancelled = true; }
 
@@ -17,6 +17,9 @@ class TaskAccount final : public Task {
   ~TaskAccount();
 
   void run() override;
+
+  quint32 resources() const override { return ResourceNone; }
+  bool coalescable() const override { return true; }
 };
 
 #endif  // TASKACCOUNT_H
@@ -17,6 +17,9 @@ class TaskCaptivePortalLookup final : public Task {
   ~TaskCaptivePortalLookup();
 
   void run() override;
+
+  quint32 resources() const override { return ResourceNone; }
+  bool coalescable() const override { return true; }
 };
 
 #endif  // TASKCAPTIVEPORTALLOOKUP_H
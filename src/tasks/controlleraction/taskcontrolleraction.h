@@ -29,6 +29,9 @@ class TaskControllerAction final : public Task {
 
   void run() override;
 
+  quint32 resources() const override { return ResourceController; }
+  Priority priority() const override { return PriorityHigh; }
+
  private slots:
   void stateChanged();
   void silentSwitchDone();
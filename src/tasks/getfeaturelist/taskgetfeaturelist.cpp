@@ -39,4 +39,9 @@ void TaskGetFeatureList::run() {
             FeatureList::instance()->updateFeatureList(data);
             emit completed();
           });
+
+  connect(request, &NetworkRequest::requestUnchanged, this, [this]() {
+    logger.debug() << "Feature list unchanged";
+    emit completed();
+  });
 }
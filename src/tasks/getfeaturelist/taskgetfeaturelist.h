@@ -17,6 +17,10 @@ class TaskGetFeatureList final : public Task {
   ~TaskGetFeatureList();
 
   void run() override;
+
+  quint32 resources() const override { return ResourceNone; }
+  bool coalescable() const override { return true; }
+  Priority priority() const override { return PriorityLow; }
 };
 
 #endif  // TASKGETFEATURELIST_H
@@ -13,6 +13,13 @@ Logger logger(LOG_MAIN, "TaskGroup");
 TaskGroup::TaskGroup(std::initializer_list<Task*> list)
     : Task("TaskGroup"), m_tasks(list) {
   MVPN_COUNT_CTOR(TaskGroup);
+
+  // Computed once: the subtasks are removed as they complete, and the group
+  // keeps its resources until it completes as a whole.
+  for (Task* task : m_tasks) {
+    m_resources |= task->resources();
+    m_priority = qMax(m_priority, task->priority());
+  }
 }
 
 TaskGroup::~TaskGroup() {
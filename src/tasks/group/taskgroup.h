@@ -22,11 +22,18 @@ class TaskGroup final : public Task {
   void cancel() override;
   bool deletable() const override;
 
+  // The group is scheduled as a single task, which uses the resources of all
+  // its subtasks.
+  quint32 resources() const override { return m_resources; }
+  Priority priority() const override { return m_priority; }
+
  private:
   void maybeComplete();
 
  private:
   QList<Task*> m_tasks;
+  quint32 m_resources = ResourceNone;
+  Priority m_priority = PriorityLow;
 };
 
 #endif  // TASKGROUP_H
@@ -17,6 +17,9 @@ class TaskHeartbeat final : public Task {
   ~TaskHeartbeat();
 
   void run() override;
+
+  quint32 resources() const override { return ResourceNone; }
+  bool coalescable() const override { return true; }
 };
 
 #endif  // TASKHEARTBEAT_H
@@ -6,6 +6,7 @@
 #include "errorhandler.h"
 #include "leakdetector.h"
 #include "logger.h"
+#include "models/servercountrymodel.h"
 #include "mozillavpn.h"
 #include "networkrequest.h"
 
@@ -13,7 +14,11 @@ namespace {
 Logger logger(LOG_MAIN, "TaskServers");
 }
 
-TaskServers::TaskServers() : Task("TaskServers") {
+TaskServers::TaskServers()
+    : Task("TaskServers"),
+      m_parser("countries", [this](const QJsonValue& value) {
+        return ServerCountryModel::parseCountry(value, m_countries);
+      }) {
   MVPN_COUNT_CTOR(TaskServers);
 }
 
@@ -30,10 +35,25 @@ void TaskServers::run() {
         emit completed();
       });
 
+  connect(request, &NetworkRequest::requestDataReceived, this,
+          [this](const QByteArray& chunk) { m_parser.feed(chunk); });
+
   connect(request, &NetworkRequest::requestCompleted, this,
           [this](const QByteArray& data) {
             logger.debug() << "Servers obtained";
-            MozillaVPN::instance()->serversFetched(data);
+
+            // Cached or coalesced replies are not streamed: the model parses
+            // them.
+            if (m_parser.isComplete() && m_parser.hasArray()) {
+              MozillaVPN::instance()->serversFetched(data, &m_countries);
+            } else {
+              MozillaVPN::instance()->serversFetched(data);
+            }
             emit completed();
           });
+
+  connect(request, &NetworkRequest::requestUnchanged, this, [this]() {
+    logger.debug() << "Servers unchanged";
+    emit completed();
+  });
 }
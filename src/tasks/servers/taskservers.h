@@ -5,8 +5,11 @@
 #ifndef TASKSERVERS_H
 #define TASKSERVERS_H
 
+#include "jsonstreamparser.h"
+#include "models/servercountry.h"
 #include "task.h"
 
+#include <QList>
 #include <QObject>
 
 class TaskServers final : public Task {
@@ -17,6 +20,14 @@ class TaskServers final : public Task {
   ~TaskServers();
 
   void run() override;
+
+  quint32 resources() const override { return ResourceNone; }
+  bool coalescable() const override { return true; }
+
+ private:
+  // The server list is parsed while it is being received.
+  QList<ServerCountry> m_countries;
+  JsonStreamParser m_parser;
 };
 
 #endif  // TASKSERVERS_H
@@ -36,4 +36,9 @@ void TaskSurveyData::run() {
             MozillaVPN::instance()->surveyChecked(data);
             emit completed();
           });
+
+  connect(request, &NetworkRequest::requestUnchanged, this, [this]() {
+    logger.debug() << "Survey data unchanged";
+    emit completed();
+  });
 }
@@ -17,6 +17,10 @@ class TaskSurveyData final : public Task {
   ~TaskSurveyData();
 
   void run() override;
+
+  quint32 resources() const override { return ResourceNone; }
+  bool coalescable() const override { return true; }
+  Priority priority() const override { return PriorityLow; }
 };
 
 #endif  // TASKSURVEYDATA_H
@@ -3,6 +3,7 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include "taskscheduler.h"
+#include "constants.h"
 #include "leakdetector.h"
 #include "logger.h"
 #include "mozillavpn.h"
@@ -22,6 +23,15 @@ void TaskScheduler::scheduleTask(Task* task) {
 // static
 void TaskScheduler::deleteTasks() { maybeCreate()->deleteTasksInternal(); }
 
+// static
+void TaskScheduler::setMaxConcurrentTasks(int maxConcurrentTasks) {
+  Q_ASSERT(maxConcurrentTasks > 0);
+
+  TaskScheduler* taskScheduler = maybeCreate();
+  taskScheduler->m_maxConcurrentTasks = maxConcurrentTasks;
+  taskScheduler->maybeRunTask();
+}
+
 // static
 TaskScheduler* TaskScheduler::maybeCreate() {
   static TaskScheduler* s_taskScheduler = nullptr;
@@ -31,40 +41,99 @@ TaskScheduler* TaskScheduler::maybeCreate() {
   return s_taskScheduler;
 }
 
-TaskScheduler::TaskScheduler(QObject* parent) : QObject(parent) {
+TaskScheduler::TaskScheduler(QObject* parent)
+    : QObject(parent),
+      m_maxConcurrentTasks(Constants::TASK_SCHEDULER_MAX_CONCURRENT_TASKS) {
   MVPN_COUNT_CTOR(TaskScheduler);
 }
 
 TaskScheduler::~TaskScheduler() { MVPN_COUNT_DTOR(TaskScheduler); }
 
+// static
+bool TaskScheduler::conflicts(const Task* a, const Task* b) {
+  // A task using all the resources conflicts even with the ones using none.
+  return a->resources() == Task::ResourceAll ||
+         b->resources() == Task::ResourceAll ||
+         (a->resources() & b->resources()) != 0 || a->name() == b->name();
+}
+
 void TaskScheduler::scheduleTaskInternal(Task* task) {
+  if (task->coalescable()) {
+    for (Task* pending : m_tasks) {
+      if (pending->name() == task->name()) {
+        logger.debug() << "Task already scheduled:" << task->name();
+        task->deleteLater();
+        return;
+      }
+    }
+  }
+
   m_tasks.append(task);
   maybeRunTask();
 }
 
-void TaskScheduler::maybeRunTask() {
-  logger.debug() << "Tasks: " << m_tasks.size();
+int TaskScheduler::nextRunnableTask() const {
+  int next = -1;
+
+  for (int i = 0; i < m_tasks.length(); ++i) {
+    const Task* task = m_tasks.at(i);
+    if (next >= 0 && m_tasks.at(next)->priority() >= task->priority()) {
+      continue;
+    }
+
+    bool runnable = true;
+    for (const Task* running : m_running) {
+      if (conflicts(task, running)) {
+        runnable = false;
+        break;
+      }
+    }
 
-  if (m_running_task || m_tasks.empty()) {
-    return;
+    for (int j = 0; runnable && j < i; ++j) {
+      if (conflicts(task, m_tasks.at(j))) {
+        runnable = false;
+      }
+    }
+
+    if (runnable) {
+      next = i;
+    }
   }
 
-  m_running_task = m_tasks.takeFirst();
-  Q_ASSERT(m_running_task);
+  return next;
+}
+
+void TaskScheduler::maybeRunTask() {
+  logger.debug() << "Tasks: " << m_tasks.size() << "running:"
+                 << m_running.size();
+
+  while (m_running.length() < m_maxConcurrentTasks) {
+    int next = nextRunnableTask();
+    if (next < 0) {
+      return;
+    }
+
+    Task* task = m_tasks.takeAt(next);
+    Q_ASSERT(task);
 
-  QObject::connect(m_running_task, &Task::completed, this,
-                   &TaskScheduler::taskCompleted);
+    // The task can complete synchronously, from run().
+    m_running.append(task);
 
-  m_running_task->run();
+    QObject::connect(task, &Task::completed, this,
+                     [this, task]() { taskCompleted(task); });
+
+    logger.debug() << "Running task:" << task->name();
+    task->run();
+  }
 }
 
-void TaskScheduler::taskCompleted() {
-  Q_ASSERT(m_running_task);
+void TaskScheduler::taskCompleted(Task* task) {
+  Q_ASSERT(m_running.contains(task));
 
-  logger.debug() << "Task completed:" << m_running_task->name();
-  m_running_task->deleteLater();
-  m_running_task->disconnect();
-  m_running_task = nullptr;
+  logger.debug() << "Task completed:" << task->name();
+  m_running.removeOne(task);
+  task->deleteLater();
+  task->disconnect();
 
   maybeRunTask();
 }
@@ -79,10 +148,17 @@ void TaskScheduler::deleteTasksInternal() {
     }
   }
 
-  if (m_running_task && m_running_task->deletable()) {
-    m_running_task->cancel();
-    m_running_task->deleteLater();
-    m_running_task->disconnect();
-    m_running_task = nullptr;
+  QMutableListIterator<Task*> j(m_running);
+  while (j.hasNext()) {
+    Task* task = j.next();
+    if (task->deletable()) {
+      task->cancel();
+      task->deleteLater();
+      task->disconnect();
+      j.remove();
+    }
   }
+
+  // The non-deletable tasks left may have been waiting for the deleted ones.
+  maybeRunTask();
 }
@@ -5,10 +5,18 @@
 #ifndef TASKSCHEDULER_H
 #define TASKSCHEDULER_H
 
+#include <QList>
 #include <QObject>
 
 class Task;
 
+// Runs the scheduled tasks, up to `maxConcurrentTasks` at the same time.
+//
+// Two tasks conflict if they share a resource (see Task::resources()), if one
+// of them uses all the resources, or if they have the same name. A pending task starts when it conflicts neither
+// with a running task nor with a task scheduled before it, so that conflicting
+// tasks keep the scheduling order. Among the tasks which can start, the one
+// with the highest priority goes first.
 class TaskScheduler final : public QObject {
   Q_OBJECT
 
@@ -16,21 +24,31 @@ class TaskScheduler final : public QObject {
   static void scheduleTask(Task* task);
   static void deleteTasks();
 
+  // 1 restores the sequential behavior: one task at a time.
+  static void setMaxConcurrentTasks(int maxConcurrentTasks);
+
  private:
   explicit TaskScheduler(QObject* parent);
   ~TaskScheduler();
 
   static TaskScheduler* maybeCreate();
 
+  static bool conflicts(const Task* a, const Task* b);
+
   void scheduleTaskInternal(Task* task);
   void deleteTasksInternal();
 
   void maybeRunTask();
+  int nextRunnableTask() const;
 
-  void taskCompleted();
+  void taskCompleted(Task* task);
 
  private:
-  Task* m_running_task = nullptr;
+  int m_maxConcurrentTasks;
+
+  QList<Task*> m_running;
+
+  // Pending tasks, in scheduling order.
   QList<Task*> m_tasks;
 };
 
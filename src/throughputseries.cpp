@@ -0,0 +1,62 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "throughputseries.h"
+
+#include <QtGlobal>
+
+ThroughputSeries::ThroughputSeries(int capacity) {
+  m_samples.resize(qMax(1, capacity));
+  m_maxDeque.reserve(m_samples.size() * 2);
+}
+
+int ThroughputSeries::count() const {
+  return static_cast<int>(
+      qMin(m_appended, static_cast<quint64>(m_samples.size())));
+}
+
+void ThroughputSeries::reset() {
+  m_samples.fill(Sample());
+  m_appended = 0;
+  m_maxDeque.clear();
+  m_maxHead = 0;
+}
+
+void ThroughputSeries::append(quint64 txBytes, quint64 rxBytes) {
+  const int size = m_samples.size();
+  quint64 index = m_appended++;
+
+  Sample& sample = m_samples[index % size];
+  sample.m_txBytes = txBytes;
+  sample.m_rxBytes = rxBytes;
+
+  // The values smaller than the new one can never be the maximum again.
+  quint64 value = qMax(txBytes, rxBytes);
+  while (m_maxDeque.size() > m_maxHead && m_maxDeque.last().value <= value) {
+    m_maxDeque.removeLast();
+  }
+  m_maxDeque.append({index, value});
+
+  // Drop what has left the window. The new sample is always kept.
+  while (m_maxDeque[m_maxHead].index + size <= index) {
+    m_maxHead++;
+  }
+  if (m_maxHead >= size) {
+    m_maxDeque.remove(0, m_maxHead);
+    m_maxHead = 0;
+  }
+}
+
+const ThroughputSeries::Sample& ThroughputSeries::at(int pos) const {
+  Q_ASSERT(pos >= 0 && pos < count());
+  quint64 index = m_appended - count() + pos;
+  return m_samples.at(index % m_samples.size());
+}
+
+quint64 ThroughputSeries::maximum() const {
+  if (m_maxHead == m_maxDeque.size()) {
+    return 0;
+  }
+  return m_maxDeque.at(m_maxHead).value;
+}
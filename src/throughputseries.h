@@ -0,0 +1,57 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef THROUGHPUTSERIES_H
+#define THROUGHPUTSERIES_H
+
+#include <QVector>
+
+// Fixed-capacity time series of throughput samples. Once the capacity is
+// reached, every new sample overwrites the oldest one in a circular buffer.
+// The maximum of the window is kept in a monotonic deque, so appending a
+// sample and reading the maximum are O(1) amortized, whatever the length of
+// the session.
+class ThroughputSeries final {
+ public:
+  struct Sample {
+    quint64 m_txBytes = 0;
+    quint64 m_rxBytes = 0;
+  };
+
+  explicit ThroughputSeries(int capacity);
+
+  int capacity() const { return m_samples.size(); }
+  int count() const;
+
+  // Number of samples appended since the last reset. It's also the index of
+  // the next sample.
+  quint64 appended() const { return m_appended; }
+
+  void reset();
+
+  void append(quint64 txBytes, quint64 rxBytes);
+
+  // 0 is the oldest sample of the window.
+  const Sample& at(int pos) const;
+  const Sample& last() const { return at(count() - 1); }
+
+  // The highest value, tx or rx, of the window. 0 if empty.
+  quint64 maximum() const;
+
+ private:
+  struct MaxEntry {
+    quint64 index;
+    quint64 value;
+  };
+
+  QVector<Sample> m_samples;
+  quint64 m_appended = 0;
+
+  // Ordered by sample index, with strictly decreasing values. The front is the
+  // maximum of the window.
+  QVector<MaxEntry> m_maxDeque;
+  int m_maxHead = 0;
+};
+
+#endif  // THROUGHPUTSERIES_H
@@ -24,6 +24,10 @@ TimerController::TimerController(ControllerImpl* impl) : m_impl(impl) {
           [this] { TimerController::maybeDone(false); });
   connect(m_impl, &ControllerImpl::statusUpdated, this,
           &ControllerImpl::statusUpdated);
+  connect(m_impl, &ControllerImpl::statusSampled, this,
+          &ControllerImpl::statusSampled);
+  connect(m_impl, &ControllerImpl::statusSubscribed, this,
+          &ControllerImpl::statusSubscribed);
 
   m_timer.setSingleShot(true);
   connect(&m_timer, &QTimer::timeout, this, &TimerController::timeout);
@@ -150,6 +154,12 @@ void TimerController::maybeDone(bool isConnected) {
 
 void TimerController::checkStatus() { m_impl->checkStatus(); }
 
+bool TimerController::subscribeStatus(int intervalMsec) {
+  return m_impl->subscribeStatus(intervalMsec);
+}
+
+void TimerController::unsubscribeStatus() { m_impl->unsubscribeStatus(); }
+
 void TimerController::getBackendLogs(
     std::function<void(const QString&)>&& a_callback) {
   std::function<void(const QString&)> callback = std::move(a_callback);
@@ -37,6 +37,10 @@ class TimerController final : public ControllerImpl {
 
   void checkStatus() override;
 
+  bool subscribeStatus(int intervalMsec) override;
+
+  void unsubscribeStatus() override;
+
   void getBackendLogs(std::function<void(const QString&)>&& callback) override;
 
   void cleanupBackendLogs() override;
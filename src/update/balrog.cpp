@@ -18,6 +18,7 @@
 #include <QSslCertificate>
 #include <QSslKey>
 #include <QTemporaryDir>
+#include <QTimer>
 
 typedef struct {
   const char* p;
@@ -334,57 +335,22 @@ bool Balrog::processData(Task* task, const QByteArray& data) {
     return false;
   }
 
-  NetworkRequest* request = NetworkRequest::createForGetUrl(task, url);
-
-  // No timeout for this request.
-  request->disableTimeout();
-
-  connect(
-      request, &NetworkRequest::requestFailed, this,
-      [this, request](QNetworkReply::NetworkError error, const QByteArray&) {
-        logger.error() << "Request failed" << error;
-        propagateError(request, error);
-        deleteLater();
-      });
-
-  connect(request, &NetworkRequest::requestCompleted, this,
-          [this, hashValue, hashFunction, url](const QByteArray& data) {
-            logger.debug() << "Request completed";
-
-            if (!computeHash(url, data, hashValue, hashFunction)) {
-              logger.error() << "Ignore failure.";
-              deleteLater();
-            }
-          });
-
-  return true;
-}
-
-bool Balrog::computeHash(const QString& url, const QByteArray& data,
-                         const QString& hashValue,
-                         const QString& hashFunction) {
-  logger.debug() << "Compute the hash";
-
   if (hashFunction != "sha512") {
     logger.error() << "Invalid hash function";
     return false;
   }
 
-  QCryptographicHash hash(QCryptographicHash::Sha512);
-  hash.addData(data);
-  QByteArray hashHex = hash.result().toHex();
+  m_hashValue = hashValue.toLatin1();
 
-  if (hashHex != hashValue) {
-    logger.error() << "Hash doesn't match";
+  if (!prepareDownload(url)) {
     return false;
   }
 
-  return saveFileAndInstall(url, data);
+  startDownload(task);
+  return true;
 }
 
-bool Balrog::saveFileAndInstall(const QString& url, const QByteArray& data) {
-  logger.debug() << "Save the file and install it";
-
+bool Balrog::prepareDownload(const QString& url) {
   int pos = url.lastIndexOf("/");
   if (pos == -1) {
     logger.error() << "The URL seems to be without /.";
@@ -400,24 +366,99 @@ bool Balrog::saveFileAndInstall(const QString& url, const QByteArray& data) {
     return false;
   }
 
-  QDir dir(m_tmpDir.path());
-  QString tmpFile = dir.filePath(fileName);
-
-  QFile file(tmpFile);
-  if (!file.open(QIODevice::ReadWrite)) {
+  if (!m_download.open(QDir(m_tmpDir.path()).filePath(fileName))) {
     logger.error() << "Unable to create a file in the temporary folder";
     return false;
   }
 
-  qint64 written = file.write(data);
-  if (written != data.length()) {
-    logger.error() << "Unable to write the whole configuration file";
+  m_downloadUrl = url;
+  return true;
+}
+
+void Balrog::startDownload(Task* task) {
+  logger.debug() << "Download the package from" << m_download.offset();
+
+  m_download.startAttempt();
+
+  NetworkRequest* request = NetworkRequest::createForDownload(
+      task, m_downloadUrl, m_download.offset());
+
+  // No timeout for this request.
+  request->disableTimeout();
+
+  connect(request, &NetworkRequest::requestHeaderReceived, this,
+          [this](NetworkRequest* request) {
+            QByteArray range = request->rawHeader("Content-Range");
+            if (!m_download.headerReceived(request->statusCode(), range)) {
+              request->abort();
+            }
+          });
+
+  connect(request, &NetworkRequest::requestDataReceived, this,
+          [this, request](const QByteArray& data) {
+            if (!m_download.write(data)) {
+              request->abort();
+            }
+          });
+
+  connect(request, &NetworkRequest::requestFailed, this,
+          [this, task, request](QNetworkReply::NetworkError error,
+                                const QByteArray&) {
+            downloadFailed(task, request, error);
+          });
+
+  connect(request, &NetworkRequest::requestCompleted, this,
+          [this](const QByteArray&) {
+            logger.debug() << "Request completed";
+
+            if (!downloadCompleted()) {
+              logger.error() << "Ignore failure.";
+              deleteLater();
+            }
+          });
+}
+
+void Balrog::downloadFailed(Task* task, NetworkRequest* request,
+                            QNetworkReply::NetworkError error) {
+  Q_ASSERT(request);
+
+  logger.error() << "Request failed" << error << "after"
+                 << m_download.offset() << "bytes";
+
+  // Aborted by us: the reason has been logged already.
+  if (error == QNetworkReply::OperationCanceledError) {
+    deleteLater();
+    return;
+  }
+
+  int delay = m_download.failed(request->statusCode());
+  if (delay < 0) {
+    propagateError(request, error);
+    deleteLater();
+    return;
+  }
+
+  logger.debug() << "Resume the download in" << delay << "msecs";
+  QTimer::singleShot(delay, this, [this, task]() { startDownload(task); });
+}
+
+bool Balrog::downloadCompleted() {
+  logger.debug() << "Verify the hash of" << m_download.offset() << "bytes";
+
+  // The hash has been computed while downloading: no need to read the file
+  // again.
+  if (m_download.hashHex() != m_hashValue) {
+    logger.error() << "Hash doesn't match";
     return false;
   }
 
-  file.close();
+  if (!m_download.close()) {
+    logger.error() << "Unable to write the whole package:"
+                   << m_download.errorString();
+    return false;
+  }
 
-  return install(tmpFile);
+  return install(m_download.fileName());
 }
 
 bool Balrog::install(const QString& filePath) {
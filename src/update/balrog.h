@@ -5,9 +5,9 @@
 #ifndef BALROG_H
 #define BALROG_H
 
+#include "resumabledownload.h"
 #include "updater.h"
 
-#include <QCryptographicHash>
 #include <QNetworkReply>
 #include <QTemporaryDir>
 
@@ -34,9 +34,11 @@ class Balrog final : public Updater {
   bool validateSignature(const QByteArray& x5uData,
                          const QByteArray& updateData,
                          const QByteArray& signatureBlob);
-  bool computeHash(const QString& url, const QByteArray& data,
-                   const QString& hashValue, const QString& hashFunction);
-  bool saveFileAndInstall(const QString& url, const QByteArray& data);
+  bool prepareDownload(const QString& url);
+  void startDownload(Task* task);
+  void downloadFailed(Task* task, NetworkRequest* request,
+                      QNetworkReply::NetworkError error);
+  bool downloadCompleted();
   bool install(const QString& filePath);
   void propagateError(NetworkRequest* request,
                       QNetworkReply::NetworkError error);
@@ -44,6 +46,10 @@ class Balrog final : public Updater {
  private:
   QTemporaryDir m_tmpDir;
   bool m_downloadAndInstall;
+
+  QString m_downloadUrl;
+  QByteArray m_hashValue;
+  ResumableDownload m_download;
 };
 
 #endif  // BALROG_H
@@ -0,0 +1,135 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "resumabledownload.h"
+#include "leakdetector.h"
+#include "logger.h"
+
+// Network failures during a download. The delay doubles at each attempt.
+constexpr int DOWNLOAD_MAX_RETRIES = 5;
+constexpr int DOWNLOAD_RETRY_MSEC = 2000;
+
+namespace {
+Logger logger(LOG_NETWORKING, "ResumableDownload");
+}
+
+ResumableDownload::ResumableDownload() {
+  MVPN_COUNT_CTOR(ResumableDownload);
+}
+
+ResumableDownload::~ResumableDownload() {
+  MVPN_COUNT_DTOR(ResumableDownload);
+}
+
+bool ResumableDownload::open(const QString& fileName) {
+  m_file.setFileName(fileName);
+  if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    return false;
+  }
+
+  reset();
+  m_attemptOffset = 0;
+  m_retries = 0;
+  return true;
+}
+
+void ResumableDownload::reset() {
+  m_file.resize(0);
+  m_file.seek(0);
+  m_hash.reset();
+  m_offset = 0;
+}
+
+void ResumableDownload::startAttempt() {
+  m_attemptOffset = m_offset;
+  m_status = 0;
+}
+
+bool ResumableDownload::headerReceived(int status,
+                                       const QByteArray& contentRange) {
+  m_status = status;
+
+  if (status == 200) {
+    if (m_offset > 0) {
+      logger.debug() << "Range ignored by the server - starting over";
+      reset();
+      m_attemptOffset = 0;
+    }
+    return true;
+  }
+
+  // 206 Partial Content. The range must start where we stopped.
+  if (status == 206 && m_offset > 0) {
+    QByteArray expected = "bytes " + QByteArray::number(m_offset) + "-";
+    if (!contentRange.startsWith(expected)) {
+      logger.error() << "Unexpected Content-Range:" << contentRange;
+      return false;
+    }
+    return true;
+  }
+
+  // The request fails when the body is received.
+  if (status >= 400) {
+    return true;
+  }
+
+  logger.error() << "Unexpected status code:" << status;
+  return false;
+}
+
+bool ResumableDownload::write(const QByteArray& data) {
+  // The body of an error response is not part of the file.
+  if (m_status >= 400) {
+    return true;
+  }
+
+  qint64 written = m_file.write(data);
+  if (written != data.length()) {
+    logger.error() << "Unable to write the file:" << m_file.errorString();
+    return false;
+  }
+
+  m_hash.addData(data);
+  m_offset += data.length();
+  return true;
+}
+
+int ResumableDownload::failed(int status) {
+  // 416 Range Not Satisfiable: what we have is not a prefix of the file
+  // anymore.
+  if (status == 416 && m_offset > 0) {
+    logger.debug() << "Range not satisfiable - starting over";
+    reset();
+  } else if (status >= 400) {
+    // Trying again would not help.
+    return -1;
+  }
+
+  // Network drop. The counter restarts when some progress has been made.
+  if (m_offset > m_attemptOffset) {
+    m_retries = 0;
+  }
+
+  if (m_retries >= DOWNLOAD_MAX_RETRIES) {
+    logger.error() << "Too many failures";
+    return -1;
+  }
+
+  int delay = DOWNLOAD_RETRY_MSEC << m_retries;
+  ++m_retries;
+  return delay;
+}
+
+QByteArray ResumableDownload::hashHex() const {
+  return m_hash.result().toHex();
+}
+
+bool ResumableDownload::close() {
+  if (!m_file.flush()) {
+    return false;
+  }
+
+  m_file.close();
+  return true;
+}
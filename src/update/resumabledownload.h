@@ -0,0 +1,65 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef RESUMABLEDOWNLOAD_H
+#define RESUMABLEDOWNLOAD_H
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QString>
+
+// The state of a download written to a file, and hashed, as it arrives. After
+// a network failure, the download resumes from offset() with a Range request.
+//
+// The network requests are left to the caller, which reports the events of
+// each attempt: startAttempt(), headerReceived(), write() and failed().
+class ResumableDownload final {
+  Q_DISABLE_COPY_MOVE(ResumableDownload)
+
+ public:
+  ResumableDownload();
+  ~ResumableDownload();
+
+  // Truncates `fileName`, and starts the download over.
+  bool open(const QString& fileName);
+
+  QString fileName() const { return m_file.fileName(); }
+  QString errorString() const { return m_file.errorString(); }
+
+  // Where the next attempt starts.
+  qint64 offset() const { return m_offset; }
+
+  void startAttempt();
+
+  // Returns false if the attempt must be aborted. Error statuses are
+  // accepted: their body is dropped, and failed() handles them.
+  bool headerReceived(int status, const QByteArray& contentRange);
+
+  // Returns false if the data cannot be written.
+  bool write(const QByteArray& data);
+
+  // Returns the delay before the next attempt, in msecs, or -1 if the
+  // download must give up.
+  int failed(int status);
+
+  // Hex SHA-512 of the data written so far.
+  QByteArray hashHex() const;
+
+  // Flushes and closes the file.
+  bool close();
+
+ private:
+  void reset();
+
+ private:
+  QFile m_file;
+  QCryptographicHash m_hash{QCryptographicHash::Sha512};
+  qint64 m_offset = 0;
+  qint64 m_attemptOffset = 0;
+  int m_retries = 0;
+  int m_status = 0;
+};
+
+#endif  // RESUMABLEDOWNLOAD_H
@@ -45,13 +45,16 @@ HEADERS += \
     ../../src/hkdf.h \
     ../../src/inspector/inspectorwebsocketconnection.h \
     ../../src/ipaddress.h \
+    ../../src/ipprefixset.h \
     ../../src/leakdetector.h \
     ../../src/logger.h \
     ../../src/loghandler.h \
+    ../../src/logstore.h \
     ../../src/models/feature.h \
     ../../src/mozillavpn.h \
     ../../src/networkmanager.h \
     ../../src/networkrequest.h \
+    ../../src/networkresponsecache.h \
     ../../src/rfc/rfc1918.h \
     ../../src/rfc/rfc4193.h \
     ../../src/rfc/rfc4291.h \
@@ -66,6 +69,7 @@ HEADERS += \
     ../../src/update/versionapi.h \
     ../../src/urlopener.h \
     testemailvalidation.h \
+    testnetworkrequestcache.h \
     testpasswordvalidation.h \
     testsignupandin.h
 
@@ -82,13 +86,16 @@ SOURCES += \
     ../../src/hawkauth.cpp \
     ../../src/hkdf.cpp \
     ../../src/ipaddress.cpp \
+    ../../src/ipprefixset.cpp \
     ../../src/l18nstringsimpl.cpp \
     ../../src/leakdetector.cpp \
     ../../src/logger.cpp \
     ../../src/loghandler.cpp \
+    ../../src/logstore.cpp \
     ../../src/models/feature.cpp \
     ../../src/networkmanager.cpp \
     ../../src/networkrequest.cpp \
+    ../../src/networkresponsecache.cpp \
     ../../src/rfc/rfc1918.cpp \
     ../../src/rfc/rfc4193.cpp \
     ../../src/rfc/rfc4291.cpp \
@@ -103,6 +110,7 @@ SOURCES += \
     ../../src/urlopener.cpp \
     main.cpp \
     testemailvalidation.cpp \
+    testnetworkrequestcache.cpp \
     testpasswordvalidation.cpp \
     testsignupandin.cpp
 
@@ -10,6 +10,7 @@
 #include "../../src/simplenetworkmanager.h"
 
 #include "testemailvalidation.h"
+#include "testnetworkrequestcache.h"
 #include "testpasswordvalidation.h"
 #include "testsignupandin.h"
 
@@ -27,12 +28,20 @@ int main(int argc, char* argv[]) {
 
   QCoreApplication a(argc, argv);
 
-  SimpleNetworkManager snm;
   FeatureList::instance()->initialize();
 
+  int failures = 0;
+
+  // With its own NetworkManager, before the real one is created.
+  {
+    TestNetworkRequestCache tnrc;
+    failures += QTest::qExec(&tnrc);
+  }
+
+  SimpleNetworkManager snm;
+
   settingsHolder.setDevModeFeatureFlags(QStringList{"inAppAccountCreate"});
 
-  int failures = 0;
   TestEmailValidation tev;
   failures += QTest::qExec(&tev);
 
@@ -49,7 +49,7 @@ void MozillaVPN::deviceRemoved(const QString&) {}
 
 void MozillaVPN::deviceRemovalCompleted(const QString&) {}
 
-void MozillaVPN::serversFetched(const QByteArray&) {}
+void MozillaVPN::serversFetched(const QByteArray&, QList<ServerCountry>*) {}
 
 void MozillaVPN::removeDeviceFromPublicKey(const QString&) {}
 
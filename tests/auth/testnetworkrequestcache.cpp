@@ -0,0 +1,272 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "testnetworkrequestcache.h"
+#include "../../src/networkmanager.h"
+#include "../../src/networkrequest.h"
+#include "../../src/networkresponsecache.h"
+#include "../../src/tasks/function/taskfunction.h"
+
+#include <QCoreApplication>
+#include <QNetworkAccessManager>
+#include <QPointer>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTest>
+
+namespace {
+
+// A reply which stays in flight until the test answers it.
+class MockNetworkReply final : public QNetworkReply {
+ public:
+  MockNetworkReply(const QNetworkRequest& request, QObject* parent)
+      : QNetworkReply(parent) {
+    setRequest(request);
+    setUrl(request.url());
+    setOperation(QNetworkAccessManager::GetOperation);
+    open(QIODevice::ReadOnly);
+  }
+
+  void respond(int status, const QByteArray& body,
+               const QByteArray& etag = QByteArray()) {
+    setAttribute(QNetworkRequest::HttpStatusCodeAttribute, status);
+    if (!etag.isEmpty()) {
+      setRawHeader("ETag", etag);
+    }
+    if (status >= 400) {
+      setError(QNetworkReply::ContentNotFoundError, "Not found");
+    }
+    m_body = body;
+    emit metaDataChanged();
+    emit readyRead();
+    setFinished(true);
+    emit finished();
+  }
+
+  void abort() override { close(); }
+
+  bool isSequential() const override { return true; }
+
+  qint64 bytesAvailable() const override {
+    return m_body.size() - m_offset + QIODevice::bytesAvailable();
+  }
+
+ protected:
+  qint64 readData(char* data, qint64 maxSize) override {
+    qint64 len = qMin(maxSize, m_body.size() - m_offset);
+    memcpy(data, m_body.constData() + m_offset, len);
+    m_offset += len;
+    return len;
+  }
+
+ private:
+  QByteArray m_body;
+  qint64 m_offset = 0;
+};
+
+class MockNetworkAccessManager final : public QNetworkAccessManager {
+ public:
+  explicit MockNetworkAccessManager(QObject* parent)
+      : QNetworkAccessManager(parent) {}
+
+  // The replies still alive, in the order of the requests.
+  QList<QPointer<MockNetworkReply>> m_replies;
+
+ protected:
+  QNetworkReply* createRequest(Operation op, const QNetworkRequest& request,
+                               QIODevice* outgoingData) override {
+    Q_ASSERT(op == GetOperation);
+    Q_UNUSED(outgoingData);
+
+    MockNetworkReply* reply = new MockNetworkReply(request, this);
+    m_replies.append(reply);
+    return reply;
+  }
+};
+
+constexpr const char* BODY = "{\"servers\":[]}";
+
+QString cacheKey(MockNetworkReply* reply) {
+  return NetworkResponseCache::key(reply->request().url(),
+                                   reply->request().rawHeader("Authorization"));
+}
+
+}  // namespace
+
+class MockNetworkManager final : public NetworkManager {
+ public:
+  MockNetworkManager() : m_manager(new MockNetworkAccessManager(this)) {}
+
+  QNetworkAccessManager* networkAccessManager() override { return m_manager; }
+
+  MockNetworkAccessManager* mock() const { return m_manager; }
+
+ protected:
+  void clearCacheInternal() override {}
+
+ private:
+  MockNetworkAccessManager* m_manager;
+};
+
+void TestNetworkRequestCache::initTestCase() {
+  QStandardPaths::setTestModeEnabled(true);
+  m_networkManager = new MockNetworkManager();
+}
+
+void TestNetworkRequestCache::cleanupTestCase() {
+  NetworkResponseCache::instance()->clear();
+  delete m_networkManager;
+  m_networkManager = nullptr;
+  QStandardPaths::setTestModeEnabled(false);
+}
+
+void TestNetworkRequestCache::init() {
+  NetworkResponseCache::instance()->clear();
+  m_networkManager->mock()->m_replies.clear();
+  m_task = new TaskFunction([]() {});
+}
+
+void TestNetworkRequestCache::cleanup() {
+  delete m_task;
+  m_task = nullptr;
+  QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+}
+
+void TestNetworkRequestCache::coalescing() {
+  NetworkRequest* leader = NetworkRequest::createForServers(m_task);
+  NetworkRequest* follower = NetworkRequest::createForServers(m_task);
+  QSignalSpy leaderSpy(leader, &NetworkRequest::requestCompleted);
+  QSignalSpy followerSpy(follower, &NetworkRequest::requestCompleted);
+
+  // A single request goes out, unconditional.
+  QCOMPARE(m_networkManager->mock()->m_replies.length(), 1);
+  MockNetworkReply* reply = m_networkManager->mock()->m_replies.first();
+  QVERIFY(!reply->request().hasRawHeader("If-None-Match"));
+
+  reply->respond(200, BODY, "\"v1\"");
+
+  QCOMPARE(leaderSpy.count(), 1);
+  QCOMPARE(leaderSpy.first().first().toByteArray(), QByteArray(BODY));
+  QCOMPARE(followerSpy.count(), 1);
+  QCOMPARE(followerSpy.first().first().toByteArray(), QByteArray(BODY));
+  QCOMPARE(follower->statusCode(), 200);
+
+  // Not coalesced once the leader is done: the next one is conditional.
+  NetworkRequest::createForServers(m_task);
+  QCOMPARE(m_networkManager->mock()->m_replies.length(), 2);
+  QCOMPARE(m_networkManager->mock()->m_replies.last()->request().rawHeader(
+               "If-None-Match"),
+           QByteArray("\"v1\""));
+}
+
+void TestNetworkRequestCache::notModified() {
+  NetworkRequest::createForServers(m_task);
+  m_networkManager->mock()->m_replies.last()->respond(200, BODY, "\"v1\"");
+
+  // The body has been delivered: a consumer which can keep its state is told
+  // that nothing changed, the others get the cached body.
+  NetworkRequest* leader = NetworkRequest::createForServers(m_task);
+  NetworkRequest* follower = NetworkRequest::createForServers(m_task);
+  QSignalSpy unchangedSpy(leader, &NetworkRequest::requestUnchanged);
+  QSignalSpy leaderSpy(leader, &NetworkRequest::requestCompleted);
+  QSignalSpy followerSpy(follower, &NetworkRequest::requestCompleted);
+
+  QCOMPARE(m_networkManager->mock()->m_replies.length(), 2);
+  m_networkManager->mock()->m_replies.last()->respond(304, QByteArray());
+
+  QCOMPARE(unchangedSpy.count(), 1);
+  QCOMPARE(leaderSpy.count(), 0);
+  QCOMPARE(followerSpy.count(), 1);
+  QCOMPARE(followerSpy.first().first().toByteArray(), QByteArray(BODY));
+  QCOMPARE(follower->statusCode(), 304);
+}
+
+void TestNetworkRequestCache::notModifiedUndelivered() {
+  // Cached by a previous run of the app: the body must be delivered once.
+  NetworkRequest* request = NetworkRequest::createForServers(m_task);
+  QString key = cacheKey(m_networkManager->mock()->m_replies.last());
+  delete request;
+
+  NetworkResponseCache::instance()->store(key, {"\"v1\"", QByteArray(), BODY});
+  QVERIFY(!NetworkResponseCache::instance()->isDelivered(key));
+
+  request = NetworkRequest::createForServers(m_task);
+  QSignalSpy unchangedSpy(request, &NetworkRequest::requestUnchanged);
+  QSignalSpy completedSpy(request, &NetworkRequest::requestCompleted);
+
+  MockNetworkReply* reply = m_networkManager->mock()->m_replies.last();
+  QCOMPARE(reply->request().rawHeader("If-None-Match"), QByteArray("\"v1\""));
+  reply->respond(304, QByteArray());
+
+  QCOMPARE(unchangedSpy.count(), 0);
+  QCOMPARE(completedSpy.count(), 1);
+  QCOMPARE(completedSpy.first().first().toByteArray(), QByteArray(BODY));
+  QVERIFY(NetworkResponseCache::instance()->isDelivered(key));
+}
+
+void TestNetworkRequestCache::notModifiedWithoutCache() {
+  NetworkRequest* request = NetworkRequest::createForServers(m_task);
+  QSignalSpy failedSpy(request, &NetworkRequest::requestFailed);
+  QSignalSpy completedSpy(request, &NetworkRequest::requestCompleted);
+
+  m_networkManager->mock()->m_replies.last()->respond(304, QByteArray());
+
+  QCOMPARE(failedSpy.count(), 1);
+  QCOMPARE(completedSpy.count(), 0);
+}
+
+void TestNetworkRequestCache::failure() {
+  NetworkRequest* leader = NetworkRequest::createForServers(m_task);
+  NetworkRequest* follower = NetworkRequest::createForServers(m_task);
+  QSignalSpy leaderSpy(leader, &NetworkRequest::requestFailed);
+  QSignalSpy followerSpy(follower, &NetworkRequest::requestFailed);
+
+  MockNetworkReply* reply = m_networkManager->mock()->m_replies.last();
+  QString key = cacheKey(reply);
+  reply->respond(404, QByteArray());
+
+  QCOMPARE(leaderSpy.count(), 1);
+  QCOMPARE(followerSpy.count(), 1);
+  QCOMPARE(follower->statusCode(), 404);
+
+  // Nothing is cached from a failure.
+  QVERIFY(!NetworkResponseCache::instance()->find(key).isValid());
+}
+
+void TestNetworkRequestCache::leaderDeleted() {
+  NetworkRequest* leader = NetworkRequest::createForServers(m_task);
+  NetworkRequest* first = NetworkRequest::createForServers(m_task);
+  NetworkRequest* second = NetworkRequest::createForServers(m_task);
+  QSignalSpy firstSpy(first, &NetworkRequest::requestCompleted);
+  QSignalSpy secondSpy(second, &NetworkRequest::requestCompleted);
+  QCOMPARE(m_networkManager->mock()->m_replies.length(), 1);
+
+  // The first follower sends its own request, and leads the others.
+  delete leader;
+  QCOMPARE(m_networkManager->mock()->m_replies.length(), 2);
+  QVERIFY(!m_networkManager->mock()->m_replies.first());
+
+  // A new request is coalesced with the new leader.
+  NetworkRequest* third = NetworkRequest::createForServers(m_task);
+  QSignalSpy thirdSpy(third, &NetworkRequest::requestCompleted);
+  QCOMPARE(m_networkManager->mock()->m_replies.length(), 2);
+
+  m_networkManager->mock()->m_replies.last()->respond(200, BODY, "\"v1\"");
+
+  QCOMPARE(firstSpy.count(), 1);
+  QCOMPARE(secondSpy.count(), 1);
+  QCOMPARE(thirdSpy.count(), 1);
+}
+
+void TestNetworkRequestCache::followerDeleted() {
+  NetworkRequest* leader = NetworkRequest::createForServers(m_task);
+  NetworkRequest* follower = NetworkRequest::createForServers(m_task);
+  QSignalSpy leaderSpy(leader, &NetworkRequest::requestCompleted);
+
+  delete follower;
+  QCOMPARE(m_networkManager->mock()->m_replies.length(), 1);
+
+  m_networkManager->mock()->m_replies.last()->respond(200, BODY, "\"v1\"");
+  QCOMPARE(leaderSpy.count(), 1);
+}
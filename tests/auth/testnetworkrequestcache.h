@@ -0,0 +1,32 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <QObject>
+
+class MockNetworkManager;
+class Task;
+
+// Runs NetworkRequest against canned replies, with its own NetworkManager: it
+// must run before the SimpleNetworkManager is created.
+class TestNetworkRequestCache final : public QObject {
+  Q_OBJECT
+
+ private slots:
+  void initTestCase();
+  void cleanupTestCase();
+  void init();
+  void cleanup();
+
+  void coalescing();
+  void notModified();
+  void notModifiedUndelivered();
+  void notModifiedWithoutCache();
+  void failure();
+  void leaderDeleted();
+  void followerDeleted();
+
+ private:
+  MockNetworkManager* m_networkManager = nullptr;
+  Task* m_task = nullptr;
+};
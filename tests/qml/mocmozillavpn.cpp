@@ -54,7 +54,7 @@ void MozillaVPN::deviceRemoved(const QString&) {}
 
 void MozillaVPN::deviceRemovalCompleted(const QString&) {}
 
-void MozillaVPN::serversFetched(const QByteArray&) {}
+void MozillaVPN::serversFetched(const QByteArray&, QList<ServerCountry>*) {}
 
 void MozillaVPN::removeDeviceFromPublicKey(const QString&) {}
 
@@ -43,10 +43,12 @@ SOURCES += \
     ../../src/l18nstringsimpl.cpp \
     ../../src/logger.cpp \
     ../../src/loghandler.cpp \
+    ../../src/logstore.cpp \
     ../../src/models/feature.cpp \
     ../../src/models/whatsnewmodel.cpp \
     ../../src/networkmanager.cpp \
     ../../src/networkrequest.cpp \
+    ../../src/networkresponsecache.cpp \
     ../../src/settingsholder.cpp \
     ../../src/update/updater.cpp \
     ../../src/update/versionapi.cpp \
@@ -61,11 +63,13 @@ HEADERS += \
     ../../src/inspector/inspectorwebsocketconnection.h \
     ../../src/logger.h \
     ../../src/loghandler.h \
+    ../../src/logstore.h \
     ../../src/models/feature.h \
     ../../src/models/whatsnewmodel.h \
     ../../src/mozillavpn.h \
     ../../src/networkmanager.h \
     ../../src/networkrequest.h \
+    ../../src/networkresponsecache.h \
     ../../src/settingsholder.h \
     ../../src/update/updater.h \
     ../../src/update/versionapi.h \
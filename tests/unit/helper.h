@@ -33,6 +33,9 @@ class TestHelper : public QObject {
 
   static QVector<NetworkConfig> networkConfig;
 
+  // The URLs of the captive portal detection requests, in order.
+  static QVector<QUrl> captivePortalRequests;
+
   static MozillaVPN::State vpnState;
 
   static Controller::State controllerState;
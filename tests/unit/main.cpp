@@ -8,7 +8,10 @@
 #include "constants.h"
 #include "helper.h"
 
+#include <QStandardPaths>
+
 QVector<TestHelper::NetworkConfig> TestHelper::networkConfig;
+QVector<QUrl> TestHelper::captivePortalRequests;
 MozillaVPN::State TestHelper::vpnState = MozillaVPN::StateInitialize;
 Controller::State TestHelper::controllerState = Controller::StateInitializing;
 QVector<QObject*> TestHelper::testList;
@@ -20,6 +23,9 @@ int main(int argc, char* argv[]) {
   LeakDetector leakDetector;
   Q_UNUSED(leakDetector);
 #endif
+
+  // Nothing must be written in the real application data directories.
+  QStandardPaths::setTestModeEnabled(true);
   {
     SettingsHolder settingsHolder;
     Constants::setStaging();
@@ -66,6 +66,10 @@ void Controller::getStatus(
   callback("127.0.0.1", "127.0.0.1", 0, 0);
 }
 
+bool Controller::subscribeStatus(int) { return false; }
+
+void Controller::unsubscribeStatus() {}
+
 void Controller::quit() {}
 
 void Controller::connectionConfirmed() {}
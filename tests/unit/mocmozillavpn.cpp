@@ -33,7 +33,9 @@ void MozillaVPN::initialize() {}
 
 void MozillaVPN::setState(State) {}
 
-bool MozillaVPN::setServerList(QByteArray const&) { return true; }
+bool MozillaVPN::setServerList(QByteArray const&, QList<ServerCountry>*) {
+  return true;
+}
 
 void MozillaVPN::getStarted() {}
 
@@ -53,7 +55,7 @@ void MozillaVPN::deviceRemoved(const QString&) {}
 
 void MozillaVPN::deviceRemovalCompleted(const QString&) {}
 
-void MozillaVPN::serversFetched(const QByteArray&) {}
+void MozillaVPN::serversFetched(const QByteArray&, QList<ServerCountry>*) {}
 
 void MozillaVPN::removeDeviceFromPublicKey(const QString&) {}
 
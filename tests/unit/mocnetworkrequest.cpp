@@ -87,8 +87,9 @@ NetworkRequest* NetworkRequest::createForIpInfo(Task* parent,
 }
 
 NetworkRequest* NetworkRequest::createForCaptivePortalDetection(
-    Task* parent, const QUrl&, const QByteArray&) {
-  return new NetworkRequest(parent, 1234, false);
+    Task* parent, const QUrl& url, const QByteArray&) {
+  TestHelper::captivePortalRequests.append(url);
+  return new NetworkRequest(parent, 200, false);
 }
 
 NetworkRequest* NetworkRequest::createForCaptivePortalLookup(Task* parent) {
@@ -142,8 +143,14 @@ NetworkRequest* NetworkRequest::createForGetFeatureList(Task* parent) {
 
 void NetworkRequest::replyFinished() { QFAIL("Not called!"); }
 
+void NetworkRequest::replyReadyRead() { QFAIL("Not called!"); }
+
 void NetworkRequest::timeout() {}
 
+int NetworkRequest::statusCode() const { return m_status; }
+
+void NetworkRequest::abort() {}
+
 void NetworkRequest::sslErrors(const QList<QSslError>& errors) {
   Q_UNUSED(errors);
 }
@@ -148,6 +148,68 @@ void TestAdjust::addFields() {
   QCOMPARE(params.toString(), output);
 }
 
+void TestAdjust::queryFiltering() {
+  QStringList unknown;
+
+  // The values are not decoded and encoded again.
+  QCOMPARE(AdjustFiltering::instance()->filterQuery(
+               "os_name=a%20b+c&&foo%5Fbar=1&os%5Fversion=%C3%A9&region",
+               unknown),
+           QByteArray("os_name=a%20b+c&os%5Fversion=%C3%A9&region=xxxxx"));
+  QCOMPARE(unknown, QStringList{"foo_bar"});
+
+  unknown.clear();
+  QCOMPARE(AdjustFiltering::instance()->filterQuery(QByteArray(), unknown),
+           QByteArray());
+  QVERIFY(unknown.isEmpty());
+}
+
+void TestAdjust::filterBenchmark_data() {
+  QTest::addColumn<bool>("raw");
+  QTest::addColumn<int>("repeat");
+
+  QTest::addRow("QUrlQuery, small") << false << 1;
+  QTest::addRow("raw query, small") << true << 1;
+  QTest::addRow("QUrlQuery, large") << false << 20;
+  QTest::addRow("raw query, large") << true << 20;
+}
+
+void TestAdjust::filterBenchmark() {
+  QFETCH(bool, raw);
+  QFETCH(int, repeat);
+
+  // An attribution payload with every known parameter, a few unknown ones,
+  // and long values.
+  AdjustFiltering* filtering = AdjustFiltering::instance();
+  QStringList names = filtering->allowList.values();
+  names.append(filtering->denyList.keys());
+  names.append(filtering->mirrorList.keys());
+  for (int i = 0; i < 10; ++i) {
+    names.append(QString("custom_%1").arg(i));
+  }
+
+  QUrlQuery payload;
+  for (int i = 0; i < repeat; ++i) {
+    for (const QString& name : names) {
+      payload.addQueryItem(name, QString("value %1 %2").arg(name).arg(i));
+    }
+  }
+
+  QByteArray query = payload.query(QUrl::FullyEncoded).toLatin1();
+
+  if (raw) {
+    QBENCHMARK {
+      QStringList unknown;
+      filtering->filterQuery(query, unknown);
+    }
+  } else {
+    QBENCHMARK {
+      QStringList unknown;
+      filtering->filterParameters(payload, unknown);
+    }
+  }
+}
+
 void TestAdjust::stateMachine_data() {
   QTest::addColumn<QByteArray>("firstLine");
   QTest::addColumn<QByteArray>("headers");
@@ -213,4 +275,40 @@ void TestAdjust::stateMachine() {
            AdjustProxyPackageHandler::ProcessingState::ProcessingDone);
 }
 
+void TestAdjust::pipelining() {
+  AdjustProxyPackageHandler packageHandler;
+
+  // Two requests and the beginning of a third one, in a single chunk. A line
+  // break after a body is ignored.
+  packageHandler.processData(
+      "POST /first HTTP/1.1\r\nContent-Length: 9\r\n\r\ntest=test\r\n"
+      "GET /second?a=b HTTP/1.1\r\nConnection: close\r\nAccept: */*\r\n\r\n"
+      "GET /third HTTP/1.0\r\n");
+
+  QVERIFY(packageHandler.isProcessingDone());
+  QCOMPARE(packageHandler.getMethod(), QString("POST"));
+  QCOMPARE(packageHandler.getPath(), QString("/first"));
+  QVERIFY(packageHandler.keepAlive());
+
+  packageHandler.nextRequest();
+  QVERIFY(packageHandler.isProcessingDone());
+  QCOMPARE(packageHandler.getMethod(), QString("GET"));
+  QCOMPARE(packageHandler.getPath(), QString("/second"));
+  QVERIFY(!packageHandler.keepAlive());
+  // Connection is a hop-by-hop header: it is not forwarded.
+  QCOMPARE(packageHandler.getHeaders(),
+           (QList<QPair<QString, QString>>{{"Accept", "*/*"}}));
+
+  packageHandler.nextRequest();
+  QCOMPARE(packageHandler.getProcessingState(),
+           AdjustProxyPackageHandler::ProcessingState::FirstLineDone);
+  QCOMPARE(packageHandler.getPath(), QString("/third"));
+  QVERIFY(!packageHandler.keepAlive());
+
+  packageHandler.processData("Connection: keep-alive\r\n\r\n");
+  QVERIFY(packageHandler.isProcessingDone());
+  QVERIFY(packageHandler.keepAlive());
+  QVERIFY(packageHandler.getHeaders().isEmpty());
+}
+
 static TestAdjust s_testAdjust;
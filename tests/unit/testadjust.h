@@ -14,6 +14,13 @@ class TestAdjust final : public TestHelper {
   void addFields_data();
   void addFields();
 
+  void queryFiltering();
+
+  void filterBenchmark_data();
+  void filterBenchmark();
+
   void stateMachine_data();
   void stateMachine();
+
+  void pipelining();
 };
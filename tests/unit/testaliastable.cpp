@@ -0,0 +1,77 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "testaliastable.h"
+#include "../../src/aliastable.h"
+#include "helper.h"
+
+#include <QRandomGenerator>
+
+void TestAliasTable::empty() {
+  AliasTable table;
+  QVERIFY(table.isEmpty());
+
+  QRandomGenerator generator(42);
+  QCOMPARE(table.pick(&generator), -1);
+
+  table.build(QVector<double>());
+  QVERIFY(table.isEmpty());
+}
+
+void TestAliasTable::zeroWeights() {
+  AliasTable table;
+  table.build(QVector<double>{0, 0, 0});
+  QCOMPARE(table.size(), 3);
+
+  // Every entry has the same probability.
+  QRandomGenerator generator(42);
+  QVector<int> counts(3);
+  for (int i = 0; i < 3000; ++i) {
+    counts[table.pick(&generator)]++;
+  }
+  for (int count : counts) {
+    QVERIFY(count > 800 && count < 1200);
+  }
+}
+
+void TestAliasTable::distribution_data() {
+  QTest::addColumn<QVector<double>>("weights");
+
+  QTest::addRow("single") << QVector<double>{5};
+  QTest::addRow("uniform") << QVector<double>{1, 1, 1, 1};
+  QTest::addRow("skewed") << QVector<double>{1, 2, 3, 94};
+  QTest::addRow("disabled") << QVector<double>{10, 0, 30, -5, 60};
+}
+
+void TestAliasTable::distribution() {
+  QFETCH(QVector<double>, weights);
+
+  AliasTable table;
+  table.build(weights);
+  QCOMPARE(table.size(), weights.size());
+
+  double sum = 0;
+  for (double weight : weights) {
+    sum += qMax(0.0, weight);
+  }
+
+  const int picks = 100000;
+  QRandomGenerator generator(42);
+  QVector<int> counts(weights.size());
+  for (int i = 0; i < picks; ++i) {
+    counts[table.pick(&generator)]++;
+  }
+
+  for (int i = 0; i < weights.size(); ++i) {
+    double expected = qMax(0.0, weights[i]) / sum;
+    double actual = static_cast<double>(counts[i]) / picks;
+    QVERIFY2(qAbs(expected - actual) < 0.01,
+             qPrintable(QString("index %1: expected %2, got %3")
+                            .arg(i)
+                            .arg(expected)
+                            .arg(actual)));
+  }
+}
+
+static TestAliasTable s_testAliasTable;
@@ -0,0 +1,210 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "testcaptiveportal.h"
+#include "../../src/captiveportal/captiveportal.h"
+#include "../../src/captiveportal/captiveportalmonitor.h"
+#include "../../src/captiveportal/captiveportalrequest.h"
+#include "../../src/settingsholder.h"
+#include "../../src/tasks/function/taskfunction.h"
+#include "helper.h"
+
+namespace {
+
+QUrl ipv4Url(const QString& address) {
+  return QUrl(QString(CAPTIVEPORTAL_URL_IPV4).arg(address));
+}
+
+QUrl ipv6Url(const QString& address) {
+  return QUrl(QString(CAPTIVEPORTAL_URL_IPV6).arg(address));
+}
+
+// Runs a detection with the results of the requests queued in
+// TestHelper::networkConfig. Returns the number of results: 1 unless broken.
+int detect(CaptivePortalRequest::CaptivePortalResult& result) {
+  TaskFunction task([]() {});
+  CaptivePortalRequest* request = new CaptivePortalRequest(&task);
+
+  int count = 0;
+  QObject::connect(request, &CaptivePortalRequest::completed,
+                   [&](CaptivePortalRequest::CaptivePortalResult detected) {
+                     ++count;
+                     result = detected;
+                   });
+  request->run();
+
+  // Longer than the attempt delay: nothing may start after the result.
+  QTest::qWait(500);
+  return count;
+}
+
+}  // namespace
+
+void TestCaptivePortal::init() {
+  TestHelper::networkConfig.clear();
+  TestHelper::captivePortalRequests.clear();
+}
+
+void TestCaptivePortal::cleanup() { TestHelper::networkConfig.clear(); }
+
+void TestCaptivePortal::monitorBackoff() {
+  CaptivePortalMonitor monitor(nullptr);
+  monitor.m_active = true;
+  monitor.m_interval = 2000;
+
+  // The first failure is a change: the interval stays short.
+  monitor.scheduleCheck(CaptivePortalRequest::Failure);
+  QCOMPARE(monitor.m_interval, 2000u);
+
+  // Then it doubles while the checks keep failing, up to a minute.
+  QList<uint32_t> expected = {4000, 8000, 16000, 32000, 60000, 60000};
+  for (uint32_t interval : expected) {
+    monitor.scheduleCheck(CaptivePortalRequest::Failure);
+    QCOMPARE(monitor.m_interval, interval);
+  }
+  QVERIFY(monitor.m_timer.isActive());
+
+  // Back to the minimum when the result changes.
+  monitor.scheduleCheck(CaptivePortalRequest::PortalDetected);
+  QCOMPARE(monitor.m_interval, 2000u);
+
+  monitor.m_active = false;
+}
+
+void TestCaptivePortal::monitorPortal() {
+  CaptivePortalMonitor monitor(nullptr);
+  monitor.m_active = true;
+  monitor.m_interval = 2000;
+
+  // The VPN must come back soon after the user logs in.
+  QList<uint32_t> expected = {2000, 4000, 8000, 10000, 10000};
+  for (uint32_t interval : expected) {
+    monitor.scheduleCheck(CaptivePortalRequest::PortalDetected);
+    QCOMPARE(monitor.m_interval, interval);
+  }
+
+  // The checks failing is a change.
+  monitor.scheduleCheck(CaptivePortalRequest::Failure);
+  QCOMPARE(monitor.m_interval, 2000u);
+  monitor.scheduleCheck(CaptivePortalRequest::Failure);
+  QCOMPARE(monitor.m_interval, 4000u);
+
+  monitor.m_active = false;
+}
+
+void TestCaptivePortal::monitorNetworkChange() {
+  CaptivePortalMonitor monitor(nullptr);
+  monitor.m_active = true;
+  monitor.m_interval = 2000;
+  monitor.m_clearConnections = false;
+
+  for (int i = 0; i < 5; ++i) {
+    monitor.scheduleCheck(CaptivePortalRequest::Failure);
+  }
+  QCOMPARE(monitor.m_interval, 32000u);
+
+  // A new network is checked soon, on new connections.
+  monitor.networkChanged();
+  QCOMPARE(monitor.m_interval, 2000u);
+  QCOMPARE(monitor.m_lastResult, -1);
+  QVERIFY(monitor.m_clearConnections);
+  QVERIFY(monitor.m_timer.isActive());
+  QCOMPARE(monitor.m_timer.interval(), 2000);
+
+  // Not while a check is running: that check schedules the next one.
+  monitor.m_timer.stop();
+  monitor.m_checking = true;
+  monitor.networkChanged();
+  QVERIFY(!monitor.m_timer.isActive());
+
+  monitor.m_checking = false;
+  monitor.m_active = false;
+}
+
+void TestCaptivePortal::requestOrder() {
+  SettingsHolder settingsHolder;
+  settingsHolder.setCaptivePortalIpv4Addresses(
+      QStringList{"192.0.2.1", "192.0.2.2", "192.0.2.3"});
+  settingsHolder.setCaptivePortalIpv6Addresses(
+      QStringList{"2001:db8::1", "2001:db8::2"});
+
+  // Each failure starts the next attempt right away, alternating the
+  // families, IPv6 first.
+  for (int i = 0; i < 4; ++i) {
+    TestHelper::networkConfig.append(TestHelper::NetworkConfig(
+        TestHelper::NetworkConfig::Failure, QByteArray()));
+  }
+  TestHelper::networkConfig.append(TestHelper::NetworkConfig(
+      TestHelper::NetworkConfig::Success, CAPTIVEPORTAL_REQUEST_CONTENT));
+
+  CaptivePortalRequest::CaptivePortalResult result;
+  QCOMPARE(detect(result), 1);
+  QCOMPARE(result, CaptivePortalRequest::NoPortal);
+  QCOMPARE(TestHelper::captivePortalRequests,
+           QVector<QUrl>({ipv6Url("2001:db8::1"), ipv4Url("192.0.2.1"),
+                          ipv6Url("2001:db8::2"), ipv4Url("192.0.2.2"),
+                          ipv4Url("192.0.2.3")}));
+  QVERIFY(TestHelper::networkConfig.isEmpty());
+}
+
+void TestCaptivePortal::requestFirstAnswer() {
+  SettingsHolder settingsHolder;
+  settingsHolder.setCaptivePortalIpv4Addresses(QStringList{"192.0.2.1"});
+  settingsHolder.setCaptivePortalIpv6Addresses(QStringList{"2001:db8::1"});
+
+  // The first answer cancels the attempts not started yet.
+  TestHelper::networkConfig.append(TestHelper::NetworkConfig(
+      TestHelper::NetworkConfig::Success, CAPTIVEPORTAL_REQUEST_CONTENT));
+
+  CaptivePortalRequest::CaptivePortalResult result;
+  QCOMPARE(detect(result), 1);
+  QCOMPARE(result, CaptivePortalRequest::NoPortal);
+  QCOMPARE(TestHelper::captivePortalRequests,
+           QVector<QUrl>({ipv6Url("2001:db8::1")}));
+}
+
+void TestCaptivePortal::requestPortal() {
+  SettingsHolder settingsHolder;
+  settingsHolder.setCaptivePortalIpv4Addresses(QStringList{"192.0.2.1"});
+  settingsHolder.setCaptivePortalIpv6Addresses(QStringList{"2001:db8::1"});
+
+  // A portal answering in place of the detection server is decisive too.
+  TestHelper::networkConfig.append(TestHelper::NetworkConfig(
+      TestHelper::NetworkConfig::Failure, QByteArray()));
+  TestHelper::networkConfig.append(TestHelper::NetworkConfig(
+      TestHelper::NetworkConfig::Success, "<html>Log in</html>"));
+
+  CaptivePortalRequest::CaptivePortalResult result;
+  QCOMPARE(detect(result), 1);
+  QCOMPARE(result, CaptivePortalRequest::PortalDetected);
+  QCOMPARE(TestHelper::captivePortalRequests.length(), 2);
+}
+
+void TestCaptivePortal::requestFailure() {
+  SettingsHolder settingsHolder;
+  settingsHolder.setCaptivePortalIpv4Addresses(QStringList{"192.0.2.1"});
+  settingsHolder.setCaptivePortalIpv6Addresses(QStringList());
+
+  TestHelper::networkConfig.append(TestHelper::NetworkConfig(
+      TestHelper::NetworkConfig::Failure, QByteArray()));
+
+  CaptivePortalRequest::CaptivePortalResult result;
+  QCOMPARE(detect(result), 1);
+  QCOMPARE(result, CaptivePortalRequest::Failure);
+  QCOMPARE(TestHelper::captivePortalRequests,
+           QVector<QUrl>({ipv4Url("192.0.2.1")}));
+}
+
+void TestCaptivePortal::requestNoAddresses() {
+  SettingsHolder settingsHolder;
+  settingsHolder.setCaptivePortalIpv4Addresses(QStringList());
+  settingsHolder.setCaptivePortalIpv6Addresses(QStringList());
+
+  CaptivePortalRequest::CaptivePortalResult result;
+  QCOMPARE(detect(result), 1);
+  QCOMPARE(result, CaptivePortalRequest::NoPortal);
+  QVERIFY(TestHelper::captivePortalRequests.isEmpty());
+}
+
+static TestCaptivePortal s_testCaptivePortal;
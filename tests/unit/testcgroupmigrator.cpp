@@ -0,0 +1,108 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "testcgroupmigrator.h"
+#include "../../src/platforms/linux/daemon/cgroupmigrator.h"
+#include "helper.h"
+
+#include <QDir>
+#include <QScopeGuard>
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+void TestCgroupMigrator::parseProcCgroup_data() {
+  QTest::addColumn<QByteArray>("data");
+  QTest::addColumn<QString>("controller");
+  QTest::addColumn<QString>("path");
+
+  QByteArray hybrid =
+      "12:pids:/user.slice/user-1000.slice\n"
+      "7:net_cls,net_prio:/mozvpn.exclude\n"
+      "1:name=systemd:/user.slice/user-1000.slice/session-2.scope\n"
+      "0::/user.slice/user-1000.slice/session-2.scope\n";
+  QTest::addRow("v2") << hybrid << QString()
+                      << "/user.slice/user-1000.slice/session-2.scope";
+  QTest::addRow("net_cls") << hybrid << "net_cls"
+                           << "/mozvpn.exclude";
+  QTest::addRow("net_prio") << hybrid << "net_prio"
+                            << "/mozvpn.exclude";
+  QTest::addRow("missing") << hybrid << "memory" << QString();
+  QTest::addRow("named") << hybrid << "systemd" << QString();
+
+  QByteArray unified = "0::/app.slice/app-firefox.scope\n";
+  QTest::addRow("unified") << unified << QString()
+                           << "/app.slice/app-firefox.scope";
+  QTest::addRow("unified net_cls") << unified << "net_cls" << QString();
+
+  QTest::addRow("root") << QByteArray("0::/") << QString() << "/";
+  QTest::addRow("colon") << QByteArray("0::/a:b.scope\n") << QString()
+                         << "/a:b.scope";
+  QTest::addRow("empty") << QByteArray() << QString() << QString();
+}
+
+void TestCgroupMigrator::parseProcCgroup() {
+  QFETCH(QByteArray, data);
+  QFETCH(QString, controller);
+  QFETCH(QString, path);
+
+  QString result = CgroupMigrator::parseProcCgroup(data, controller);
+  QCOMPARE(result, path);
+  QCOMPARE(result.isNull(), path.isNull());
+}
+
+void TestCgroupMigrator::migrateAndRestore() {
+  QString root = qEnvironmentVariable("MVPN_TEST_CGROUP2");
+  if (root.isEmpty()) {
+    QSKIP("MVPN_TEST_CGROUP2 is not set");
+  }
+  QCOMPARE(CgroupMigrator::version(root), CgroupMigrator::Version2);
+
+  QString cgroup = root + "/mozvpn.test";
+  QVERIFY(QDir().mkpath(cgroup));
+  auto cleanup = qScopeGuard([&] { QDir().rmdir(cgroup); });
+
+  pid_t pid = fork();
+  QVERIFY(pid >= 0);
+  if (pid == 0) {
+    pause();
+    _exit(0);
+  }
+  auto reaper = qScopeGuard([&] {
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+  });
+
+  QString original = CgroupMigrator::cgroupOf(pid, root, QString());
+  QVERIFY(!original.isNull());
+  QVERIFY(original != cgroup);
+
+  CgroupMigrator::Result result = CgroupMigrator::migrate(cgroup, {pid});
+  QCOMPARE(result.version, CgroupMigrator::Version2);
+  QCOMPARE(result.moved, 1);
+  QVERIFY(result.failures.isEmpty());
+  QCOMPARE(CgroupMigrator::cgroupOf(pid, root, QString()), cgroup);
+
+  // Already there.
+  result = CgroupMigrator::migrate(cgroup, {pid});
+  QCOMPARE(result.moved, 0);
+  QCOMPARE(result.skipped, 1);
+
+  result = CgroupMigrator::migrate(original, {pid});
+  QCOMPARE(result.moved, 1);
+  QCOMPARE(CgroupMigrator::cgroupOf(pid, root, QString()), original);
+
+  reaper.dismiss();
+  kill(pid, SIGKILL);
+  waitpid(pid, nullptr, 0);
+
+  QVERIFY(CgroupMigrator::cgroupOf(pid, root, QString()).isNull());
+  result = CgroupMigrator::migrate(cgroup, {pid});
+  QCOMPARE(result.moved, 0);
+  QCOMPARE(result.vanished, 1);
+}
+
+static TestCgroupMigrator s_testCgroupMigrator;
@@ -0,0 +1,190 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "testcgroupsockmark.h"
+#include "../../src/platforms/linux/daemon/cgroupmigrator.h"
+#include "../../src/platforms/linux/daemon/cgroupsockmark.h"
+#include "helper.h"
+
+#include <QDir>
+#include <QScopeGuard>
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+constexpr uint32_t TEST_MARK = 0xca6c;
+constexpr uint32_t TEST_OTHER_MARK = 0xca6d;
+
+namespace {
+uint32_t socketMark(int fd) {
+  uint32_t mark = 0;
+  socklen_t len = sizeof(mark);
+  if (getsockopt(fd, SOL_SOCKET, SO_MARK, &mark, &len) != 0) {
+    return UINT32_MAX;
+  }
+  return mark;
+}
+
+// Forks a process which opens a socket when told to through `control`, and
+// writes its mark to `result`.
+pid_t forkSocketOpener(int control, int result) {
+  pid_t pid = fork();
+  if (pid != 0) {
+    return pid;
+  }
+
+  char c;
+  if (read(control, &c, 1) != 1) {
+    _exit(1);
+  }
+  int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  uint32_t mark = fd < 0 ? UINT32_MAX : socketMark(fd);
+  if (write(result, &mark, sizeof(mark)) != sizeof(mark)) {
+    _exit(1);
+  }
+  pause();
+  _exit(0);
+}
+}  // namespace
+
+void TestCgroupSockMark::remarkSockets() {
+  if (geteuid() != 0) {
+    QSKIP("Setting the socket marks needs CAP_NET_ADMIN");
+  }
+
+  int inet = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  int inet6 = socket(AF_INET6, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  int local = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  int other = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  auto guard = qScopeGuard([&] {
+    close(inet);
+    close(inet6);
+    close(local);
+    close(other);
+  });
+  QVERIFY(inet >= 0 && local >= 0 && other >= 0);
+
+  // Marked by the application: not ours to change.
+  uint32_t mark = 0x1234;
+  QCOMPARE(setsockopt(other, SOL_SOCKET, SO_MARK, &mark, sizeof(mark)), 0);
+
+  const QVector<uint32_t> marks = {TEST_MARK, TEST_OTHER_MARK};
+  int changed = CgroupSockMark::remarkSockets(getpid(), TEST_MARK, marks);
+  if (changed < 0 && errno == ENOSYS) {
+    QSKIP("No pidfd_getfd()");
+  }
+  QVERIFY(changed >= (inet6 >= 0 ? 2 : 1));
+  QCOMPARE(socketMark(inet), TEST_MARK);
+  if (inet6 >= 0) {
+    QCOMPARE(socketMark(inet6), TEST_MARK);
+  }
+  QCOMPARE(socketMark(other), 0x1234u);
+
+  // Nothing left to change.
+  QCOMPARE(CgroupSockMark::remarkSockets(getpid(), TEST_MARK, marks), 0);
+
+  QVERIFY(CgroupSockMark::remarkSockets(getpid(), TEST_OTHER_MARK, marks) > 0);
+  QCOMPARE(socketMark(inet), TEST_OTHER_MARK);
+
+  QVERIFY(CgroupSockMark::remarkSockets(getpid(), 0, marks) > 0);
+  QCOMPARE(socketMark(inet), 0u);
+  QCOMPARE(socketMark(other), 0x1234u);
+}
+
+void TestCgroupSockMark::attach() {
+  QString root = qEnvironmentVariable("MVPN_TEST_CGROUP2");
+  if (root.isEmpty()) {
+    QSKIP("MVPN_TEST_CGROUP2 is not set");
+  }
+
+  QString cgroup = root + "/mozvpn.test";
+  QVERIFY(QDir().mkpath(cgroup));
+  auto cleanup = qScopeGuard([&] { QDir().rmdir(cgroup); });
+
+  CgroupSockMark sockMark;
+  QVERIFY(sockMark.attach(cgroup, TEST_MARK));
+  QVERIFY(sockMark.isAttached());
+
+  int control[2];
+  int result[2];
+  QCOMPARE(pipe(control), 0);
+  QCOMPARE(pipe(result), 0);
+  pid_t pid = forkSocketOpener(control[0], result[1]);
+  QVERIFY(pid >= 0);
+  auto reaper = qScopeGuard([&] {
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+    close(control[0]);
+    close(control[1]);
+    close(result[0]);
+    close(result[1]);
+  });
+
+  QCOMPARE(CgroupMigrator::migrate(cgroup, {pid}).moved, 1);
+
+  QCOMPARE(write(control[1], "x", 1), 1);
+  uint32_t mark = 0;
+  QCOMPARE(read(result[0], &mark, sizeof(mark)),
+           static_cast<ssize_t>(sizeof(mark)));
+  QCOMPARE(mark, TEST_MARK);
+
+  // The sockets created outside of the cgroup are not marked.
+  int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  QVERIFY(fd >= 0);
+  uint32_t ownMark = socketMark(fd);
+  close(fd);
+  QCOMPARE(ownMark, 0u);
+
+  // Out of the cgroup, for rmdir.
+  QCOMPARE(CgroupMigrator::migrate(root, {pid}).moved, 1);
+  sockMark.detach();
+  QVERIFY(!sockMark.isAttached());
+}
+
+void TestCgroupSockMark::moveOut() {
+  QString root = qEnvironmentVariable("MVPN_TEST_CGROUP2");
+  if (root.isEmpty()) {
+    QSKIP("MVPN_TEST_CGROUP2 is not set");
+  }
+
+  QString cgroup = root + "/mozvpn.test";
+  QVERIFY(QDir().mkpath(cgroup));
+  auto cleanup = qScopeGuard([&] { QDir().rmdir(cgroup); });
+
+  CgroupSockMark sockMark;
+  QVERIFY(sockMark.attach(cgroup, TEST_MARK));
+
+  int control[2];
+  int result[2];
+  QCOMPARE(pipe(control), 0);
+  QCOMPARE(pipe(result), 0);
+  pid_t pid = forkSocketOpener(control[0], result[1]);
+  QVERIFY(pid >= 0);
+  auto reaper = qScopeGuard([&] {
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+    close(control[0]);
+    close(control[1]);
+    close(result[0]);
+    close(result[1]);
+  });
+
+  QCOMPARE(CgroupMigrator::migrate(cgroup, {pid}).moved, 1);
+  QCOMPARE(write(control[1], "x", 1), 1);
+  uint32_t mark = 0;
+  QCOMPARE(read(result[0], &mark, sizeof(mark)),
+           static_cast<ssize_t>(sizeof(mark)));
+  QCOMPARE(mark, TEST_MARK);
+
+  // The kernel leaves the socket marked when the process moves out: the
+  // daemon marks it again.
+  QCOMPARE(CgroupMigrator::migrate(root, {pid}).moved, 1);
+  QCOMPARE(CgroupSockMark::remarkSockets(pid, 0, {TEST_MARK}), 1);
+  QCOMPARE(CgroupSockMark::remarkSockets(pid, 0, {TEST_MARK}), 0);
+}
+
+static TestCgroupSockMark s_testCgroupSockMark;
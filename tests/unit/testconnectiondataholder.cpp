@@ -124,4 +124,56 @@ void TestConnectionDataHolder::chart() {
   QCOMPARE(cdh.rxBytes(), (uint32_t)0);
 }
 
+void TestConnectionDataHolder::history() {
+  ConnectionDataHolder cdh;
+
+  const ThroughputSeries& minutes =
+      cdh.history(ConnectionDataHolder::Minutes);
+  const ThroughputSeries& hours = cdh.history(ConnectionDataHolder::Hours);
+
+  // The first sample is the baseline of the counters.
+  cdh.addHistory(1000, 2000, 0);
+  QCOMPARE(minutes.count(), 0);
+
+  cdh.addHistory(61000, 122000, 60000);
+  QCOMPARE(minutes.count(), 1);
+  QCOMPARE(minutes.last().m_txBytes, Q_UINT64_C(1000));
+  QCOMPARE(minutes.last().m_rxBytes, Q_UINT64_C(2000));
+
+  // A late sample is averaged over the real interval.
+  cdh.addHistory(151000, 302000, 150000);
+  QCOMPARE(minutes.count(), 2);
+  QCOMPARE(minutes.last().m_txBytes, Q_UINT64_C(1000));
+  QCOMPARE(minutes.last().m_rxBytes, Q_UINT64_C(2000));
+
+  // A new tunnel restarts the counters: that's a new baseline.
+  cdh.addHistory(0, 0, 210000);
+  QCOMPARE(minutes.count(), 2);
+
+  // 60 minutes make an hour.
+  for (int i = 1; i <= 58; ++i) {
+    cdh.addHistory(i * 60000, i * 60000, 210000 + i * 60000);
+  }
+  QCOMPARE(minutes.count(), 60);
+  QCOMPARE(minutes.last().m_rxBytes, Q_UINT64_C(1000));
+  QCOMPARE(hours.count(), 1);
+  QCOMPARE(hours.last().m_txBytes, Q_UINT64_C(1000));
+  QCOMPARE(hours.last().m_rxBytes, Q_UINT64_C(62000) / 60);
+
+  // The points of the chart are only recorded while it's visible.
+  QCOMPARE(cdh.history(ConnectionDataHolder::Seconds).count(), 0);
+
+  // QML reads the same tiers.
+  QVariantList points = cdh.historyPoints(ConnectionDataHolder::Hours);
+  QCOMPARE(points.length(), 1);
+  QVariantMap point = points[0].toMap();
+  QCOMPARE(point["txBytes"].toULongLong(), Q_UINT64_C(1000));
+  QCOMPARE(point["rxBytes"].toULongLong(), Q_UINT64_C(62000) / 60);
+  QCOMPARE(cdh.historyPoints(ConnectionDataHolder::Minutes).length(), 60);
+
+  QSignalSpy spy(&cdh, &ConnectionDataHolder::historyChanged);
+  cdh.addHistory(59 * 60000, 59 * 60000, 210000 + 59 * 60000);
+  QCOMPARE(spy.count(), 1);
+}
+
 static TestConnectionDataHolder s_testConnectionDataHolder;
@@ -15,6 +15,8 @@ class TestConnectionDataHolder final : public TestHelper {
 
   void chart();
 
+  void history();
+
   void cleanupTestCase() {
     TestHelper::controllerState = Controller::StateInitializing;
   }
@@ -0,0 +1,80 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "testdaemonstatusframe.h"
+#include "../../src/daemon/daemonstatusframe.h"
+#include "helper.h"
+
+void TestDaemonStatusFrame::roundTrip_data() {
+  QTest::addColumn<bool>("connected");
+  QTest::addColumn<qint64>("txBytes");
+  QTest::addColumn<qint64>("rxBytes");
+  QTest::addColumn<qint64>("handshake");
+
+  QTest::addRow("empty") << false << Q_INT64_C(0) << Q_INT64_C(0)
+                         << Q_INT64_C(0);
+  QTest::addRow("connected")
+      << true << Q_INT64_C(1234) << Q_INT64_C(56789)
+      << Q_INT64_C(1634000000000);
+  QTest::addRow("large") << true << Q_INT64_C(0x7fffffffffffffff)
+                         << Q_INT64_C(0x0123456789abcdef) << Q_INT64_C(-1);
+  QTest::addRow("disconnected")
+      << false << Q_INT64_C(4294967296) << Q_INT64_C(255) << Q_INT64_C(0);
+}
+
+void TestDaemonStatusFrame::roundTrip() {
+  QFETCH(bool, connected);
+  QFETCH(qint64, txBytes);
+  QFETCH(qint64, rxBytes);
+  QFETCH(qint64, handshake);
+
+  DaemonStatusFrame frame;
+  frame.m_connected = connected;
+  frame.m_txBytes = txBytes;
+  frame.m_rxBytes = rxBytes;
+  frame.m_handshake = handshake;
+
+  QByteArray data = frame.encode();
+  QCOMPARE(data.length(), DaemonStatusFrame::SIZE);
+
+  DaemonStatusFrame decoded;
+  QVERIFY(decoded.decode(data.constData()));
+  QCOMPARE(decoded.m_connected, connected);
+  QCOMPARE(decoded.m_txBytes, txBytes);
+  QCOMPARE(decoded.m_rxBytes, rxBytes);
+  QCOMPARE(decoded.m_handshake, handshake);
+}
+
+void TestDaemonStatusFrame::layout() {
+  DaemonStatusFrame frame;
+  frame.m_connected = true;
+  frame.m_txBytes = Q_INT64_C(0x0102030405060708);
+  frame.m_rxBytes = Q_INT64_C(0x1112131415161718);
+  frame.m_handshake = Q_INT64_C(0x2122232425262728);
+
+  // The marker tells the frame apart from the JSON lines.
+  QByteArray expected = QByteArray::fromHex(
+      "0001"
+      "0807060504030201"
+      "1817161514131211"
+      "2827262524232221");
+  QCOMPARE(frame.encode(), expected);
+  QCOMPARE(frame.encode().at(0), DaemonStatusFrame::MARKER);
+}
+
+void TestDaemonStatusFrame::invalidMarker() {
+  DaemonStatusFrame frame;
+  frame.m_connected = true;
+  frame.m_txBytes = 42;
+
+  QByteArray data = frame.encode();
+  data[0] = '{';
+
+  DaemonStatusFrame decoded;
+  QVERIFY(!decoded.decode(data.constData()));
+  QCOMPARE(decoded.m_connected, false);
+  QCOMPARE(decoded.m_txBytes, Q_INT64_C(0));
+}
+
+static TestDaemonStatusFrame s_testDaemonStatusFrame;
@@ -0,0 +1,144 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "testipprefixset.h"
+#include "../../src/ipprefixset.h"
+#include "helper.h"
+
+namespace {
+
+QString join(const QList<IPAddress>& list) {
+  QStringList strings;
+  for (const IPAddress& ip : list) {
+    strings.append(ip.toString());
+  }
+  return strings.join(",");
+}
+
+}  // namespace
+
+void TestIPPrefixSet::basic() {
+  IPPrefixSet set;
+  QVERIFY(set.isEmpty());
+  QVERIFY(set.prefixes().isEmpty());
+
+  set.add(IPAddress("10.0.0.0/8"));
+  QVERIFY(!set.isEmpty());
+  QCOMPARE(join(set.prefixes()), "10.0.0.0/8");
+
+  set.clear();
+  QVERIFY(set.isEmpty());
+}
+
+void TestIPPrefixSet::addRemove_data() {
+  QTest::addColumn<QStringList>("add");
+  QTest::addColumn<QStringList>("remove");
+  QTest::addColumn<QString>("result");
+
+  QTest::addRow("world vs rfc1918 (part)")
+      << QStringList{"0.0.0.0/0"} << QStringList{"10.0.0.0/8"}
+      << "0.0.0.0/5,8.0.0.0/7,11.0.0.0/8,12.0.0.0/6,16.0.0.0/4,32.0.0.0/"
+         "3,64.0.0.0/2,128.0.0.0/1";
+
+  QTest::addRow("siblings are merged")
+      << QStringList{"10.0.0.0/9", "10.128.0.0/9"} << QStringList{}
+      << "10.0.0.0/8";
+
+  QTest::addRow("covered prefixes are dropped")
+      << QStringList{"10.1.0.0/16", "10.0.0.0/8", "10.2.3.4"} << QStringList{}
+      << "10.0.0.0/8";
+
+  QTest::addRow("host inside the world")
+      << QStringList{"0.0.0.0/0", "127.0.0.1"} << QStringList{} << "0.0.0.0/0";
+
+  QTest::addRow("remove everything")
+      << QStringList{"10.0.0.0/8", "::/0"}
+      << QStringList{"0.0.0.0/0", "::/0"} << "";
+
+  QTest::addRow("remove outside")
+      << QStringList{"10.0.0.0/8"} << QStringList{"192.168.0.0/16"}
+      << "10.0.0.0/8";
+
+  QTest::addRow("both families")
+      << QStringList{"::/0", "0.0.0.0/0"}
+      << QStringList{"128.0.0.0/1", "8000::/1"} << "0.0.0.0/1,::/1";
+
+  QTest::addRow("ipv6 ula and multicast")
+      << QStringList{"::/0"} << QStringList{"fc00::/7", "ff00::/8"}
+      << "::/1,8000::/2,c000::/3,e000::/4,f000::/5,f800::/6,fe00::/8";
+}
+
+void TestIPPrefixSet::addRemove() {
+  QFETCH(QStringList, add);
+  QFETCH(QStringList, remove);
+  QFETCH(QString, result);
+
+  IPPrefixSet set;
+  for (const QString& ip : add) {
+    set.add(IPAddress(ip));
+  }
+  for (const QString& ip : remove) {
+    set.remove(IPAddress(ip));
+  }
+
+  QCOMPARE(join(set.prefixes()), result);
+}
+
+void TestIPPrefixSet::contains() {
+  IPPrefixSet set;
+  set.add(IPAddress("10.0.0.0/8"));
+  set.add(IPAddress("fc00::/7"));
+
+  QVERIFY(set.contains(QHostAddress("10.1.2.3")));
+  QVERIFY(!set.contains(QHostAddress("11.1.2.3")));
+  QVERIFY(set.contains(QHostAddress("fd00::1")));
+  QVERIFY(!set.contains(QHostAddress("fe80::1")));
+
+  QVERIFY(set.contains(IPAddress("10.4.0.0/16")));
+  QVERIFY(set.contains(IPAddress("10.0.0.0/8")));
+  QVERIFY(!set.contains(IPAddress("8.0.0.0/6")));
+  QVERIFY(!set.contains(IPAddress("0.0.0.0/0")));
+}
+
+void TestIPPrefixSet::uniteSubtract() {
+  IPPrefixSet a;
+  a.add(IPAddress("10.0.0.0/8"));
+
+  IPPrefixSet b;
+  b.add(IPAddress("10.1.0.0/16"));
+  b.add(IPAddress("11.0.0.0/8"));
+
+  a.subtract(b);
+  QVERIFY(!a.contains(QHostAddress("10.1.2.3")));
+  QVERIFY(a.contains(QHostAddress("10.2.3.4")));
+  QCOMPARE(a.prefixes().length(), 8);
+
+  a.unite(b);
+  QCOMPARE(join(a.prefixes()), "10.0.0.0/7");
+}
+
+void TestIPPrefixSet::manyExclusions() {
+  QList<IPAddress> exclude;
+  for (int i = 0; i < 4096; ++i) {
+    exclude.append(IPAddress(QHostAddress(static_cast<quint32>(i) << 20), 24));
+  }
+
+  IPPrefixSet set;
+  set.add(IPAddress("0.0.0.0/0"));
+  set.remove(exclude);
+
+  QList<IPAddress> result = set.prefixes();
+  // Each /12 block loses its first /24: 12 prefixes are left in each of them.
+  QCOMPARE(result.length(), 4096 * 12);
+
+  QCOMPARE(result, IPAddress::excludeAddresses({IPAddress("0.0.0.0/0")},
+                                               exclude));
+
+  for (const IPAddress& ip : exclude) {
+    QVERIFY(!set.contains(ip.address()));
+  }
+  QVERIFY(set.contains(QHostAddress("0.0.1.0")));
+}
+
+static TestIPPrefixSet s_testIPPrefixSet;
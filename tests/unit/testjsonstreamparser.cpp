@@ -0,0 +1,151 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "testjsonstreamparser.h"
+#include "../../src/jsonstreamparser.h"
+#include "helper.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+
+namespace {
+
+constexpr const char* SERVER_LIST =
+    "{ \"version\": 2, \"note\": \"a, \\\"quoted\\\" ] value}\",\n"
+    "  \"countries\": [\n"
+    "    {\"name\": \"A\",\n"
+    "     \"cities\": [{\"name\": \"a]\"}, {\"name\": \"b\"}]},\n"
+    "    {\"name\": \"B}\", \"cities\": []},\n"
+    "    42\n"
+    "  ],\n"
+    "  \"extra\": {\"list\": [1, 2, 3]}\n"
+    "}\n";
+
+}  // namespace
+
+void TestJsonStreamParser::parse_data() {
+  QTest::addColumn<QByteArray>("json");
+  QTest::addColumn<bool>("complete");
+  QTest::addColumn<bool>("error");
+  QTest::addColumn<bool>("hasArray");
+  QTest::addColumn<int>("records");
+
+  QTest::addRow("empty") << QByteArray() << false << false << false << 0;
+  QTest::addRow("spaces") << QByteArray("  \n") << false << false << false
+                          << 0;
+  QTest::addRow("array") << QByteArray("[]") << false << true << false << 0;
+  QTest::addRow("string") << QByteArray("\"a\"") << false << true << false
+                          << 0;
+  QTest::addRow("empty object")
+      << QByteArray("{}") << true << false << false << 0;
+  QTest::addRow("no array") << QByteArray("{\"records\": 42}") << true << false
+                            << false << 0;
+  QTest::addRow("empty array")
+      << QByteArray("{\"records\": []}") << true << false << true << 0;
+  QTest::addRow("records")
+      << QByteArray("{\"records\": [{}, [], \"a\", 1]}") << true << false
+      << true << 4;
+  QTest::addRow("truncated")
+      << QByteArray("{\"records\": [{}, {\"a\":") << false << false << true
+      << 1;
+  QTest::addRow("invalid record")
+      << QByteArray("{\"records\": [{\"a\" 1}]}") << false << true << true
+      << 0;
+  QTest::addRow("empty record")
+      << QByteArray("{\"records\": [{}, ]}") << false << true << true << 1;
+  QTest::addRow("invalid member")
+      << QByteArray("{\"a\": tru, \"records\": []}") << false << true << false
+      << 0;
+  QTest::addRow("missing colon")
+      << QByteArray("{\"records\" []}") << false << true << false << 0;
+  QTest::addRow("garbage") << QByteArray("{\"records\": []} x") << false
+                           << true << true << 0;
+}
+
+void TestJsonStreamParser::parse() {
+  QFETCH(QByteArray, json);
+  QFETCH(bool, complete);
+  QFETCH(bool, error);
+  QFETCH(bool, hasArray);
+  QFETCH(int, records);
+
+  int count = 0;
+  JsonStreamParser parser("records", [&count](const QJsonValue&) {
+    ++count;
+    return true;
+  });
+
+  QCOMPARE(parser.feed(json), !error);
+  QCOMPARE(parser.isComplete(), complete);
+  QCOMPARE(parser.hasError(), error);
+  QCOMPARE(parser.hasArray(), hasArray);
+  QCOMPARE(parser.recordCount(), records);
+  QCOMPARE(count, records);
+}
+
+void TestJsonStreamParser::chunks() {
+  QByteArray json(SERVER_LIST);
+
+  // The same result for any chunk size, down to a byte at a time.
+  for (int size = 1; size <= json.length(); ++size) {
+    QList<QJsonValue> records;
+    JsonStreamParser parser("countries", [&records](const QJsonValue& value) {
+      records.append(value);
+      return true;
+    });
+
+    for (int i = 0; i < json.length(); i += size) {
+      QVERIFY(parser.feed(json.mid(i, size)));
+    }
+
+    QVERIFY(parser.isComplete());
+    QVERIFY(parser.hasArray());
+    QCOMPARE(records.length(), 3);
+
+    QJsonObject a = records.at(0).toObject();
+    QCOMPARE(a["name"].toString(), QString("A"));
+    QCOMPARE(a["cities"].toArray().size(), 2);
+    QCOMPARE(a["cities"].toArray().at(0).toObject()["name"].toString(),
+             QString("a]"));
+    QCOMPARE(records.at(1).toObject()["name"].toString(), QString("B}"));
+    QCOMPARE(records.at(2).toInt(), 42);
+
+    const QJsonObject& members = parser.members();
+    QCOMPARE(members.size(), 3);
+    QCOMPARE(members["version"].toInt(), 2);
+    QCOMPARE(members["note"].toString(), QString("a, \"quoted\" ] value}"));
+    QCOMPARE(members["extra"].toObject()["list"].toArray().size(), 3);
+    QVERIFY(!members.contains("countries"));
+  }
+
+  // The streamed records match the DOM.
+  QJsonArray countries =
+      QJsonDocument::fromJson(json).object()["countries"].toArray();
+  int index = 0;
+  JsonStreamParser parser("countries", [&](const QJsonValue& value) {
+    return value == countries.at(index++);
+  });
+  QVERIFY(parser.feed(json));
+  QVERIFY(parser.isComplete());
+  QCOMPARE(index, countries.size());
+}
+
+void TestJsonStreamParser::rejectedRecord() {
+  int count = 0;
+  JsonStreamParser parser("records", [&count](const QJsonValue& value) {
+    ++count;
+    return value.isObject();
+  });
+
+  QVERIFY(!parser.feed("{\"records\": [{}, 1, {}]}"));
+  QVERIFY(parser.hasError());
+  QCOMPARE(parser.recordCount(), 1);
+  QCOMPARE(count, 2);
+
+  // Nothing is parsed after an error.
+  QVERIFY(!parser.feed("{}"));
+  QCOMPARE(count, 2);
+}
+
+static TestJsonStreamParser s_testJsonStreamParser;
@@ -7,6 +7,9 @@
 #include "../../src/loghandler.h"
 #include "helper.h"
 
+#include <QMutex>
+#include <QThread>
+
 void TestLogger::logger() {
   Logger l("test", "class");
   l.info() << "Hello world" << 42 << 'a' << QString("OK") << QByteArray("Array")
@@ -41,4 +44,65 @@ void TestLogger::logHandler() {
   }
 }
 
+void TestLogger::asyncLogging() {
+  constexpr int THREADS = 4;
+  constexpr int LINES = 200;
+
+  LogHandler* lh = LogHandler::instance();
+  LogHandler::flush();
+  quint64 dropped = LogHandler::droppedLines();
+
+  QMutex mutex;
+  QStringList received;
+  QMetaObject::Connection connection = connect(
+      lh, &LogHandler::logEntryAdded, lh,
+      [&](const QByteArray& log) {
+        if (log.contains("asyncLogging")) {
+          QMutexLocker lock(&mutex);
+          received.append(QString::fromUtf8(log).trimmed());
+        }
+      },
+      Qt::DirectConnection);
+
+  QList<QThread*> threads;
+  for (int t = 0; t < THREADS; ++t) {
+    threads.append(QThread::create([t]() {
+      Logger l("test", "asyncLogging");
+      for (int i = 0; i < LINES; ++i) {
+        l.debug() << "thread" << QString::number(t) << "line"
+                  << QString::number(i);
+      }
+    }));
+  }
+
+  for (QThread* thread : threads) {
+    thread->start();
+  }
+  for (QThread* thread : threads) {
+    QVERIFY(thread->wait());
+    delete thread;
+  }
+
+  LogHandler::flush();
+  disconnect(connection);
+
+  QCOMPARE(LogHandler::droppedLines(), dropped);
+  QCOMPARE(received.length(), THREADS * LINES);
+
+  // The lines of each thread are received in order.
+  for (int t = 0; t < THREADS; ++t) {
+    QString prefix = QString("thread %1 line ").arg(t);
+    int next = 0;
+    for (const QString& line : received) {
+      int pos = line.indexOf(prefix);
+      if (pos < 0) {
+        continue;
+      }
+      QCOMPARE(line.mid(pos + prefix.length()).toInt(), next);
+      ++next;
+    }
+    QCOMPARE(next, LINES);
+  }
+}
+
 static TestLogger s_testLogger;
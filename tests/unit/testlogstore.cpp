@@ -0,0 +1,189 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "testlogstore.h"
+#include "../../src/logger.h"
+#include "../../src/logstore.h"
+#include "helper.h"
+
+#include <QDir>
+#include <QTemporaryDir>
+
+constexpr quint32 SEGMENT_SIZE = 65536;
+constexpr int MAX_SEGMENTS = 3;
+
+namespace {
+
+LogHandler::Log makeLog(LogLevel level, const QString& module, qint64 msecs,
+                        const QString& message) {
+  LogHandler::Log log(level, QStringList{module}, "TestLogStore", message);
+  log.m_dateTime = QDateTime::fromMSecsSinceEpoch(msecs);
+  return log;
+}
+
+QList<LogHandler::Log> readAll(const QString& path,
+                               const LogHandler::Filter& filter) {
+  QList<LogHandler::Log> logs;
+  LogStore::read(path, filter,
+                 [&logs](const LogHandler::Log& log) { logs.append(log); });
+  return logs;
+}
+
+int segmentCount(const QString& path) {
+  return QDir(path).entryList(QDir::Files).length();
+}
+
+}  // namespace
+
+void TestLogStore::appendRead() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+
+  LogStore store(dir.path(), SEGMENT_SIZE, MAX_SEGMENTS);
+  QVERIFY(store.open());
+
+  QVERIFY(store.append(makeLog(Info, "main", 1000, "Hello world")));
+  QVERIFY(store.append(
+      LogHandler::Log(Warning, "main.cpp", "main()", 42, "From Qt")));
+
+  // Nothing is visible before the commit.
+  QVERIFY(readAll(dir.path(), LogHandler::Filter()).isEmpty());
+
+  store.commit();
+
+  QList<LogHandler::Log> logs = readAll(dir.path(), LogHandler::Filter());
+  QCOMPARE(logs.length(), 2);
+
+  QCOMPARE(logs[0].m_logLevel, Info);
+  QCOMPARE(logs[0].m_dateTime.toMSecsSinceEpoch(), qint64(1000));
+  QCOMPARE(logs[0].m_modules, QStringList{"main"});
+  QCOMPARE(logs[0].m_className, "TestLogStore");
+  QCOMPARE(logs[0].m_message, "Hello world");
+  QVERIFY(!logs[0].m_fromQT);
+
+  QCOMPARE(logs[1].m_logLevel, Warning);
+  QVERIFY(logs[1].m_fromQT);
+  QCOMPARE(logs[1].m_file, "main.cpp");
+  QCOMPARE(logs[1].m_function, "main()");
+  QCOMPARE(logs[1].m_line, 42);
+  QCOMPARE(logs[1].m_message, "From Qt");
+}
+
+void TestLogStore::rotation() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+
+  LogStore store(dir.path(), SEGMENT_SIZE, MAX_SEGMENTS);
+  QVERIFY(store.open());
+
+  // About 8 segments of 1 KB lines.
+  const QString payload(1000, 'x');
+  const int count = 500;
+  for (int i = 0; i < count; ++i) {
+    QVERIFY(store.append(makeLog(Debug, "main", i, payload)));
+  }
+  store.commit();
+
+  QCOMPARE(segmentCount(dir.path()), MAX_SEGMENTS);
+
+  // The newest lines are kept, in order.
+  QList<LogHandler::Log> logs = readAll(dir.path(), LogHandler::Filter());
+  QVERIFY(logs.length() > count / 4);
+  QVERIFY(logs.length() < count);
+  for (int i = 0; i < logs.length(); ++i) {
+    QCOMPARE(logs[i].m_dateTime.toMSecsSinceEpoch(),
+             qint64(count - logs.length() + i));
+    QCOMPARE(logs[i].m_modules, QStringList{"main"});
+  }
+
+  // Oversized messages are truncated.
+  QVERIFY(store.append(makeLog(Debug, "main", count, QString(40000, 'y'))));
+  store.commit();
+  logs = readAll(dir.path(), LogHandler::Filter());
+  QVERIFY(logs.last().m_message.length() < 40000);
+
+  store.close();
+  LogStore::removeAll(dir.path());
+  QCOMPARE(segmentCount(dir.path()), 0);
+}
+
+void TestLogStore::filters() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+
+  LogStore store(dir.path(), SEGMENT_SIZE, MAX_SEGMENTS);
+  QVERIFY(store.open());
+
+  for (int i = 0; i < 100; ++i) {
+    LogLevel level = i % 10 == 0 ? Error : Debug;
+    QString module = i % 2 ? "networking" : "controller";
+    QVERIFY(store.append(makeLog(level, module, 1000 + i,
+                                 QString("line %1").arg(i))));
+  }
+  store.commit();
+
+  LogHandler::Filter filter;
+  QCOMPARE(readAll(dir.path(), filter).length(), 100);
+
+  filter.m_minLogLevel = Error;
+  QCOMPARE(readAll(dir.path(), filter).length(), 10);
+
+  filter = LogHandler::Filter();
+  filter.m_modules = QStringList{"networking"};
+  QList<LogHandler::Log> logs = readAll(dir.path(), filter);
+  QCOMPARE(logs.length(), 50);
+  for (const LogHandler::Log& log : logs) {
+    QCOMPARE(log.m_modules, QStringList{"networking"});
+  }
+
+  filter = LogHandler::Filter();
+  filter.m_from = 1010;
+  filter.m_to = 1019;
+  logs = readAll(dir.path(), filter);
+  QCOMPARE(logs.length(), 10);
+  QCOMPARE(logs.first().m_message, "line 10");
+  QCOMPARE(logs.last().m_message, "line 19");
+
+  // Out of the time range of the segment.
+  filter.m_from = 5000;
+  filter.m_to = 0;
+  QVERIFY(readAll(dir.path(), filter).isEmpty());
+}
+
+void TestLogStore::resume() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+
+  {
+    LogStore store(dir.path(), SEGMENT_SIZE, MAX_SEGMENTS);
+    QVERIFY(store.open());
+    QVERIFY(store.append(makeLog(Info, "main", 1, "first")));
+  }
+
+  // The last segment is reused, with its string ids.
+  {
+    LogStore store(dir.path(), SEGMENT_SIZE, MAX_SEGMENTS);
+    QVERIFY(store.open());
+    QVERIFY(store.append(makeLog(Info, "main", 2, "second")));
+    QVERIFY(store.append(makeLog(Info, "other", 3, "third")));
+  }
+
+  QCOMPARE(segmentCount(dir.path()), 1);
+
+  QList<LogHandler::Log> logs = readAll(dir.path(), LogHandler::Filter());
+  QCOMPARE(logs.length(), 3);
+  QCOMPARE(logs[0].m_message, "first");
+  QCOMPARE(logs[1].m_message, "second");
+  QCOMPARE(logs[1].m_modules, QStringList{"main"});
+  QCOMPARE(logs[2].m_modules, QStringList{"other"});
+
+  // A segment of another size is not resumed.
+  {
+    LogStore store(dir.path(), SEGMENT_SIZE * 2, MAX_SEGMENTS);
+    QVERIFY(store.open());
+  }
+  QCOMPARE(segmentCount(dir.path()), 2);
+}
+
+static TestLogStore s_testLogStore;
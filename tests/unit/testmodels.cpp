@@ -10,6 +10,7 @@
 #include "../../src/models/servercountry.h"
 #include "../../src/models/servercountrymodel.h"
 #include "../../src/models/serverdata.h"
+#include "../../src/models/serverlistsnapshot.h"
 #include "../../src/models/surveymodel.h"
 #include "../../src/models/user.h"
 #include "../../src/settingsholder.h"
@@ -18,6 +19,7 @@
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QTemporaryDir>
 
 // Device
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -1175,6 +1177,190 @@ void TestModels::serverCountryModelPick() {
   }
 }
 
+namespace {
+
+QJsonObject serverCountryJson(const QString& code, const QString& name,
+                              const QString& publicKey) {
+  QJsonArray portRanges;
+  portRanges.append(QJsonArray{1, 10});
+  portRanges.append(QJsonArray{20, 30});
+
+  QJsonObject server;
+  server.insert("hostname", "hostname-" + code);
+  server.insert("ipv4_addr_in", "ipv4AddrIn-" + code);
+  server.insert("ipv4_gateway", "ipv4Gateway");
+  server.insert("ipv6_addr_in", "ipv6AddrIn");
+  server.insert("ipv6_gateway", "ipv6Gateway");
+  server.insert("public_key", publicKey);
+  server.insert("weight", 1234);
+  server.insert("port_ranges", portRanges);
+  server.insert("multihop_port", 1234);
+  server.insert("socks5_name", "socks5_name");
+
+  QJsonObject city;
+  city.insert("code", "city-" + code);
+  city.insert("name", "City " + name);
+  city.insert("latitude", 12.34);
+  city.insert("longitude", 34.56);
+  city.insert("servers", QJsonArray{server});
+
+  QJsonObject country;
+  country.insert("name", name);
+  country.insert("code", code);
+  country.insert("cities", QJsonArray{city});
+  return country;
+}
+
+QByteArray serverListJson(const QJsonArray& countries) {
+  QJsonObject obj;
+  obj.insert("countries", countries);
+  return QJsonDocument(obj).toJson();
+}
+
+}  // anonymous namespace
+
+void TestModels::serverCountryModelDiff() {
+  SettingsHolder settingsHolder;
+  qRegisterMetaType<QVector<int>>();
+
+  ServerCountryModel m;
+  QVERIFY(m.fromJson(serverListJson(
+      {serverCountryJson("aa", "Aaa", "keyA"),
+       serverCountryJson("bb", "Bbb", "keyB"),
+       serverCountryJson("dd", "Ddd", "keyD")})));
+  QCOMPARE(m.rowCount(QModelIndex()), 3);
+
+  QSignalSpy resetSpy(&m, &ServerCountryModel::modelReset);
+  QSignalSpy insertSpy(&m, &ServerCountryModel::rowsInserted);
+  QSignalSpy removeSpy(&m, &ServerCountryModel::rowsRemoved);
+  QSignalSpy changeSpy(&m, &ServerCountryModel::dataChanged);
+  QSignalSpy serversSpy(&m, &ServerCountryModel::serversChanged);
+
+  // "bb" is removed, "cc" is added and "dd" has a new server.
+  QVERIFY(m.fromJson(serverListJson(
+      {serverCountryJson("aa", "Aaa", "keyA"),
+       serverCountryJson("cc", "Ccc", "keyC"),
+       serverCountryJson("dd", "Ddd", "keyD2")})));
+
+  QCOMPARE(resetSpy.count(), 0);
+  QCOMPARE(serversSpy.count(), 1);
+
+  QCOMPARE(removeSpy.count(), 1);
+  QCOMPARE(removeSpy.at(0).at(1).toInt(), 1);
+  QCOMPARE(removeSpy.at(0).at(2).toInt(), 1);
+
+  QCOMPARE(insertSpy.count(), 1);
+  QCOMPARE(insertSpy.at(0).at(1).toInt(), 1);
+  QCOMPARE(insertSpy.at(0).at(2).toInt(), 1);
+
+  QCOMPARE(changeSpy.count(), 1);
+  QCOMPARE(changeSpy.at(0).at(0).value<QModelIndex>().row(), 2);
+
+  QCOMPARE(m.rowCount(QModelIndex()), 3);
+  QCOMPARE(m.data(m.index(1, 0), ServerCountryModel::CodeRole), "cc");
+  QCOMPARE(m.countryName("bb"), QString());
+  QCOMPARE(m.countryName("cc"), "Ccc");
+
+  ServerData sd;
+  QVERIFY(!m.pickByPublicKey("keyD", sd));
+  QVERIFY(m.pickByPublicKey("keyD2", sd));
+  QCOMPARE(sd.exitCountryCode(), "dd");
+  QCOMPARE(sd.exitCityName(), "City Ddd");
+  QVERIFY(m.exists(sd));
+  QCOMPARE(m.servers(sd).length(), 1);
+  QCOMPARE(m.servers(sd).at(0).publicKey(), "keyD2");
+
+  // A renamed country changes its position: the model is reset.
+  QVERIFY(m.fromJson(serverListJson(
+      {serverCountryJson("aa", "Zzz", "keyA"),
+       serverCountryJson("cc", "Ccc", "keyC"),
+       serverCountryJson("dd", "Ddd", "keyD2")})));
+  QCOMPARE(resetSpy.count(), 1);
+  QCOMPARE(serversSpy.count(), 2);
+  QCOMPARE(m.data(m.index(2, 0), ServerCountryModel::CodeRole), "aa");
+  QCOMPARE(m.countryName("aa"), "Zzz");
+}
+
+void TestModels::serverListSnapshot() {
+  SettingsHolder settingsHolder;
+
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+  const QString fileName = dir.filePath("servers.bin");
+
+  QByteArray json = serverListJson({serverCountryJson("aa", "Aaa", "keyA"),
+                                    serverCountryJson("bb", "Bbb", "keyB")});
+
+  ServerCountryModel m;
+  m.setSnapshotFileName(fileName);
+  QVERIFY(m.fromJson(json));
+  QVERIFY(QFile::exists(fileName));
+
+  QByteArray snapshot = ServerListSnapshot::serialize(m.countries(), json);
+  QVERIFY(!snapshot.isEmpty());
+
+  const uchar* data = reinterpret_cast<const uchar*>(snapshot.constData());
+
+  QList<ServerCountry> countries;
+  QVERIFY(ServerListSnapshot::deserialize(data, snapshot.length(), json,
+                                          countries));
+  QCOMPARE(countries.length(), m.countries().length());
+  for (int i = 0; i < countries.length(); ++i) {
+    QVERIFY(ServerListSnapshot::identical(countries.at(i),
+                                          m.countries().at(i)));
+  }
+
+  const Server& server = countries.at(0).cities().at(0).servers().at(0);
+  QCOMPARE(server.publicKey(), "keyA");
+  QCOMPARE(server.weight(), (uint32_t)1234);
+  uint32_t port = server.choosePort();
+  QVERIFY((port >= 1 && port <= 10) || (port >= 20 && port <= 30));
+
+  // The snapshot of another JSON is ignored.
+  QList<ServerCountry> other;
+  QVERIFY(!ServerListSnapshot::deserialize(data, snapshot.length(),
+                                           json + " ", other));
+  QVERIFY(other.isEmpty());
+
+  // Truncated or corrupted.
+  QVERIFY(!ServerListSnapshot::deserialize(data, snapshot.length() - 8, json,
+                                           other));
+  QVERIFY(!ServerListSnapshot::deserialize(data, 4, json, other));
+
+  QByteArray corrupted(snapshot);
+  corrupted[0] = corrupted[0] ^ 0xff;
+  QVERIFY(!ServerListSnapshot::deserialize(
+      reinterpret_cast<const uchar*>(corrupted.constData()),
+      corrupted.length(), json, other));
+  QVERIFY(other.isEmpty());
+
+  // The model loads the snapshot matching the JSON in the settings. The
+  // snapshot is forged with other countries, to tell it apart from the JSON.
+  ServerCountryModel forged;
+  forged.setSnapshotFileName(QString());
+  QVERIFY(forged.fromJson(
+      serverListJson({serverCountryJson("cc", "Ccc", "keyC")})));
+  QVERIFY(ServerListSnapshot::save(fileName, json, forged.countries()));
+
+  SettingsHolder::instance()->setServers(json);
+
+  ServerCountryModel m2;
+  m2.setSnapshotFileName(fileName);
+  QVERIFY(m2.fromSettings());
+  QCOMPARE(m2.rowCount(QModelIndex()), 1);
+  QCOMPARE(m2.countryName("cc"), "Ccc");
+
+  // Without a valid snapshot, the JSON is parsed and the snapshot rewritten.
+  QVERIFY(QFile::remove(fileName));
+
+  ServerCountryModel m3;
+  m3.setSnapshotFileName(fileName);
+  QVERIFY(m3.fromSettings());
+  QCOMPARE(m3.rowCount(QModelIndex()), 2);
+  QCOMPARE(m3.countryName("bb"), "Bbb");
+  QVERIFY(QFile::exists(fileName));
+}
+
 // ServerData
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
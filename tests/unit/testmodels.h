@@ -39,6 +39,9 @@ class TestModels final : public TestHelper {
   void serverCountryModelFromJson_data();
   void serverCountryModelFromJson();
   void serverCountryModelPick();
+  void serverCountryModelDiff();
+
+  void serverListSnapshot();
 
   void serverDataBasic();
 
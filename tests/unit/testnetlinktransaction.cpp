@@ -0,0 +1,276 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "testnetlinktransaction.h"
+#include "../../src/platforms/linux/daemon/netlinktransaction.h"
+#include "helper.h"
+
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <net/if.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+// Routes of the tests: 10.0.<index / 256>.<index % 256>/32 in this table.
+constexpr int TEST_TABLE = 100;
+
+// More than one chunk of requests.
+constexpr int TEST_ROUTES = 150;
+
+int s_nlsock = -1;
+int s_monitor = -1;
+
+int openSocket(uint32_t groups) {
+  int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (fd < 0) {
+    return -1;
+  }
+
+  struct sockaddr_nl addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = groups;
+  if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+void appendAttr32(struct nlmsghdr* nlmsg, int type, uint32_t value) {
+  struct rtattr* attr = reinterpret_cast<struct rtattr*>(
+      reinterpret_cast<char*>(nlmsg) + NLMSG_ALIGN(nlmsg->nlmsg_len));
+  attr->rta_type = type;
+  attr->rta_len = RTA_LENGTH(sizeof(value));
+  memcpy(RTA_DATA(attr), &value, sizeof(value));
+  nlmsg->nlmsg_len = NLMSG_ALIGN(nlmsg->nlmsg_len) + RTA_ALIGN(attr->rta_len);
+}
+
+// The route with an unknown interface fails with ENODEV.
+void appendRoute(NetlinkTransaction& transaction, int type, int flags,
+                 int index, bool valid = true) {
+  char buf[NLMSG_SPACE(sizeof(struct rtmsg) + 2 * RTA_SPACE(4))];
+  memset(buf, 0, sizeof(buf));
+
+  struct nlmsghdr* nlmsg = reinterpret_cast<struct nlmsghdr*>(buf);
+  nlmsg->nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+  nlmsg->nlmsg_type = type;
+  nlmsg->nlmsg_flags = NLM_F_REQUEST | flags;
+
+  struct rtmsg* rtm = static_cast<struct rtmsg*>(NLMSG_DATA(nlmsg));
+  rtm->rtm_family = AF_INET;
+  rtm->rtm_dst_len = 32;
+  rtm->rtm_table = TEST_TABLE;
+  rtm->rtm_type = RTN_UNICAST;
+  rtm->rtm_protocol = RTPROT_BOOT;
+  rtm->rtm_scope = RT_SCOPE_LINK;
+
+  appendAttr32(nlmsg, RTA_DST, htonl(0x0a000000 + index));
+  appendAttr32(nlmsg, RTA_OIF, valid ? if_nametoindex("lo") : 0xffff);
+
+  // As WireguardUtilsLinux does: only the new routes are undone.
+  if (type == RTM_NEWROUTE && (flags & NLM_F_EXCL)) {
+    transaction.append(nlmsg, RTM_DELROUTE, NLM_F_REQUEST);
+  } else {
+    transaction.append(nlmsg);
+  }
+}
+
+// Route notifications received by the monitor: "+index" for the new routes,
+// "-index" for the deleted ones.
+QStringList notifications() {
+  QStringList result;
+  char buf[16384];
+
+  for (;;) {
+    ssize_t len = recv(s_monitor, buf, sizeof(buf), MSG_DONTWAIT);
+    if (len <= 0) {
+      return result;
+    }
+
+    struct nlmsghdr* nlmsg = reinterpret_cast<struct nlmsghdr*>(buf);
+    for (; NLMSG_OK(nlmsg, len); nlmsg = NLMSG_NEXT(nlmsg, len)) {
+      if (nlmsg->nlmsg_type != RTM_NEWROUTE &&
+          nlmsg->nlmsg_type != RTM_DELROUTE) {
+        continue;
+      }
+      struct rtmsg* rtm = static_cast<struct rtmsg*>(NLMSG_DATA(nlmsg));
+      if (rtm->rtm_table != TEST_TABLE) {
+        continue;
+      }
+
+      int attrlen = RTM_PAYLOAD(nlmsg);
+      for (struct rtattr* attr = RTM_RTA(rtm); RTA_OK(attr, attrlen);
+           attr = RTA_NEXT(attr, attrlen)) {
+        if (attr->rta_type != RTA_DST) {
+          continue;
+        }
+        uint32_t dst;
+        memcpy(&dst, RTA_DATA(attr), sizeof(dst));
+        int index = ntohl(dst) - 0x0a000000;
+        result.append(QString("%1%2")
+                          .arg(nlmsg->nlmsg_type == RTM_NEWROUTE ? '+' : '-')
+                          .arg(index));
+      }
+    }
+  }
+}
+
+// Whether the route exists: deleting it fails with ESRCH otherwise. The
+// routes which exist are deleted.
+QList<bool> deleteRoutes(uint32_t& sequence, const QList<int>& indexes) {
+  NetlinkTransaction transaction(s_nlsock, sequence);
+  for (int index : indexes) {
+    appendRoute(transaction, RTM_DELROUTE, 0, index);
+  }
+  transaction.commit();
+
+  QList<bool> result;
+  for (int i = 0; i < indexes.length(); ++i) {
+    result.append(transaction.error(i) == 0);
+  }
+  return result;
+}
+
+}  // namespace
+
+void TestNetlinkTransaction::init() {
+  if (qEnvironmentVariable("MVPN_TEST_NETNS").isEmpty()) {
+    QSKIP("MVPN_TEST_NETNS is not set");
+  }
+
+  s_nlsock = openSocket(0);
+  s_monitor = openSocket(RTMGRP_IPV4_ROUTE);
+  QVERIFY(s_nlsock >= 0);
+  QVERIFY(s_monitor >= 0);
+}
+
+void TestNetlinkTransaction::cleanup() {
+  if (s_monitor >= 0) {
+    close(s_monitor);
+    s_monitor = -1;
+  }
+  if (s_nlsock >= 0) {
+    // Leave the table empty for the next test.
+    uint32_t sequence = 1;
+    QList<int> indexes;
+    for (int i = 0; i < TEST_ROUTES; ++i) {
+      indexes.append(i);
+    }
+    deleteRoutes(sequence, indexes);
+
+    close(s_nlsock);
+    s_nlsock = -1;
+  }
+}
+
+void TestNetlinkTransaction::commitOrder() {
+  // The sequence numbers wrap in the middle of the transaction.
+  uint32_t sequence = UINT32_MAX - TEST_ROUTES / 2;
+
+  NetlinkTransaction transaction(s_nlsock, sequence);
+  QStringList expected;
+  for (int i = 0; i < TEST_ROUTES; ++i) {
+    appendRoute(transaction, RTM_NEWROUTE, NLM_F_CREATE | NLM_F_EXCL, i);
+    expected.append(QString("+%1").arg(i));
+  }
+  QCOMPARE(transaction.count(), TEST_ROUTES);
+
+  QVERIFY(transaction.commit());
+  for (int i = 0; i < TEST_ROUTES; ++i) {
+    QCOMPARE(transaction.error(i), 0);
+  }
+  QCOMPARE(sequence, static_cast<uint32_t>(TEST_ROUTES / 2 - 1));
+
+  // The kernel applied the requests in order.
+  QCOMPARE(notifications(), expected);
+}
+
+void TestNetlinkTransaction::errors() {
+  uint32_t sequence = 1;
+
+  NetlinkTransaction existing(s_nlsock, sequence);
+  appendRoute(existing, RTM_NEWROUTE, NLM_F_CREATE | NLM_F_EXCL, 120);
+  QVERIFY(existing.commit());
+
+  // The errors are reported for the right requests, in every chunk.
+  NetlinkTransaction transaction(s_nlsock, sequence);
+  for (int i = 0; i < TEST_ROUTES; ++i) {
+    appendRoute(transaction, RTM_NEWROUTE, NLM_F_CREATE | NLM_F_EXCL, i,
+                i != 5 && i != 70);
+  }
+  QVERIFY(!transaction.commit());
+
+  for (int i = 0; i < TEST_ROUTES; ++i) {
+    int error = transaction.error(i);
+    if (i == 5 || i == 70) {
+      QCOMPARE(error, ENODEV);
+    } else if (i == 120) {
+      QCOMPARE(error, EEXIST);
+    } else {
+      QCOMPARE(error, 0);
+    }
+  }
+}
+
+void TestNetlinkTransaction::rollbackOrder() {
+  uint32_t sequence = 1;
+
+  NetlinkTransaction transaction(s_nlsock, sequence);
+  QList<int> indexes;
+  for (int i = 0; i < TEST_ROUTES; ++i) {
+    appendRoute(transaction, RTM_NEWROUTE, NLM_F_CREATE | NLM_F_EXCL, i,
+                i != TEST_ROUTES - 1);
+    indexes.append(i);
+  }
+  QVERIFY(!transaction.commit());
+  notifications();
+
+  // The routes are removed newest first.
+  transaction.rollback();
+  QStringList expected;
+  for (int i = TEST_ROUTES - 2; i >= 0; --i) {
+    expected.append(QString("-%1").arg(i));
+  }
+  QCOMPARE(notifications(), expected);
+
+  for (bool exists : deleteRoutes(sequence, indexes)) {
+    QVERIFY(!exists);
+  }
+}
+
+void TestNetlinkTransaction::rollbackCreatedOnly() {
+  uint32_t sequence = 1;
+
+  NetlinkTransaction existing(s_nlsock, sequence);
+  appendRoute(existing, RTM_NEWROUTE, NLM_F_CREATE | NLM_F_EXCL, 1);
+  QVERIFY(existing.commit());
+
+  NetlinkTransaction transaction(s_nlsock, sequence);
+  appendRoute(transaction, RTM_NEWROUTE, NLM_F_CREATE | NLM_F_EXCL, 1);
+  appendRoute(transaction, RTM_NEWROUTE, NLM_F_CREATE | NLM_F_EXCL, 2);
+  appendRoute(transaction, RTM_NEWROUTE, NLM_F_CREATE | NLM_F_REPLACE, 3);
+  appendRoute(transaction, RTM_NEWROUTE, NLM_F_CREATE | NLM_F_EXCL, 4, false);
+  QVERIFY(!transaction.commit());
+  QCOMPARE(transaction.error(0), EEXIST);
+  QCOMPARE(transaction.error(1), 0);
+  QCOMPARE(transaction.error(2), 0);
+  QCOMPARE(transaction.error(3), ENODEV);
+  notifications();
+
+  // The route which was already there stays, and so does the replacement,
+  // which has no undo.
+  transaction.rollback();
+  QCOMPARE(notifications(), QStringList{"-2"});
+  QCOMPARE(deleteRoutes(sequence, {1, 2, 3, 4}),
+           (QList<bool>{true, false, true, false}));
+}
+
+static TestNetlinkTransaction s_testNetlinkTransaction;
@@ -0,0 +1,102 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "testnetworkresponsecache.h"
+#include "../../src/networkresponsecache.h"
+#include "helper.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QUrl>
+
+void TestNetworkResponseCache::key() {
+  QUrl url("https://vpn.mozilla.org/api/v1/vpn/servers");
+  QString key = NetworkResponseCache::key(url, "Bearer foo");
+
+  QCOMPARE(key, NetworkResponseCache::key(url, "Bearer foo"));
+  QVERIFY(key != NetworkResponseCache::key(url, "Bearer bar"));
+  QVERIFY(key != NetworkResponseCache::key(url, QByteArray()));
+  QVERIFY(key != NetworkResponseCache::key(
+                     QUrl("https://vpn.mozilla.org/api/v1/vpn/account"),
+                     "Bearer foo"));
+
+  // The token is never part of the key.
+  QVERIFY(!key.contains("foo"));
+}
+
+void TestNetworkResponseCache::storeFind() {
+  QTemporaryDir dir;
+  QString path = dir.filePath("api");
+
+  {
+    NetworkResponseCache cache(path);
+    QVERIFY(!cache.find("a").isValid());
+
+    cache.store("a", {"\"etag\"", QByteArray(), "body"});
+    NetworkResponseCache::Entry entry = cache.find("a");
+    QVERIFY(entry.isValid());
+    QCOMPARE(entry.m_etag, QByteArray("\"etag\""));
+    QCOMPARE(entry.m_body, QByteArray("body"));
+
+    QVERIFY(!cache.isDelivered("a"));
+    cache.setDelivered("a");
+    QVERIFY(cache.isDelivered("a"));
+  }
+
+  // Entries persist, but the delivery doesn't.
+  NetworkResponseCache cache(path);
+  NetworkResponseCache::Entry entry = cache.find("a");
+  QVERIFY(entry.isValid());
+  QCOMPARE(entry.m_etag, QByteArray("\"etag\""));
+  QVERIFY(entry.m_lastModified.isEmpty());
+  QCOMPARE(entry.m_body, QByteArray("body"));
+  QVERIFY(!cache.isDelivered("a"));
+
+  cache.store("a", {QByteArray(), "Mon, 01 Jan 2022 00:00:00 GMT", "new"});
+  QCOMPARE(NetworkResponseCache(path).find("a").m_body, QByteArray("new"));
+
+  cache.remove("a");
+  QVERIFY(!cache.find("a").isValid());
+  QVERIFY(!NetworkResponseCache(path).find("a").isValid());
+}
+
+void TestNetworkResponseCache::invalidEntries() {
+  QTemporaryDir dir;
+  QString path = dir.filePath("api");
+  NetworkResponseCache cache(path);
+
+  // No validators: nothing to store.
+  cache.store("a", {QByteArray(), QByteArray(), "body"});
+  QVERIFY(!cache.find("a").isValid());
+  QVERIFY(!QFile::exists(QDir(path).filePath("a")));
+
+  // Corrupted files are ignored and removed.
+  QVERIFY(QDir().mkpath(path));
+  QFile file(QDir(path).filePath("b"));
+  QVERIFY(file.open(QIODevice::WriteOnly));
+  file.write("garbage");
+  file.close();
+
+  QVERIFY(!cache.find("b").isValid());
+  QVERIFY(!file.exists());
+}
+
+void TestNetworkResponseCache::clear() {
+  QTemporaryDir dir;
+  QString path = dir.filePath("api");
+  NetworkResponseCache cache(path);
+
+  cache.store("a", {"1", QByteArray(), "a"});
+  cache.store("b", {"2", QByteArray(), "b"});
+  cache.setDelivered("a");
+
+  cache.clear();
+  QVERIFY(!cache.isDelivered("a"));
+  QVERIFY(!cache.find("a").isValid());
+  QVERIFY(!cache.find("b").isValid());
+  QVERIFY(!QDir(path).exists());
+}
+
+static TestNetworkResponseCache s_testNetworkResponseCache;
@@ -0,0 +1,133 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "testpathmtuprober.h"
+#include "../../src/pingsender.h"
+#include "../../src/platforms/linux/daemon/pathmtuprober.h"
+#include "helper.h"
+
+#include <QSignalSpy>
+
+namespace {
+
+constexpr const char* PROBE_DEST = "192.0.2.1";
+
+// From pathmtuprober.cpp.
+constexpr int PROBE_MIN_SIZE = 576;
+constexpr int PROBE_GRANULARITY = 8;
+
+// Records the probes instead of sending them.
+class FakePingSender final : public PingSender {
+ public:
+  void sendPing(const QString& dest, quint16 sequence) override {
+    m_dests.append(dest);
+    m_sizes.append(m_probeSize);
+    m_sequences.append(sequence);
+  }
+
+  bool setProbeSize(int size) override {
+    m_probeSize = size;
+    return true;
+  }
+
+  int m_probeSize = 0;
+  QStringList m_dests;
+  QList<int> m_sizes;
+  QList<quint16> m_sequences;
+};
+
+}  // namespace
+
+void TestPathMtuProber::bisection_data() {
+  QTest::addColumn<int>("upperBound");
+  QTest::addColumn<int>("pathMtu");
+
+  QTest::addRow("ethernet") << 1500 << 1500;
+  QTest::addRow("pppoe") << 1500 << 1492;
+  QTest::addRow("tunnel") << 1500 << 1420;
+  QTest::addRow("minimum") << 1500 << PROBE_MIN_SIZE;
+  QTest::addRow("bounded") << 1420 << 1500;
+  QTest::addRow("jumbo") << 9000 << 1500;
+  QTest::addRow("too small") << 1500 << 560;
+  QTest::addRow("no answer") << 1500 << 0;
+}
+
+void TestPathMtuProber::bisection() {
+  QFETCH(int, upperBound);
+  QFETCH(int, pathMtu);
+
+  FakePingSender* sender = new FakePingSender();
+  PathMtuProber prober(sender, nullptr);
+  QSignalSpy spy(&prober, &PathMtuProber::discovered);
+
+  // Each probe is answered if it fits in the path.
+  prober.start(PROBE_DEST, upperBound);
+  int probes = 0;
+  while (prober.isRunning()) {
+    QVERIFY(++probes <= 16);
+    QCOMPARE(sender->m_probeSize, prober.m_size);
+    QCOMPARE(sender->m_sizes.last(), prober.m_size);
+    QCOMPARE(sender->m_dests.last(), QString(PROBE_DEST));
+    prober.next(prober.m_size <= pathMtu);
+  }
+
+  // The largest size is tried first, then the minimum one if it fails.
+  QCOMPARE(sender->m_sizes.first(), upperBound);
+  if (pathMtu < upperBound) {
+    QVERIFY(sender->m_sizes.length() > 1);
+    QCOMPARE(sender->m_sizes.at(1), PROBE_MIN_SIZE);
+  }
+
+  // The pings go back to their normal size.
+  QCOMPARE(sender->m_probeSize, 0);
+
+  if (pathMtu < PROBE_MIN_SIZE) {
+    QCOMPARE(spy.count(), 0);
+    QCOMPARE(sender->m_sizes.length(), 2);
+    return;
+  }
+
+  QCOMPARE(spy.count(), 1);
+  int mtu = spy.first().first().toInt();
+  int expected = qMin(pathMtu, upperBound);
+  QVERIFY(mtu <= expected);
+  QVERIFY(mtu > expected - PROBE_GRANULARITY);
+  if (pathMtu >= upperBound) {
+    QCOMPARE(sender->m_sizes.length(), 1);
+  }
+}
+
+void TestPathMtuProber::attempts() {
+  FakePingSender* sender = new FakePingSender();
+  PathMtuProber prober(sender, nullptr);
+  QSignalSpy spy(&prober, &PathMtuProber::discovered);
+
+  prober.start(PROBE_DEST, 1500);
+  QCOMPARE(sender->m_sizes, QList<int>({1500}));
+
+  // A lost probe is sent again at the same size, then the size is dropped.
+  prober.probeTimedOut();
+  QCOMPARE(sender->m_sizes, QList<int>({1500, 1500}));
+  prober.probeTimedOut();
+  QCOMPARE(sender->m_sizes, QList<int>({1500, 1500, PROBE_MIN_SIZE}));
+
+  // Late answers to the previous size are ignored.
+  emit sender->recvPing(sender->m_sequences.at(1));
+  QCOMPARE(prober.m_low, 0);
+  QCOMPARE(sender->m_sizes.length(), 3);
+
+  // Any attempt at the current size counts.
+  prober.probeTimedOut();
+  QCOMPARE(sender->m_sizes.length(), 4);
+  emit sender->recvPing(sender->m_sequences.at(2));
+  QCOMPARE(prober.m_low, PROBE_MIN_SIZE);
+  QCOMPARE(sender->m_sizes.last(), (PROBE_MIN_SIZE + 1500) / 2);
+
+  prober.stop();
+  QVERIFY(!prober.isRunning());
+  QCOMPARE(sender->m_probeSize, 0);
+  QCOMPARE(spy.count(), 0);
+}
+
+static TestPathMtuProber s_testPathMtuProber;
@@ -0,0 +1,170 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "testpidtracker.h"
+#include "../../src/platforms/linux/daemon/pidtracker.h"
+#include "helper.h"
+
+#include <QRandomGenerator>
+
+#include <sys/prctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+// static
+void TestPidTracker::compare(PidTable& table,
+                             const QHash<int, uint>& reference) {
+  QCOMPARE(table.count(), reference.count());
+
+  QList<int> keys = table.keys();
+  std::sort(keys.begin(), keys.end());
+  QList<int> expected = reference.keys();
+  std::sort(expected.begin(), expected.end());
+  QCOMPARE(keys, expected);
+
+  for (auto i = reference.constBegin(); i != reference.constEnd(); ++i) {
+    PidTable::Entry* entry = table.find(i.key());
+    QVERIFY(entry);
+    QCOMPARE(entry->pid, i.key());
+    QCOMPARE(entry->threads, i.value());
+  }
+
+  // Every cluster ends with an empty slot, or the lookups would not end.
+  int empty = 0;
+  for (const PidTable::Entry& entry : table.m_entries) {
+    if (entry.pid == 0) {
+      ++empty;
+    }
+  }
+  QCOMPARE(empty, table.m_entries.size() - reference.count());
+  QVERIFY(empty > 0);
+}
+
+void TestPidTracker::pidTableRandom() {
+  QRandomGenerator generator(42);
+  PidTable table;
+  QHash<int, uint> reference;
+
+  // A small range of pids, so that the same ones are added and removed often.
+  for (int step = 0; step < 20000; ++step) {
+    int pid = generator.bounded(1, 200);
+    if (generator.bounded(3) == 0) {
+      table.remove(pid);
+      reference.remove(pid);
+    } else {
+      uint threads = generator.bounded(1, 100);
+      table.insert(pid)->threads = threads;
+      reference.insert(pid, threads);
+    }
+
+    if (step % 100 == 0) {
+      compare(table, reference);
+    }
+    QVERIFY(!table.find(200 + step % 100));
+  }
+  compare(table, reference);
+
+  for (int pid : reference.keys()) {
+    table.remove(pid);
+  }
+  compare(table, QHash<int, uint>());
+}
+
+void TestPidTracker::pidTableWrapAround() {
+  PidTable table;
+  int mask = table.m_mask;
+
+  // Pids of the last slot and of the first ones: their clusters wrap around.
+  QHash<int, QList<int>> bySlot;
+  for (int pid = 1; bySlot.value(mask).length() < 4 ||
+                    bySlot.value(0).length() < 2 ||
+                    bySlot.value(1).length() < 1;
+       ++pid) {
+    bySlot[table.slot(pid)].append(pid);
+  }
+
+  QList<int> pids = bySlot.value(mask).mid(0, 3) + bySlot.value(0).mid(0, 2) +
+                    bySlot.value(1).mid(0, 1);
+
+  // Removes each pid of the cluster in turn, then all of them in any order.
+  for (int i = 0; i < pids.length(); ++i) {
+    PidTable removed;
+    QHash<int, uint> reference;
+    for (int pid : pids) {
+      removed.insert(pid)->threads = pid;
+      reference.insert(pid, pid);
+    }
+    compare(removed, reference);
+
+    for (int j = 0; j < pids.length(); ++j) {
+      int pid = pids.at((i + j) % pids.length());
+      removed.remove(pid);
+      reference.remove(pid);
+      compare(removed, reference);
+    }
+  }
+
+  // Removing a missing pid leaves the cluster alone.
+  QHash<int, uint> reference;
+  for (int pid : pids) {
+    table.insert(pid)->threads = 1;
+    reference.insert(pid, 1);
+  }
+  table.remove(bySlot.value(mask).at(3));
+  compare(table, reference);
+}
+
+void TestPidTracker::pidTableRehash() {
+  PidTable table;
+  QHash<int, uint> reference;
+
+  int capacity = table.m_entries.size();
+  for (int pid = 1; pid <= 5000; ++pid) {
+    table.insert(pid * 7)->threads = pid;
+    reference.insert(pid * 7, pid);
+
+    // The load factor stays under 1/2.
+    QVERIFY(table.count() * 2 <= table.m_entries.size());
+  }
+  QVERIFY(table.m_entries.size() > capacity);
+  compare(table, reference);
+
+  // The entries survive the growth of the table.
+  for (int pid = 1; pid <= 5000; pid += 2) {
+    table.remove(pid * 7);
+    reference.remove(pid * 7);
+  }
+  compare(table, reference);
+
+  PidTable other;
+  other.swap(table);
+  compare(other, reference);
+  compare(table, QHash<int, uint>());
+
+  other.clear();
+  QCOMPARE(other.m_entries.size(), capacity);
+  compare(other, QHash<int, uint>());
+}
+
+void TestPidTracker::readProcStat() {
+  char name[16] = {0};
+  QCOMPARE(prctl(PR_GET_NAME, name), 0);
+
+  // A command name which looks like the end of the command and more fields.
+  QCOMPARE(prctl(PR_SET_NAME, "x) Z 1 2 (y)"), 0);
+
+  int ppid = 0;
+  uint threads = 0;
+  bool ok = PidTracker::readProcStat(getpid(), ppid, threads);
+  prctl(PR_SET_NAME, name);
+
+  QVERIFY(ok);
+  QCOMPARE(ppid, getppid());
+  QVERIFY(threads >= 1);
+
+  QVERIFY(!PidTracker::readProcStat(0, ppid, threads));
+}
+
+static TestPidTracker s_testPidTracker;
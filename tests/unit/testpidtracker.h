@@ -0,0 +1,23 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "helper.h"
+
+#include <QHash>
+
+class PidTable;
+
+class TestPidTracker final : public TestHelper {
+  Q_OBJECT
+
+ private:
+  // Checks the table against a reference of the pids and their thread counts.
+  static void compare(PidTable& table, const QHash<int, uint>& reference);
+
+ private slots:
+  void pidTableRandom();
+  void pidTableWrapAround();
+  void pidTableRehash();
+  void readProcStat();
+};
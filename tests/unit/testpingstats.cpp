@@ -0,0 +1,176 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "testpingstats.h"
+#include "../../src/pingstats.h"
+#include "helper.h"
+
+void TestPingStats::empty() {
+  PingStats stats;
+  QCOMPARE(stats.windowSize(), PingStats::DEFAULT_WINDOW_SIZE);
+  QCOMPARE(stats.latency(), (uint)0);
+  QCOMPARE(stats.stddev(), (uint)0);
+  QCOMPARE(stats.maximum(), (uint)0);
+  QCOMPARE(stats.percentile(50), (uint)0);
+  QCOMPARE(stats.loss(0), 0.0);
+
+  // Replies without a matching request are ignored.
+  QCOMPARE(stats.addReceived(0, 100), (qint64)-1);
+}
+
+void TestPingStats::basic() {
+  PingStats stats;
+  stats.addSent(0, 1000);
+  stats.addSent(1, 2000);
+  stats.addSent(2, 3000);
+
+  QCOMPARE(stats.addReceived(0, 1010), (qint64)10);
+  QCOMPARE(stats.addReceived(1, 2020), (qint64)20);
+  QCOMPARE(stats.addReceived(2, 3030), (qint64)30);
+
+  // Duplicated replies are ignored.
+  QCOMPARE(stats.addReceived(2, 3040), (qint64)-1);
+  QCOMPARE(stats.addReceivedLatency(2, 5), (qint64)-1);
+
+  QCOMPARE(stats.sentCount(), 3);
+  QCOMPARE(stats.receivedCount(), 3);
+  QCOMPARE(stats.latency(), (uint)20);
+  QCOMPARE(stats.stddev(), (uint)8);
+  QCOMPARE(stats.maximum(), (uint)30);
+
+  stats.reset();
+  QCOMPARE(stats.sentCount(), 0);
+  QCOMPARE(stats.latency(), (uint)0);
+  QCOMPARE(stats.maximum(), (uint)0);
+}
+
+void TestPingStats::latency() {
+  PingStats stats;
+  stats.addSent(0, 1000);
+  stats.addSent(1, 2000);
+
+  // The latency measured by the sender is used as it is.
+  QCOMPARE(stats.addReceivedLatency(0, 1500), (qint64)1500);
+  QCOMPARE(stats.addReceived(0, 9000), (qint64)-1);
+  QCOMPARE(stats.addReceivedLatency(1, -10), (qint64)0);
+
+  QCOMPARE(stats.receivedCount(), 2);
+  QCOMPARE(stats.maximum(), (uint)1500);
+}
+
+void TestPingStats::window() {
+  PingStats stats(4);
+  QCOMPARE(stats.windowSize(), 4);
+
+  for (quint16 i = 0; i < 10; ++i) {
+    stats.addSent(i, i * 1000);
+    QCOMPARE(stats.addReceived(i, i * 1000 + i), (qint64)i);
+  }
+
+  // Only the last 4 samples (6, 7, 8, 9) are part of the window.
+  QCOMPARE(stats.sentCount(), 4);
+  QCOMPARE(stats.receivedCount(), 4);
+  QCOMPARE(stats.latency(), (uint)8);
+  QCOMPARE(stats.maximum(), (uint)9);
+
+  // Replies for requests outside of the window are ignored.
+  QCOMPARE(stats.addReceived(5, 10000), (qint64)-1);
+
+  stats.setWindowSize(1024);
+  QCOMPARE(stats.windowSize(), 1024);
+  QCOMPARE(stats.sentCount(), 0);
+
+  stats.setWindowSize(0);
+  QCOMPARE(stats.windowSize(), 1);
+}
+
+void TestPingStats::maximum() {
+  PingStats stats(3);
+
+  stats.addSent(0, 0);
+  stats.addSent(1, 0);
+  stats.addSent(2, 0);
+
+  // Out of order replies.
+  stats.addReceived(2, 20);
+  stats.addReceived(0, 50);
+  stats.addReceived(1, 30);
+  QCOMPARE(stats.maximum(), (uint)50);
+
+  // The slowest request leaves the window.
+  stats.addSent(3, 0);
+  QCOMPARE(stats.maximum(), (uint)30);
+
+  stats.addSent(4, 0);
+  QCOMPARE(stats.maximum(), (uint)20);
+
+  stats.addSent(5, 0);
+  QCOMPARE(stats.maximum(), (uint)0);
+
+  stats.addReceived(5, 5);
+  stats.addReceived(4, 4);
+  QCOMPARE(stats.maximum(), (uint)5);
+}
+
+void TestPingStats::loss() {
+  PingStats stats;
+
+  for (quint16 i = 0; i < 10; ++i) {
+    stats.addSent(i, i * 1000);
+  }
+  for (quint16 i = 0; i < 5; ++i) {
+    stats.addReceived(i, i * 1000 + 10);
+  }
+
+  // Everything sent before 10 seconds: 5 pings out of 10 are lost.
+  QCOMPARE(stats.loss(10000), 0.5);
+
+  // The last 5 pings are still in flight.
+  QCOMPARE(stats.loss(5000), 0.0);
+
+  // The last 3 pings are still in flight: 2 out of 7 lost.
+  QCOMPARE(stats.loss(7000), 2.0 / 7.0);
+}
+
+void TestPingStats::percentile() {
+  PingStats stats(100);
+
+  for (quint16 i = 0; i < 100; ++i) {
+    stats.addSent(i, 0);
+    stats.addReceived(i, i + 1);
+  }
+
+  // Small values are exact.
+  QCOMPARE(stats.percentile(0), (uint)1);
+  QCOMPARE(stats.percentile(50), (uint)50);
+  QCOMPARE(stats.percentile(100), (uint)100);
+
+  // Bigger values are approximated within a few percents.
+  uint p95 = stats.percentile(95);
+  QVERIFY(p95 >= 92 && p95 <= 98);
+  uint p99 = stats.percentile(99);
+  QVERIFY(p99 >= 96 && p99 <= 100);
+
+  stats.reset();
+  stats.addSent(0, 0);
+  stats.addReceived(0, 100000);
+  uint single = stats.percentile(99);
+  QVERIFY(single >= 97000 && single <= 100000);
+}
+
+void TestPingStats::sequenceWrap() {
+  PingStats stats(8);
+
+  quint16 sequence = 65530;
+  for (int i = 0; i < 12; ++i) {
+    stats.addSent(sequence, i * 1000);
+    QCOMPARE(stats.addReceived(sequence, i * 1000 + 10), (qint64)10);
+    ++sequence;
+  }
+
+  QCOMPARE(stats.receivedCount(), 8);
+  QCOMPARE(stats.latency(), (uint)10);
+}
+
+static TestPingStats s_testPingStats;
@@ -0,0 +1,190 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "testresumabledownload.h"
+#include "../../src/update/resumabledownload.h"
+#include "helper.h"
+
+#include <QCryptographicHash>
+#include <QTemporaryDir>
+
+namespace {
+
+// From resumabledownload.cpp.
+constexpr int DOWNLOAD_MAX_RETRIES = 5;
+constexpr int DOWNLOAD_RETRY_MSEC = 2000;
+
+QByteArray sha512Hex(const QByteArray& data) {
+  return QCryptographicHash::hash(data, QCryptographicHash::Sha512).toHex();
+}
+
+QByteArray fileContent(const QString& fileName) {
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return QByteArray();
+  }
+  return file.readAll();
+}
+
+}  // namespace
+
+void TestResumableDownload::resume() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+
+  ResumableDownload download;
+  QVERIFY(download.open(dir.filePath("package")));
+
+  download.startAttempt();
+  QVERIFY(download.headerReceived(200, QByteArray()));
+  QVERIFY(download.write("abc"));
+  QCOMPARE(download.offset(), qint64(3));
+
+  // The connection drops: the next attempt starts where this one stopped.
+  QCOMPARE(download.failed(0), DOWNLOAD_RETRY_MSEC);
+  QCOMPARE(download.offset(), qint64(3));
+
+  download.startAttempt();
+  QVERIFY(download.headerReceived(206, "bytes 3-5/6"));
+  QVERIFY(download.write("def"));
+  QCOMPARE(download.offset(), qint64(6));
+
+  QCOMPARE(download.hashHex(), sha512Hex("abcdef"));
+  QVERIFY(download.close());
+  QCOMPARE(fileContent(dir.filePath("package")), QByteArray("abcdef"));
+}
+
+void TestResumableDownload::rangeIgnored() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+
+  ResumableDownload download;
+  QVERIFY(download.open(dir.filePath("package")));
+
+  download.startAttempt();
+  QVERIFY(download.headerReceived(200, QByteArray()));
+  QVERIFY(download.write("abc"));
+  QCOMPARE(download.failed(0), DOWNLOAD_RETRY_MSEC);
+
+  // The whole file comes again: the file and the hash start over.
+  download.startAttempt();
+  QVERIFY(download.headerReceived(200, QByteArray()));
+  QCOMPARE(download.offset(), qint64(0));
+  QVERIFY(download.write("abcdef"));
+
+  QCOMPARE(download.hashHex(), sha512Hex("abcdef"));
+  QVERIFY(download.close());
+  QCOMPARE(fileContent(dir.filePath("package")), QByteArray("abcdef"));
+}
+
+void TestResumableDownload::rangeMismatch() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+
+  ResumableDownload download;
+  QVERIFY(download.open(dir.filePath("package")));
+
+  download.startAttempt();
+  QVERIFY(download.headerReceived(200, QByteArray()));
+  QVERIFY(download.write("abc"));
+  QCOMPARE(download.failed(0), DOWNLOAD_RETRY_MSEC);
+
+  download.startAttempt();
+  QVERIFY(!download.headerReceived(206, "bytes 2-5/6"));
+  QVERIFY(!download.headerReceived(206, QByteArray()));
+
+  // A partial reply to a request without range is not expected either.
+  ResumableDownload other;
+  QVERIFY(other.open(dir.filePath("other")));
+  other.startAttempt();
+  QVERIFY(!other.headerReceived(206, "bytes 0-5/6"));
+}
+
+void TestResumableDownload::rangeNotSatisfiable() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+
+  ResumableDownload download;
+  QVERIFY(download.open(dir.filePath("package")));
+
+  download.startAttempt();
+  QVERIFY(download.headerReceived(200, QByteArray()));
+  QVERIFY(download.write("abc"));
+  QCOMPARE(download.failed(0), DOWNLOAD_RETRY_MSEC);
+
+  // 416: the download is retried from the beginning.
+  download.startAttempt();
+  QVERIFY(download.headerReceived(416, QByteArray()));
+  QVERIFY(download.write("Range Not Satisfiable"));
+  QCOMPARE(download.failed(416), DOWNLOAD_RETRY_MSEC << 1);
+  QCOMPARE(download.offset(), qint64(0));
+
+  download.startAttempt();
+  QVERIFY(download.headerReceived(200, QByteArray()));
+  QVERIFY(download.write("ABCDEF"));
+
+  QCOMPARE(download.hashHex(), sha512Hex("ABCDEF"));
+  QVERIFY(download.close());
+  QCOMPARE(fileContent(dir.filePath("package")), QByteArray("ABCDEF"));
+
+  // Without anything downloaded, 416 is an error like the others.
+  ResumableDownload other;
+  QVERIFY(other.open(dir.filePath("other")));
+  other.startAttempt();
+  QVERIFY(other.headerReceived(416, QByteArray()));
+  QCOMPARE(other.failed(416), -1);
+}
+
+void TestResumableDownload::httpError() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+
+  ResumableDownload download;
+  QVERIFY(download.open(dir.filePath("package")));
+
+  download.startAttempt();
+  QVERIFY(download.headerReceived(200, QByteArray()));
+  QVERIFY(download.write("abc"));
+  QCOMPARE(download.failed(0), DOWNLOAD_RETRY_MSEC);
+
+  // 451 Unavailable For Legal Reasons: the header is accepted, for the
+  // request to fail with its status, and the body is not written.
+  download.startAttempt();
+  QVERIFY(download.headerReceived(451, QByteArray()));
+  QVERIFY(download.write("Unavailable For Legal Reasons"));
+  QCOMPARE(download.offset(), qint64(3));
+  QCOMPARE(download.failed(451), -1);
+
+  QCOMPARE(download.hashHex(), sha512Hex("abc"));
+  QVERIFY(download.close());
+  QCOMPARE(fileContent(dir.filePath("package")), QByteArray("abc"));
+}
+
+void TestResumableDownload::retries() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+
+  ResumableDownload download;
+  QVERIFY(download.open(dir.filePath("package")));
+
+  // The delay doubles while the attempts make no progress.
+  for (int i = 0; i < DOWNLOAD_MAX_RETRIES; ++i) {
+    download.startAttempt();
+    QCOMPARE(download.failed(0), DOWNLOAD_RETRY_MSEC << i);
+  }
+  download.startAttempt();
+  QCOMPARE(download.failed(0), -1);
+
+  // Progress restarts the counter.
+  QVERIFY(download.open(dir.filePath("package")));
+  for (int i = 0; i < DOWNLOAD_MAX_RETRIES; ++i) {
+    download.startAttempt();
+    QVERIFY(download.headerReceived(i ? 206 : 200,
+                                    "bytes " + QByteArray::number(i) + "-"));
+    QVERIFY(download.write("x"));
+    QCOMPARE(download.failed(0), DOWNLOAD_RETRY_MSEC);
+  }
+}
+
+static TestResumableDownload s_testResumableDownload;
@@ -0,0 +1,218 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "testserverlatency.h"
+#include "../../src/controller.h"
+#include "../../src/models/servercountrymodel.h"
+#include "../../src/pingsender.h"
+#include "../../src/serverlatency.h"
+#include "../../src/settingsholder.h"
+#include "helper.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+namespace {
+
+// One country, with one city and one server, for each (public key, address).
+QByteArray serverList(const QList<QPair<QString, QString>>& servers) {
+  QJsonArray countries;
+  for (const QPair<QString, QString>& pair : servers) {
+    QJsonObject server;
+    server.insert("hostname", "hostname-" + pair.first);
+    server.insert("ipv4_addr_in", pair.second);
+    server.insert("ipv4_gateway", "10.64.0.1");
+    server.insert("ipv6_addr_in", "::1");
+    server.insert("ipv6_gateway", "::1");
+    server.insert("public_key", pair.first);
+    server.insert("weight", 100);
+    server.insert("port_ranges", QJsonArray{QJsonArray{1, 10}});
+
+    QJsonObject city;
+    city.insert("code", "city-" + pair.first);
+    city.insert("name", "City " + pair.first);
+    city.insert("latitude", 12.34);
+    city.insert("longitude", 34.56);
+    city.insert("servers", QJsonArray{server});
+
+    QJsonObject country;
+    country.insert("code", "country-" + pair.first);
+    country.insert("name", "Country " + pair.first);
+    country.insert("cities", QJsonArray{city});
+    countries.append(country);
+  }
+
+  QJsonObject obj;
+  obj.insert("countries", countries);
+  return QJsonDocument(obj).toJson();
+}
+
+}  // namespace
+
+// static
+quint16 TestServerLatency::pendingSequence(const ServerLatency& latency,
+                                           const QString& address) {
+  for (const ServerLatency::PingKey& key : latency.m_pending.keys()) {
+    if (key.first == address) {
+      return key.second;
+    }
+  }
+
+  QTest::qFail("No pending ping", __FILE__, __LINE__);
+  return 0;
+}
+
+void TestServerLatency::init() {
+  TestHelper::controllerState = Controller::StateOff;
+}
+
+void TestServerLatency::cleanup() {
+  TestHelper::controllerState = Controller::StateInitializing;
+}
+
+void TestServerLatency::demultiplex() {
+  SettingsHolder settingsHolder;
+
+  ServerCountryModel model;
+  model.setSnapshotFileName(QString());
+  QVERIFY(model.fromJson(
+      serverList({{"keyA", "192.0.2.1"}, {"keyB", "192.0.2.2"}})));
+
+  Controller controller;
+  ServerLatency latency;
+  latency.initialize(&model, &controller);
+  QSignalSpy spy(&latency, &ServerLatency::updated);
+
+  latency.refresh();
+  QVERIFY(latency.isRefreshing());
+
+  PingSender* sender = latency.findChild<PingSender*>();
+  QVERIFY(sender);
+
+  quint16 sequenceA = pendingSequence(latency, "192.0.2.1");
+  quint16 sequenceB = pendingSequence(latency, "192.0.2.2");
+  QVERIFY(sequenceA != sequenceB);
+
+  // The sequence number of one server, from the other one.
+  emit sender->recvPingReply("192.0.2.2", sequenceA, 5000);
+  // A host which has not been pinged.
+  emit sender->recvPingReply("198.51.100.1", sequenceB, 5000);
+  QCOMPARE(latency.latency("keyA"), 0u);
+  QCOMPARE(latency.latency("keyB"), 0u);
+  QVERIFY(latency.isRefreshing());
+
+  emit sender->recvPingReply("192.0.2.1", sequenceA, 10000);
+  QCOMPARE(latency.latency("keyA"), 10u);
+  QCOMPARE(latency.latency("keyB"), 0u);
+  QCOMPARE(spy.count(), 0);
+
+  emit sender->recvPingReply("192.0.2.2", sequenceB, 30000);
+  QCOMPARE(latency.latency("keyB"), 30u);
+  QCOMPARE(latency.loss("keyA"), 0.0);
+  QCOMPARE(spy.count(), 1);
+  QVERIFY(!latency.isRefreshing());
+}
+
+void TestServerLatency::staleReplies() {
+  SettingsHolder settingsHolder;
+
+  ServerCountryModel model;
+  model.setSnapshotFileName(QString());
+  QVERIFY(model.fromJson(serverList({{"keyA", "192.0.2.1"}})));
+
+  Controller controller;
+  ServerLatency latency;
+  latency.initialize(&model, &controller);
+
+  latency.refresh();
+  quint16 first = pendingSequence(latency, "192.0.2.1");
+  emit latency.findChild<PingSender*>()->recvPingReply("192.0.2.1", first,
+                                                       10000);
+  QVERIFY(!latency.isRefreshing());
+  QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+
+  latency.refresh();
+  PingSender* sender = latency.findChild<PingSender*>();
+  QVERIFY(sender);
+  quint16 second = pendingSequence(latency, "192.0.2.1");
+  QVERIFY(first != second);
+
+  // The reply to the previous refresh arrives late.
+  emit sender->recvPingReply("192.0.2.1", first, 90000);
+  QCOMPARE(latency.latency("keyA"), 10u);
+  QVERIFY(latency.isRefreshing());
+
+  emit sender->recvPingReply("192.0.2.1", second, 10000);
+  QCOMPARE(latency.latency("keyA"), 10u);
+  QVERIFY(!latency.isRefreshing());
+}
+
+void TestServerLatency::timeout() {
+  SettingsHolder settingsHolder;
+
+  ServerCountryModel model;
+  model.setSnapshotFileName(QString());
+  QVERIFY(model.fromJson(
+      serverList({{"keyA", "192.0.2.1"}, {"keyB", "192.0.2.2"}})));
+
+  Controller controller;
+  ServerLatency latency;
+  latency.initialize(&model, &controller);
+  QSignalSpy spy(&latency, &ServerLatency::updated);
+
+  latency.refresh();
+  emit latency.findChild<PingSender*>()->recvPingReply(
+      "192.0.2.1", pendingSequence(latency, "192.0.2.1"), 10000);
+
+  // Age the ping still pending, as if the timeout had expired.
+  for (auto i = latency.m_pending.begin(); i != latency.m_pending.end(); ++i) {
+    i->timestamp -= 60000;
+  }
+  latency.sendPings();
+
+  QCOMPARE(spy.count(), 1);
+  QVERIFY(!latency.isRefreshing());
+  QCOMPARE(latency.loss("keyA"), 0.0);
+  QVERIFY(latency.loss("keyB") > 0);
+  QCOMPARE(latency.latency("keyB"), 0u);
+}
+
+void TestServerLatency::cancelOnActivation() {
+  SettingsHolder settingsHolder;
+
+  ServerCountryModel model;
+  model.setSnapshotFileName(QString());
+  QVERIFY(model.fromJson(serverList({{"keyA", "192.0.2.1"}})));
+
+  Controller controller;
+  ServerLatency latency;
+  latency.initialize(&model, &controller);
+  QSignalSpy spy(&latency, &ServerLatency::updated);
+
+  // Other state changes don't interrupt the refresh.
+  latency.refresh();
+  QVERIFY(latency.isRefreshing());
+  emit controller.stateChanged();
+  QVERIFY(latency.isRefreshing());
+
+  quint16 sequence = pendingSequence(latency, "192.0.2.1");
+  PingSender* sender = latency.findChild<PingSender*>();
+
+  TestHelper::controllerState = Controller::StateOn;
+  emit controller.stateChanged();
+  QVERIFY(!latency.isRefreshing());
+  QVERIFY(latency.m_pending.isEmpty());
+
+  // The replies which arrive afterwards would have gone through the tunnel.
+  emit sender->recvPingReply("192.0.2.1", sequence, 10000);
+  QCOMPARE(latency.latency("keyA"), 0u);
+  QCOMPARE(spy.count(), 0);
+
+  // No refresh while the VPN is on.
+  latency.refresh();
+  QVERIFY(!latency.isRefreshing());
+}
+
+static TestServerLatency s_testServerLatency;
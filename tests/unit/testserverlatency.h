@@ -0,0 +1,24 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "helper.h"
+
+class ServerLatency;
+
+class TestServerLatency final : public TestHelper {
+  Q_OBJECT
+
+ private:
+  static quint16 pendingSequence(const ServerLatency& latency,
+                                 const QString& address);
+
+ private slots:
+  void init();
+  void cleanup();
+
+  void demultiplex();
+  void staleReplies();
+  void timeout();
+  void cancelOnActivation();
+};
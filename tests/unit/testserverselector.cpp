@@ -0,0 +1,297 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "testserverselector.h"
+#include "../../src/controller.h"
+#include "../../src/models/servercountrymodel.h"
+#include "../../src/models/serverdata.h"
+#include "../../src/pingsender.h"
+#include "../../src/serverlatency.h"
+#include "../../src/serverselector.h"
+#include "../../src/settingsholder.h"
+#include "helper.h"
+
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+
+namespace {
+
+constexpr int PICKS = 2000;
+
+QJsonObject serverJson(const QString& publicKey, const QString& address,
+                       int weight) {
+  QJsonObject server;
+  server.insert("hostname", "hostname-" + publicKey);
+  server.insert("ipv4_addr_in", address);
+  server.insert("ipv4_gateway", "10.64.0.1");
+  server.insert("ipv6_addr_in", "::1");
+  server.insert("ipv6_gateway", "::1");
+  server.insert("public_key", publicKey);
+  server.insert("weight", weight);
+  server.insert("port_ranges", QJsonArray{QJsonArray{1, 10}});
+  return server;
+}
+
+QJsonObject countryJson(const QString& code, const QJsonArray& servers) {
+  QJsonObject city;
+  city.insert("code", "city-" + code);
+  city.insert("name", "City " + code);
+  city.insert("latitude", 12.34);
+  city.insert("longitude", 34.56);
+  city.insert("servers", servers);
+
+  QJsonObject country;
+  country.insert("code", code);
+  country.insert("name", "Country " + code);
+  country.insert("cities", QJsonArray{city});
+  return country;
+}
+
+QByteArray serverListJson(const QJsonArray& countries) {
+  QJsonObject obj;
+  obj.insert("countries", countries);
+  return QJsonDocument(obj).toJson();
+}
+
+// Two servers with the same weight in "aa", one in "bb".
+QByteArray defaultServerList() {
+  return serverListJson(
+      {countryJson("aa", {serverJson("keyA", "192.0.2.1", 100),
+                          serverJson("keyB", "192.0.2.2", 100)}),
+       countryJson("bb", {serverJson("keyC", "192.0.2.3", 100)})});
+}
+
+// How many times each server of "aa" is picked.
+QHash<QString, int> countPicks(ServerSelector& selector) {
+  QHash<QString, int> counts;
+  for (int i = 0; i < PICKS; ++i) {
+    counts[selector.pick("aa", "City aa").publicKey()]++;
+  }
+  return counts;
+}
+
+}  // namespace
+
+void TestServerSelector::init() {
+  TestHelper::controllerState = Controller::StateOff;
+}
+
+void TestServerSelector::cleanup() {
+  TestHelper::controllerState = Controller::StateInitializing;
+}
+
+void TestServerSelector::deterministic() {
+  SettingsHolder settingsHolder;
+
+  ServerCountryModel model;
+  model.setSnapshotFileName(QString());
+  QVERIFY(model.fromJson(defaultServerList()));
+
+  Controller controller;
+  ServerLatency latency;
+  latency.initialize(&model, &controller);
+
+  QRandomGenerator first(42);
+  ServerSelector a;
+  a.initialize(&model, &latency);
+  a.m_generator = &first;
+
+  QRandomGenerator second(42);
+  ServerSelector b;
+  b.initialize(&model, &latency);
+  b.m_generator = &second;
+
+  for (int i = 0; i < 100; ++i) {
+    QCOMPARE(a.pick("aa", "City aa").publicKey(),
+             b.pick("aa", "City aa").publicKey());
+  }
+
+  QCOMPARE(a.serverCount("aa", "City aa"), 2);
+  QCOMPARE(a.serverCount("zz", "City zz"), 0);
+  QVERIFY(!a.pick("zz", "City zz").initialized());
+}
+
+void TestServerSelector::excluded() {
+  SettingsHolder settingsHolder;
+
+  ServerCountryModel model;
+  model.setSnapshotFileName(QString());
+  QVERIFY(model.fromJson(defaultServerList()));
+
+  Controller controller;
+  ServerLatency latency;
+  latency.initialize(&model, &controller);
+
+  QRandomGenerator generator(42);
+  ServerSelector selector;
+  selector.initialize(&model, &latency);
+  selector.m_generator = &generator;
+
+  // Even when the excluded server takes most of the weight.
+  selector.recordFailure("keyB");
+  selector.recordFailure("keyB");
+  for (int i = 0; i < 100; ++i) {
+    QCOMPARE(selector.pick("aa", "City aa", "keyA").publicKey(), "keyB");
+  }
+
+  // The only server of the city.
+  QVERIFY(!selector.pick("bb", "City bb", "keyC").initialized());
+}
+
+void TestServerSelector::failurePenalty() {
+  SettingsHolder settingsHolder;
+
+  ServerCountryModel model;
+  model.setSnapshotFileName(QString());
+  QVERIFY(model.fromJson(defaultServerList()));
+
+  Controller controller;
+  ServerLatency latency;
+  latency.initialize(&model, &controller);
+
+  QRandomGenerator generator(42);
+  ServerSelector selector;
+  selector.initialize(&model, &latency);
+  selector.m_generator = &generator;
+
+  const QList<Server> servers =
+      model.countries().at(0).cities().at(0).servers();
+  const Server& serverA = servers.at(0);
+  const Server& serverB = servers.at(1);
+  QCOMPARE(serverA.publicKey(), "keyA");
+  QCOMPARE(selector.score(serverA), selector.score(serverB));
+
+  // Each failure divides the score by 10.
+  selector.recordFailure("keyA");
+  QVERIFY(qFuzzyCompare(selector.score(serverA) * 10, selector.score(serverB)));
+
+  QHash<QString, int> counts = countPicks(selector);
+  // Expected: 1/11 of the picks.
+  QVERIFY2(counts["keyA"] > 120 && counts["keyA"] < 250,
+           qPrintable(QString::number(counts["keyA"])));
+
+  selector.recordFailure("keyA");
+  QVERIFY(
+      qFuzzyCompare(selector.score(serverA) * 100, selector.score(serverB)));
+
+  counts = countPicks(selector);
+  // Expected: 1/101 of the picks.
+  QVERIFY2(counts["keyA"] < 50, qPrintable(QString::number(counts["keyA"])));
+
+  // A successful connection clears the failures.
+  selector.recordSuccess("keyA");
+  QCOMPARE(selector.score(serverA), selector.score(serverB));
+
+  counts = countPicks(selector);
+  QVERIFY2(counts["keyA"] > 850 && counts["keyA"] < 1150,
+           qPrintable(QString::number(counts["keyA"])));
+}
+
+void TestServerSelector::failureDecay() {
+  SettingsHolder settingsHolder;
+
+  ServerCountryModel model;
+  model.setSnapshotFileName(QString());
+  QVERIFY(model.fromJson(defaultServerList()));
+
+  Controller controller;
+  ServerLatency latency;
+  latency.initialize(&model, &controller);
+
+  QRandomGenerator generator(42);
+  ServerSelector selector;
+  selector.initialize(&model, &latency);
+  selector.m_generator = &generator;
+
+  selector.recordFailure("keyA");
+  selector.recordFailure("keyA");
+  QCOMPARE(selector.m_failures["keyA"].m_count, 2);
+  QVERIFY(countPicks(selector)["keyA"] < 50);
+
+  // Move the failures back in time, past the 10 minutes they count for.
+  qint64 past = QDateTime::currentMSecsSinceEpoch() - 600001;
+  selector.m_failures["keyA"].m_lastFailure = past;
+  selector.m_failureExpiry = past;
+
+  QHash<QString, int> counts = countPicks(selector);
+  QVERIFY(!selector.m_failures.contains("keyA"));
+  QCOMPARE(selector.m_failureExpiry, Q_INT64_C(0));
+  QVERIFY2(counts["keyA"] > 850 && counts["keyA"] < 1150,
+           qPrintable(QString::number(counts["keyA"])));
+
+  // An old failure doesn't add up with a new one.
+  selector.recordFailure("keyA");
+  selector.m_failures["keyA"].m_lastFailure = past;
+  selector.recordFailure("keyA");
+  QCOMPARE(selector.m_failures["keyA"].m_count, 1);
+}
+
+void TestServerSelector::latencyPreference() {
+  SettingsHolder settingsHolder;
+
+  ServerCountryModel model;
+  model.setSnapshotFileName(QString());
+  QVERIFY(model.fromJson(serverListJson(
+      {countryJson("aa", {serverJson("keyA", "192.0.2.1", 100),
+                          serverJson("keyB", "192.0.2.2", 100)})})));
+
+  Controller controller;
+  ServerLatency latency;
+  latency.initialize(&model, &controller);
+
+  QRandomGenerator generator(42);
+  ServerSelector selector;
+  selector.initialize(&model, &latency);
+  selector.m_generator = &generator;
+
+  // A fresh ServerLatency numbers the pings from 0, in the model order.
+  latency.refresh();
+  PingSender* sender = latency.findChild<PingSender*>();
+  QVERIFY(sender);
+  emit sender->recvPingReply("192.0.2.1", 0, 10000);
+  emit sender->recvPingReply("192.0.2.2", 1, 200000);
+  QVERIFY(!latency.isRefreshing());
+  QCOMPARE(latency.latency("keyA"), 10u);
+  QCOMPARE(latency.latency("keyB"), 200u);
+
+  // Scores: 100 * 50 / (50 + 10) and 100 * 50 / (50 + 200).
+  QHash<QString, int> counts = countPicks(selector);
+  double expected = PICKS * (50.0 / 60) / (50.0 / 60 + 50.0 / 250);
+  QVERIFY2(qAbs(counts["keyA"] - expected) < PICKS * 0.05,
+           qPrintable(QString::number(counts["keyA"])));
+}
+
+void TestServerSelector::pickLocation() {
+  SettingsHolder settingsHolder;
+
+  ServerCountryModel model;
+  model.setSnapshotFileName(QString());
+  QVERIFY(model.fromJson(defaultServerList()));
+
+  Controller controller;
+  ServerLatency latency;
+  latency.initialize(&model, &controller);
+
+  QRandomGenerator generator(42);
+  ServerSelector selector;
+  selector.initialize(&model, &latency);
+  selector.m_generator = &generator;
+
+  // "aa" has twice the servers of "bb".
+  int aa = 0;
+  for (int i = 0; i < PICKS; ++i) {
+    ServerData data;
+    QVERIFY(selector.pickLocation(data));
+    if (data.exitCountryCode() == "aa") {
+      ++aa;
+    }
+  }
+  QVERIFY2(aa > PICKS * 0.6 && aa < PICKS * 0.73,
+           qPrintable(QString::number(aa)));
+}
+
+static TestServerSelector s_testServerSelector;
@@ -3,13 +3,38 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include "testtasks.h"
+#include "../../src/constants.h"
 #include "../../src/mozillavpn.h"
 #include "../../src/tasks/account/taskaccount.h"
 #include "../../src/tasks/adddevice/taskadddevice.h"
 #include "../../src/tasks/function/taskfunction.h"
+#include "../../src/tasks/group/taskgroup.h"
 #include "../../src/tasks/servers/taskservers.h"
 #include "../../src/taskscheduler.h"
 
+namespace {
+// Completes only when the test says so.
+class ManualTask final : public Task {
+ public:
+  ManualTask(const QString& name, quint32 resources, Priority priority,
+             QStringList& runs)
+      : Task(name), m_resources(resources), m_priority(priority), m_runs(runs) {}
+
+  quint32 resources() const override { return m_resources; }
+  Priority priority() const override { return m_priority; }
+  bool coalescable() const override { return true; }
+
+  void run() override { m_runs.append(name()); }
+
+  void finish() { emit completed(); }
+
+ private:
+  const quint32 m_resources;
+  const Priority m_priority;
+  QStringList& m_runs;
+};
+}  // namespace
+
 void TestTasks::account() {
   // Failure
   {
@@ -108,6 +133,117 @@ void TestTasks::function() {
   QVERIFY(completed);
 }
 
+void TestTasks::scheduler() {
+  QStringList runs;
+
+  ManualTask* a =
+      new ManualTask("A", Task::ResourceNone, Task::PriorityNormal, runs);
+  ManualTask* b =
+      new ManualTask("B", Task::ResourceNone, Task::PriorityNormal, runs);
+  TaskScheduler::scheduleTask(a);
+  TaskScheduler::scheduleTask(b);
+  QCOMPARE(runs, QStringList({"A", "B"}));
+
+  // Exclusive task: it waits for the running ones, and the next ones wait for
+  // it.
+  ManualTask* barrier =
+      new ManualTask("Barrier", Task::ResourceAll, Task::PriorityNormal, runs);
+  TaskScheduler::scheduleTask(barrier);
+
+  ManualTask* c =
+      new ManualTask("C", Task::ResourceNone, Task::PriorityNormal, runs);
+  TaskScheduler::scheduleTask(c);
+
+  // Coalesced with the pending C.
+  TaskScheduler::scheduleTask(
+      new ManualTask("C", Task::ResourceNone, Task::PriorityNormal, runs));
+
+  // Not coalesced: the other A is running. It runs after it.
+  ManualTask* a2 =
+      new ManualTask("A", Task::ResourceNone, Task::PriorityNormal, runs);
+  TaskScheduler::scheduleTask(a2);
+  QCOMPARE(runs, QStringList({"A", "B"}));
+
+  a->finish();
+  QCOMPARE(runs, QStringList({"A", "B"}));
+
+  b->finish();
+  QCOMPARE(runs, QStringList({"A", "B", "Barrier"}));
+
+  barrier->finish();
+  QCOMPARE(runs, QStringList({"A", "B", "Barrier", "C", "A"}));
+
+  c->finish();
+  a2->finish();
+  QCOMPARE(runs.length(), 5);
+}
+
+void TestTasks::schedulerPriority() {
+  TaskScheduler::setMaxConcurrentTasks(1);
+
+  QStringList runs;
+
+  ManualTask* first =
+      new ManualTask("First", Task::ResourceNone, Task::PriorityNormal, runs);
+  TaskScheduler::scheduleTask(first);
+
+  ManualTask* low =
+      new ManualTask("Low", Task::ResourceNone, Task::PriorityLow, runs);
+  ManualTask* high =
+      new ManualTask("High", Task::ResourceNone, Task::PriorityHigh, runs);
+  TaskScheduler::scheduleTask(low);
+  TaskScheduler::scheduleTask(high);
+  QCOMPARE(runs, QStringList({"First"}));
+
+  first->finish();
+  QCOMPARE(runs, QStringList({"First", "High"}));
+
+  high->finish();
+  QCOMPARE(runs, QStringList({"First", "High", "Low"}));
+
+  low->finish();
+
+  TaskScheduler::setMaxConcurrentTasks(
+      Constants::TASK_SCHEDULER_MAX_CONCURRENT_TASKS);
+}
+
+void TestTasks::schedulerGroup() {
+  QStringList runs;
+
+  ManualTask* a =
+      new ManualTask("A", Task::ResourceNone, Task::PriorityNormal, runs);
+  ManualTask* b = new ManualTask("B", Task::ResourceController,
+                                 Task::PriorityNormal, runs);
+  TaskGroup* group = new TaskGroup({a, b});
+  QCOMPARE(group->resources(), quint32(Task::ResourceController));
+
+  bool groupCompleted = false;
+  connect(group, &Task::completed, [&]() { groupCompleted = true; });
+  TaskScheduler::scheduleTask(group);
+  QCOMPARE(runs, QStringList({"A", "B"}));
+
+  // The group is not flattened: a task with the same name as a subtask is not
+  // coalesced with it, and a task sharing its resources waits for all of it.
+  ManualTask* a2 =
+      new ManualTask("A", Task::ResourceNone, Task::PriorityNormal, runs);
+  ManualTask* c = new ManualTask("C", Task::ResourceController,
+                                 Task::PriorityNormal, runs);
+  TaskScheduler::scheduleTask(a2);
+  TaskScheduler::scheduleTask(c);
+  QCOMPARE(runs, QStringList({"A", "B", "A"}));
+
+  b->finish();
+  QVERIFY(!groupCompleted);
+  QCOMPARE(runs, QStringList({"A", "B", "A"}));
+
+  a->finish();
+  QVERIFY(groupCompleted);
+  QCOMPARE(runs, QStringList({"A", "B", "A", "C"}));
+
+  a2->finish();
+  c->finish();
+}
+
 void TestTasks::removeDevice() {
   // TODO
 }
@@ -18,5 +18,9 @@ class TestTasks final : public TestHelper {
 
   void function();
 
+  void scheduler();
+  void schedulerPriority();
+  void schedulerGroup();
+
   void removeDevice();
 };
@@ -0,0 +1,93 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "testthroughputseries.h"
+#include "../../src/throughputseries.h"
+#include "helper.h"
+
+void TestThroughputSeries::empty() {
+  ThroughputSeries series(4);
+  QCOMPARE(series.capacity(), 4);
+  QCOMPARE(series.count(), 0);
+  QCOMPARE(series.appended(), (quint64)0);
+  QCOMPARE(series.maximum(), (quint64)0);
+}
+
+void TestThroughputSeries::ring() {
+  ThroughputSeries series(3);
+
+  series.append(1, 10);
+  series.append(2, 20);
+  QCOMPARE(series.count(), 2);
+  QCOMPARE(series.at(0).m_txBytes, (quint64)1);
+  QCOMPARE(series.last().m_rxBytes, (quint64)20);
+
+  // The oldest samples are overwritten.
+  series.append(3, 30);
+  series.append(4, 40);
+  series.append(5, 50);
+  QCOMPARE(series.count(), 3);
+  QCOMPARE(series.appended(), (quint64)5);
+  QCOMPARE(series.at(0).m_txBytes, (quint64)3);
+  QCOMPARE(series.at(1).m_txBytes, (quint64)4);
+  QCOMPARE(series.at(2).m_txBytes, (quint64)5);
+  QCOMPARE(series.last().m_rxBytes, (quint64)50);
+}
+
+void TestThroughputSeries::maximum() {
+  ThroughputSeries series(3);
+
+  series.append(5, 1);
+  QCOMPARE(series.maximum(), (quint64)5);
+
+  // Either direction counts.
+  series.append(0, 7);
+  QCOMPARE(series.maximum(), (quint64)7);
+
+  series.append(2, 2);
+  QCOMPARE(series.maximum(), (quint64)7);
+
+  series.append(3, 3);
+  QCOMPARE(series.maximum(), (quint64)7);
+
+  // 7 leaves the window.
+  series.append(1, 1);
+  QCOMPARE(series.maximum(), (quint64)3);
+
+  series.append(0, 0);
+  series.append(0, 0);
+  QCOMPARE(series.maximum(), (quint64)1);
+
+  series.append(0, 0);
+  QCOMPARE(series.maximum(), (quint64)0);
+
+  // A long run, compared to a brute force maximum.
+  for (quint64 i = 0; i < 1000; ++i) {
+    series.append((i * 37) % 101, (i * 53) % 97);
+
+    quint64 expected = 0;
+    for (int pos = 0; pos < series.count(); ++pos) {
+      expected = qMax(expected, series.at(pos).m_txBytes);
+      expected = qMax(expected, series.at(pos).m_rxBytes);
+    }
+    QCOMPARE(series.maximum(), expected);
+  }
+}
+
+void TestThroughputSeries::reset() {
+  ThroughputSeries series(2);
+  series.append(10, 20);
+  series.append(30, 40);
+
+  series.reset();
+  QCOMPARE(series.count(), 0);
+  QCOMPARE(series.appended(), (quint64)0);
+  QCOMPARE(series.maximum(), (quint64)0);
+
+  series.append(1, 2);
+  QCOMPARE(series.count(), 1);
+  QCOMPARE(series.maximum(), (quint64)2);
+}
+
+static TestThroughputSeries s_testThroughputSeries;
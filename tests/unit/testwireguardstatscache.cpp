@@ -0,0 +1,280 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "testwireguardstatscache.h"
+#include "../../src/platforms/linux/daemon/wireguardstatscache.h"
+#include "helper.h"
+
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace {
+
+// From linux/wireguard.h.
+constexpr uint16_t WGDEVICE_A_IFNAME = 2;
+constexpr uint16_t WGDEVICE_A_PEERS = 8;
+constexpr uint16_t WGPEER_A_PUBLIC_KEY = 1;
+constexpr uint16_t WGPEER_A_LAST_HANDSHAKE_TIME = 6;
+constexpr uint16_t WGPEER_A_RX_BYTES = 7;
+constexpr uint16_t WGPEER_A_TX_BYTES = 8;
+constexpr uint16_t WGPEER_A_ALLOWEDIPS = 9;
+
+constexpr uint16_t FAMILY_ID = 42;
+constexpr uint32_t SEQUENCE = 7;
+
+// Monotonic and real time of the samples, in msecs.
+constexpr qint64 NOW = 100000;
+constexpr qint64 REAL_NOW = Q_INT64_C(1600000000000);
+
+QByteArray attr(uint16_t type, const void* data, int len) {
+  struct nlattr header;
+  header.nla_len = NLA_HDRLEN + len;
+  header.nla_type = type;
+
+  QByteArray buffer(reinterpret_cast<const char*>(&header), sizeof(header));
+  buffer.append(static_cast<const char*>(data), len);
+  buffer.append(NLA_ALIGN(len) - len, '\0');
+  return buffer;
+}
+
+QByteArray attrU64(uint16_t type, uint64_t value) {
+  return attr(type, &value, sizeof(value));
+}
+
+QByteArray nested(uint16_t type, const QByteArray& children) {
+  return attr(type | NLA_F_NESTED, children.constData(), children.length());
+}
+
+QByteArray peerKey(char id) {
+  return QByteArray(WireguardStatsCache::KEY_LEN, id);
+}
+
+// The statistics are only in the first part of a peer split across messages.
+QByteArray peer(int index, char id, uint64_t rx, uint64_t tx,
+                int64_t handshakeSec, bool withStats = true) {
+  QByteArray key = peerKey(id);
+  QByteArray children = attr(WGPEER_A_PUBLIC_KEY, key.constData(), key.size());
+  if (withStats) {
+    int64_t handshake[2] = {handshakeSec, handshakeSec ? 500000000 : 0};
+    children += attr(WGPEER_A_LAST_HANDSHAKE_TIME, handshake,
+                     sizeof(handshake));
+    children += attrU64(WGPEER_A_RX_BYTES, rx);
+    children += attrU64(WGPEER_A_TX_BYTES, tx);
+  }
+  children += nested(WGPEER_A_ALLOWEDIPS, attr(1, "\0\0\0\0", 4));
+  return nested(index, children);
+}
+
+QByteArray message(uint16_t type, const QByteArray& payload,
+                   uint32_t sequence = SEQUENCE) {
+  struct nlmsghdr header;
+  memset(&header, 0, sizeof(header));
+  header.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN + payload.length());
+  header.nlmsg_type = type;
+  header.nlmsg_flags = NLM_F_MULTI;
+  header.nlmsg_seq = sequence;
+
+  struct genlmsghdr genl;
+  memset(&genl, 0, sizeof(genl));
+
+  QByteArray buffer(reinterpret_cast<const char*>(&header), sizeof(header));
+  buffer.append(reinterpret_cast<const char*>(&genl), sizeof(genl));
+  buffer.append(payload);
+  buffer.append(NLMSG_ALIGN(buffer.length()) - buffer.length(), '\0');
+  return buffer;
+}
+
+QByteArray device(const QList<QByteArray>& peers) {
+  QByteArray payload = attr(WGDEVICE_A_IFNAME, "wg0\0", 4);
+  QByteArray list;
+  for (const QByteArray& p : peers) {
+    list += p;
+  }
+  return message(FAMILY_ID, payload + nested(WGDEVICE_A_PEERS, list));
+}
+
+QByteArray done() { return message(NLMSG_DONE, QByteArray()); }
+
+QByteArray error(int code) {
+  struct nlmsgerr err;
+  memset(&err, 0, sizeof(err));
+  err.error = -code;
+
+  QByteArray buffer = message(NLMSG_ERROR, QByteArray());
+  // NLMSG_ERROR carries a nlmsgerr instead of the genetlink header.
+  buffer.resize(NLMSG_HDRLEN);
+  buffer.append(reinterpret_cast<const char*>(&err), sizeof(err));
+  reinterpret_cast<struct nlmsghdr*>(buffer.data())->nlmsg_len =
+      buffer.length();
+  return buffer;
+}
+
+const WireguardStatsCache::Peer* findPeer(const WireguardStatsCache& cache,
+                                          char id) {
+  QByteArray key = peerKey(id);
+  return cache.find(reinterpret_cast<const uint8_t*>(key.constData()));
+}
+
+}  // namespace
+
+// static
+bool TestWireguardStatsCache::dump(WireguardStatsCache& cache,
+                                   const QList<QByteArray>& data, qint64 now,
+                                   int& error) {
+  cache.m_familyId = FAMILY_ID;
+  cache.m_sequence = SEQUENCE;
+  ++cache.m_generation;
+
+  error = 0;
+  for (const QByteArray& datagram : data) {
+    if (cache.parseDump(datagram.constData(), datagram.length(), now,
+                        REAL_NOW + (now - NOW), error)) {
+      if (error == 0) {
+        cache.prunePeers();
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+void TestWireguardStatsCache::firstSample() {
+  WireguardStatsCache cache("wg0");
+  int err = 0;
+
+  QVERIFY(dump(cache,
+               {device({peer(0, 'a', 1000, 2000, REAL_NOW / 1000 - 10)}) +
+                done()},
+               NOW, err));
+  QCOMPARE(err, 0);
+  QCOMPARE(cache.peers().length(), 1);
+
+  const WireguardStatsCache::Peer* p = findPeer(cache, 'a');
+  QVERIFY(p);
+  QCOMPARE(p->m_rxBytes, Q_INT64_C(1000));
+  QCOMPARE(p->m_txBytes, Q_INT64_C(2000));
+  QCOMPARE(p->m_handshake, REAL_NOW - 10000 + 500);
+  QCOMPARE(p->m_handshakeAge, Q_INT64_C(9500));
+
+  // A single sample says nothing about the rates.
+  QCOMPARE(p->m_rxRate, Q_INT64_C(-1));
+  QCOMPARE(p->m_txRate, Q_INT64_C(-1));
+
+  QVERIFY(!findPeer(cache, 'b'));
+}
+
+void TestWireguardStatsCache::rates() {
+  WireguardStatsCache cache("wg0");
+  int err = 0;
+
+  QVERIFY(dump(cache, {device({peer(0, 'a', 1000, 2000, 0)}), done()}, NOW,
+               err));
+  QVERIFY(dump(cache, {device({peer(0, 'a', 5000, 3000, 0)}), done()},
+               NOW + 2000, err));
+
+  const WireguardStatsCache::Peer* p = findPeer(cache, 'a');
+  QVERIFY(p);
+  QCOMPARE(p->m_rxRate, Q_INT64_C(2000));
+  QCOMPARE(p->m_txRate, Q_INT64_C(500));
+
+  // No handshake yet.
+  QCOMPARE(p->m_handshake, Q_INT64_C(0));
+  QCOMPARE(p->m_handshakeAge, Q_INT64_C(-1));
+
+  // The counters restart when the peer is replaced.
+  QVERIFY(dump(cache, {device({peer(0, 'a', 100, 100, 0)}), done()},
+               NOW + 3000, err));
+  QCOMPARE(p->m_rxRate, Q_INT64_C(0));
+  QCOMPARE(p->m_txRate, Q_INT64_C(0));
+  QCOMPARE(p->m_rxBytes, Q_INT64_C(100));
+}
+
+void TestWireguardStatsCache::splitPeer() {
+  WireguardStatsCache cache("wg0");
+  int err = 0;
+
+  // The second part of 'a' has no statistics, and comes with 'b'.
+  QVERIFY(dump(cache,
+               {device({peer(0, 'a', 1000, 2000, 0)}),
+                device({peer(0, 'a', 0, 0, 0, false),
+                        peer(1, 'b', 10, 20, 0)}),
+                done()},
+               NOW, err));
+  QCOMPARE(cache.peers().length(), 2);
+
+  const WireguardStatsCache::Peer* a = findPeer(cache, 'a');
+  QVERIFY(a);
+  QCOMPARE(a->m_rxBytes, Q_INT64_C(1000));
+  QCOMPARE(a->m_txBytes, Q_INT64_C(2000));
+
+  const WireguardStatsCache::Peer* b = findPeer(cache, 'b');
+  QVERIFY(b);
+  QCOMPARE(b->m_rxBytes, Q_INT64_C(10));
+}
+
+void TestWireguardStatsCache::removedPeer() {
+  WireguardStatsCache cache("wg0");
+  int err = 0;
+
+  QVERIFY(dump(cache,
+               {device({peer(0, 'a', 1, 1, 0), peer(1, 'b', 2, 2, 0),
+                        peer(2, 'c', 3, 3, 0)}),
+                done()},
+               NOW, err));
+  QCOMPARE(cache.peers().length(), 3);
+
+  QVERIFY(dump(cache,
+               {device({peer(0, 'a', 1, 1, 0), peer(1, 'c', 3, 3, 0)}),
+                done()},
+               NOW + 1000, err));
+  QCOMPARE(cache.peers().length(), 2);
+  QVERIFY(findPeer(cache, 'a'));
+  QVERIFY(!findPeer(cache, 'b'));
+  QVERIFY(findPeer(cache, 'c'));
+  QCOMPARE(findPeer(cache, 'c')->m_rxRate, Q_INT64_C(0));
+
+  QVERIFY(dump(cache, {device({}), done()}, NOW + 2000, err));
+  QVERIFY(cache.peers().isEmpty());
+}
+
+void TestWireguardStatsCache::errors() {
+  WireguardStatsCache cache("wg0");
+  int err = 0;
+
+  // Messages of other requests are ignored.
+  QVERIFY(!dump(cache,
+                {message(FAMILY_ID, QByteArray(), SEQUENCE + 1) +
+                 message(NLMSG_DONE, QByteArray(), SEQUENCE - 1)},
+                NOW, err));
+  QCOMPARE(err, 0);
+
+  QVERIFY(dump(cache, {error(ENODEV)}, NOW, err));
+  QCOMPARE(err, ENODEV);
+}
+
+void TestWireguardStatsCache::malformed() {
+  WireguardStatsCache cache("wg0");
+  int err = 0;
+
+  // A key of the wrong size.
+  QByteArray shortKey = nested(
+      0, attr(WGPEER_A_PUBLIC_KEY, "short", 5) + attrU64(WGPEER_A_RX_BYTES, 1) +
+             attrU64(WGPEER_A_TX_BYTES, 1));
+  QVERIFY(dump(cache, {device({shortKey}), done()}, NOW, err));
+  QVERIFY(cache.peers().isEmpty());
+
+  // An attribute longer than its message is not read.
+  QByteArray truncated = device({peer(0, 'a', 1, 1, 0)});
+  truncated.chop(8);
+  reinterpret_cast<struct nlmsghdr*>(truncated.data())->nlmsg_len =
+      truncated.length();
+  QVERIFY(dump(cache, {truncated, done()}, NOW, err));
+  QCOMPARE(err, 0);
+  QVERIFY(cache.peers().isEmpty());
+}
+
+static TestWireguardStatsCache s_testWireguardStatsCache;
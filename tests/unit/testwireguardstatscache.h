@@ -0,0 +1,24 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "helper.h"
+
+class WireguardStatsCache;
+
+class TestWireguardStatsCache final : public TestHelper {
+  Q_OBJECT
+
+ private:
+  // Feeds the datagrams of a whole dump, as refresh() does.
+  static bool dump(WireguardStatsCache& cache, const QList<QByteArray>& data,
+                   qint64 now, int& error);
+
+ private slots:
+  void firstSample();
+  void rates();
+  void splitPeer();
+  void removedPeer();
+  void errors();
+  void malformed();
+};
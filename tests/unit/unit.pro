@@ -35,7 +35,11 @@ include($$PWD/../../nebula/nebula.pri)
 HEADERS += \
     ../../src/adjust/adjustfiltering.h \
     ../../src/adjust/adjustproxypackagehandler.h \
+    ../../src/aliastable.h \
     ../../src/captiveportal/captiveportal.h \
+    ../../src/captiveportal/captiveportalmonitor.h \
+    ../../src/captiveportal/captiveportalrequest.h \
+    ../../src/captiveportal/captiveportalrequesttask.h \
     ../../src/collator.h \
     ../../src/command.h \
     ../../src/commandlineparser.h \
@@ -48,10 +52,13 @@ HEADERS += \
     ../../src/featurelist.h \
     ../../src/inspector/inspectorwebsocketconnection.h \
     ../../src/ipaddress.h \
+    ../../src/ipprefixset.h \
+    ../../src/jsonstreamparser.h \
     ../../src/leakdetector.h \
     ../../src/localizer.h \
     ../../src/logger.h \
     ../../src/loghandler.h \
+    ../../src/logstore.h \
     ../../src/models/device.h \
     ../../src/models/devicemodel.h \
     ../../src/models/feature.h \
@@ -64,6 +71,7 @@ HEADERS += \
     ../../src/models/servercountry.h \
     ../../src/models/servercountrymodel.h \
     ../../src/models/serverdata.h \
+    ../../src/models/serverlistsnapshot.h \
     ../../src/models/supportcategorymodel.h \
     ../../src/models/survey.h \
     ../../src/models/surveymodel.h \
@@ -72,10 +80,13 @@ HEADERS += \
     ../../src/mozillavpn.h \
     ../../src/networkmanager.h \
     ../../src/networkrequest.h \
+    ../../src/networkresponsecache.h \
     ../../src/networkwatcher.h \
     ../../src/networkwatcherimpl.h \
     ../../src/pinghelper.h \
     ../../src/pingsender.h \
+    ../../src/pingsenderfactory.h \
+    ../../src/pingstats.h \
     ../../src/platforms/android/androiddatamigration.h \
     ../../src/platforms/android/androidsharedprefs.h \
     ../../src/platforms/dummy/dummynetworkwatcher.h \
@@ -87,6 +98,8 @@ HEADERS += \
     ../../src/rfc/rfc4291.h \
     ../../src/rfc/rfc5735.h \
     ../../src/serveri18n.h \
+    ../../src/serverlatency.h \
+    ../../src/serverselector.h \
     ../../src/settingsholder.h \
     ../../src/simplenetworkmanager.h \
     ../../src/statusicon.h \
@@ -95,38 +108,57 @@ HEADERS += \
     ../../src/tasks/adddevice/taskadddevice.h \
     ../../src/tasks/ipfinder/taskipfinder.h \
     ../../src/tasks/function/taskfunction.h \
+    ../../src/tasks/group/taskgroup.h \
     ../../src/tasks/release/taskrelease.h \
     ../../src/tasks/servers/taskservers.h \
     ../../src/taskscheduler.h \
     ../../src/theme.h \
+    ../../src/throughputseries.h \
     ../../src/timersingleshot.h \
+    ../../src/update/resumabledownload.h \
     ../../src/update/updater.h \
     ../../src/update/versionapi.h \
     ../../src/urlopener.h \
     helper.h \
     testadjust.h \
+    testaliastable.h \
     testandroidmigration.h \
+    testcaptiveportal.h \
     testcommandlineparser.h \
     testconnectiondataholder.h \
+    testdaemonstatusframe.h \
     testfeature.h \
     testlocalizer.h \
     testlogger.h \
+    testlogstore.h \
     testipaddress.h \
     testipfinder.h \
+    testipprefixset.h \
+    testjsonstreamparser.h \
     testlicense.h \
     testmodels.h \
     testmozillavpnh.h \
     testnetworkmanager.h \
+    testnetworkresponsecache.h \
+    testpingstats.h \
     testreleasemonitor.h \
+    testresumabledownload.h \
+    testserverlatency.h \
+    testserverselector.h \
     teststatusicon.h \
     testtasks.h \
     testthemes.h \
+    testthroughputseries.h \
     testtimersingleshot.h
 
 SOURCES += \
     ../../src/adjust/adjustfiltering.cpp \
     ../../src/adjust/adjustproxypackagehandler.cpp \
+    ../../src/aliastable.cpp \
     ../../src/captiveportal/captiveportal.cpp \
+    ../../src/captiveportal/captiveportalmonitor.cpp \
+    ../../src/captiveportal/captiveportalrequest.cpp \
+    ../../src/captiveportal/captiveportalrequesttask.cpp \
     ../../src/collator.cpp \
     ../../src/command.cpp \
     ../../src/commandlineparser.cpp \
@@ -141,11 +173,14 @@ SOURCES += \
     ../../src/hacl-star/Hacl_Curve25519_51.c \
     ../../src/hacl-star/Hacl_Poly1305_32.c \
     ../../src/ipaddress.cpp \
+    ../../src/ipprefixset.cpp \
+    ../../src/jsonstreamparser.cpp \
     ../../src/l18nstringsimpl.cpp \
     ../../src/leakdetector.cpp \
     ../../src/localizer.cpp \
     ../../src/logger.cpp \
     ../../src/loghandler.cpp \
+    ../../src/logstore.cpp \
     ../../src/models/device.cpp \
     ../../src/models/devicemodel.cpp \
     ../../src/models/feature.cpp \
@@ -158,14 +193,19 @@ SOURCES += \
     ../../src/models/servercountry.cpp \
     ../../src/models/servercountrymodel.cpp \
     ../../src/models/serverdata.cpp \
+    ../../src/models/serverlistsnapshot.cpp \
     ../../src/models/supportcategorymodel.cpp \
     ../../src/models/survey.cpp \
     ../../src/models/surveymodel.cpp \
     ../../src/models/user.cpp \
     ../../src/models/whatsnewmodel.cpp \
     ../../src/networkmanager.cpp \
+    ../../src/networkresponsecache.cpp \
     ../../src/networkwatcher.cpp \
     ../../src/pinghelper.cpp \
+    ../../src/pingsender.cpp \
+    ../../src/pingsenderfactory.cpp \
+    ../../src/pingstats.cpp \
     ../../src/platforms/android/androiddatamigration.cpp \
     ../../src/platforms/android/androidsharedprefs.cpp \
     ../../src/platforms/dummy/dummynetworkwatcher.cpp \
@@ -177,6 +217,8 @@ SOURCES += \
     ../../src/rfc/rfc4291.cpp \
     ../../src/rfc/rfc5735.cpp \
     ../../src/serveri18n.cpp \
+    ../../src/serverlatency.cpp \
+    ../../src/serverselector.cpp \
     ../../src/settingsholder.cpp \
     ../../src/simplenetworkmanager.cpp \
     ../../src/statusicon.cpp \
@@ -184,11 +226,14 @@ SOURCES += \
     ../../src/tasks/adddevice/taskadddevice.cpp \
     ../../src/tasks/ipfinder/taskipfinder.cpp \
     ../../src/tasks/function/taskfunction.cpp \
+    ../../src/tasks/group/taskgroup.cpp \
     ../../src/tasks/release/taskrelease.cpp \
     ../../src/tasks/servers/taskservers.cpp \
     ../../src/taskscheduler.cpp \
     ../../src/theme.cpp \
+    ../../src/throughputseries.cpp \
     ../../src/timersingleshot.cpp \
+    ../../src/update/resumabledownload.cpp \
     ../../src/update/updater.cpp \
     ../../src/update/versionapi.cpp \
     ../../src/urlopener.cpp \
@@ -198,22 +243,34 @@ SOURCES += \
     mocmozillavpn.cpp \
     mocnetworkrequest.cpp \
     testadjust.cpp \
+    testaliastable.cpp \
     testandroidmigration.cpp \
+    testcaptiveportal.cpp \
     testcommandlineparser.cpp \
     testconnectiondataholder.cpp \
+    testdaemonstatusframe.cpp \
     testfeature.cpp \
     testlocalizer.cpp \
     testlogger.cpp \
+    testlogstore.cpp \
     testipaddress.cpp \
     testipfinder.cpp \
+    testipprefixset.cpp \
+    testjsonstreamparser.cpp \
     testlicense.cpp \
     testmodels.cpp \
     testmozillavpnh.cpp \
     testnetworkmanager.cpp \
+    testnetworkresponsecache.cpp \
+    testpingstats.cpp \
     testreleasemonitor.cpp \
+    testresumabledownload.cpp \
+    testserverlatency.cpp \
+    testserverselector.cpp \
     teststatusicon.cpp \
     testtasks.cpp \
     testthemes.cpp \
+    testthroughputseries.cpp \
     testtimersingleshot.cpp
 
 exists($$PWD/../../translations/generated/l18nstrings.h) {
@@ -226,6 +283,36 @@ exists($$PWD/../../translations/generated/l18nstrings.h) {
 # Platform-specific: Linux
 linux {
     # QMAKE_CXXFLAGS *= -Werror
+
+    HEADERS += \
+        ../../src/platforms/linux/daemon/cgroupmigrator.h \
+        ../../src/platforms/linux/daemon/cgroupsockmark.h \
+        ../../src/platforms/linux/daemon/netlinktransaction.h \
+        ../../src/platforms/linux/daemon/pathmtuprober.h \
+        ../../src/platforms/linux/daemon/pidtracker.h \
+        ../../src/platforms/linux/daemon/wireguardstatscache.h \
+        ../../src/platforms/linux/linuxpingsender.h \
+        testcgroupmigrator.h \
+        testcgroupsockmark.h \
+        testnetlinktransaction.h \
+        testpathmtuprober.h \
+        testpidtracker.h \
+        testwireguardstatscache.h
+
+    SOURCES += \
+        ../../src/platforms/linux/daemon/cgroupmigrator.cpp \
+        ../../src/platforms/linux/daemon/cgroupsockmark.cpp \
+        ../../src/platforms/linux/daemon/netlinktransaction.cpp \
+        ../../src/platforms/linux/daemon/pathmtuprober.cpp \
+        ../../src/platforms/linux/daemon/pidtracker.cpp \
+        ../../src/platforms/linux/daemon/wireguardstatscache.cpp \
+        ../../src/platforms/linux/linuxpingsender.cpp \
+        testcgroupmigrator.cpp \
+        testcgroupsockmark.cpp \
+        testnetlinktransaction.cpp \
+        testpathmtuprober.cpp \
+        testpidtracker.cpp \
+        testwireguardstatscache.cpp
 }
 
 # Platform-specific: MacOS
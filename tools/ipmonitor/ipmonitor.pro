@@ -20,15 +20,19 @@ else:linux:!android {
 
 HEADERS += \
         ../../src/ipaddress.h \
+        ../../src/ipprefixset.h \
         ../../src/leakdetector.h \
         ../../src/loghandler.h \
+        ../../src/logstore.h \
         ../../src/logger.h \
         ../../src/rfc/rfc1918.h
 SOURCES += \
         main.cpp \
         ../../src/ipaddress.cpp \
+        ../../src/ipprefixset.cpp \
         ../../src/leakdetector.cpp \
         ../../src/loghandler.cpp \
+        ../../src/logstore.cpp \
         ../../src/logger.cpp \
         ../../src/rfc/rfc1918.cpp
 